@@ -106,6 +106,22 @@ if [ $have_pthread -eq 0 ] && [ "$uname" != "Darwin" ]; then
    fi
 fi
 
+# the codecs for the binlog compression
+for inc_path in /usr/include /usr/local/include; do
+  if [ -f $inc_path/zlib.h ]; then
+    CFLAGS="$CFLAGS -DFDIR_WITH_ZLIB"
+    LIBS="$LIBS -lz"
+    break
+  fi
+done
+for inc_path in /usr/include /usr/local/include; do
+  if [ -f $inc_path/lz4.h ]; then
+    CFLAGS="$CFLAGS -DFDIR_WITH_LZ4"
+    LIBS="$LIBS -llz4"
+    break
+  fi
+done
+
 cd src/server
 cp Makefile.in Makefile
 perl -pi -e "s#\\\$\(CFLAGS\)#$CFLAGS#g" Makefile
@@ -114,6 +130,14 @@ perl -pi -e "s#\\\$\(TARGET_PREFIX\)#$TARGET_PREFIX#g" Makefile
 perl -pi -e "s#\\\$\(TARGET_CONF_PATH\)#$TARGET_CONF_PATH#g" Makefile
 make $1 $2
 
+cd tools
+cp Makefile.in Makefile
+perl -pi -e "s#\\\$\(CFLAGS\)#$CFLAGS#g" Makefile
+perl -pi -e "s#\\\$\(LIBS\)#$LIBS#g" Makefile
+perl -pi -e "s#\\\$\(TARGET_PREFIX\)#$TARGET_PREFIX#g" Makefile
+make $1 $2
+cd ..
+
 cd ../client
 cp Makefile.in Makefile
 perl -pi -e "s#\\\$\(CFLAGS\)#$CFLAGS#g" Makefile
@@ -5,6 +5,7 @@
 #include "fastcommon/logger.h"
 #include "fastcommon/connection_pool.h"
 #include "client_global.h"
+#include "client_mux.h"
 #include "client_func.h"
 
 static int copy_dir_servers(FDIRServerGroup *server_group,
@@ -76,6 +77,32 @@ int fdir_load_server_group_ex(FDIRServerGroup *server_group,
     return 0;
 }
 
+/* the mux connection is to the master, which is the first server
+   as get_master_connection does */
+static int fdir_client_init_mux(FDIRServerCluster *server_cluster)
+{
+    int bytes;
+    int result;
+
+    bytes = sizeof(FDIRMuxConnection);
+    server_cluster->mux = (FDIRMuxConnection *)malloc(bytes);
+    if (server_cluster->mux == NULL) {
+        logError("file: "__FILE__", line: %d, "
+            "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+
+    if ((result=fdir_mux_connection_init(server_cluster->mux,
+                    server_cluster->server_group.servers,
+                    g_client_global_vars.connect_timeout,
+                    g_client_global_vars.network_timeout)) != 0)
+    {
+        free(server_cluster->mux);
+        server_cluster->mux = NULL;
+    }
+    return result;
+}
+
 static int fdir_client_do_init_ex(FDIRServerCluster *server_cluster,
         const char *conf_filename, IniContext *iniContext)
 {
@@ -123,18 +150,31 @@ static int fdir_client_do_init_ex(FDIRServerCluster *server_cluster,
         return result;
     }
 
+    server_cluster->thread_route.enabled = iniGetBoolValue(NULL,
+            "route_by_thread", iniContext, false);
+
+    if (iniGetBoolValue(NULL, "multiplex_connection", iniContext, false)) {
+        if ((result=fdir_client_init_mux(server_cluster)) != 0) {
+            return result;
+        }
+    }
+
 #ifdef DEBUG_FLAG
     logDebug("FastDIR v%d.%02d, "
             "base_path=%s, "
             "connect_timeout=%d, "
             "network_timeout=%d, "
-            "dir_server_count=%d",
+            "dir_server_count=%d, "
+            "route_by_thread=%d, "
+            "multiplex_connection=%d",
             g_fdir_global_vars.version.major,
             g_fdir_global_vars.version.minor,
             g_client_global_vars.base_path,
             g_client_global_vars.connect_timeout,
             g_client_global_vars.network_timeout,
-            server_cluster->server_group.count);
+            server_cluster->server_group.count,
+            server_cluster->thread_route.enabled,
+            server_cluster->mux != NULL);
 #endif
 
     return 0;
@@ -166,6 +206,25 @@ void fdir_client_destroy_ex(FDIRServerCluster *server_cluster)
         return;
     }
 
+    if (server_cluster->thread_route.conns != NULL) {
+        ConnectionInfo *conn;
+        ConnectionInfo *end;
+
+        end = server_cluster->thread_route.conns +
+            server_cluster->thread_route.work_threads;
+        for (conn=server_cluster->thread_route.conns; conn<end; conn++) {
+            if (conn->sock >= 0) {
+                conn_pool_disconnect_server(conn);
+            }
+        }
+        free(server_cluster->thread_route.conns);
+    }
+
+    if (server_cluster->mux != NULL) {
+        fdir_mux_connection_destroy(server_cluster->mux);
+        free(server_cluster->mux);
+    }
+
     free(server_cluster->server_group.servers);
     if (server_cluster->slave_group.servers != NULL) {
         free(server_cluster->slave_group.servers);
@@ -0,0 +1,423 @@
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "fastcommon/shared_func.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/sockopt.h"
+#include "fastcommon/pthread_func.h"
+#include "fastcommon/connection_pool.h"
+#include "fdir_proto.h"
+#include "client_mux.h"
+
+#define MUX_WAITER_BUCKET(mconn, req_id) \
+    ((mconn)->waiters + ((unsigned int)(req_id)) % FDIR_MUX_WAITER_BUCKETS)
+
+static void mux_add_waiter(FDIRMuxConnection *mconn, FDIRMuxWaiter *waiter)
+{
+    FDIRMuxWaiter **bucket;
+
+    bucket = MUX_WAITER_BUCKET(mconn, waiter->req_id);
+    waiter->next = *bucket;
+    *bucket = waiter;
+}
+
+static FDIRMuxWaiter *mux_remove_waiter(FDIRMuxConnection *mconn,
+        const int req_id)
+{
+    FDIRMuxWaiter **bucket;
+    FDIRMuxWaiter *previous;
+    FDIRMuxWaiter *waiter;
+
+    bucket = MUX_WAITER_BUCKET(mconn, req_id);
+    previous = NULL;
+    waiter = *bucket;
+    while (waiter != NULL && waiter->req_id != req_id) {
+        previous = waiter;
+        waiter = waiter->next;
+    }
+
+    if (waiter != NULL) {
+        if (previous == NULL) {
+            *bucket = waiter->next;
+        } else {
+            previous->next = waiter->next;
+        }
+    }
+    return waiter;
+}
+
+static inline void mux_notify_waiter(FDIRMuxWaiter *waiter, const int result)
+{
+    waiter->result = result;
+    waiter->done = true;
+    pthread_cond_signal(&waiter->cond);
+}
+
+static void mux_fail_all_waiters(FDIRMuxConnection *mconn, const int result)
+{
+    FDIRMuxWaiter **bucket;
+    FDIRMuxWaiter **end;
+    FDIRMuxWaiter *waiter;
+
+    pthread_mutex_lock(&mconn->lock);
+    end = mconn->waiters + FDIR_MUX_WAITER_BUCKETS;
+    for (bucket=mconn->waiters; bucket<end; bucket++) {
+        while (*bucket != NULL) {
+            waiter = *bucket;
+            *bucket = waiter->next;
+
+            waiter->response->error.length = snprintf(
+                    waiter->response->error.message,
+                    sizeof(waiter->response->error.message),
+                    "connection to server %s:%d broken, "
+                    "errno: %d, error info: %s", mconn->conn.ip_addr,
+                    mconn->conn.port, result, STRERROR(result));
+            mux_notify_waiter(waiter, result);
+        }
+    }
+    pthread_mutex_unlock(&mconn->lock);
+}
+
+/* the waiters are failed under send_lock, so the request sent on the
+   new connection is never failed by the close of the old one */
+static void mux_close_connection(FDIRMuxConnection *mconn, const int result)
+{
+    pthread_mutex_lock(&mconn->send_lock);
+    if (mconn->conn.sock >= 0) {
+        conn_pool_disconnect_server(&mconn->conn);
+    }
+    mux_fail_all_waiters(mconn, result);
+    pthread_mutex_unlock(&mconn->send_lock);
+}
+
+//receive until done or error, the read timeout is not an error
+static int mux_recv_data(FDIRMuxConnection *mconn, char *data, const int size)
+{
+    int received;
+    int count;
+    int result;
+
+    received = 0;
+    while (received < size && mconn->running) {
+        result = tcprecvdata_nb_ex(mconn->conn.sock, data + received,
+                size - received, mconn->network_timeout, &count);
+        received += count;
+        if (result != 0 && result != ETIMEDOUT) {
+            return result;
+        }
+    }
+
+    return received == size ? 0 : EINTR;
+}
+
+static int mux_skip_data(FDIRMuxConnection *mconn, const int size)
+{
+    char buff[4 * 1024];
+    int remain;
+    int bytes;
+    int result;
+
+    remain = size;
+    while (remain > 0) {
+        bytes = remain < sizeof(buff) ? remain : sizeof(buff);
+        if ((result=mux_recv_data(mconn, buff, bytes)) != 0) {
+            return result;
+        }
+        remain -= bytes;
+    }
+
+    return 0;
+}
+
+static int mux_deal_response(FDIRMuxConnection *mconn,
+        FDIRHeaderInfo *header, FDIRMuxWaiter *waiter)
+{
+    FDIRResponseInfo *response;
+    int result;
+
+    response = waiter->response;
+    response->header = *header;
+    if (header->status != 0) {
+        if (header->body_len >= sizeof(response->error.message)) {
+            response->error.length = sizeof(response->error.message) - 1;
+        } else {
+            response->error.length = header->body_len;
+        }
+        if ((result=mux_recv_data(mconn, response->error.message,
+                        response->error.length)) != 0)
+        {
+            return result;
+        }
+        response->error.message[response->error.length] = '\0';
+        waiter->result = header->status;
+        return mux_skip_data(mconn, header->body_len -
+                response->error.length);
+    }
+
+    if (header->cmd != waiter->expect_cmd) {
+        response->error.length = sprintf(response->error.message,
+                "response cmd: %d != expect: %d",
+                header->cmd, waiter->expect_cmd);
+        waiter->result = EINVAL;
+        return mux_skip_data(mconn, header->body_len);
+    }
+
+    if (header->body_len != waiter->expect_body_len) {
+        response->error.length = snprintf(response->error.message,
+                sizeof(response->error.message),
+                "server %s:%d, response body length: %d != %d",
+                mconn->conn.ip_addr, mconn->conn.port,
+                header->body_len, waiter->expect_body_len);
+        waiter->result = EINVAL;
+        return mux_skip_data(mconn, header->body_len);
+    }
+
+    waiter->result = 0;
+    if (header->body_len == 0) {
+        return 0;
+    }
+    return mux_recv_data(mconn, waiter->recv_data, header->body_len);
+}
+
+static int mux_wait_connected(FDIRMuxConnection *mconn)
+{
+    struct timespec ts;
+
+    pthread_mutex_lock(&mconn->lock);
+    while (mconn->conn.sock < 0 && mconn->running) {
+        ts.tv_sec = time(NULL) + 1;
+        ts.tv_nsec = 0;
+        pthread_cond_timedwait(&mconn->cond, &mconn->lock, &ts);
+    }
+    pthread_mutex_unlock(&mconn->lock);
+    return mconn->running ? 0 : EINTR;
+}
+
+static void *mux_receiver_thread(void *arg)
+{
+    FDIRMuxConnection *mconn;
+    FDIRProtoHeader proto_header;
+    FDIRHeaderInfo header;
+    FDIRMuxWaiter *waiter;
+    int result;
+
+    mconn = (FDIRMuxConnection *)arg;
+    while (mconn->running) {
+        if (mux_wait_connected(mconn) != 0) {
+            break;
+        }
+
+        if ((result=mux_recv_data(mconn, (char *)&proto_header,
+                        sizeof(FDIRProtoHeader))) != 0)
+        {
+            if (mconn->running) {
+                mux_close_connection(mconn, result);
+            }
+            continue;
+        }
+
+        if (!FDIR_PROTO_CHECK_MAGIC(proto_header.magic)) {
+            logError("file: "__FILE__", line: %d, "
+                    "server %s:%d, magic "FDIR_PROTO_MAGIC_FORMAT
+                    " is invalid, expect: "FDIR_PROTO_MAGIC_FORMAT,
+                    __LINE__, mconn->conn.ip_addr, mconn->conn.port,
+                    FDIR_PROTO_MAGIC_PARAMS(proto_header.magic),
+                    FDIR_PROTO_MAGIC_EXPECT_PARAMS);
+            mux_close_connection(mconn, EINVAL);
+            continue;
+        }
+
+        fdir_proto_extract_header(&proto_header, &header);
+        pthread_mutex_lock(&mconn->lock);
+        waiter = mux_remove_waiter(mconn, header.req_id);
+        pthread_mutex_unlock(&mconn->lock);
+
+        if (waiter == NULL) {  //the waiter timed out
+            result = mux_skip_data(mconn, header.body_len);
+        } else {
+            result = mux_deal_response(mconn, &header, waiter);
+            if (result != 0) {
+                waiter->result = result;
+            }
+
+            pthread_mutex_lock(&mconn->lock);
+            mux_notify_waiter(waiter, waiter->result);
+            pthread_mutex_unlock(&mconn->lock);
+        }
+
+        if (result != 0 && mconn->running) {
+            mux_close_connection(mconn, result);
+        }
+    }
+
+    return NULL;
+}
+
+int fdir_mux_connection_init(FDIRMuxConnection *mconn,
+        const ConnectionInfo *server, const int connect_timeout,
+        const int network_timeout)
+{
+    int result;
+
+    memset(mconn, 0, sizeof(FDIRMuxConnection));
+    mconn->conn = *server;
+    mconn->conn.sock = -1;
+    mconn->connect_timeout = connect_timeout;
+    mconn->network_timeout = network_timeout;
+    if ((result=init_pthread_lock(&mconn->send_lock)) != 0) {
+        return result;
+    }
+    if ((result=init_pthread_lock(&mconn->lock)) != 0) {
+        return result;
+    }
+    if ((result=pthread_cond_init(&mconn->cond, NULL)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_cond_init fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+
+    mconn->running = true;
+    if ((result=fc_create_thread(&mconn->recv_tid, mux_receiver_thread,
+                    mconn, 64 * 1024)) != 0)
+    {
+        mconn->running = false;
+        return result;
+    }
+
+    return 0;
+}
+
+void fdir_mux_connection_destroy(FDIRMuxConnection *mconn)
+{
+    mconn->running = false;
+    pthread_mutex_lock(&mconn->lock);
+    pthread_cond_signal(&mconn->cond);
+    pthread_mutex_unlock(&mconn->lock);
+
+    pthread_mutex_lock(&mconn->send_lock);
+    if (mconn->conn.sock >= 0) {
+        shutdown(mconn->conn.sock, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&mconn->send_lock);
+
+    pthread_join(mconn->recv_tid, NULL);
+    mux_close_connection(mconn, EINTR);
+
+    pthread_cond_destroy(&mconn->cond);
+    pthread_mutex_destroy(&mconn->lock);
+    pthread_mutex_destroy(&mconn->send_lock);
+}
+
+static int mux_send_request(FDIRMuxConnection *mconn, FDIRMuxWaiter *waiter,
+        char *send_data, const int send_len, FDIRResponseInfo *response)
+{
+    int result;
+
+    pthread_mutex_lock(&mconn->send_lock);
+    do {
+        /* failed by the close of the connection before sending,
+           the request MUST NOT be sent since the caller gets the error */
+        pthread_mutex_lock(&mconn->lock);
+        result = waiter->done ? waiter->result : 0;
+        pthread_mutex_unlock(&mconn->lock);
+        if (result != 0) {
+            break;
+        }
+
+        if (mconn->conn.sock < 0) {
+            if ((result=conn_pool_connect_server(&mconn->conn,
+                            mconn->connect_timeout)) != 0)
+            {
+                response->error.length = snprintf(response->error.message,
+                        sizeof(response->error.message),
+                        "connect to server %s:%d fail, "
+                        "errno: %d, error info: %s", mconn->conn.ip_addr,
+                        mconn->conn.port, result, STRERROR(result));
+                break;
+            }
+
+            pthread_mutex_lock(&mconn->lock);
+            pthread_cond_signal(&mconn->cond);
+            pthread_mutex_unlock(&mconn->lock);
+        }
+
+        if ((result=tcpsenddata_nb(mconn->conn.sock, send_data, send_len,
+                        mconn->network_timeout)) != 0)
+        {
+            response->error.length = snprintf(response->error.message,
+                    sizeof(response->error.message),
+                    "send data to server %s:%d fail, "
+                    "errno: %d, error info: %s", mconn->conn.ip_addr,
+                    mconn->conn.port, result, STRERROR(result));
+
+            //the receiver will close the connection
+            shutdown(mconn->conn.sock, SHUT_RDWR);
+        }
+    } while (0);
+    pthread_mutex_unlock(&mconn->send_lock);
+
+    return result;
+}
+
+int fdir_mux_send_and_recv_response(FDIRMuxConnection *mconn,
+        char *send_data, const int send_len, FDIRResponseInfo *response,
+        const unsigned char expect_cmd, char *recv_data,
+        const int expect_body_len)
+{
+    FDIRMuxWaiter waiter;
+    struct timespec ts;
+    int result;
+
+    waiter.req_id = __sync_add_and_fetch(&mconn->next_req_id, 1);
+    waiter.done = false;
+    waiter.result = 0;
+    waiter.expect_cmd = expect_cmd;
+    waiter.recv_data = recv_data;
+    waiter.expect_body_len = expect_body_len;
+    waiter.response = response;
+    if ((result=pthread_cond_init(&waiter.cond, NULL)) != 0) {
+        return result;
+    }
+    FDIR_PROTO_SET_REQ_ID((FDIRProtoHeader *)send_data, waiter.req_id);
+
+    pthread_mutex_lock(&mconn->lock);
+    mux_add_waiter(mconn, &waiter);
+    pthread_mutex_unlock(&mconn->lock);
+
+    result = mux_send_request(mconn, &waiter, send_data,
+            send_len, response);
+
+    pthread_mutex_lock(&mconn->lock);
+    if (result != 0) {
+        //the waiter maybe removed by the receiver already
+        if (mux_remove_waiter(mconn, waiter.req_id) != NULL) {
+            waiter.done = true;
+            waiter.result = result;
+        }
+    }
+
+    ts.tv_sec = time(NULL) + mconn->network_timeout;
+    ts.tv_nsec = 0;
+    while (!waiter.done) {
+        if (pthread_cond_timedwait(&waiter.cond, &mconn->lock,
+                    &ts) == ETIMEDOUT)
+        {
+            //the receiver is writing the response when not found
+            if (mux_remove_waiter(mconn, waiter.req_id) != NULL) {
+                response->error.length = snprintf(response->error.message,
+                        sizeof(response->error.message),
+                        "wait response from server %s:%d timeout",
+                        mconn->conn.ip_addr, mconn->conn.port);
+                waiter.done = true;
+                waiter.result = ETIMEDOUT;
+            } else {
+                ts.tv_sec = time(NULL) + 1;
+            }
+        }
+    }
+    pthread_mutex_unlock(&mconn->lock);
+
+    pthread_cond_destroy(&waiter.cond);
+    return waiter.result;
+}
@@ -0,0 +1,59 @@
+
+#ifndef _FDIR_CLIENT_MUX_H
+#define _FDIR_CLIENT_MUX_H
+
+#include <pthread.h>
+#include "fastcommon/connection_pool.h"
+#include "fdir_types.h"
+
+#define FDIR_MUX_WAITER_BUCKETS  1024
+
+typedef struct fdir_mux_waiter {
+    int req_id;
+    bool done;
+    int result;
+    unsigned char expect_cmd;
+    char *recv_data;
+    int expect_body_len;
+    FDIRResponseInfo *response;
+    pthread_cond_t cond;
+    struct fdir_mux_waiter *next;
+} FDIRMuxWaiter;
+
+/* many threads share one connection, the requests are sent under
+   send_lock and the responses are matched to the waiters by req_id
+   in the receiver thread */
+typedef struct fdir_mux_connection {
+    ConnectionInfo conn;
+    int connect_timeout;
+    int network_timeout;
+    volatile int next_req_id;
+    volatile bool running;
+    pthread_t recv_tid;
+    pthread_mutex_t send_lock;
+    pthread_mutex_t lock;  //for waiters and the socket status
+    pthread_cond_t cond;   //notify the receiver when connected
+    FDIRMuxWaiter *waiters[FDIR_MUX_WAITER_BUCKETS];
+} FDIRMuxConnection;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fdir_mux_connection_init(FDIRMuxConnection *mconn,
+        const ConnectionInfo *server, const int connect_timeout,
+        const int network_timeout);
+
+void fdir_mux_connection_destroy(FDIRMuxConnection *mconn);
+
+//the request id of send_data will be set
+int fdir_mux_send_and_recv_response(FDIRMuxConnection *mconn,
+        char *send_data, const int send_len, FDIRResponseInfo *response,
+        const unsigned char expect_cmd, char *recv_data,
+        const int expect_body_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,7 +6,9 @@
 #include "fastcommon/sockopt.h"
 #include "fastcommon/connection_pool.h"
 #include "fdir_proto.h"
+#include "fdir_func.h"
 #include "client_global.h"
+#include "client_mux.h"
 #include "client_proto.h"
 
 static inline void init_client_buffer(FDIRClientBuffer *buffer)
@@ -165,6 +167,212 @@ static inline void log_network_error_ex(FDIRResponseInfo *response,
 #define log_network_error(response, conn, result) \
         log_network_error_ex(response, conn, result, __LINE__)
 
+static int client_bind_thread(ConnectionInfo *conn,
+        const int thread_index, int *work_threads)
+{
+    FDIRProtoHeader *header;
+    FDIRProtoBindThreadReq *req;
+    FDIRProtoBindThreadResp resp;
+    char out_buff[sizeof(FDIRProtoHeader) + sizeof(FDIRProtoBindThreadReq)];
+    FDIRResponseInfo response;
+    int result;
+
+    memset(out_buff, 0, sizeof(out_buff));
+    header = (FDIRProtoHeader *)out_buff;
+    req = (FDIRProtoBindThreadReq *)(header + 1);
+    int2buff(thread_index, req->thread_index);
+    FDIR_PROTO_SET_HEADER(header, FDIR_SERVICE_PROTO_BIND_THREAD_REQ,
+            sizeof(FDIRProtoBindThreadReq));
+
+    response.error.length = 0;
+    response.error.message[0] = '\0';
+    if ((result=fdir_send_and_recv_response(conn, out_buff,
+                    sizeof(out_buff), &response, g_client_global_vars.
+                    network_timeout, FDIR_SERVICE_PROTO_BIND_THREAD_RESP,
+                    (char *)&resp, sizeof(resp))) != 0)
+    {
+        log_network_error(&response, conn, result);
+        return result;
+    }
+
+    *work_threads = buff2int(resp.work_threads);
+    if (*work_threads <= 0 || buff2int(resp.thread_index) != thread_index) {
+        logError("file: "__FILE__", line: %d, "
+                "server %s:%d, invalid work threads: %d or bound "
+                "thread index: %d != %d", __LINE__, conn->ip_addr,
+                conn->port, *work_threads, buff2int(resp.thread_index),
+                thread_index);
+        return EINVAL;
+    }
+    return 0;
+}
+
+static int client_connect_thread(FDIRServerCluster *server_cluster,
+        ConnectionInfo *conn, const int thread_index, int *work_threads)
+{
+    ConnectionInfo *master;
+    int result;
+
+    if ((master=get_master_connection(server_cluster, &result)) == NULL) {
+        return result;
+    }
+
+    strcpy(conn->ip_addr, master->ip_addr);
+    conn->port = master->port;
+    conn->sock = -1;
+    if ((result=make_connection(conn)) != 0) {
+        return result;
+    }
+
+    if ((result=client_bind_thread(conn, thread_index, work_threads)) != 0) {
+        conn_pool_disconnect_server(conn);
+    }
+    return result;
+}
+
+static void client_release_thread_route(FDIRServerCluster *server_cluster)
+{
+    ConnectionInfo *conn;
+    ConnectionInfo *end;
+
+    end = server_cluster->thread_route.conns +
+        server_cluster->thread_route.work_threads;
+    for (conn=server_cluster->thread_route.conns; conn<end; conn++) {
+        if (conn->sock >= 0) {
+            conn_pool_disconnect_server(conn);
+        }
+    }
+    free(server_cluster->thread_route.conns);
+    server_cluster->thread_route.conns = NULL;
+    server_cluster->thread_route.master = NULL;
+    server_cluster->thread_route.work_threads = 0;
+}
+
+static int client_init_thread_route(FDIRServerCluster *server_cluster)
+{
+    ConnectionInfo first;
+    ConnectionInfo *conn;
+    ConnectionInfo *end;
+    int work_threads;
+    int bytes;
+    int result;
+
+    memset(&first, 0, sizeof(first));
+    if ((result=client_connect_thread(server_cluster, &first,
+                    0, &work_threads)) != 0)
+    {
+        return result;
+    }
+
+    bytes = sizeof(ConnectionInfo) * work_threads;
+    server_cluster->thread_route.conns = (ConnectionInfo *)malloc(bytes);
+    if (server_cluster->thread_route.conns == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        conn_pool_disconnect_server(&first);
+        return ENOMEM;
+    }
+
+    end = server_cluster->thread_route.conns + work_threads;
+    for (conn=server_cluster->thread_route.conns; conn<end; conn++) {
+        *conn = first;
+        conn->sock = -1;
+    }
+    server_cluster->thread_route.conns[0].sock = first.sock;
+    server_cluster->thread_route.work_threads = work_threads;
+    server_cluster->thread_route.master = server_cluster->master;
+    return 0;
+}
+
+/* get the connection bound to the owner thread of the hash code,
+   fallback to the master connection when thread route disabled */
+static ConnectionInfo *get_routed_connection(FDIRServerCluster
+        *server_cluster, const unsigned int hash_code, int *err_no)
+{
+    ConnectionInfo *conn;
+    int thread_index;
+    int work_threads;
+
+    if (!server_cluster->thread_route.enabled) {
+        return get_master_connection(server_cluster, err_no);
+    }
+
+    //the connections are bound to the work threads of the former master
+    if (server_cluster->thread_route.conns != NULL &&
+            server_cluster->thread_route.master != server_cluster->master)
+    {
+        client_release_thread_route(server_cluster);
+    }
+
+    if (server_cluster->thread_route.conns == NULL) {
+        if ((*err_no=client_init_thread_route(server_cluster)) != 0) {
+            logWarning("file: "__FILE__", line: %d, "
+                    "init thread route fail, errno: %d, "
+                    "use the master connection instead",
+                    __LINE__, *err_no);
+            //retry on the next request when the master is unreachable
+            if (!is_network_error(*err_no)) {
+                server_cluster->thread_route.enabled = false;
+            }
+            return get_master_connection(server_cluster, err_no);
+        }
+    }
+
+    thread_index = hash_code % server_cluster->thread_route.work_threads;
+    conn = server_cluster->thread_route.conns + thread_index;
+    if (conn->sock < 0) {
+        if ((*err_no=client_connect_thread(server_cluster, conn,
+                        thread_index, &work_threads)) != 0)
+        {
+            //the master may be changed, rebuild on the next request
+            client_release_thread_route(server_cluster);
+            return NULL;
+        }
+
+        if (work_threads != server_cluster->thread_route.work_threads ||
+                server_cluster->thread_route.master != server_cluster->master)
+        {
+            //the master restarted with other work threads, rebuild
+            client_release_thread_route(server_cluster);
+            if ((*err_no=client_init_thread_route(server_cluster)) != 0) {
+                return NULL;
+            }
+            thread_index = hash_code %
+                server_cluster->thread_route.work_threads;
+            conn = server_cluster->thread_route.conns + thread_index;
+            if (conn->sock < 0 && (*err_no=client_connect_thread(
+                            server_cluster, conn, thread_index,
+                            &work_threads)) != 0)
+            {
+                return NULL;
+            }
+        }
+    }
+
+    *err_no = 0;
+    return conn;
+}
+
+/* the request shares the mux connection with the other threads,
+   the broken connection is closed and reconnected by the mux */
+static int client_mux_send_and_recv(FDIRServerCluster *server_cluster,
+        char *out_buff, const int out_bytes, const unsigned char expect_cmd,
+        char *recv_data, const int expect_body_len)
+{
+    FDIRResponseInfo response;
+    int result;
+
+    response.error.length = 0;
+    response.error.message[0] = '\0';
+    if ((result=fdir_mux_send_and_recv_response(server_cluster->mux,
+                    out_buff, out_bytes, &response, expect_cmd,
+                    recv_data, expect_body_len)) != 0)
+    {
+        log_network_error(&response, &server_cluster->mux->conn, result);
+    }
+    return result;
+}
+
 int fdir_client_create_dentry(FDIRServerCluster *server_cluster,
         const FDIRDEntryFullName *entry_info, const int flags,
         const mode_t mode)
@@ -187,10 +395,6 @@ int fdir_client_create_dentry(FDIRServerCluster *server_cluster,
         return result;
     }
 
-    if ((conn=get_master_connection(server_cluster, &result)) == NULL) {
-        return result;
-    }
-
     int2buff(flags, entry_body->front.flags);
     int2buff(mode, entry_body->front.mode);
     out_bytes = sizeof(FDIRProtoHeader) + sizeof(FDIRProtoCreateDEntryBody)
@@ -198,6 +402,17 @@ int fdir_client_create_dentry(FDIRServerCluster *server_cluster,
     FDIR_PROTO_SET_HEADER(header, FDIR_SERVICE_PROTO_CREATE_DENTRY,
             out_bytes - sizeof(FDIRProtoHeader));
 
+    if (server_cluster->mux != NULL) {
+        return client_mux_send_and_recv(server_cluster, out_buff,
+                out_bytes, FDIR_PROTO_ACK, NULL, 0);
+    }
+
+    if ((conn=get_routed_connection(server_cluster,
+                    fdir_get_parent_hashcode(entry_info), &result)) == NULL)
+    {
+        return result;
+    }
+
     response.error.length = 0;
     response.error.message[0] = '\0';
     if ((result=fdir_send_and_recv_none_body_response(conn, out_buff,
@@ -214,6 +429,123 @@ int fdir_client_create_dentry(FDIRServerCluster *server_cluster,
     return result;
 }
 
+int fdir_client_batch_create_dentry(FDIRServerCluster *server_cluster,
+        const FDIRDEntryFullName *parent, const string_t *names,
+        const int count, const int flags, const mode_t mode, int *results)
+{
+    FDIRProtoHeader *header;
+    FDIRProtoBatchCreateDEntryBody *entry_body;
+    FDIRProtoBatchCreateDEntryRespBodyHeader *body_header;
+    FDIRProtoDEntryNamePart *name_part;
+    const string_t *name;
+    const string_t *end;
+    ConnectionInfo *conn;
+    FDIRResponseInfo response;
+    char *out_buff;
+    char *p;
+    int alloc_size;
+    int out_bytes;
+    int resp_bytes;
+    int i;
+    int result;
+
+    if (count <= 0 || count > FDIR_BATCH_DENTRY_MAX_COUNT) {
+        logError("file: "__FILE__", line: %d, "
+                "invalid name count: %d, which <= 0 or > %d",
+                __LINE__, count, FDIR_BATCH_DENTRY_MAX_COUNT);
+        return EINVAL;
+    }
+
+    end = names + count;
+    alloc_size = sizeof(FDIRProtoHeader) + sizeof(
+            FDIRProtoBatchCreateDEntryBody) + NAME_MAX + PATH_MAX;
+    for (name=names; name<end; name++) {
+        if (name->len <= 0 || name->len > NAME_MAX) {
+            logError("file: "__FILE__", line: %d, "
+                    "invalid name length: %d, which <= 0 or > %d",
+                    __LINE__, name->len, NAME_MAX);
+            return EINVAL;
+        }
+        alloc_size += sizeof(FDIRProtoDEntryNamePart) + name->len;
+    }
+
+    resp_bytes = sizeof(FDIRProtoBatchCreateDEntryRespBodyHeader) + 2 * count;
+    if (alloc_size < resp_bytes) {
+        alloc_size = resp_bytes;
+    }
+    out_buff = (char *)malloc(alloc_size);
+    if (out_buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, alloc_size);
+        return ENOMEM;
+    }
+
+    header = (FDIRProtoHeader *)out_buff;
+    entry_body = (FDIRProtoBatchCreateDEntryBody *)(out_buff +
+            sizeof(FDIRProtoHeader));
+    if ((result=client_check_set_proto_dentry(parent,
+                    &entry_body->parent)) != 0)
+    {
+        free(out_buff);
+        return result;
+    }
+
+    //the parent of the children is the parent path itself
+    if ((conn=get_routed_connection(server_cluster, fdir_get_dentry_hashcode(
+                        &parent->ns, &parent->path, true), &result)) == NULL)
+    {
+        free(out_buff);
+        return result;
+    }
+
+    int2buff(flags, entry_body->front.flags);
+    int2buff(mode, entry_body->front.mode);
+    int2buff(count, entry_body->front.count);
+    p = out_buff + sizeof(FDIRProtoHeader) + sizeof(
+            FDIRProtoBatchCreateDEntryBody) + parent->ns.len +
+        parent->path.len;
+    for (name=names; name<end; name++) {
+        name_part = (FDIRProtoDEntryNamePart *)p;
+        name_part->name_len = name->len;
+        memcpy(name_part->name_str, name->str, name->len);
+        p += sizeof(FDIRProtoDEntryNamePart) + name->len;
+    }
+    out_bytes = p - out_buff;
+    FDIR_PROTO_SET_HEADER(header, FDIR_SERVICE_PROTO_BATCH_CREATE_DENTRY_REQ,
+            out_bytes - sizeof(FDIRProtoHeader));
+
+    response.error.length = 0;
+    response.error.message[0] = '\0';
+    if ((result=fdir_send_and_recv_response(conn, out_buff, out_bytes,
+                    &response, g_client_global_vars.network_timeout,
+                    FDIR_SERVICE_PROTO_BATCH_CREATE_DENTRY_RESP,
+                    out_buff, resp_bytes)) != 0)
+    {
+        log_network_error(&response, conn, result);
+    } else {
+        body_header = (FDIRProtoBatchCreateDEntryRespBodyHeader *)out_buff;
+        if (buff2int(body_header->count) != count) {
+            logError("file: "__FILE__", line: %d, "
+                    "server %s:%d, response count: %d != request count: %d",
+                    __LINE__, conn->ip_addr, conn->port,
+                    buff2int(body_header->count), count);
+            result = EINVAL;
+        } else {
+            p = out_buff + sizeof(FDIRProtoBatchCreateDEntryRespBodyHeader);
+            for (i=0; i<count; i++) {
+                results[i] = buff2short(p + 2 * i);
+            }
+        }
+    }
+
+    if ((result != 0) && is_network_error(result)) {
+        conn_pool_disconnect_server(conn);
+    }
+
+    free(out_buff);
+    return result;
+}
+
 int fdir_client_remove_dentry(FDIRServerCluster *server_cluster,
         const FDIRDEntryFullName *entry_info)
 {
@@ -235,15 +567,22 @@ int fdir_client_remove_dentry(FDIRServerCluster *server_cluster,
         return result;
     }
 
-    if ((conn=get_master_connection(server_cluster, &result)) == NULL) {
-        return result;
-    }
-
     out_bytes = sizeof(FDIRProtoHeader) + sizeof(FDIRProtoRemoveDEntry)
         + entry_info->ns.len + entry_info->path.len;
     FDIR_PROTO_SET_HEADER(header, FDIR_SERVICE_PROTO_REMOVE_DENTRY,
             out_bytes - sizeof(FDIRProtoHeader));
 
+    if (server_cluster->mux != NULL) {
+        return client_mux_send_and_recv(server_cluster, out_buff,
+                out_bytes, FDIR_PROTO_ACK, NULL, 0);
+    }
+
+    if ((conn=get_routed_connection(server_cluster,
+                    fdir_get_parent_hashcode(entry_info), &result)) == NULL)
+    {
+        return result;
+    }
+
     response.error.length = 0;
     response.error.message[0] = '\0';
     if ((result=fdir_send_and_recv_none_body_response(conn, out_buff,
@@ -260,6 +599,507 @@ int fdir_client_remove_dentry(FDIRServerCluster *server_cluster,
     return result;
 }
 
+static inline void client_unpack_dentry_stat(
+        const FDIRProtoDEntryStat *proto_stat, FDIRDStatus *stat)
+{
+    stat->inode = buff2long(proto_stat->inode);
+    stat->mode = buff2int(proto_stat->mode);
+    stat->ctime = buff2int(proto_stat->ctime);
+    stat->mtime = buff2int(proto_stat->mtime);
+    stat->atime = 0;
+    stat->size = buff2long(proto_stat->size);
+}
+
+int fdir_client_stat_dentry(FDIRServerCluster *server_cluster,
+        const FDIRDEntryFullName *entry_info, FDIRDStatus *stat)
+{
+    FDIRProtoHeader *header;
+    FDIRProtoStatDEntryBody *entry_body;
+    FDIRProtoDEntryStat proto_stat;
+    int out_bytes;
+    ConnectionInfo *conn;
+    char out_buff[sizeof(FDIRProtoHeader) + sizeof(FDIRProtoStatDEntryBody)
+        + NAME_MAX + PATH_MAX];
+    FDIRResponseInfo response;
+    int result;
+
+    header = (FDIRProtoHeader *)out_buff;
+    entry_body = (FDIRProtoStatDEntryBody *)(out_buff +
+            sizeof(FDIRProtoHeader));
+    if ((result=client_check_set_proto_dentry(entry_info,
+                    &entry_body->dentry)) != 0)
+    {
+        return result;
+    }
+
+    out_bytes = sizeof(FDIRProtoHeader) + sizeof(FDIRProtoStatDEntryBody)
+        + entry_info->ns.len + entry_info->path.len;
+    FDIR_PROTO_SET_HEADER(header, FDIR_SERVICE_PROTO_STAT_DENTRY_REQ,
+            out_bytes - sizeof(FDIRProtoHeader));
+
+    if (server_cluster->mux != NULL) {
+        if ((result=client_mux_send_and_recv(server_cluster, out_buff,
+                        out_bytes, FDIR_SERVICE_PROTO_STAT_DENTRY_RESP,
+                        (char *)&proto_stat, sizeof(FDIRProtoDEntryStat))) == 0)
+        {
+            client_unpack_dentry_stat(&proto_stat, stat);
+        }
+        return result;
+    }
+
+    if ((conn=get_routed_connection(server_cluster,
+                    fdir_get_parent_hashcode(entry_info), &result)) == NULL)
+    {
+        return result;
+    }
+
+    response.error.length = 0;
+    response.error.message[0] = '\0';
+    if ((result=fdir_send_and_recv_response(conn, out_buff, out_bytes,
+                    &response, g_client_global_vars.network_timeout,
+                    FDIR_SERVICE_PROTO_STAT_DENTRY_RESP, (char *)&proto_stat,
+                    sizeof(FDIRProtoDEntryStat))) == 0)
+    {
+        client_unpack_dentry_stat(&proto_stat, stat);
+    } else {
+        log_network_error(&response, conn, result);
+    }
+
+    if ((result != 0) && is_network_error(result)) {
+        conn_pool_disconnect_server(conn);
+    }
+
+    return result;
+}
+
+static int client_pack_batch_op(FDIRClientBatchOp *op, char *p, int *len)
+{
+    FDIRProtoBatchOpHeader *op_header;
+    FDIRProtoCreateDEntryBody *create_body;
+    FDIRProtoDEntryInfo *entry_proto;
+    int fixed_part_size;
+    int result;
+
+    op_header = (FDIRProtoBatchOpHeader *)p;
+    switch (op->cmd) {
+        case FDIR_SERVICE_PROTO_CREATE_DENTRY:
+            create_body = (FDIRProtoCreateDEntryBody *)(op_header + 1);
+            int2buff(op->flags, create_body->front.flags);
+            int2buff(op->mode, create_body->front.mode);
+            entry_proto = &create_body->dentry;
+            fixed_part_size = sizeof(FDIRProtoCreateDEntryBody);
+            break;
+        case FDIR_SERVICE_PROTO_REMOVE_DENTRY:
+            entry_proto = &((FDIRProtoRemoveDEntry *)
+                    (op_header + 1))->dentry;
+            fixed_part_size = sizeof(FDIRProtoRemoveDEntry);
+            break;
+        case FDIR_SERVICE_PROTO_STAT_DENTRY_REQ:
+            entry_proto = &((FDIRProtoStatDEntryBody *)
+                    (op_header + 1))->dentry;
+            fixed_part_size = sizeof(FDIRProtoStatDEntryBody);
+            break;
+        default:
+            logError("file: "__FILE__", line: %d, "
+                    "unsupported batch op cmd: %d", __LINE__, op->cmd);
+            return EINVAL;
+    }
+
+    if ((result=client_check_set_proto_dentry(&op->fullname,
+                    entry_proto)) != 0)
+    {
+        return result;
+    }
+
+    *len = fixed_part_size + op->fullname.ns.len + op->fullname.path.len;
+    op_header->cmd = op->cmd;
+    int2buff(*len, op_header->body_len);
+    *len += sizeof(FDIRProtoBatchOpHeader);
+    return 0;
+}
+
+int fdir_client_batch_op(FDIRServerCluster *server_cluster,
+        FDIRClientBatchOp *ops, const int count, const int flags)
+{
+    FDIRProtoHeader *header;
+    FDIRProtoBatchOpFront *proto_front;
+    FDIRProtoBatchOpRespBodyHeader *body_header;
+    FDIRProtoBatchOpRespBodyPart *body_part;
+    FDIRClientBatchOp *op;
+    FDIRClientBatchOp *end;
+    ConnectionInfo *conn;
+    FDIRResponseInfo response;
+    char *out_buff;
+    char *p;
+    int alloc_size;
+    int resp_bytes;
+    int len;
+    int result;
+
+    if (count <= 0 || count > FDIR_BATCH_OP_MAX_COUNT) {
+        logError("file: "__FILE__", line: %d, "
+                "invalid op count: %d, which <= 0 or > %d",
+                __LINE__, count, FDIR_BATCH_OP_MAX_COUNT);
+        return EINVAL;
+    }
+
+    alloc_size = sizeof(FDIRProtoHeader) + sizeof(FDIRProtoBatchOpFront) +
+        count * (sizeof(FDIRProtoBatchOpHeader) + sizeof(
+                    FDIRProtoCreateDEntryBody) + NAME_MAX + PATH_MAX);
+    resp_bytes = sizeof(FDIRProtoBatchOpRespBodyHeader) +
+        count * sizeof(FDIRProtoBatchOpRespBodyPart);
+    out_buff = (char *)malloc(alloc_size);
+    if (out_buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, alloc_size);
+        return ENOMEM;
+    }
+
+    header = (FDIRProtoHeader *)out_buff;
+    proto_front = (FDIRProtoBatchOpFront *)(header + 1);
+    int2buff(count, proto_front->count);
+    int2buff(flags, proto_front->flags);
+    p = (char *)(proto_front + 1);
+    end = ops + count;
+    for (op=ops; op<end; op++) {
+        if ((result=client_pack_batch_op(op, p, &len)) != 0) {
+            free(out_buff);
+            return result;
+        }
+        p += len;
+    }
+
+    if ((conn=get_master_connection(server_cluster, &result)) == NULL) {
+        free(out_buff);
+        return result;
+    }
+
+    FDIR_PROTO_SET_HEADER(header, FDIR_SERVICE_PROTO_BATCH_OP_REQ,
+            (p - out_buff) - sizeof(FDIRProtoHeader));
+
+    response.error.length = 0;
+    response.error.message[0] = '\0';
+    if ((result=fdir_send_and_recv_response(conn, out_buff, p - out_buff,
+                    &response, g_client_global_vars.network_timeout,
+                    FDIR_SERVICE_PROTO_BATCH_OP_RESP, out_buff,
+                    resp_bytes)) != 0)
+    {
+        log_network_error(&response, conn, result);
+    } else {
+        body_header = (FDIRProtoBatchOpRespBodyHeader *)out_buff;
+        if (buff2int(body_header->count) != count) {
+            logError("file: "__FILE__", line: %d, "
+                    "server %s:%d, response count: %d != request count: %d",
+                    __LINE__, conn->ip_addr, conn->port,
+                    buff2int(body_header->count), count);
+            result = EINVAL;
+        } else {
+            body_part = (FDIRProtoBatchOpRespBodyPart *)(body_header + 1);
+            for (op=ops; op<end; op++, body_part++) {
+                op->result = buff2short(body_part->status);
+                client_unpack_dentry_stat(&body_part->stat, &op->stat);
+            }
+        }
+    }
+
+    if ((result != 0) && is_network_error(result)) {
+        conn_pool_disconnect_server(conn);
+    }
+
+    free(out_buff);
+    return result;
+}
+
+int fdir_client_service_stat(ConnectionInfo *conn,
+        FDIRThreadStat *stats, const int size, int *count,
+        FDIRBinlogStat *binlog_stat)
+{
+    FDIRProtoHeader header;
+    FDIRProtoServiceStatRespBodyHeader *body_header;
+    FDIRProtoServiceStatRespBodyPart *body_part;
+    FDIRResponseInfo response;
+    FDIRThreadStat *stat;
+    FDIRThreadStat *end;
+    char *in_buff;
+    int alloc_size;
+    int recv_bytes;
+    int result;
+
+    FDIR_PROTO_SET_HEADER(&header, FDIR_SERVICE_PROTO_SERVICE_STAT_REQ, 0);
+    response.error.length = 0;
+    response.error.message[0] = '\0';
+    if ((result=fdir_send_and_check_response_header(conn, (char *)&header,
+                    sizeof(header), &response, g_client_global_vars.
+                    network_timeout, FDIR_SERVICE_PROTO_SERVICE_STAT_RESP)) != 0)
+    {
+        log_network_error(&response, conn, result);
+        return result;
+    }
+
+    alloc_size = response.header.body_len;
+    if (alloc_size < sizeof(FDIRProtoServiceStatRespBodyHeader)) {
+        logError("file: "__FILE__", line: %d, "
+                "server %s:%d, response body length: %d is too short",
+                __LINE__, conn->ip_addr, conn->port, alloc_size);
+        return EINVAL;
+    }
+    in_buff = (char *)malloc(alloc_size);
+    if (in_buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, alloc_size);
+        return ENOMEM;
+    }
+
+    if ((result=tcprecvdata_nb_ex(conn->sock, in_buff, alloc_size,
+                    g_client_global_vars.network_timeout,
+                    &recv_bytes)) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "recv from server %s:%d fail, errno: %d, error info: %s",
+                __LINE__, conn->ip_addr, conn->port,
+                result, STRERROR(result));
+        free(in_buff);
+        return result;
+    }
+
+    body_header = (FDIRProtoServiceStatRespBodyHeader *)in_buff;
+    *count = buff2int(body_header->thread_count);
+    if (sizeof(FDIRProtoServiceStatRespBodyHeader) + *count *
+            sizeof(FDIRProtoServiceStatRespBodyPart) != alloc_size)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "server %s:%d, response body length: %d is invalid, "
+                "thread count: %d", __LINE__, conn->ip_addr,
+                conn->port, alloc_size, *count);
+        free(in_buff);
+        return EINVAL;
+    }
+
+    binlog_stat->data_version = buff2long(body_header->data_version);
+    binlog_stat->min_version = buff2long(body_header->binlog_min_version);
+    binlog_stat->sync.count = buff2long(body_header->binlog_sync_count);
+    binlog_stat->sync.bytes = buff2long(body_header->binlog_sync_bytes);
+    binlog_stat->sync.time_used = buff2long(
+            body_header->binlog_sync_time_used);
+    binlog_stat->sync.max_time_used = buff2int(
+            body_header->binlog_sync_max_time_used);
+
+    if (*count > size) {
+        *count = size;
+    }
+    body_part = (FDIRProtoServiceStatRespBodyPart *)(body_header + 1);
+    end = stats + *count;
+    for (stat=stats; stat<end; stat++, body_part++) {
+        stat->requests = buff2long(body_part->requests);
+        stat->forwarded = buff2long(body_part->forwarded);
+        stat->bloom.checks = buff2long(body_part->bloom_checks);
+        stat->bloom.negatives = buff2long(body_part->bloom_negatives);
+        stat->bloom.false_positives = buff2long(
+                body_part->bloom_false_positives);
+        stat->bloom.rebuilds = buff2long(body_part->bloom_rebuilds);
+    }
+
+    free(in_buff);
+    return 0;
+}
+
+static inline void client_unpack_latency_percentiles(
+        const FDIRProtoLatencyPercentiles *src, FDIRLatencyPercentiles *dest)
+{
+    dest->count = buff2long(src->count);
+    dest->p50 = buff2int(src->p50);
+    dest->p99 = buff2int(src->p99);
+    dest->p999 = buff2int(src->p999);
+    dest->max = buff2int(src->max);
+}
+
+int fdir_client_latency_stat(ConnectionInfo *conn, FDIRLatencyStats *stats)
+{
+    FDIRProtoHeader header;
+    FDIRProtoLatencyStatRespBodyHeader *body_header;
+    FDIRProtoLatencyStatCmdPart *cmd_part;
+    FDIRProtoLatencyStatStatusPart *status_part;
+    FDIRResponseInfo response;
+    char *in_buff;
+    int alloc_size;
+    int recv_bytes;
+    int result;
+    int i;
+
+    FDIR_PROTO_SET_HEADER(&header, FDIR_SERVICE_PROTO_LATENCY_STAT_REQ, 0);
+    response.error.length = 0;
+    response.error.message[0] = '\0';
+    if ((result=fdir_send_and_check_response_header(conn, (char *)&header,
+                    sizeof(header), &response, g_client_global_vars.
+                    network_timeout, FDIR_SERVICE_PROTO_LATENCY_STAT_RESP)) != 0)
+    {
+        log_network_error(&response, conn, result);
+        return result;
+    }
+
+    alloc_size = response.header.body_len;
+    if (alloc_size < sizeof(FDIRProtoLatencyStatRespBodyHeader)) {
+        logError("file: "__FILE__", line: %d, "
+                "server %s:%d, response body length: %d is too short",
+                __LINE__, conn->ip_addr, conn->port, alloc_size);
+        return EINVAL;
+    }
+    in_buff = (char *)malloc(alloc_size);
+    if (in_buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, alloc_size);
+        return ENOMEM;
+    }
+
+    if ((result=tcprecvdata_nb_ex(conn->sock, in_buff, alloc_size,
+                    g_client_global_vars.network_timeout,
+                    &recv_bytes)) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "recv from server %s:%d fail, errno: %d, error info: %s",
+                __LINE__, conn->ip_addr, conn->port,
+                result, STRERROR(result));
+        free(in_buff);
+        return result;
+    }
+
+    body_header = (FDIRProtoLatencyStatRespBodyHeader *)in_buff;
+    stats->cmd_count = buff2int(body_header->cmd_count);
+    stats->status_count = buff2int(body_header->status_count);
+    if (stats->cmd_count < 0 || stats->cmd_count > 256 ||
+            stats->status_count < 0 || stats->status_count > 256 ||
+            sizeof(FDIRProtoLatencyStatRespBodyHeader) + stats->cmd_count *
+            sizeof(FDIRProtoLatencyStatCmdPart) + stats->status_count *
+            sizeof(FDIRProtoLatencyStatStatusPart) != alloc_size)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "server %s:%d, response body length: %d is invalid, "
+                "cmd count: %d, status count: %d", __LINE__, conn->ip_addr,
+                conn->port, alloc_size, stats->cmd_count,
+                stats->status_count);
+        free(in_buff);
+        return EINVAL;
+    }
+
+    cmd_part = (FDIRProtoLatencyStatCmdPart *)(body_header + 1);
+    for (i=0; i<stats->cmd_count; i++, cmd_part++) {
+        stats->cmds[i].cmd = cmd_part->cmd;
+        stats->cmds[i].errors = buff2long(cmd_part->errors);
+        client_unpack_latency_percentiles(&cmd_part->total,
+                &stats->cmds[i].total);
+        client_unpack_latency_percentiles(&cmd_part->forwarded,
+                &stats->cmds[i].forwarded);
+    }
+
+    status_part = (FDIRProtoLatencyStatStatusPart *)cmd_part;
+    for (i=0; i<stats->status_count; i++, status_part++) {
+        stats->statuses[i].status = buff2short(status_part->status);
+        stats->statuses[i].count = buff2long(status_part->count);
+    }
+
+    free(in_buff);
+    return 0;
+}
+
+int fdir_client_slow_trace(ConnectionInfo *conn, FDIRSlowTrace *traces,
+        const int size, int *count)
+{
+    char out_buff[sizeof(FDIRProtoHeader) + sizeof(FDIRProtoSlowTraceReq)];
+    FDIRProtoHeader *header;
+    FDIRProtoSlowTraceReq *req;
+    FDIRProtoSlowTraceRespBodyHeader *body_header;
+    FDIRProtoSlowTraceEntry *proto_entry;
+    FDIRResponseInfo response;
+    FDIRSlowTrace *trace;
+    FDIRSlowTrace *end;
+    char *in_buff;
+    int alloc_size;
+    int recv_bytes;
+    int result;
+
+    header = (FDIRProtoHeader *)out_buff;
+    req = (FDIRProtoSlowTraceReq *)(header + 1);
+    FDIR_PROTO_SET_HEADER(header, FDIR_SERVICE_PROTO_SLOW_TRACE_REQ,
+            sizeof(FDIRProtoSlowTraceReq));
+    memset(req, 0, sizeof(FDIRProtoSlowTraceReq));
+    int2buff(size, req->count);
+
+    response.error.length = 0;
+    response.error.message[0] = '\0';
+    if ((result=fdir_send_and_check_response_header(conn, out_buff,
+                    sizeof(out_buff), &response, g_client_global_vars.
+                    network_timeout, FDIR_SERVICE_PROTO_SLOW_TRACE_RESP)) != 0)
+    {
+        log_network_error(&response, conn, result);
+        return result;
+    }
+
+    alloc_size = response.header.body_len;
+    if (alloc_size < sizeof(FDIRProtoSlowTraceRespBodyHeader)) {
+        logError("file: "__FILE__", line: %d, "
+                "server %s:%d, response body length: %d is too short",
+                __LINE__, conn->ip_addr, conn->port, alloc_size);
+        return EINVAL;
+    }
+    in_buff = (char *)malloc(alloc_size);
+    if (in_buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, alloc_size);
+        return ENOMEM;
+    }
+
+    if ((result=tcprecvdata_nb_ex(conn->sock, in_buff, alloc_size,
+                    g_client_global_vars.network_timeout,
+                    &recv_bytes)) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "recv from server %s:%d fail, errno: %d, error info: %s",
+                __LINE__, conn->ip_addr, conn->port,
+                result, STRERROR(result));
+        free(in_buff);
+        return result;
+    }
+
+    body_header = (FDIRProtoSlowTraceRespBodyHeader *)in_buff;
+    *count = buff2int(body_header->count);
+    if (*count < 0 || sizeof(FDIRProtoSlowTraceRespBodyHeader) + *count *
+            sizeof(FDIRProtoSlowTraceEntry) != alloc_size)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "server %s:%d, response body length: %d is invalid, "
+                "entry count: %d", __LINE__, conn->ip_addr,
+                conn->port, alloc_size, *count);
+        free(in_buff);
+        return EINVAL;
+    }
+
+    if (*count > size) {
+        *count = size;
+    }
+    proto_entry = (FDIRProtoSlowTraceEntry *)(body_header + 1);
+    end = traces + *count;
+    for (trace=traces; trace<end; trace++, proto_entry++) {
+        trace->time_us = buff2long(proto_entry->time_us);
+        trace->total = buff2int(proto_entry->total);
+        trace->parse = buff2int(proto_entry->parse);
+        trace->forward = buff2int(proto_entry->forward);
+        trace->execute = buff2int(proto_entry->execute);
+        trace->binlog = buff2int(proto_entry->binlog);
+        trace->send = buff2int(proto_entry->send);
+        trace->req_body_len = buff2int(proto_entry->req_body_len);
+        trace->status = buff2short(proto_entry->status);
+        trace->thread_index = buff2short(proto_entry->thread_index);
+        trace->cmd = proto_entry->cmd;
+        trace->sampled = proto_entry->sampled;
+        trace->forwarded = proto_entry->forwarded;
+        snprintf(trace->client_ip, sizeof(trace->client_ip), "%.*s",
+                (int)sizeof(proto_entry->client_ip), proto_entry->client_ip);
+    }
+
+    free(in_buff);
+    return 0;
+}
+
 static int check_realloc_client_buffer(FDIRResponseInfo *response,
         FDIRClientBuffer *buffer)
 {
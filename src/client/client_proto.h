@@ -10,6 +10,17 @@ typedef struct fdir_client_dentry {
     FDIRDStatus stat;
 } FDIRClientDentry;
 
+typedef struct fdir_client_batch_op {
+    unsigned char cmd;  //FDIR_SERVICE_PROTO_CREATE_DENTRY, REMOVE_DENTRY
+                        //or STAT_DENTRY_REQ
+    int flags;          //for create
+    mode_t mode;        //for create
+    FDIRDEntryFullName fullname;
+
+    int result;         //output: the errno, 0 for success
+    FDIRDStatus stat;   //output: for create and stat
+} FDIRClientBatchOp;
+
 typedef struct fdir_client_buffer {
     int size;
     char fixed[16 * 1024]; //fixed buffer
@@ -36,9 +47,33 @@ int fdir_client_create_dentry(FDIRServerCluster *server_cluster,
         const FDIRDEntryFullName *entry_info, const int flags,
         const mode_t mode);
 
+//results[i] is the status (errno) of names[i], 0 for success
+int fdir_client_batch_create_dentry(FDIRServerCluster *server_cluster,
+        const FDIRDEntryFullName *parent, const string_t *names,
+        const int count, const int flags, const mode_t mode, int *results);
+
 int fdir_client_remove_dentry(FDIRServerCluster *server_cluster,
         const FDIRDEntryFullName *entry_info);
 
+int fdir_client_stat_dentry(FDIRServerCluster *server_cluster,
+        const FDIRDEntryFullName *entry_info, FDIRDStatus *stat);
+
+//flags: FDIR_BATCH_OP_FLAGS_ANY_ORDER and FDIR_BATCH_OP_FLAGS_ABORT_ON_ERROR
+int fdir_client_batch_op(FDIRServerCluster *server_cluster,
+        FDIRClientBatchOp *ops, const int count, const int flags);
+
+//get the request stats of the work threads and the binlog stat
+int fdir_client_service_stat(ConnectionInfo *conn,
+        FDIRThreadStat *stats, const int size, int *count,
+        FDIRBinlogStat *binlog_stat);
+
+//get the latency stats by command merged from all work threads
+int fdir_client_latency_stat(ConnectionInfo *conn, FDIRLatencyStats *stats);
+
+//fetch the latest slow or sampled request traces, newest first
+int fdir_client_slow_trace(ConnectionInfo *conn, FDIRSlowTrace *traces,
+        const int size, int *count);
+
 int fdir_client_list_dentry(FDIRServerCluster *server_cluster,
         const FDIRDEntryFullName *entry_info, FDIRClientDentryArray *array);
 
@@ -24,10 +24,88 @@ typedef struct fdir_slave_group {
     ConnectionInfo **servers;
 } FDIRSlaveGroup;
 
+typedef struct fdir_thread_route {
+    bool enabled;     //send the request to the owner thread of the parent
+    int work_threads; //the work threads of the master
+    ConnectionInfo *master; //the master which the conns connect to
+    ConnectionInfo *conns;  //the connections bound to each work thread
+} FDIRThreadRoute;
+
+struct fdir_mux_connection;
+
 typedef struct fdir_server_cluster {
     FDIRServerGroup server_group;
     FDIRSlaveGroup slave_group;
     ConnectionInfo *master;
+    FDIRThreadRoute thread_route;
+    struct fdir_mux_connection *mux;  //shared by the threads, NULL for off
 } FDIRServerCluster;
 
+typedef struct fdir_thread_stat {
+    int64_t requests;   //the requests received by the thread
+    int64_t forwarded;  //the requests forwarded to other threads
+    struct {
+        int64_t checks;     //the lookups checked by the bloom filters
+        int64_t negatives;  //the lookups skipped by the bloom filters
+        int64_t false_positives;
+        int64_t rebuilds;   //the bloom filters built or rebuilt
+    } bloom;
+} FDIRThreadStat;
+
+typedef struct fdir_binlog_stat {
+    int64_t data_version;  //the current data version
+    int64_t min_version;   //the slaves can catch up from this version
+    struct {
+        int64_t count;      //the fdatasync count of the binlog
+        int64_t bytes;      //the bytes written by these syncs
+        int64_t time_used;  //the total fdatasync time in us
+        int max_time_used;  //in us
+    } sync;
+} FDIRBinlogStat;
+
+typedef struct fdir_latency_percentiles {
+    int64_t count;
+    int p50;   //in microseconds
+    int p99;
+    int p999;
+    int max;
+} FDIRLatencyPercentiles;
+
+typedef struct fdir_cmd_latency {
+    unsigned char cmd;
+    int64_t errors;
+    FDIRLatencyPercentiles total;
+    FDIRLatencyPercentiles forwarded;  //the time waiting in forwarding
+} FDIRCmdLatency;
+
+typedef struct fdir_status_count {
+    int status;
+    int64_t count;
+} FDIRStatusCount;
+
+typedef struct fdir_latency_stats {
+    int cmd_count;
+    int status_count;
+    FDIRCmdLatency cmds[256];
+    FDIRStatusCount statuses[256];
+} FDIRLatencyStats;
+
+//the time used of each stage in microseconds
+typedef struct fdir_slow_trace {
+    int64_t time_us;  //the request start time
+    int total;
+    int parse;
+    int forward;      //waiting in forwarding
+    int execute;
+    int binlog;
+    int send;
+    int req_body_len;
+    short status;
+    short thread_index;
+    unsigned char cmd;
+    bool sampled;
+    bool forwarded;
+    char client_ip[IP_ADDRESS_SIZE];
+} FDIRSlowTrace;
+
 #endif
@@ -5,6 +5,7 @@
 #include "client_func.h"
 #include "client_global.h"
 #include "client_proto.h"
+#include "client_mux.h"
 
 #ifdef __cplusplus
 extern "C" {
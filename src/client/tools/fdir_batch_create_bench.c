@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastdir/fdir_client.h"
+
+#define DEFAULT_ENTRY_COUNT  (8 * 1024)
+#define DEFAULT_BATCH_SIZE   1024
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [-c config_filename] [-N entry count] "
+            "[-b batch size] <-n namespace> <parent path>\n"
+            "\tcreate the files one by one, then by batch create, "
+            "each pass in its own\n\tsubdirectory of the parent path, "
+            "and compare the throughput,\n\tdefault entry count: %d "
+            "(max %d), batch size: %d\n", argv[0], DEFAULT_ENTRY_COUNT,
+            FDIR_MAX_ENTRIES_PER_PATH, DEFAULT_BATCH_SIZE);
+}
+
+//the children count of a directory is limited by the server
+static int create_pass_dir(const FDIRDEntryFullName *parent,
+        const char *name, char *path, const int size,
+        FDIRDEntryFullName *dir)
+{
+    int result;
+
+    dir->ns = parent->ns;
+    dir->path.str = path;
+    dir->path.len = snprintf(path, size, "%.*s/%s",
+            parent->path.len, parent->path.str, name);
+    if ((result=fdir_client_create_dentry(&g_client_global_vars.
+                    server_cluster, dir, 0, 0755 | S_IFDIR)) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "create directory %s fail, errno: %d, error info: %s",
+                __LINE__, path, result, STRERROR(result));
+    }
+    return result;
+}
+
+static int create_one_by_one(const FDIRDEntryFullName *parent,
+        const char *prefix, const int count)
+{
+    FDIRDEntryFullName fullname;
+    char path[PATH_MAX];
+    int result;
+    int i;
+
+    fullname.ns = parent->ns;
+    fullname.path.str = path;
+    for (i=0; i<count; i++) {
+        fullname.path.len = snprintf(path, sizeof(path), "%.*s/%s%08d",
+                parent->path.len, parent->path.str, prefix, i);
+        if ((result=fdir_client_create_dentry(&g_client_global_vars.
+                        server_cluster, &fullname, 0, 0644 | S_IFREG)) != 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "create %s fail, errno: %d, error info: %s",
+                    __LINE__, path, result, STRERROR(result));
+            return result;
+        }
+    }
+    return 0;
+}
+
+static int create_by_batch(const FDIRDEntryFullName *parent,
+        const char *prefix, const int count, const int batch_size)
+{
+    string_t *names;
+    char *name_buff;
+    int *results;
+    int name_size;
+    int current;
+    int start;
+    int result;
+    int i;
+
+    name_size = strlen(prefix) + 16;
+    names = (string_t *)malloc(sizeof(string_t) * batch_size);
+    results = (int *)malloc(sizeof(int) * batch_size);
+    name_buff = (char *)malloc(name_size * batch_size);
+    if (names == NULL || results == NULL || name_buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc fail, batch size: %d", __LINE__, batch_size);
+        return ENOMEM;
+    }
+
+    result = 0;
+    for (start=0; start<count; start+=batch_size) {
+        current = (count - start < batch_size) ? count - start : batch_size;
+        for (i=0; i<current; i++) {
+            names[i].str = name_buff + name_size * i;
+            names[i].len = sprintf(names[i].str, "%s%08d",
+                    prefix, start + i);
+        }
+
+        if ((result=fdir_client_batch_create_dentry(&g_client_global_vars.
+                        server_cluster, parent, names, current, 0,
+                        0644 | S_IFREG, results)) != 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "batch create fail, errno: %d, error info: %s",
+                    __LINE__, result, STRERROR(result));
+            break;
+        }
+
+        for (i=0; i<current; i++) {
+            if (results[i] != 0) {
+                logError("file: "__FILE__", line: %d, "
+                        "create %.*s fail, errno: %d, error info: %s",
+                        __LINE__, names[i].len, names[i].str,
+                        results[i], STRERROR(results[i]));
+                result = results[i];
+                break;
+            }
+        }
+        if (result != 0) {
+            break;
+        }
+    }
+
+    free(names);
+    free(results);
+    free(name_buff);
+    return result;
+}
+
+static void output_result(const char *caption, const int count,
+        const int64_t time_used)
+{
+    printf("%-12s: %d entries, %"PRId64" ms, %.1f us per entry, "
+            "%.0f entries per second\n", caption, count, time_used / 1000,
+            (double)time_used / count, (double)count * 1000000 /
+            (time_used > 0 ? time_used : 1));
+}
+
+int main(int argc, char *argv[])
+{
+    const char *config_filename = "/etc/fdir/client.conf";
+    FDIRDEntryFullName parent;
+    FDIRDEntryFullName single_dir;
+    FDIRDEntryFullName batch_dir;
+    char single_name[32];
+    char batch_name[32];
+    char single_path[PATH_MAX];
+    char batch_path[PATH_MAX];
+    char *ns;
+    int64_t start_time;
+    int64_t single_time;
+    int64_t batch_time;
+    int entry_count;
+    int batch_size;
+    int result;
+    int ch;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    ns = NULL;
+    entry_count = DEFAULT_ENTRY_COUNT;
+    batch_size = DEFAULT_BATCH_SIZE;
+    while ((ch=getopt(argc, argv, "hc:n:N:b:")) != -1) {
+        switch (ch) {
+            case 'h':
+                usage(argv);
+                return 0;
+            case 'c':
+                config_filename = optarg;
+                break;
+            case 'n':
+                ns = optarg;
+                break;
+            case 'N':
+                entry_count = atoi(optarg);
+                break;
+            case 'b':
+                batch_size = atoi(optarg);
+                break;
+            default:
+                usage(argv);
+                return 1;
+        }
+    }
+
+    if (ns == NULL || optind >= argc || entry_count <= 0 ||
+            entry_count > FDIR_MAX_ENTRIES_PER_PATH ||
+            batch_size <= 0 || batch_size > FDIR_BATCH_DENTRY_MAX_COUNT)
+    {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    if ((result=fdir_client_init(config_filename)) != 0) {
+        return result;
+    }
+
+    FC_SET_STRING(parent.ns, ns);
+    FC_SET_STRING(parent.path, argv[optind]);
+    result = fdir_client_create_dentry(&g_client_global_vars.server_cluster,
+            &parent, 0, 0755 | S_IFDIR);
+    if (result != 0 && result != EEXIST) {
+        return result;
+    }
+
+    //the subdirectories of each run are unique by the pid
+    sprintf(single_name, "single-%d", (int)getpid());
+    sprintf(batch_name, "batch-%d", (int)getpid());
+    if ((result=create_pass_dir(&parent, single_name, single_path,
+                    sizeof(single_path), &single_dir)) != 0 ||
+            (result=create_pass_dir(&parent, batch_name, batch_path,
+                    sizeof(batch_path), &batch_dir)) != 0)
+    {
+        return result;
+    }
+
+    start_time = get_current_time_us();
+    if ((result=create_one_by_one(&single_dir, "f", entry_count)) != 0) {
+        return result;
+    }
+    single_time = get_current_time_us() - start_time;
+
+    start_time = get_current_time_us();
+    if ((result=create_by_batch(&batch_dir, "f",
+                    entry_count, batch_size)) != 0)
+    {
+        return result;
+    }
+    batch_time = get_current_time_us() - start_time;
+
+    output_result("one by one", entry_count, single_time);
+    output_result("batch", entry_count, batch_time);
+    printf("batch size: %d, speedup: %.2fx\n", batch_size,
+            (double)single_time / (batch_time > 0 ? batch_time : 1));
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/connection_pool.h"
+#include "fastdir/fdir_proto.h"
+#include "fastdir/fdir_client.h"
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [-c config_filename] "
+            "<host[:port]>\n", argv[0]);
+}
+
+static void output_percentiles(const char *caption,
+        const FDIRLatencyPercentiles *p)
+{
+    printf("    %-10s count: %"PRId64", p50: %d us, p99: %d us, "
+            "p999: %d us, max: %d us\n", caption, p->count,
+            p->p50, p->p99, p->p999, p->max);
+}
+
+static void output_latency_stats(const FDIRLatencyStats *stats)
+{
+    const FDIRCmdLatency *cmd;
+    const FDIRCmdLatency *cmd_end;
+    const FDIRStatusCount *status;
+    const FDIRStatusCount *status_end;
+
+    cmd_end = stats->cmds + stats->cmd_count;
+    for (cmd=stats->cmds; cmd<cmd_end; cmd++) {
+        printf("cmd: %d (%s), errors: %"PRId64"\n", cmd->cmd,
+                fdir_get_cmd_caption(cmd->cmd), cmd->errors);
+        output_percentiles("total", &cmd->total);
+        if (cmd->forwarded.count > 0) {
+            output_percentiles("forwarded", &cmd->forwarded);
+        }
+    }
+
+    if (stats->status_count > 0) {
+        printf("\nerrors by status:\n");
+    }
+    status_end = stats->statuses + stats->status_count;
+    for (status=stats->statuses; status<status_end; status++) {
+        printf("    status: %d (%s), count: %"PRId64"\n",
+                status->status, STRERROR(status->status),
+                status->count);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+	int ch;
+    const char *config_filename = "/etc/fdir/client.conf";
+    ConnectionInfo conn;
+    FDIRLatencyStats stats;
+	int result;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    while ((ch=getopt(argc, argv, "hc:")) != -1) {
+        switch (ch) {
+            case 'h':
+                usage(argv);
+                break;
+            case 'c':
+                config_filename = optarg;
+                break;
+            default:
+                usage(argv);
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    if ((result=fdir_client_init(config_filename)) != 0) {
+        return result;
+    }
+
+    if ((result=conn_pool_parse_server_info(argv[optind], &conn,
+                    FDIR_SERVER_DEFAULT_SERVICE_PORT)) != 0)
+    {
+        return result;
+    }
+    if ((result=conn_pool_connect_server(&conn, g_client_global_vars.
+                    connect_timeout)) != 0)
+    {
+        return result;
+    }
+
+    if ((result=fdir_client_latency_stat(&conn, &stats)) == 0) {
+        output_latency_stats(&stats);
+    }
+    conn_pool_disconnect_server(&conn);
+    return result;
+}
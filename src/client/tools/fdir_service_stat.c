@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/connection_pool.h"
+#include "fastdir/fdir_client.h"
+
+#define MAX_THREAD_COUNT  256
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [-c config_filename] "
+            "<host[:port]>\n", argv[0]);
+}
+
+static void output_thread_stats(const FDIRThreadStat *stats, const int count)
+{
+    const FDIRThreadStat *stat;
+    const FDIRThreadStat *end;
+    int64_t requests;
+    int64_t forwarded;
+    int64_t checks;
+    int64_t negatives;
+    int64_t false_positives;
+    int64_t rebuilds;
+
+    requests = forwarded = 0;
+    checks = negatives = false_positives = rebuilds = 0;
+    printf("%-8s %16s %16s %10s %16s %16s %16s %16s\n", "thread",
+            "requests", "forwarded", "ratio", "bloom checks",
+            "bloom negatives", "false positives", "bloom rebuilds");
+    end = stats + count;
+    for (stat=stats; stat<end; stat++) {
+        printf("%-8d %16"PRId64" %16"PRId64" %9.2f%% %16"PRId64
+                " %16"PRId64" %16"PRId64" %16"PRId64"\n",
+                (int)(stat - stats), stat->requests, stat->forwarded,
+                stat->requests > 0 ? 100.00 * stat->forwarded /
+                stat->requests : 0.00, stat->bloom.checks,
+                stat->bloom.negatives, stat->bloom.false_positives,
+                stat->bloom.rebuilds);
+        requests += stat->requests;
+        forwarded += stat->forwarded;
+        checks += stat->bloom.checks;
+        negatives += stat->bloom.negatives;
+        false_positives += stat->bloom.false_positives;
+        rebuilds += stat->bloom.rebuilds;
+    }
+    printf("%-8s %16"PRId64" %16"PRId64" %9.2f%% %16"PRId64
+            " %16"PRId64" %16"PRId64" %16"PRId64"\n", "total",
+            requests, forwarded, requests > 0 ?
+            100.00 * forwarded / requests : 0.00,
+            checks, negatives, false_positives, rebuilds);
+}
+
+static void output_binlog_stat(const FDIRBinlogStat *binlog_stat)
+{
+    printf("\ndata version: %"PRId64", binlog min version: %"PRId64"\n",
+            binlog_stat->data_version, binlog_stat->min_version);
+    printf("binlog sync count: %"PRId64", bytes: %"PRId64
+            ", avg bytes per sync: %"PRId64", avg time used: %"PRId64
+            " us, max time used: %d us\n", binlog_stat->sync.count,
+            binlog_stat->sync.bytes, binlog_stat->sync.count > 0 ?
+            binlog_stat->sync.bytes / binlog_stat->sync.count : 0,
+            binlog_stat->sync.count > 0 ? binlog_stat->sync.time_used /
+            binlog_stat->sync.count : 0, binlog_stat->sync.max_time_used);
+}
+
+int main(int argc, char *argv[])
+{
+	int ch;
+    const char *config_filename = "/etc/fdir/client.conf";
+    ConnectionInfo conn;
+    FDIRThreadStat stats[MAX_THREAD_COUNT];
+    FDIRBinlogStat binlog_stat;
+    int count;
+	int result;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    while ((ch=getopt(argc, argv, "hc:")) != -1) {
+        switch (ch) {
+            case 'h':
+                usage(argv);
+                break;
+            case 'c':
+                config_filename = optarg;
+                break;
+            default:
+                usage(argv);
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    if ((result=fdir_client_init(config_filename)) != 0) {
+        return result;
+    }
+
+    if ((result=conn_pool_parse_server_info(argv[optind], &conn,
+                    FDIR_SERVER_DEFAULT_SERVICE_PORT)) != 0)
+    {
+        return result;
+    }
+    if ((result=conn_pool_connect_server(&conn, g_client_global_vars.
+                    connect_timeout)) != 0)
+    {
+        return result;
+    }
+
+    if ((result=fdir_client_service_stat(&conn, stats,
+                    MAX_THREAD_COUNT, &count, &binlog_stat)) == 0)
+    {
+        output_thread_stats(stats, count);
+        output_binlog_stat(&binlog_stat);
+    }
+    conn_pool_disconnect_server(&conn);
+    return result;
+}
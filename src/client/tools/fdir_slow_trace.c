@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/connection_pool.h"
+#include "fastdir/fdir_proto.h"
+#include "fastdir/fdir_client.h"
+
+#define DEFAULT_TRACE_COUNT  100
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [-c config_filename] [-n count] "
+            "<host[:port]>\n", argv[0]);
+}
+
+static void output_traces(const FDIRSlowTrace *traces, const int count)
+{
+    const FDIRSlowTrace *trace;
+    const FDIRSlowTrace *end;
+    struct tm tm;
+    time_t t;
+    char time_buff[32];
+
+    end = traces + count;
+    for (trace=traces; trace<end; trace++) {
+        t = trace->time_us / 1000000;
+        localtime_r(&t, &tm);
+        strftime(time_buff, sizeof(time_buff), "%Y-%m-%d %H:%M:%S", &tm);
+        printf("%s.%06d %s cmd: %d (%s), status: %d, thread: %d, "
+                "req body len: %d%s%s\n", time_buff,
+                (int)(trace->time_us % 1000000), trace->client_ip,
+                trace->cmd, fdir_get_cmd_caption(trace->cmd),
+                trace->status, trace->thread_index, trace->req_body_len,
+                trace->forwarded ? ", forwarded" : "",
+                trace->sampled ? ", sampled" : "");
+        printf("    total: %d us, parse: %d us, forward: %d us, "
+                "execute: %d us, binlog: %d us, send: %d us\n",
+                trace->total, trace->parse, trace->forward,
+                trace->execute, trace->binlog, trace->send);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+	int ch;
+    const char *config_filename = "/etc/fdir/client.conf";
+    ConnectionInfo conn;
+    FDIRSlowTrace *traces;
+    int size;
+    int count;
+	int result;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    size = DEFAULT_TRACE_COUNT;
+    while ((ch=getopt(argc, argv, "hc:n:")) != -1) {
+        switch (ch) {
+            case 'h':
+                usage(argv);
+                break;
+            case 'c':
+                config_filename = optarg;
+                break;
+            case 'n':
+                size = atoi(optarg);
+                break;
+            default:
+                usage(argv);
+                return 1;
+        }
+    }
+
+    if (optind >= argc || size <= 0) {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    if ((result=fdir_client_init(config_filename)) != 0) {
+        return result;
+    }
+
+    traces = (FDIRSlowTrace *)malloc(sizeof(FDIRSlowTrace) * size);
+    if (traces == NULL) {
+        fprintf(stderr, "malloc %d bytes fail\n",
+                (int)sizeof(FDIRSlowTrace) * size);
+        return ENOMEM;
+    }
+
+    if ((result=conn_pool_parse_server_info(argv[optind], &conn,
+                    FDIR_SERVER_DEFAULT_SERVICE_PORT)) != 0)
+    {
+        return result;
+    }
+    if ((result=conn_pool_connect_server(&conn, g_client_global_vars.
+                    connect_timeout)) != 0)
+    {
+        return result;
+    }
+
+    if ((result=fdir_client_slow_trace(&conn, traces, size, &count)) == 0) {
+        output_traces(traces, count);
+    }
+    conn_pool_disconnect_server(&conn);
+    free(traces);
+    return result;
+}
@@ -0,0 +1,176 @@
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define FDIR_CRC32C_HW_SUPPORTED  1
+#endif
+#include "fdir_func.h"
+
+#define FDIR_CRC32C_POLY  0x82F63B78   //the reversed Castagnoli polynomial
+
+typedef unsigned int (*crc32c_update_func)(unsigned int crc,
+        const char *buff, const int len);
+
+static unsigned int crc32c_table[256];
+static crc32c_update_func crc32c_update;
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+static unsigned int crc32c_update_sw(unsigned int crc,
+        const char *buff, const int len)
+{
+    const unsigned char *p;
+    const unsigned char *end;
+
+    end = (const unsigned char *)buff + len;
+    for (p=(const unsigned char *)buff; p<end; p++) {
+        crc = crc32c_table[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef FDIR_CRC32C_HW_SUPPORTED
+__attribute__((target("sse4.2")))
+static unsigned int crc32c_update_hw(unsigned int crc,
+        const char *buff, const int len)
+{
+    const char *p;
+    const char *end;
+    uint64_t crc64;
+    uint64_t v;
+
+    p = buff;
+    end = buff + len;
+    crc64 = crc;
+    while (end - p >= 8) {
+        memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+        p += 8;
+    }
+    crc = (unsigned int)crc64;
+    while (p < end) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+static void crc32c_init()
+{
+    unsigned int crc;
+    int i;
+    int k;
+
+    for (i=0; i<256; i++) {
+        crc = i;
+        for (k=0; k<8; k++) {
+            crc = (crc & 1) ? (crc >> 1) ^ FDIR_CRC32C_POLY : crc >> 1;
+        }
+        crc32c_table[i] = crc;
+    }
+
+#ifdef FDIR_CRC32C_HW_SUPPORTED
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc32c_update = crc32c_update_hw;
+        return;
+    }
+#endif
+    crc32c_update = crc32c_update_sw;
+}
+
+unsigned int fdir_crc32c_update(unsigned int crc,
+        const char *buff, const int len)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+    return crc32c_update(crc, buff, len);
+}
+
+//return end when not found
+static inline const char *fdir_find_slash(const char *p, const char *end)
+{
+#ifdef __SSE2__
+    __m128i slashes;
+    int mask;
+
+    slashes = _mm_set1_epi8('/');
+    while (end - p >= 16) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(
+                        (const __m128i *)p), slashes));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    while (p < end && *p != '/') {
+        p++;
+    }
+    return p;
+}
+
+int fdir_parse_path(const string_t *ns, const string_t *path,
+        string_t *parts, const int max_count, int *count,
+        unsigned int *parent_hash_code, unsigned int *hash_code)
+{
+    const char *part;
+    const char *slash;
+    const char *end;
+    unsigned int crc;
+    unsigned int parent_crc;
+    int len;
+
+    pthread_once(&crc32c_once, crc32c_init);
+    crc = crc32c_update(0xFFFFFFFF, ns->str, ns->len);
+    parent_crc = crc;
+    *count = 0;
+
+    part = path->str;
+    end = path->str + path->len;
+    while (part < end) {
+        slash = fdir_find_slash(part, end);
+        len = slash - part;
+        if (len > 0) {
+            if (len > NAME_MAX) {
+                return ENAMETOOLONG;
+            }
+            if (parts != NULL) {
+                if (*count >= max_count) {
+                    return EOVERFLOW;
+                }
+                parts[*count].str = (char *)part;
+                parts[*count].len = len;
+            }
+            (*count)++;
+
+            parent_crc = crc;
+            crc = crc32c_update(crc, "/", 1);
+            crc = crc32c_update(crc, part, len);
+        }
+        part = slash + 1;
+    }
+
+    *parent_hash_code = ~parent_crc;
+    *hash_code = ~crc;
+    return 0;
+}
+
+unsigned int fdir_get_dentry_hashcode(const string_t *ns,
+        const string_t *path, const bool include_last)
+{
+    unsigned int parent_hash_code;
+    unsigned int hash_code;
+    int count;
+
+    if (fdir_parse_path(ns, path, NULL, 0, &count,
+                &parent_hash_code, &hash_code) != 0)
+    {
+        return 0;  //the invalid path will be rejected by the server
+    }
+    return include_last ? hash_code : parent_hash_code;
+}
@@ -0,0 +1,42 @@
+#ifndef _FDIR_FUNC_H
+#define _FDIR_FUNC_H
+
+#include "fdir_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    //CRC32C (Castagnoli), use the SSE4.2 instruction when the CPU supports
+    unsigned int fdir_crc32c_update(unsigned int crc,
+            const char *buff, const int len);
+
+    /* split the path to the non-empty parts, validate and hash them in
+       one pass. the hash code is the CRC32C of the logic path:
+       namespace + "/part1/part2/...", the parent hash code excludes
+       the last part.
+       parts: NULL for calculating the hash codes only
+       return error no, 0 for success */
+    int fdir_parse_path(const string_t *ns, const string_t *path,
+            string_t *parts, const int max_count, int *count,
+            unsigned int *parent_hash_code, unsigned int *hash_code);
+
+    /* the hash code of the logic path, the last part is excluded when
+       include_last is false (the hash code of the parent).
+       the server routes the request to the work thread by this hash code,
+       so the client and the server MUST use the same function */
+    unsigned int fdir_get_dentry_hashcode(const string_t *ns,
+            const string_t *path, const bool include_last);
+
+    static inline unsigned int fdir_get_parent_hashcode(
+            const FDIRDEntryFullName *fullname)
+    {
+        return fdir_get_dentry_hashcode(&fullname->ns,
+                &fullname->path, false);
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -11,6 +11,82 @@ void fdir_proto_init()
 {
 }
 
+const char *fdir_get_cmd_caption(const int cmd)
+{
+    switch (cmd) {
+        case FDIR_PROTO_ACK:
+            return "ACK";
+        case FDIR_PROTO_ACTIVE_TEST_REQ:
+            return "ACTIVE_TEST_REQ";
+        case FDIR_PROTO_ACTIVE_TEST_RESP:
+            return "ACTIVE_TEST_RESP";
+        case FDIR_SERVICE_PROTO_CREATE_DENTRY:
+            return "CREATE_DENTRY";
+        case FDIR_SERVICE_PROTO_REMOVE_DENTRY:
+            return "REMOVE_DENTRY";
+        case FDIR_SERVICE_PROTO_LIST_DENTRY_FIRST_REQ:
+            return "LIST_DENTRY_FIRST_REQ";
+        case FDIR_SERVICE_PROTO_LIST_DENTRY_NEXT_REQ:
+            return "LIST_DENTRY_NEXT_REQ";
+        case FDIR_SERVICE_PROTO_LIST_DENTRY_RESP:
+            return "LIST_DENTRY_RESP";
+        case FDIR_SERVICE_PROTO_BATCH_CREATE_DENTRY_REQ:
+            return "BATCH_CREATE_DENTRY_REQ";
+        case FDIR_SERVICE_PROTO_BATCH_CREATE_DENTRY_RESP:
+            return "BATCH_CREATE_DENTRY_RESP";
+        case FDIR_SERVICE_PROTO_BATCH_OP_REQ:
+            return "BATCH_OP_REQ";
+        case FDIR_SERVICE_PROTO_BATCH_OP_RESP:
+            return "BATCH_OP_RESP";
+        case FDIR_SERVICE_PROTO_STAT_DENTRY_REQ:
+            return "STAT_DENTRY_REQ";
+        case FDIR_SERVICE_PROTO_STAT_DENTRY_RESP:
+            return "STAT_DENTRY_RESP";
+        case FDIR_SERVICE_PROTO_BIND_THREAD_REQ:
+            return "BIND_THREAD_REQ";
+        case FDIR_SERVICE_PROTO_BIND_THREAD_RESP:
+            return "BIND_THREAD_RESP";
+        case FDIR_SERVICE_PROTO_SERVICE_STAT_REQ:
+            return "SERVICE_STAT_REQ";
+        case FDIR_SERVICE_PROTO_SERVICE_STAT_RESP:
+            return "SERVICE_STAT_RESP";
+        case FDIR_SERVICE_PROTO_LATENCY_STAT_REQ:
+            return "LATENCY_STAT_REQ";
+        case FDIR_SERVICE_PROTO_LATENCY_STAT_RESP:
+            return "LATENCY_STAT_RESP";
+        case FDIR_SERVICE_PROTO_SLOW_TRACE_REQ:
+            return "SLOW_TRACE_REQ";
+        case FDIR_SERVICE_PROTO_SLOW_TRACE_RESP:
+            return "SLOW_TRACE_RESP";
+        case FDIR_CLUSTER_PROTO_GET_SERVER_STATUS_REQ:
+            return "GET_SERVER_STATUS_REQ";
+        case FDIR_CLUSTER_PROTO_GET_SERVER_STATUS_RESP:
+            return "GET_SERVER_STATUS_RESP";
+        case FDIR_CLUSTER_PROTO_JOIN_MASTER:
+            return "JOIN_MASTER";
+        case FDIR_CLUSTER_PROTO_PING_MASTER_REQ:
+            return "PING_MASTER_REQ";
+        case FDIR_CLUSTER_PROTO_PING_MASTER_RESP:
+            return "PING_MASTER_RESP";
+        case FDIR_CLUSTER_PROTO_PRE_SET_NEXT_MASTER:
+            return "PRE_SET_NEXT_MASTER";
+        case FDIR_CLUSTER_PROTO_COMMIT_NEXT_MASTER:
+            return "COMMIT_NEXT_MASTER";
+        case FDIR_CLUSTER_PROTO_NOTIFY_RESELECT_MASTER:
+            return "NOTIFY_RESELECT_MASTER";
+        case FDIR_CLUSTER_PROTO_MASTER_PUSH_CLUSTER_CHG:
+            return "MASTER_PUSH_CLUSTER_CHG";
+        case FDIR_CLUSTER_PROTO_MASTER_PUSH_BINLOG:
+            return "MASTER_PUSH_BINLOG";
+        case FDIR_REPLICA_PROTO_JOIN_SLAVE_REQ:
+            return "JOIN_SLAVE_REQ";
+        case FDIR_REPLICA_PROTO_JOIN_SLAVE_RESP:
+            return "JOIN_SLAVE_RESP";
+        default:
+            return "UNKNOWN";
+    }
+}
+
 int fdir_proto_set_body_length(struct fast_task_info *task)
 {
     FDIRProtoHeader *header;
@@ -83,12 +159,17 @@ int fdir_check_response(ConnectionInfo *conn, FDIRResponseInfo *response,
     return response->header.status;
 }
 
+static volatile int next_req_id = 0;
+
 int fdir_send_and_recv_response_header(ConnectionInfo *conn, char *data,
         const int len, FDIRResponseInfo *response, const int network_timeout)
 {
     int result;
+    int req_id;
     FDIRProtoHeader header_proto;
 
+    req_id = __sync_add_and_fetch(&next_req_id, 1);
+    FDIR_PROTO_SET_REQ_ID((FDIRProtoHeader *)data, req_id);
     if ((result=tcpsenddata_nb(conn->sock, data, len, network_timeout)) != 0) {
         response->error.length = snprintf(response->error.message,
                 sizeof(response->error.message),
@@ -112,6 +193,16 @@ int fdir_send_and_recv_response_header(ConnectionInfo *conn, char *data,
     }
 
     fdir_proto_extract_header(&header_proto, &response->header);
+    if (response->header.req_id != req_id) {
+        /* the response of a former request which timed out,
+           the connection is out of sync and should be closed */
+        response->error.length = snprintf(response->error.message,
+                sizeof(response->error.message),
+                "server %s:%d, response req_id: %d != expect: %d",
+                conn->ip_addr, conn->port,
+                response->header.req_id, req_id);
+        return ECONNRESET;
+    }
     return 0;
 }
 
@@ -20,6 +20,24 @@
 #define FDIR_SERVICE_PROTO_LIST_DENTRY_FIRST_REQ   45
 #define FDIR_SERVICE_PROTO_LIST_DENTRY_NEXT_REQ    47
 #define FDIR_SERVICE_PROTO_LIST_DENTRY_RESP        48
+#define FDIR_SERVICE_PROTO_BATCH_CREATE_DENTRY_REQ   49
+#define FDIR_SERVICE_PROTO_BATCH_CREATE_DENTRY_RESP  50
+#define FDIR_SERVICE_PROTO_BATCH_OP_REQ            51
+#define FDIR_SERVICE_PROTO_BATCH_OP_RESP           52
+#define FDIR_SERVICE_PROTO_STAT_DENTRY_REQ         53
+#define FDIR_SERVICE_PROTO_STAT_DENTRY_RESP        54
+#define FDIR_SERVICE_PROTO_BIND_THREAD_REQ         55
+#define FDIR_SERVICE_PROTO_BIND_THREAD_RESP        56
+#define FDIR_SERVICE_PROTO_SERVICE_STAT_REQ        57
+#define FDIR_SERVICE_PROTO_SERVICE_STAT_RESP       58
+#define FDIR_SERVICE_PROTO_LATENCY_STAT_REQ        59
+#define FDIR_SERVICE_PROTO_LATENCY_STAT_RESP       60
+#define FDIR_SERVICE_PROTO_SLOW_TRACE_REQ          91
+#define FDIR_SERVICE_PROTO_SLOW_TRACE_RESP         92
+
+//flags for batch op
+#define FDIR_BATCH_OP_FLAGS_ANY_ORDER        1  //the ops can be reordered
+#define FDIR_BATCH_OP_FLAGS_ABORT_ON_ERROR   2  //cancel the remain ops
 
 
 //cluster commands
@@ -59,10 +77,15 @@
     do {  \
         FDIR_PROTO_SET_MAGIC((header)->magic);   \
         (header)->cmd = _cmd;      \
+        (header)->flags = 0;       \
         (header)->status[0] = (header)->status[1] = 0; \
         int2buff(_body_len, (header)->body_len); \
+        int2buff(0, (header)->req_id); \
     } while (0)
 
+#define FDIR_PROTO_SET_REQ_ID(header, _req_id) \
+    int2buff(_req_id, (header)->req_id)
+
 #define FDIR_PROTO_SET_RESPONSE_HEADER(proto_header, resp_header) \
     do {  \
         (proto_header)->cmd = (resp_header).cmd;       \
@@ -73,10 +96,10 @@
 typedef struct fdir_proto_header {
     unsigned char magic[4]; //magic number
     char body_len[4];       //body length
+    char req_id[4];         //request id, the server echoes it back
     char status[2];         //status to store errno
-    char flags[2];
+    unsigned char flags;
     unsigned char cmd;      //the command code
-    char padding[3];
 } FDIRProtoHeader;
 
 typedef struct fdir_proto_dentry_info {
@@ -97,10 +120,70 @@ typedef struct fdir_proto_create_dentry_body {
     FDIRProtoDEntryInfo dentry;
 } FDIRProtoCreateDEntryBody;
 
+typedef struct fdir_proto_batch_create_dentry_front {
+    char flags[4];
+    char mode[4];
+    char count[4];   //name count
+    char padding[4];
+} FDIRProtoBatchCreateDEntryFront;
+
+typedef struct fdir_proto_batch_create_dentry_body {
+    FDIRProtoBatchCreateDEntryFront front;
+    FDIRProtoDEntryInfo parent;
+    //FDIRProtoDEntryNamePart names[count]; after the parent's path_str
+} FDIRProtoBatchCreateDEntryBody;
+
+typedef struct fdir_proto_dentry_name_part {
+    unsigned char name_len;
+    char name_str[0];
+} FDIRProtoDEntryNamePart;
+
+typedef struct fdir_proto_batch_create_dentry_resp_body_header {
+    char count[4];
+    char success_count[4];
+    //char status[count][2]; in the order of the request names
+} FDIRProtoBatchCreateDEntryRespBodyHeader;
+
 typedef struct fdir_proto_remove_dentry{
     FDIRProtoDEntryInfo dentry;
 } FDIRProtoRemoveDEntry;
 
+typedef struct fdir_proto_stat_dentry_body {
+    FDIRProtoDEntryInfo dentry;
+} FDIRProtoStatDEntryBody;
+
+typedef struct fdir_proto_dentry_stat {
+    char inode[8];
+    char mode[4];
+    char ctime[4];
+    char mtime[4];
+    char padding[4];
+    char size[8];
+} FDIRProtoDEntryStat;
+
+typedef struct fdir_proto_batch_op_front {
+    char count[4];
+    char flags[4];
+} FDIRProtoBatchOpFront;
+
+typedef struct fdir_proto_batch_op_header {
+    char body_len[4];
+    unsigned char cmd;  //CREATE_DENTRY, REMOVE_DENTRY or STAT_DENTRY_REQ
+    char padding[3];
+    //char body[body_len]; the same as the body of the cmd
+} FDIRProtoBatchOpHeader;
+
+typedef struct fdir_proto_batch_op_resp_body_header {
+    char count[4];
+    char success_count[4];
+} FDIRProtoBatchOpRespBodyHeader;
+
+typedef struct fdir_proto_batch_op_resp_body_part {
+    char status[2];
+    char padding[6];
+    FDIRProtoDEntryStat stat;  //for create and stat
+} FDIRProtoBatchOpRespBodyPart;
+
 typedef struct fdir_proto_list_dentry_first_body {
     FDIRProtoDEntryInfo dentry;
 } FDIRProtoListDEntryFirstBody;
@@ -123,6 +206,91 @@ typedef struct fdir_proto_list_dentry_resp_body_part {
     char name_str[0];
 } FDIRProtoListDEntryRespBodyPart;
 
+typedef struct fdir_proto_bind_thread_req {
+    char thread_index[4];  //the work thread to bind the connection
+    char padding[4];
+} FDIRProtoBindThreadReq;
+
+typedef struct fdir_proto_bind_thread_resp {
+    char work_threads[4];  //for the client to compute the owner thread
+    char thread_index[4];  //the bound thread
+} FDIRProtoBindThreadResp;
+
+typedef struct fdir_proto_service_stat_resp_body_header {
+    char thread_count[4];
+    char binlog_sync_max_time_used[4];  //in us
+    char binlog_sync_count[8];      //the fdatasync count of the binlog
+    char binlog_sync_bytes[8];      //the bytes written by these syncs
+    char binlog_sync_time_used[8];  //the total fdatasync time in us
+    char data_version[8];        //the current data version
+    char binlog_min_version[8];  //the min data version in the binlog files
+} FDIRProtoServiceStatRespBodyHeader;
+
+typedef struct fdir_proto_service_stat_resp_body_part {
+    char requests[8];   //the requests received by the thread
+    char forwarded[8];  //the requests forwarded to other threads
+    char bloom_checks[8];     //the lookups checked by the bloom filters
+    char bloom_negatives[8];  //the lookups skipped by the bloom filters
+    char bloom_false_positives[8];
+    char bloom_rebuilds[8];   //the bloom filters built or rebuilt
+} FDIRProtoServiceStatRespBodyPart;
+
+typedef struct fdir_proto_latency_stat_resp_body_header {
+    char cmd_count[4];
+    char status_count[4];
+} FDIRProtoLatencyStatRespBodyHeader;
+
+typedef struct fdir_proto_latency_percentiles {
+    char count[8];
+    char p50[4];   //in microseconds
+    char p99[4];
+    char p999[4];
+    char max[4];
+} FDIRProtoLatencyPercentiles;
+
+typedef struct fdir_proto_latency_stat_cmd_part {
+    unsigned char cmd;
+    char padding[7];
+    char errors[8];
+    FDIRProtoLatencyPercentiles total;
+    FDIRProtoLatencyPercentiles forwarded;  //the time waiting in forwarding
+} FDIRProtoLatencyStatCmdPart;
+
+typedef struct fdir_proto_latency_stat_status_part {
+    char status[2];
+    char padding[6];
+    char count[8];
+} FDIRProtoLatencyStatStatusPart;
+
+typedef struct fdir_proto_slow_trace_req {
+    char count[4];   //the max entry count to fetch
+    char padding[4];
+} FDIRProtoSlowTraceReq;
+
+typedef struct fdir_proto_slow_trace_resp_body_header {
+    char count[4];
+    char padding[4];
+} FDIRProtoSlowTraceRespBodyHeader;
+
+//the time used of each stage in microseconds
+typedef struct fdir_proto_slow_trace_entry {
+    char time_us[8];   //the request start time
+    char total[4];
+    char parse[4];
+    char forward[4];
+    char execute[4];
+    char binlog[4];
+    char send[4];
+    char req_body_len[4];
+    char status[2];
+    char thread_index[2];
+    unsigned char cmd;
+    unsigned char sampled;
+    unsigned char forwarded;
+    char padding[5];
+    char client_ip[16];
+} FDIRProtoSlowTraceEntry;
+
 typedef struct fdir_proto_get_server_status_req {
     char server_id[4];
     char config_sign[16];
@@ -162,6 +330,8 @@ extern "C" {
 
 void fdir_proto_init();
 
+const char *fdir_get_cmd_caption(const int cmd);
+
 int fdir_proto_set_body_length(struct fast_task_info *task);
 
 int fdir_check_response(ConnectionInfo *conn, FDIRResponseInfo *response,
@@ -213,7 +383,8 @@ static inline void fdir_proto_extract_header(FDIRProtoHeader *header_proto,
 {
     header_info->cmd = header_proto->cmd;
     header_info->body_len = buff2int(header_proto->body_len);
-    header_info->flags = buff2short(header_proto->flags);
+    header_info->flags = header_proto->flags;
+    header_info->req_id = buff2int(header_proto->req_id);
     header_info->status = buff2short(header_proto->status);
 }
 
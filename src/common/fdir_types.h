@@ -11,14 +11,22 @@
 #define FDIR_CONNECT_TIMEOUT_DEFAULT     5
 
 #define FDIR_DEFAULT_BINLOG_BUFFER_SIZE (64 * 1024)
+#define FDIR_DEFAULT_BINLOG_INDEX_INTERVAL (64 * 1024)
+#define FDIR_DEFAULT_BINLOG_COMPRESS_BLOCK_SIZE (256 * 1024)
+#define FDIR_DEFAULT_BINLOG_TAIL_CACHE_SIZE (64 * 1024 * 1024)
 
 #define FDIR_SERVER_DEFAULT_CLUSTER_PORT  11011
 #define FDIR_SERVER_DEFAULT_SERVICE_PORT  11012
 
 #define FDIR_MAX_PATH_COUNT  128
+#define FDIR_MAX_ENTRIES_PER_PATH  (16 * 1024)  //the children of one dir
+
+#define FDIR_BATCH_DENTRY_MAX_COUNT  (4 * 1024)
+#define FDIR_BATCH_OP_MAX_COUNT       256
 
 typedef struct {
     int body_len;      //body length
+    int req_id;        //request id for connection multiplexing
     short flags;
     short status;
     unsigned char cmd; //command
@@ -0,0 +1,340 @@
+//access_log.c
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/pthread_func.h"
+#include "sf/sf_global.h"
+#include "server_global.h"
+#include "access_log.h"
+
+//single producer (the work thread) and single consumer (the flush thread)
+typedef struct fdir_access_log_ring {
+    FDIRAccessLogRecord *records;
+    volatile int64_t head;     //the next position to write
+    volatile int64_t tail;     //the next position to flush
+    volatile int64_t dropped;  //dropped when the ring is full
+} FDIRAccessLogRing;
+
+typedef struct fdir_access_log_context {
+    int fd;
+    int64_t file_size;
+    char filename[PATH_MAX];
+    int ring_size;   //power of 2
+    int ring_count;  //the work thread count
+    FDIRAccessLogRing *rings;
+    int64_t last_dropped;
+    pthread_t flush_tid;
+    volatile bool running;
+} FDIRAccessLogContext;
+
+static FDIRAccessLogContext access_log_ctx = {-1};
+
+void access_log_write(const FDIRAccessLogEntry *entry)
+{
+    FDIRAccessLogRing *ring;
+    FDIRAccessLogRecord *record;
+    int64_t head;
+
+    if (entry->thread_index >= access_log_ctx.ring_count) {
+        return;
+    }
+
+    ring = access_log_ctx.rings + entry->thread_index;
+    head = ring->head;
+    if (head - ring->tail >= access_log_ctx.ring_size) {
+        ring->dropped++;
+        return;
+    }
+
+    record = ring->records + (head & (access_log_ctx.ring_size - 1));
+    long2buff(entry->time_us, record->time_us);
+    int2buff(entry->time_used, record->time_used);
+    int2buff(entry->req_body_len, record->req_body_len);
+    int2buff(entry->resp_body_len, record->resp_body_len);
+    short2buff(entry->status, record->status);
+    record->req_cmd = entry->req_cmd;
+    record->resp_cmd = entry->resp_cmd;
+    record->thread_index = entry->thread_index;
+    record->forwarded = entry->forwarded;
+    record->padding = 0;
+    record->ip_family = entry->peer->family;
+    memcpy(record->client_ip, entry->peer->addr, sizeof(record->client_ip));
+
+    __sync_synchronize();  //publish the record before the head
+    ring->head = head + 1;
+}
+
+static int access_log_rotate_file()
+{
+    char new_filename[PATH_MAX + 32];
+    struct tm tm;
+    time_t current_time;
+    int len;
+    int i;
+    int result;
+
+    current_time = time(NULL);
+    localtime_r(&current_time, &tm);
+    len = snprintf(new_filename, sizeof(new_filename), "%s.",
+            access_log_ctx.filename);
+    strftime(new_filename + len, sizeof(new_filename) - len,
+            "%Y%m%d_%H%M%S", &tm);
+    len = strlen(new_filename);
+    for (i=1; access(new_filename, F_OK) == 0; i++) {
+        sprintf(new_filename + len, ".%d", i);
+    }
+
+    if (rename(access_log_ctx.filename, new_filename) != 0) {
+        result = errno != 0 ? errno : EPERM;
+        logError("file: "__FILE__", line: %d, "
+                "rename file %s to %s fail, errno: %d, error info: %s",
+                __LINE__, access_log_ctx.filename, new_filename,
+                result, STRERROR(result));
+        return result;
+    }
+    return 0;
+}
+
+static int access_log_check_file()
+{
+    FDIRAccessLogFileHeader header;
+    struct stat stbuf;
+    int result;
+
+    if (fstat(access_log_ctx.fd, &stbuf) != 0) {
+        result = errno != 0 ? errno : EACCES;
+        logError("file: "__FILE__", line: %d, "
+                "stat file %s fail, errno: %d, error info: %s",
+                __LINE__, access_log_ctx.filename,
+                result, STRERROR(result));
+        return result;
+    }
+
+    access_log_ctx.file_size = stbuf.st_size;
+    if (access_log_ctx.file_size == 0) {
+        return ENOENT;
+    }
+
+    if (access_log_ctx.file_size < sizeof(header) || pread(access_log_ctx.
+                fd, &header, sizeof(header), 0) != sizeof(header))
+    {
+        return EINVAL;
+    }
+    return access_log_check_file_header(&header);
+}
+
+static int access_log_open_file()
+{
+    FDIRAccessLogFileHeader header;
+    int result;
+
+    access_log_ctx.fd = open(access_log_ctx.filename,
+            O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (access_log_ctx.fd < 0) {
+        result = errno != 0 ? errno : EACCES;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, access_log_ctx.filename,
+                result, STRERROR(result));
+        return result;
+    }
+
+    if ((result=access_log_check_file()) == 0) {
+        return 0;
+    }
+
+    if (result != ENOENT) {
+        //the file of the other format, keep it aside
+        logWarning("file: "__FILE__", line: %d, "
+                "access log file %s is not version %d, rotate it",
+                __LINE__, access_log_ctx.filename,
+                FDIR_ACCESS_LOG_VERSION);
+        close(access_log_ctx.fd);
+        access_log_ctx.fd = -1;
+        if ((result=access_log_rotate_file()) != 0) {
+            return result;
+        }
+        return access_log_open_file();
+    }
+
+    access_log_pack_file_header(&header);
+    if (write(access_log_ctx.fd, &header, sizeof(header)) != sizeof(header)) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "write to file %s fail, errno: %d, error info: %s",
+                __LINE__, access_log_ctx.filename,
+                result, STRERROR(result));
+        close(access_log_ctx.fd);
+        access_log_ctx.fd = -1;
+        return result;
+    }
+    access_log_ctx.file_size = sizeof(header);
+    return 0;
+}
+
+static void access_log_check_rotate()
+{
+    if (access_log_ctx.fd < 0) {  //the last reopen fail
+        access_log_open_file();
+        return;
+    }
+
+    if (ACCESS_LOG_ROTATE_SIZE == 0 || access_log_ctx.file_size <
+            ACCESS_LOG_ROTATE_SIZE)
+    {
+        return;
+    }
+
+    close(access_log_ctx.fd);
+    access_log_ctx.fd = -1;
+    access_log_rotate_file();
+    access_log_open_file();
+}
+
+static void access_log_flush_ring(FDIRAccessLogRing *ring)
+{
+    int64_t head;
+    int64_t tail;
+    int start;
+    int count;
+    int bytes;
+
+    head = ring->head;
+    __sync_synchronize();
+    tail = ring->tail;
+    while (tail < head) {
+        start = tail & (access_log_ctx.ring_size - 1);
+        count = head - tail;
+        if (count > access_log_ctx.ring_size - start) {
+            count = access_log_ctx.ring_size - start;
+        }
+
+        bytes = sizeof(FDIRAccessLogRecord) * count;
+        if (write(access_log_ctx.fd, ring->records + start, bytes) != bytes) {
+            logError("file: "__FILE__", line: %d, "
+                    "write to access log fail, errno: %d, error info: %s",
+                    __LINE__, errno, STRERROR(errno));
+        } else {
+            access_log_ctx.file_size += bytes;
+        }
+        tail += count;
+    }
+
+    __sync_synchronize();
+    ring->tail = tail;
+}
+
+static void access_log_flush_all()
+{
+    FDIRAccessLogRing *ring;
+    FDIRAccessLogRing *end;
+    int64_t dropped;
+
+    dropped = 0;
+    end = access_log_ctx.rings + access_log_ctx.ring_count;
+    for (ring=access_log_ctx.rings; ring<end; ring++) {
+        if (access_log_ctx.fd >= 0) {
+            access_log_flush_ring(ring);
+        }
+        dropped += ring->dropped;
+    }
+
+    if (dropped != access_log_ctx.last_dropped) {
+        logWarning("file: "__FILE__", line: %d, "
+                "access log ring full, %"PRId64" records dropped, "
+                "total dropped: %"PRId64, __LINE__, dropped -
+                access_log_ctx.last_dropped, dropped);
+        access_log_ctx.last_dropped = dropped;
+    }
+}
+
+static void *access_log_flush_thread_func(void *arg)
+{
+    while (access_log_ctx.running) {
+        usleep(ACCESS_LOG_FLUSH_INTERVAL_MS * 1000);
+        access_log_flush_all();
+        access_log_check_rotate();
+    }
+    return NULL;
+}
+
+int access_log_init()
+{
+    FDIRAccessLogRing *ring;
+    FDIRAccessLogRing *end;
+    int bytes;
+    int result;
+
+    if (!ACCESS_LOG_ENABLED) {
+        return 0;
+    }
+
+    access_log_ctx.ring_size = 1;
+    while (access_log_ctx.ring_size < ACCESS_LOG_RING_SIZE) {
+        access_log_ctx.ring_size *= 2;
+    }
+    access_log_ctx.ring_count = g_sf_global_vars.work_threads;
+
+    bytes = sizeof(FDIRAccessLogRing) * access_log_ctx.ring_count;
+    access_log_ctx.rings = (FDIRAccessLogRing *)malloc(bytes);
+    if (access_log_ctx.rings == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+    memset(access_log_ctx.rings, 0, bytes);
+
+    bytes = sizeof(FDIRAccessLogRecord) * access_log_ctx.ring_size;
+    end = access_log_ctx.rings + access_log_ctx.ring_count;
+    for (ring=access_log_ctx.rings; ring<end; ring++) {
+        ring->records = (FDIRAccessLogRecord *)malloc(bytes);
+        if (ring->records == NULL) {
+            logError("file: "__FILE__", line: %d, "
+                    "malloc %d bytes fail", __LINE__, bytes);
+            return ENOMEM;
+        }
+    }
+
+    snprintf(access_log_ctx.filename, sizeof(access_log_ctx.filename),
+            "%s/logs/%s", SF_G_BASE_PATH, FDIR_ACCESS_LOG_FILENAME);
+    if ((result=access_log_open_file()) != 0) {
+        return result;
+    }
+
+    access_log_ctx.running = true;
+    if ((result=fc_create_thread(&access_log_ctx.flush_tid,
+                    access_log_flush_thread_func, NULL,
+                    SF_G_THREAD_STACK_SIZE)) != 0)
+    {
+        access_log_ctx.running = false;
+        return result;
+    }
+
+    return 0;
+}
+
+void access_log_terminate()
+{
+    if (!access_log_ctx.running) {
+        return;
+    }
+
+    access_log_ctx.running = false;
+    pthread_join(access_log_ctx.flush_tid, NULL);
+    access_log_flush_all();
+    if (access_log_ctx.fd >= 0) {
+        close(access_log_ctx.fd);
+        access_log_ctx.fd = -1;
+    }
+}
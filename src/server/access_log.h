@@ -0,0 +1,147 @@
+//access_log.h
+
+#ifndef _FDIR_ACCESS_LOG_H
+#define _FDIR_ACCESS_LOG_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include "fastcommon/common_define.h"
+#include "fastcommon/shared_func.h"
+
+#define FDIR_ACCESS_LOG_FILENAME  "fdir_access.log"
+
+#define FDIR_ACCESS_LOG_DEFAULT_RING_SIZE          (64 * 1024)
+#define FDIR_ACCESS_LOG_DEFAULT_FLUSH_INTERVAL_MS  100
+#define FDIR_ACCESS_LOG_DEFAULT_ROTATE_SIZE        (256 * 1024 * 1024)
+
+#define FDIR_ACCESS_LOG_MAGIC    "FDAL"
+#define FDIR_ACCESS_LOG_VERSION  1
+
+//the header at the beginning of the access log file
+typedef struct fdir_access_log_file_header {
+    char magic[4];
+    char version[4];
+    char record_size[4];
+    char padding[4];
+} FDIRAccessLogFileHeader;
+
+//the peer address parsed once per connection
+typedef struct fdir_access_log_peer {
+    unsigned char family;  //AF_INET, AF_INET6 or 0 for unknown
+    char addr[16];         //IPv4 or IPv6 address in network order
+} FDIRAccessLogPeer;
+
+//the record in the access log file, integers are big-endian
+typedef struct fdir_access_log_record {
+    char time_us[8];      //the request start time in microseconds
+    char time_used[4];    //in microseconds
+    char req_body_len[4];
+    char resp_body_len[4];
+    char status[2];
+    unsigned char req_cmd;
+    unsigned char resp_cmd;
+    unsigned char thread_index;
+    unsigned char forwarded;
+    unsigned char ip_family;  //AF_INET, AF_INET6 or 0 for unknown
+    char padding;
+    char client_ip[16];   //IPv4 or IPv6 address in network order
+} FDIRAccessLogRecord;
+
+typedef struct fdir_access_log_entry {
+    int64_t time_us;
+    int time_used;
+    int req_body_len;
+    int resp_body_len;
+    short status;
+    unsigned char req_cmd;
+    unsigned char resp_cmd;
+    unsigned char thread_index;
+    bool forwarded;
+    const FDIRAccessLogPeer *peer;
+} FDIRAccessLogEntry;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    int access_log_init();
+    void access_log_terminate();
+
+    //called by the work thread, the record is dropped when the ring is full
+    void access_log_write(const FDIRAccessLogEntry *entry);
+
+    static inline void access_log_parse_peer(const char *client_ip,
+            FDIRAccessLogPeer *peer)
+    {
+        if (inet_pton(AF_INET, client_ip, peer->addr) == 1) {
+            peer->family = AF_INET;
+        } else if (inet_pton(AF_INET6, client_ip, peer->addr) == 1) {
+            peer->family = AF_INET6;
+        } else {
+            peer->family = 0;
+        }
+    }
+
+    //client_ip buffer size must >= INET6_ADDRSTRLEN
+    static inline const char *access_log_format_peer(
+            const FDIRAccessLogPeer *peer, char *client_ip)
+    {
+        if (peer->family == 0 || inet_ntop(peer->family, peer->addr,
+                    client_ip, INET6_ADDRSTRLEN) == NULL)
+        {
+            strcpy(client_ip, "-");
+        }
+        return client_ip;
+    }
+
+    static inline void access_log_pack_file_header(
+            FDIRAccessLogFileHeader *header)
+    {
+        memcpy(header->magic, FDIR_ACCESS_LOG_MAGIC, sizeof(header->magic));
+        int2buff(FDIR_ACCESS_LOG_VERSION, header->version);
+        int2buff(sizeof(FDIRAccessLogRecord), header->record_size);
+        memset(header->padding, 0, sizeof(header->padding));
+    }
+
+    static inline int access_log_check_file_header(
+            const FDIRAccessLogFileHeader *header)
+    {
+        if (memcmp(header->magic, FDIR_ACCESS_LOG_MAGIC,
+                    sizeof(header->magic)) != 0)
+        {
+            return EINVAL;
+        }
+        if (buff2int(header->version) != FDIR_ACCESS_LOG_VERSION ||
+                buff2int(header->record_size) !=
+                sizeof(FDIRAccessLogRecord))
+        {
+            return EOPNOTSUPP;
+        }
+        return 0;
+    }
+
+    static inline void access_log_unpack_record(
+            const FDIRAccessLogRecord *record,
+            FDIRAccessLogEntry *entry, FDIRAccessLogPeer *peer)
+    {
+        entry->time_us = buff2long(record->time_us);
+        entry->time_used = buff2int(record->time_used);
+        entry->req_body_len = buff2int(record->req_body_len);
+        entry->resp_body_len = buff2int(record->resp_body_len);
+        entry->status = buff2short(record->status);
+        entry->req_cmd = record->req_cmd;
+        entry->resp_cmd = record->resp_cmd;
+        entry->thread_index = record->thread_index;
+        entry->forwarded = record->forwarded;
+        peer->family = record->ip_family;
+        memcpy(peer->addr, record->client_ip, sizeof(peer->addr));
+        entry->peer = peer;
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
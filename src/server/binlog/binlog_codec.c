@@ -0,0 +1,122 @@
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef FDIR_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef FDIR_WITH_LZ4
+#include <lz4.h>
+#endif
+#include "binlog_codec.h"
+
+int binlog_compress_check_codec(const int codec)
+{
+    switch (codec) {
+        case FDIR_BINLOG_COMPRESS_NONE:
+            return 0;
+#ifdef FDIR_WITH_ZLIB
+        case FDIR_BINLOG_COMPRESS_ZLIB:
+            return 0;
+#endif
+#ifdef FDIR_WITH_LZ4
+        case FDIR_BINLOG_COMPRESS_LZ4:
+            return 0;
+#endif
+        default:
+            return ENOTSUP;
+    }
+}
+
+const char *binlog_compress_get_codec_caption(const int codec)
+{
+    switch (codec) {
+        case FDIR_BINLOG_COMPRESS_ZLIB:
+            return "zlib";
+        case FDIR_BINLOG_COMPRESS_LZ4:
+            return "lz4";
+        default:
+            return "none";
+    }
+}
+
+int binlog_codec_compress_bound(const int codec, const int length)
+{
+    switch (codec) {
+#ifdef FDIR_WITH_ZLIB
+        case FDIR_BINLOG_COMPRESS_ZLIB:
+            return compressBound(length);
+#endif
+#ifdef FDIR_WITH_LZ4
+        case FDIR_BINLOG_COMPRESS_LZ4:
+            return LZ4_compressBound(length);
+#endif
+        default:
+            return length;
+    }
+}
+
+int binlog_codec_compress(const int codec, const char *in, const int in_len,
+        char *out, const int out_size, int *out_len)
+{
+    switch (codec) {
+#ifdef FDIR_WITH_ZLIB
+        case FDIR_BINLOG_COMPRESS_ZLIB:
+        {
+            uLongf dest_len;
+            dest_len = out_size;
+            if (compress2((Bytef *)out, &dest_len, (const Bytef *)in,
+                        in_len, Z_DEFAULT_COMPRESSION) != Z_OK)
+            {
+                return EOVERFLOW;
+            }
+            *out_len = dest_len;
+            return 0;
+        }
+#endif
+#ifdef FDIR_WITH_LZ4
+        case FDIR_BINLOG_COMPRESS_LZ4:
+            if ((*out_len=LZ4_compress_default(in, out,
+                            in_len, out_size)) <= 0)
+            {
+                return EOVERFLOW;
+            }
+            return 0;
+#endif
+        default:
+            return ENOTSUP;
+    }
+}
+
+int binlog_codec_decompress(const int codec, const char *in, const int in_len,
+        char *out, const int out_size, int *out_len)
+{
+    switch (codec) {
+#ifdef FDIR_WITH_ZLIB
+        case FDIR_BINLOG_COMPRESS_ZLIB:
+        {
+            uLongf dest_len;
+            dest_len = out_size;
+            if (uncompress((Bytef *)out, &dest_len, (const Bytef *)in,
+                        in_len) != Z_OK)
+            {
+                return EINVAL;
+            }
+            *out_len = dest_len;
+            return 0;
+        }
+#endif
+#ifdef FDIR_WITH_LZ4
+        case FDIR_BINLOG_COMPRESS_LZ4:
+            if ((*out_len=LZ4_decompress_safe(in, out,
+                            in_len, out_size)) < 0)
+            {
+                return EINVAL;
+            }
+            return 0;
+#endif
+        default:
+            return ENOTSUP;
+    }
+}
@@ -0,0 +1,32 @@
+//binlog_codec.h
+
+#ifndef _BINLOG_CODEC_H_
+#define _BINLOG_CODEC_H_
+
+#include "../server_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//return ENOTSUP when the codec is not compiled in
+int binlog_compress_check_codec(const int codec);
+
+const char *binlog_compress_get_codec_caption(const int codec);
+
+//the max compressed length of the block
+int binlog_codec_compress_bound(const int codec, const int length);
+
+//return EOVERFLOW when the compressed data is larger than out_size
+int binlog_codec_compress(const int codec, const char *in, const int in_len,
+        char *out, const int out_size, int *out_len);
+
+//return EINVAL when the compressed data is corrupt
+int binlog_codec_decompress(const int codec, const char *in,
+        const int in_len, char *out, const int out_size, int *out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/sched_thread.h"
+#include "sf/sf_global.h"
+#include "../server_global.h"
+#include "binlog_reader.h"
+#include "binlog_consumer.h"
+#include "binlog_write_thread.h"
+#include "binlog_offset_index.h"
+#include "binlog_compress.h"
+#include "binlog_compact.h"
+
+#define GET_BINLOG_CHECKPOINT_FILENAME(filename, size) \
+    snprintf(filename, size, "%s/%s", DATA_PATH_STR,  \
+            BINLOG_CHECKPOINT_FILENAME)
+
+static volatile int64_t binlog_min_version = 0;
+
+int binlog_compact_get_checkpoint(int64_t *data_version)
+{
+    char filename[PATH_MAX];
+    char content[32];
+    char *endptr;
+    int64_t file_size;
+    int result;
+
+    GET_BINLOG_CHECKPOINT_FILENAME(filename, sizeof(filename));
+    if (access(filename, F_OK) != 0) {
+        return ENOENT;
+    }
+
+    file_size = sizeof(content) - 1;
+    if ((result=getFileContentEx(filename, content, 0, &file_size)) != 0) {
+        return result;
+    }
+    content[file_size] = '\0';
+    endptr = NULL;
+    *data_version = strtoll(content, &endptr, 10);
+    if (!(endptr == NULL || *endptr == '\0')) {
+        logError("file: "__FILE__", line: %d, "
+                "checkpoint filename: %s, invalid data version: %s",
+                __LINE__, filename, content);
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+int64_t binlog_compact_get_min_version()
+{
+    return __sync_add_and_fetch(&binlog_min_version, 0);
+}
+
+//the disk size of the plain or the compressed binlog file
+static int get_binlog_disk_size(const int binlog_index, int64_t *file_size)
+{
+    char filename[PATH_MAX];
+
+    GET_BINLOG_FILENAME(filename, sizeof(filename), binlog_index);
+    if (access(filename, F_OK) != 0 && errno == ENOENT) {
+        GET_BINLOG_COMPRESS_FILENAME(filename,
+                sizeof(filename), binlog_index);
+    }
+    return getFileSize(filename, file_size);
+}
+
+static void load_binlog_min_version()
+{
+    int64_t file_size;
+    int64_t data_version;
+    int first_index;
+
+    first_index = binlog_get_first_write_index();
+    if (get_binlog_disk_size(first_index, &file_size) != 0 ||
+            file_size == 0)
+    {
+        data_version = 0;
+    } else if (binlog_get_first_record_version(first_index,
+                &data_version) != 0)
+    {
+        return;
+    }
+
+    binlog_min_version = data_version;
+}
+
+static int remove_binlog_file(const char *filename)
+{
+    char archive_filename[PATH_MAX];
+    const char *base_name;
+
+    if (access(filename, F_OK) != 0) {
+        return 0;
+    }
+
+    if (BINLOG_RETENTION.archive) {
+        base_name = strrchr(filename, '/');
+        base_name = (base_name != NULL) ? base_name + 1 : filename;
+        snprintf(archive_filename, sizeof(archive_filename), "%s/%s/%s",
+                DATA_PATH_STR, BINLOG_ARCHIVE_PATH_NAME, base_name);
+        if (rename(filename, archive_filename) != 0) {
+            logError("file: "__FILE__", line: %d, "
+                    "rename %s to %s fail, errno: %d, error info: %s",
+                    __LINE__, filename, archive_filename,
+                    errno, STRERROR(errno));
+            return errno != 0 ? errno : EPERM;
+        }
+    } else if (unlink(filename) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "unlink %s fail, errno: %d, error info: %s",
+                __LINE__, filename, errno, STRERROR(errno));
+        return errno != 0 ? errno : EPERM;
+    }
+
+    return 0;
+}
+
+/* the binlog files whose last version < the limit can be compacted,
+   slave_version: the min data version of the slaves saved */
+static int64_t get_compact_version_limit(const int64_t checkpoint,
+        const int64_t slave_version)
+{
+    int64_t limit;
+    int64_t version;
+
+    limit = checkpoint + 1;
+    if (slave_version + 1 < limit) {
+        limit = slave_version + 1;
+    }
+
+    if (BINLOG_RETENTION.versions > 0) {
+        version = DATA_CURRENT_VERSION - BINLOG_RETENTION.versions + 1;
+        if (version < limit) {
+            limit = version;
+        }
+    }
+
+    return limit;
+}
+
+static int compact_binlog_files_func(void *args)
+{
+    char filename[PATH_MAX];
+    BinlogSegmentInfo segment;
+    int64_t checkpoint;
+    int64_t slave_version;
+    int64_t limit;
+    int64_t total_bytes;
+    int64_t file_size;
+    int first_index;
+    int current_index;
+    int index;
+    int result;
+
+    if (binlog_compact_get_checkpoint(&checkpoint) != 0) {
+        return 0;
+    }
+
+    /* the versions are saved before the files are removed, so the
+       slaves can catch up from the kept files after restart */
+    if ((result=binlog_consumer_save_slave_versions(&slave_version)) != 0) {
+        return result;
+    }
+
+    limit = get_compact_version_limit(checkpoint, slave_version);
+    first_index = binlog_get_first_write_index();
+    current_index = binlog_get_current_write_index();
+    total_bytes = 0;
+    for (index=first_index; index<=current_index; index++) {
+        if (get_binlog_disk_size(index, &file_size) == 0) {
+            total_bytes += file_size;
+        }
+    }
+
+    //only the sealed files entirely before the limit
+    for (index=first_index; index<current_index; index++) {
+        if (binlog_offset_index_load_footer(index, &segment) != 0) {
+            break;
+        }
+        if (segment.last_version >= limit) {
+            break;
+        }
+        if (get_binlog_disk_size(index, &file_size) != 0) {
+            file_size = 0;
+        }
+        if (total_bytes - file_size < BINLOG_RETENTION.bytes) {
+            break;
+        }
+        total_bytes -= file_size;
+    }
+
+    if (index == first_index) {
+        return 0;
+    }
+
+    //move the first index before removing, the readers skip these files
+    if ((result=binlog_set_first_write_index(index)) != 0) {
+        return result;
+    }
+    load_binlog_min_version();
+
+    logInfo("file: "__FILE__", line: %d, "
+            "%s the binlog files from index %d to %d, checkpoint "
+            "version: %"PRId64", the min data version: %"PRId64,
+            __LINE__, BINLOG_RETENTION.archive ? "archive" : "delete",
+            first_index, index - 1, checkpoint,
+            binlog_compact_get_min_version());
+
+    for (; first_index<index; first_index++) {
+        GET_BINLOG_FILENAME(filename, sizeof(filename), first_index);
+        remove_binlog_file(filename);
+        GET_BINLOG_COMPRESS_FILENAME(filename,
+                sizeof(filename), first_index);
+        remove_binlog_file(filename);
+        GET_BINLOG_OFFSET_INDEX_FILENAME(filename,
+                sizeof(filename), first_index);
+        remove_binlog_file(filename);
+    }
+
+    return 0;
+}
+
+int binlog_compact_init()
+{
+    char archive_path[PATH_MAX];
+    ScheduleEntry schedule_entry;
+    ScheduleArray schedule_array;
+    int result;
+
+    load_binlog_min_version();
+    if (BINLOG_RETENTION.compact_interval <= 0) {
+        return 0;
+    }
+
+    if (BINLOG_RETENTION.archive) {
+        snprintf(archive_path, sizeof(archive_path), "%s/%s",
+                DATA_PATH_STR, BINLOG_ARCHIVE_PATH_NAME);
+        if ((result=fc_check_mkdir(archive_path, 0775)) != 0) {
+            return result;
+        }
+    }
+
+    INIT_SCHEDULE_ENTRY(schedule_entry, sched_generate_next_id(),
+            0, 0, 0, BINLOG_RETENTION.compact_interval,
+            compact_binlog_files_func, NULL);
+
+    schedule_array.count = 1;
+    schedule_array.entries = &schedule_entry;
+    return sched_add_entries(&schedule_array);
+}
@@ -0,0 +1,31 @@
+//binlog_compact.h
+
+#ifndef _BINLOG_COMPACT_H_
+#define _BINLOG_COMPACT_H_
+
+#include "binlog_types.h"
+
+#define BINLOG_CHECKPOINT_FILENAME   "checkpoint.dat"
+#define BINLOG_ARCHIVE_PATH_NAME     "binlog_archive"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//setup the compaction task, should be called after the write thread inited
+int binlog_compact_init();
+
+/* the checkpoint is set by the tool fdir_binlog_checkpoint after the
+   data before it (include) is backed up, the binlog files before it
+   can be compacted. return ENOENT when no checkpoint */
+int binlog_compact_get_checkpoint(int64_t *data_version);
+
+/* the min data version in the binlog files, the slave can catch up
+   from it, 0 for the empty binlog */
+int64_t binlog_compact_get_min_version();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
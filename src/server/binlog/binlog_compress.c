@@ -0,0 +1,628 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/pthread_func.h"
+#include "sf/sf_global.h"
+#include "../server_global.h"
+#include "binlog_reader.h"
+#include "binlog_write_thread.h"
+#include "binlog_offset_index.h"
+#include "binlog_compress.h"
+
+#define BLOCK_ENTRY_SIZE  ((int)sizeof(BinlogCompressBlockEntry))
+#define TRAILER_SIZE      ((int)sizeof(BinlogCompressTrailer))
+
+typedef struct {
+    char *raw_buff;
+    char *out_buff;
+    int out_size;
+    BinlogCompressBlockEntry *entries;
+} BinlogCompressBuffers;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t tid;
+    bool notified;
+    volatile bool running;
+} compress_context;
+
+static int load_trailer(const int fd, const char *filename,
+        BinlogCompressTrailer *trailer, int64_t *file_size)
+{
+    int result;
+
+    if ((*file_size=lseek(fd, 0, SEEK_END)) < 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "lseek file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    if (*file_size < TRAILER_SIZE || pread(fd, trailer, TRAILER_SIZE,
+                *file_size - TRAILER_SIZE) != TRAILER_SIZE ||
+            memcmp(trailer->magic, BINLOG_COMPRESS_TRAILER_MAGIC,
+                sizeof(trailer->magic)) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "compressed binlog file: %s, invalid trailer",
+                __LINE__, filename);
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+static int load_block_index(BinlogCompressedFile *file,
+        const char *filename, const BinlogCompressTrailer *trailer,
+        const int64_t file_size)
+{
+    BinlogCompressBlockEntry *entries;
+    BinlogCompressBlock *block;
+    int64_t index_offset;
+    int64_t raw_offset;
+    int bytes;
+    int i;
+
+    file->codec = buff2int(trailer->codec);
+    file->block_count = buff2int(trailer->block_count);
+    file->raw_size = buff2long(trailer->raw_size);
+    index_offset = buff2long(trailer->index_offset);
+    bytes = file->block_count * BLOCK_ENTRY_SIZE;
+    if (file->block_count < 0 || index_offset + bytes +
+            TRAILER_SIZE != file_size)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "compressed binlog file: %s, invalid block count: %d",
+                __LINE__, filename, file->block_count);
+        return EINVAL;
+    }
+    if (binlog_compress_check_codec(file->codec) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "compressed binlog file: %s, the codec %s (%d) is not "
+                "supported by this build", __LINE__, filename,
+                binlog_compress_get_codec_caption(file->codec), file->codec);
+        return ENOTSUP;
+    }
+
+    entries = (BinlogCompressBlockEntry *)malloc(bytes + 1);
+    file->blocks = (BinlogCompressBlock *)malloc(sizeof(
+                BinlogCompressBlock) * (file->block_count + 1));
+    if (entries == NULL || file->blocks == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        free(entries);
+        return ENOMEM;
+    }
+    if (pread(file->fd, entries, bytes, index_offset) != bytes) {
+        logError("file: "__FILE__", line: %d, "
+                "read the block index of file \"%s\" fail",
+                __LINE__, filename);
+        free(entries);
+        return EIO;
+    }
+
+    raw_offset = 0;
+    file->in.size = file->out.size = 0;
+    for (i=0, block=file->blocks; i<file->block_count; i++, block++) {
+        block->raw_offset = buff2long(entries[i].raw_offset);
+        block->offset = buff2long(entries[i].offset);
+        block->length = buff2int(entries[i].length);
+        block->raw_length = buff2int(entries[i].raw_length);
+        if (block->raw_offset != raw_offset || block->length <= 0 ||
+                block->raw_length <= 0 || block->offset +
+                block->length > index_offset)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "compressed binlog file: %s, invalid block #%d",
+                    __LINE__, filename, i);
+            free(entries);
+            return EINVAL;
+        }
+        raw_offset += block->raw_length;
+
+        if (block->length > file->in.size) {
+            file->in.size = block->length;
+        }
+        if (block->raw_length > file->out.size) {
+            file->out.size = block->raw_length;
+        }
+    }
+    free(entries);
+
+    if (raw_offset != file->raw_size) {
+        logError("file: "__FILE__", line: %d, "
+                "compressed binlog file: %s, the blocks size: %"PRId64
+                " != raw size: %"PRId64, __LINE__, filename,
+                raw_offset, file->raw_size);
+        return EINVAL;
+    }
+
+    file->in.buff = (char *)malloc(file->in.size + 1);
+    file->out.buff = (char *)malloc(file->out.size + 1);
+    if (file->in.buff == NULL || file->out.buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__,
+                file->in.size + file->out.size);
+        return ENOMEM;
+    }
+
+    return 0;
+}
+
+int binlog_compressed_open(BinlogCompressedFile *file,
+        const int binlog_index)
+{
+    char filename[PATH_MAX];
+    BinlogCompressTrailer trailer;
+    int64_t file_size;
+    int result;
+
+    memset(file, 0, sizeof(BinlogCompressedFile));
+    file->block_index = -1;
+    GET_BINLOG_COMPRESS_FILENAME(filename, sizeof(filename), binlog_index);
+    if ((file->fd=open(filename, O_RDONLY)) < 0) {
+        result = errno != 0 ? errno : EACCES;
+        if (result != ENOENT) {
+            logError("file: "__FILE__", line: %d, "
+                    "open file \"%s\" fail, errno: %d, error info: %s",
+                    __LINE__, filename, result, STRERROR(result));
+        }
+        return result;
+    }
+
+    if ((result=load_trailer(file->fd, filename,
+                    &trailer, &file_size)) == 0)
+    {
+        result = load_block_index(file, filename, &trailer, file_size);
+    }
+    if (result != 0) {
+        binlog_compressed_close(file);
+    }
+    return result;
+}
+
+void binlog_compressed_close(BinlogCompressedFile *file)
+{
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+
+    if (file->blocks != NULL) {
+        free(file->blocks);
+        file->blocks = NULL;
+    }
+    if (file->in.buff != NULL) {
+        free(file->in.buff);
+        file->in.buff = NULL;
+    }
+    if (file->out.buff != NULL) {
+        free(file->out.buff);
+        file->out.buff = NULL;
+    }
+    file->block_index = -1;
+}
+
+int binlog_compressed_seek(BinlogCompressedFile *file,
+        const int64_t offset)
+{
+    if (offset < 0) {
+        return EINVAL;
+    }
+
+    file->position = offset < file->raw_size ? offset : file->raw_size;
+    return 0;
+}
+
+static int find_block(BinlogCompressedFile *file)
+{
+    int low;
+    int high;
+    int mid;
+
+    //sequential read
+    if (file->block_index >= 0 && file->block_index + 1 <
+            file->block_count && file->blocks[file->block_index + 1].
+            raw_offset == file->position)
+    {
+        return file->block_index + 1;
+    }
+
+    low = 0;
+    high = file->block_count - 1;
+    while (low < high) {
+        mid = (low + high + 1) / 2;
+        if (file->blocks[mid].raw_offset <= file->position) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+static int load_block(BinlogCompressedFile *file, const int block_index)
+{
+    BinlogCompressBlock *block;
+    int out_len;
+    int result;
+
+    block = file->blocks + block_index;
+    if (block->length == block->raw_length) {  //stored
+        if (pread(file->fd, file->out.buff, block->length,
+                    block->offset) != block->length)
+        {
+            return errno != 0 ? errno : EIO;
+        }
+    } else {
+        if (pread(file->fd, file->in.buff, block->length,
+                    block->offset) != block->length)
+        {
+            return errno != 0 ? errno : EIO;
+        }
+
+        if ((result=binlog_codec_decompress(file->codec, file->in.buff,
+                        block->length, file->out.buff, file->out.size,
+                        &out_len)) != 0 || out_len != block->raw_length)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "decompress the block at offset %"PRId64" fail, "
+                    "codec: %s", __LINE__, block->offset,
+                    binlog_compress_get_codec_caption(file->codec));
+            return EINVAL;
+        }
+    }
+
+    file->block_index = block_index;
+    return 0;
+}
+
+int binlog_compressed_read(BinlogCompressedFile *file,
+        char *buff, const int size)
+{
+    BinlogCompressBlock *block;
+    int offset;
+    int bytes;
+    int count;
+    int result;
+
+    count = 0;
+    while (count < size && file->position < file->raw_size) {
+        block = file->block_index >= 0 ? file->blocks +
+            file->block_index : NULL;
+        if (block == NULL || file->position < block->raw_offset ||
+                file->position >= block->raw_offset + block->raw_length)
+        {
+            if ((result=load_block(file, find_block(file))) != 0) {
+                errno = result;
+                return -1;
+            }
+            block = file->blocks + file->block_index;
+        }
+
+        offset = file->position - block->raw_offset;
+        bytes = block->raw_length - offset;
+        if (bytes > size - count) {
+            bytes = size - count;
+        }
+        memcpy(buff + count, file->out.buff + offset, bytes);
+        count += bytes;
+        file->position += bytes;
+    }
+
+    return count;
+}
+
+int binlog_compressed_get_raw_size(const int binlog_index,
+        int64_t *raw_size)
+{
+    char filename[PATH_MAX];
+    BinlogCompressTrailer trailer;
+    int64_t file_size;
+    int fd;
+    int result;
+
+    GET_BINLOG_COMPRESS_FILENAME(filename, sizeof(filename), binlog_index);
+    if ((fd=open(filename, O_RDONLY)) < 0) {
+        return errno != 0 ? errno : ENOENT;
+    }
+
+    if ((result=load_trailer(fd, filename, &trailer, &file_size)) == 0) {
+        *raw_size = buff2long(trailer.raw_size);
+    }
+    close(fd);
+    return result;
+}
+
+static int write_compressed_blocks(const int in_fd, const int out_fd,
+        const int64_t raw_size, BinlogCompressBuffers *buffers,
+        const int block_count, int64_t *file_size)
+{
+    BinlogCompressTrailer trailer;
+    int64_t raw_offset;
+    char *out;
+    int raw_length;
+    int length;
+    int i;
+
+    *file_size = 0;
+    raw_offset = 0;
+    for (i=0; i<block_count; i++) {
+        raw_length = raw_size - raw_offset < BINLOG_COMPRESS.block_size ?
+            raw_size - raw_offset : BINLOG_COMPRESS.block_size;
+        if (fc_safe_read(in_fd, buffers->raw_buff,
+                    raw_length) != raw_length)
+        {
+            return errno != 0 ? errno : EIO;
+        }
+
+        //keep the block plain when it can't be compressed
+        if (binlog_codec_compress(BINLOG_COMPRESS.codec, buffers->raw_buff,
+                    raw_length, buffers->out_buff, buffers->out_size,
+                    &length) == 0 && length < raw_length)
+        {
+            out = buffers->out_buff;
+        } else {
+            out = buffers->raw_buff;
+            length = raw_length;
+        }
+        if (fc_safe_write(out_fd, out, length) != length) {
+            return errno != 0 ? errno : EIO;
+        }
+
+        long2buff(raw_offset, buffers->entries[i].raw_offset);
+        long2buff(*file_size, buffers->entries[i].offset);
+        int2buff(length, buffers->entries[i].length);
+        int2buff(raw_length, buffers->entries[i].raw_length);
+        raw_offset += raw_length;
+        *file_size += length;
+    }
+
+    memcpy(trailer.magic, BINLOG_COMPRESS_TRAILER_MAGIC,
+            sizeof(trailer.magic));
+    int2buff(BINLOG_COMPRESS.codec, trailer.codec);
+    int2buff(block_count, trailer.block_count);
+    long2buff(*file_size, trailer.index_offset);
+    long2buff(raw_size, trailer.raw_size);
+    length = block_count * BLOCK_ENTRY_SIZE;
+    if (fc_safe_write(out_fd, (char *)buffers->entries, length) != length ||
+            fc_safe_write(out_fd, (char *)&trailer, TRAILER_SIZE) !=
+            TRAILER_SIZE || fsync(out_fd) != 0)
+    {
+        return errno != 0 ? errno : EIO;
+    }
+
+    *file_size += length + TRAILER_SIZE;
+    return 0;
+}
+
+static int do_compress_file(const char *filename, const char *tmp_filename,
+        const int64_t raw_size, int64_t *file_size)
+{
+    BinlogCompressBuffers buffers;
+    int block_count;
+    int in_fd;
+    int out_fd;
+    int result;
+
+    if ((in_fd=open(filename, O_RDONLY)) < 0) {
+        result = errno != 0 ? errno : EACCES;
+        logError("file: "__FILE__", line: %d, "
+                "open file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+    if ((out_fd=open(tmp_filename, O_WRONLY | O_CREAT | O_TRUNC,
+                    0644)) < 0)
+    {
+        result = errno != 0 ? errno : EACCES;
+        logError("file: "__FILE__", line: %d, "
+                "open file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, tmp_filename, result, STRERROR(result));
+        close(in_fd);
+        return result;
+    }
+
+    block_count = (raw_size + BINLOG_COMPRESS.block_size - 1) /
+        BINLOG_COMPRESS.block_size;
+    buffers.out_size = binlog_codec_compress_bound(BINLOG_COMPRESS.codec,
+            BINLOG_COMPRESS.block_size);
+    buffers.raw_buff = (char *)malloc(BINLOG_COMPRESS.block_size);
+    buffers.out_buff = (char *)malloc(buffers.out_size);
+    buffers.entries = (BinlogCompressBlockEntry *)malloc(
+            BLOCK_ENTRY_SIZE * (block_count + 1));
+    if (buffers.raw_buff == NULL || buffers.out_buff == NULL ||
+            buffers.entries == NULL)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, buffers.out_size +
+                BLOCK_ENTRY_SIZE * (block_count + 1));
+        result = ENOMEM;
+    } else if ((result=write_compressed_blocks(in_fd, out_fd, raw_size,
+                    &buffers, block_count, file_size)) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "compress binlog file \"%s\" to \"%s\" fail, "
+                "errno: %d, error info: %s", __LINE__, filename,
+                tmp_filename, result, STRERROR(result));
+    }
+
+    free(buffers.raw_buff);
+    free(buffers.out_buff);
+    free(buffers.entries);
+    close(in_fd);
+    close(out_fd);
+    return result;
+}
+
+static int compress_binlog_file(const int binlog_index,
+        const int64_t raw_size)
+{
+    char filename[PATH_MAX];
+    char compress_filename[PATH_MAX];
+    char tmp_filename[PATH_MAX];
+    int64_t start_time;
+    int64_t file_size;
+    int result;
+
+    GET_BINLOG_FILENAME(filename, sizeof(filename), binlog_index);
+    GET_BINLOG_COMPRESS_FILENAME(compress_filename,
+            sizeof(compress_filename), binlog_index);
+    if (access(filename, F_OK) != 0 && errno == ENOENT) {
+        return 0;  //compressed already
+    }
+
+    start_time = get_current_time_ms();
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp",
+            compress_filename);
+    if ((result=do_compress_file(filename, tmp_filename,
+                    raw_size, &file_size)) != 0)
+    {
+        unlink(tmp_filename);
+        return result;
+    }
+
+    if (rename(tmp_filename, compress_filename) != 0) {
+        result = errno != 0 ? errno : EPERM;
+        logError("file: "__FILE__", line: %d, "
+                "rename %s to %s fail, errno: %d, error info: %s",
+                __LINE__, tmp_filename, compress_filename,
+                result, STRERROR(result));
+        unlink(tmp_filename);
+        return result;
+    }
+
+    /* the compaction moves the first index before removing the files,
+       so the compressed file is removed by one of us */
+    if (binlog_index < binlog_get_first_write_index()) {
+        unlink(compress_filename);
+        return 0;
+    }
+
+    //the readers opened the plain file can still read it
+    if (unlink(filename) != 0) {
+        result = errno != 0 ? errno : EPERM;
+        logError("file: "__FILE__", line: %d, "
+                "unlink %s fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    logInfo("file: "__FILE__", line: %d, "
+            "compress binlog file %s by %s, %"PRId64" => %"PRId64" bytes, "
+            "time used: %"PRId64" ms", __LINE__, filename,
+            binlog_compress_get_codec_caption(BINLOG_COMPRESS.codec),
+            raw_size, file_size, get_current_time_ms() - start_time);
+    return 0;
+}
+
+static void compress_binlog_files()
+{
+    BinlogSegmentInfo segment;
+    int binlog_index;
+    int current_index;
+
+    binlog_index = binlog_get_compress_index();
+    if (binlog_index < binlog_get_first_write_index()) {
+        binlog_index = binlog_get_first_write_index();
+    }
+    current_index = binlog_get_current_write_index();
+    for (; binlog_index<current_index && compress_context.running;
+            binlog_index++)
+    {
+        if (binlog_offset_index_load_footer(binlog_index, &segment) == 0) {
+            if (segment.file_size > 0 && compress_binlog_file(
+                        binlog_index, segment.file_size) != 0)
+            {
+                break;  //retry when the next file rotated
+            }
+        } else if (binlog_index == current_index - 1) {
+            break;  //the rotation is sealing it
+        }  //else the file without the footer is kept plain
+
+        if (binlog_set_compress_index(binlog_index + 1) != 0) {
+            break;
+        }
+    }
+}
+
+static void *binlog_compress_thread_func(void *arg)
+{
+    while (compress_context.running) {
+        compress_binlog_files();
+
+        pthread_mutex_lock(&compress_context.lock);
+        while (!compress_context.notified && compress_context.running) {
+            pthread_cond_wait(&compress_context.cond,
+                    &compress_context.lock);
+        }
+        compress_context.notified = false;
+        pthread_mutex_unlock(&compress_context.lock);
+    }
+
+    return NULL;
+}
+
+int binlog_compress_init()
+{
+    int result;
+
+    if (BINLOG_COMPRESS.codec == FDIR_BINLOG_COMPRESS_NONE) {
+        return 0;
+    }
+
+    if ((result=init_pthread_lock(&compress_context.lock)) != 0) {
+        return result;
+    }
+    if ((result=pthread_cond_init(&compress_context.cond, NULL)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_cond_init fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+
+    compress_context.running = true;
+    if ((result=fc_create_thread(&compress_context.tid,
+                    binlog_compress_thread_func, NULL,
+                    SF_G_THREAD_STACK_SIZE)) != 0)
+    {
+        compress_context.running = false;
+    }
+    return result;
+}
+
+void binlog_compress_notify()
+{
+    if (!compress_context.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&compress_context.lock);
+    compress_context.notified = true;
+    pthread_cond_signal(&compress_context.cond);
+    pthread_mutex_unlock(&compress_context.lock);
+}
+
+void binlog_compress_finish()
+{
+    if (!compress_context.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&compress_context.lock);
+    compress_context.running = false;
+    pthread_cond_signal(&compress_context.cond);
+    pthread_mutex_unlock(&compress_context.lock);
+    pthread_join(compress_context.tid, NULL);
+}
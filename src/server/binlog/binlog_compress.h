@@ -0,0 +1,95 @@
+//binlog_compress.h
+
+#ifndef _BINLOG_COMPRESS_H_
+#define _BINLOG_COMPRESS_H_
+
+#include "binlog_types.h"
+#include "binlog_codec.h"
+
+#define BINLOG_COMPRESS_EXT  ".z"
+
+#define BINLOG_COMPRESS_TRAILER_MAGIC  "FDIRZBLK"
+
+/* the sealed binlog file is compressed to binlog.NNNNN.z by blocks:
+   the compressed blocks, the block index and the trailer.
+   the offsets of the readers and the offset index are the offsets
+   in the plain binlog file */
+typedef struct {
+    char raw_offset[8];  //the offset in the plain binlog file
+    char offset[8];      //the offset in the compressed file
+    char length[4];      //the compressed length
+    char raw_length[4];
+} BinlogCompressBlockEntry;
+
+typedef struct {
+    char magic[8];
+    char codec[4];
+    char block_count[4];
+    char index_offset[8];  //the offset of the block index
+    char raw_size[8];      //the size of the plain binlog file
+} BinlogCompressTrailer;
+
+typedef struct {
+    int64_t raw_offset;
+    int64_t offset;
+    int length;
+    int raw_length;
+} BinlogCompressBlock;
+
+typedef struct {
+    int fd;    //-1 for not opened
+    int codec;
+    int block_count;
+    int block_index;   //the decompressed block, -1 for none
+    int64_t raw_size;
+    int64_t position;  //the read position in the plain binlog file
+    BinlogCompressBlock *blocks;
+    struct {
+        char *buff;
+        int size;
+    } in;   //the compressed block
+    struct {
+        char *buff;
+        int size;
+    } out;  //the decompressed block
+} BinlogCompressedFile;
+
+#define GET_BINLOG_COMPRESS_FILENAME(filename, size, binlog_index) \
+    snprintf(filename, size, "%s/%s"BINLOG_FILE_EXT_FMT            \
+            BINLOG_COMPRESS_EXT, DATA_PATH_STR,                    \
+            BINLOG_FILE_PREFIX, binlog_index)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//start the thread to compress the sealed binlog files
+int binlog_compress_init();
+void binlog_compress_finish();
+
+//called when the binlog file rotated
+void binlog_compress_notify();
+
+//return ENOENT when the binlog file is not compressed
+int binlog_compressed_open(BinlogCompressedFile *file,
+        const int binlog_index);
+
+void binlog_compressed_close(BinlogCompressedFile *file);
+
+int binlog_compressed_seek(BinlogCompressedFile *file,
+        const int64_t offset);
+
+/* the same semantics as read(): return the bytes read,
+   0 for the end of the file, -1 for error and errno is set */
+int binlog_compressed_read(BinlogCompressedFile *file,
+        char *buff, const int size);
+
+//get the size of the plain binlog file from the trailer
+int binlog_compressed_get_raw_size(const int binlog_index,
+        int64_t *raw_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,17 +14,205 @@
 #include "fastcommon/sockopt.h"
 #include "fastcommon/shared_func.h"
 #include "fastcommon/pthread_func.h"
+#include "fastcommon/sched_thread.h"
 #include "sf/sf_global.h"
 #include "../server_global.h"
 #include "binlog_write_thread.h"
 #include "binlog_sync_thread.h"
+#include "binlog_producer.h"
 #include "binlog_consumer.h"
 
+#define BINLOG_FANOUT_LOG_SIZE  (64 * 1024)
+
+#define GET_SLAVE_VERSIONS_FILENAME(filename, size) \
+    snprintf(filename, size, "%s/%s", DATA_PATH_STR,  \
+            BINLOG_SLAVE_VERSIONS_FILENAME)
+
 ServerBinlogConsumerArray g_binlog_consumer_array;
+static ServerBinlogFanoutLog fanout_log;
 
-static int init_binlog_consumer_array()
+static int init_fanout_log()
 {
     int result;
+    int bytes;
+
+    if ((result=init_pthread_lock(&fanout_log.lock)) != 0) {
+        return result;
+    }
+    if ((result=pthread_cond_init(&fanout_log.cond, NULL)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_cond_init fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+
+    fanout_log.size = BINLOG_FANOUT_LOG_SIZE;
+    bytes = sizeof(ServerBinlogRecordBuffer *) * fanout_log.size;
+    fanout_log.entries = (ServerBinlogRecordBuffer **)malloc(bytes);
+    if (fanout_log.entries == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+
+    fanout_log.tail = 0;
+    fanout_log.reclaimed = 0;
+    fanout_log.waiting_count = 0;
+    fanout_log.running = true;
+    return 0;
+}
+
+static ServerBinlogConsumerContext *get_consumer_context(const int server_id)
+{
+    ServerBinlogConsumerContext *context;
+    ServerBinlogConsumerContext *end;
+
+    end = g_binlog_consumer_array.contexts + g_binlog_consumer_array.count;
+    for (context=g_binlog_consumer_array.contexts; context<end; context++) {
+        if (context->server->server->id == server_id) {
+            return context;
+        }
+    }
+    return NULL;
+}
+
+/* the slave behind the current data version catches up from the
+   binlog files, so the records after its saved version are sent
+   after restart and the compaction keeps them */
+static int load_slave_versions()
+{
+    ServerBinlogConsumerContext *context;
+    char filename[PATH_MAX];
+    char *content;
+    char *line;
+    char *saveptr;
+    int64_t file_size;
+    int64_t data_version;
+    int server_id;
+    int result;
+
+    GET_SLAVE_VERSIONS_FILENAME(filename, sizeof(filename));
+    if (access(filename, F_OK) != 0) {
+        return 0;
+    }
+    if ((result=getFileContent(filename, &content, &file_size)) != 0) {
+        return result;
+    }
+
+    saveptr = NULL;
+    for (line=strtok_r(content, "\n", &saveptr); line != NULL;
+            line=strtok_r(NULL, "\n", &saveptr))
+    {
+        if (sscanf(line, "%d %"SCNd64, &server_id, &data_version) != 2) {
+            logWarning("file: "__FILE__", line: %d, "
+                    "file: %s, invalid line: %s", __LINE__,
+                    filename, line);
+            continue;
+        }
+
+        context = get_consumer_context(server_id);
+        if (context == NULL || context->server == CLUSTER_MYSELF_PTR ||
+                data_version >= DATA_CURRENT_VERSION)
+        {
+            continue;
+        }
+
+        context->data_version = data_version;
+        context->saved_version = data_version;
+        context->status = BINLOG_CONSUMER_STATUS_DETACHED;
+        logInfo("file: "__FILE__", line: %d, "
+                "the slave server id: %d is behind, data version: "
+                "%"PRId64" < %"PRId64", catch up from the binlog files",
+                __LINE__, server_id, data_version, DATA_CURRENT_VERSION);
+    }
+
+    free(content);
+    return 0;
+}
+
+int binlog_consumer_save_slave_versions(int64_t *min_version)
+{
+    ServerBinlogConsumerContext *context;
+    ServerBinlogConsumerContext *end;
+    char filename[PATH_MAX];
+    char *buff;
+    int64_t data_version;
+    bool changed;
+    int bytes;
+    int len;
+    int result;
+
+    *min_version = DATA_CURRENT_VERSION;
+    changed = false;
+    end = g_binlog_consumer_array.contexts + g_binlog_consumer_array.count;
+    for (context=g_binlog_consumer_array.contexts; context<end; context++) {
+        if (context->server == CLUSTER_MYSELF_PTR) {
+            continue;
+        }
+
+        data_version = __sync_add_and_fetch(&context->data_version, 0);
+        if (data_version != context->saved_version) {
+            context->saved_version = data_version;
+            changed = true;
+        }
+        if (context->saved_version < *min_version) {
+            *min_version = context->saved_version;
+        }
+    }
+
+    if (!changed) {
+        return 0;
+    }
+
+    bytes = 64 * g_binlog_consumer_array.count;
+    buff = (char *)malloc(bytes);
+    if (buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+
+    len = 0;
+    for (context=g_binlog_consumer_array.contexts; context<end; context++) {
+        if (context->server != CLUSTER_MYSELF_PTR) {
+            len += sprintf(buff + len, "%d %"PRId64"\n",
+                    context->server->server->id, context->saved_version);
+        }
+    }
+
+    GET_SLAVE_VERSIONS_FILENAME(filename, sizeof(filename));
+    if ((result=safeWriteToFile(filename, buff, len)) != 0) {
+        for (context=g_binlog_consumer_array.contexts;
+                context<end; context++)
+        {
+            context->saved_version = -1;  //for retry
+        }
+    }
+    free(buff);
+    return result;
+}
+
+static int save_slave_versions_func(void *args)
+{
+    int64_t min_version;
+    return binlog_consumer_save_slave_versions(&min_version);
+}
+
+static int setup_slave_versions_save_task()
+{
+    ScheduleEntry schedule_entry;
+    ScheduleArray schedule_array;
+
+    INIT_SCHEDULE_ENTRY(schedule_entry, sched_generate_next_id(),
+            0, 0, 0, 1, save_slave_versions_func, NULL);
+
+    schedule_array.count = 1;
+    schedule_array.entries = &schedule_entry;
+    return sched_add_entries(&schedule_array);
+}
+
+static int init_binlog_consumer_array()
+{
     int count;
     int bytes;
     ServerBinlogConsumerContext *context;
@@ -42,12 +230,15 @@ static int init_binlog_consumer_array()
 
     end = g_binlog_consumer_array.contexts + count;
     for (context=g_binlog_consumer_array.contexts; context<end; context++) {
-        if ((result=common_blocked_queue_init_ex(&context->queue, 10240)) != 0) {
-            return result;
-        }
+        context->cursor = 0;
+        context->data_version = DATA_CURRENT_VERSION;
+        context->saved_version = DATA_CURRENT_VERSION;
+        context->status = BINLOG_CONSUMER_STATUS_ATTACHED;
+        context->server = CLUSTER_SERVER_ARRAY.servers +
+            (context - g_binlog_consumer_array.contexts);
     }
     g_binlog_consumer_array.count = count;
-    return 0;
+    return load_slave_versions();
 }
 
 static int binlog_consumer_start()
@@ -70,8 +261,6 @@ static int binlog_consumer_start()
         } else {
             thread_func = binlog_sync_thread_func;
         }
-        g_binlog_consumer_array.contexts[i].server =
-            CLUSTER_SERVER_ARRAY.servers + i;
         if ((result=pthread_create(&tid, &thread_attr, thread_func,
                         g_binlog_consumer_array.contexts + i)) != 0)
         {
@@ -90,6 +279,10 @@ int binlog_consumer_init()
 {
     int result;
 
+    if ((result=init_fanout_log()) != 0) {
+        return result;
+    }
+
     if ((result=init_binlog_consumer_array()) != 0) {
         return result;
     }
@@ -98,44 +291,286 @@ int binlog_consumer_init()
         return result;
     }
 
+    if ((result=setup_slave_versions_save_task()) != 0) {
+        return result;
+    }
+
     return binlog_consumer_start();
 }
 
 void binlog_consumer_destroy()
 {
     if (g_binlog_consumer_array.contexts != NULL) {
-        ServerBinlogConsumerContext *context;
-        ServerBinlogConsumerContext *end;
-
-        end = g_binlog_consumer_array.contexts + g_binlog_consumer_array.count;
-        for (context=g_binlog_consumer_array.contexts; context<end; context++) {
-            common_blocked_queue_destroy(&context->queue);
-        }
         free(g_binlog_consumer_array.contexts);
         g_binlog_consumer_array.contexts = NULL;
     }
+
+    if (fanout_log.entries != NULL) {
+        while (fanout_log.reclaimed < fanout_log.tail) {
+            server_binlog_free_rbuffer(fanout_log.entries[
+                    fanout_log.reclaimed++ & (fanout_log.size - 1)]);
+        }
+        free(fanout_log.entries);
+        fanout_log.entries = NULL;
+        pthread_cond_destroy(&fanout_log.cond);
+        pthread_mutex_destroy(&fanout_log.lock);
+    }
 }
 
 void binlog_consumer_terminate()
+{
+    pthread_mutex_lock(&fanout_log.lock);
+    fanout_log.running = false;
+    pthread_cond_broadcast(&fanout_log.cond);
+    pthread_mutex_unlock(&fanout_log.lock);
+}
+
+static inline bool consumer_reading_log(ServerBinlogConsumerContext *context)
+{
+    int status;
+
+    status = __sync_add_and_fetch(&context->status, 0);
+    return status == BINLOG_CONSUMER_STATUS_ATTACHED ||
+        status == BINLOG_CONSUMER_STATUS_DETACHING;
+}
+
+//free the buffers which all consumers have read
+static void fanout_log_reclaim()
 {
     ServerBinlogConsumerContext *context;
     ServerBinlogConsumerContext *end;
+    int64_t min_cursor;
+    int64_t cursor;
 
+    min_cursor = fanout_log.tail;
     end = g_binlog_consumer_array.contexts + g_binlog_consumer_array.count;
     for (context=g_binlog_consumer_array.contexts; context<end; context++) {
-        common_blocked_queue_terminate(&context->queue);
+        if (!consumer_reading_log(context)) {
+            continue;
+        }
+
+        cursor = __sync_add_and_fetch(&context->cursor, 0);
+        if (cursor < min_cursor) {
+            min_cursor = cursor;
+        }
+    }
+
+    while (fanout_log.reclaimed < min_cursor) {
+        server_binlog_free_rbuffer(fanout_log.entries[
+                fanout_log.reclaimed++ & (fanout_log.size - 1)]);
     }
 }
 
-int binlog_consumer_push_to_queues(ServerBinlogRecordBuffer *rbuffer)
+/* the slowest slave sync consumer stops reading the log at its next
+   fetch, the binlog write thread is never detached */
+static void fanout_log_detach_slowest()
 {
     ServerBinlogConsumerContext *context;
+    ServerBinlogConsumerContext *slowest;
     ServerBinlogConsumerContext *end;
+    int64_t cursor;
 
-    __sync_add_and_fetch(&rbuffer->reffer_count, g_binlog_consumer_array.count);
+    slowest = NULL;
     end = g_binlog_consumer_array.contexts + g_binlog_consumer_array.count;
     for (context=g_binlog_consumer_array.contexts; context<end; context++) {
-        common_blocked_queue_push(&context->queue, rbuffer);
+        if (!consumer_reading_log(context)) {
+            continue;
+        }
+
+        cursor = __sync_add_and_fetch(&context->cursor, 0);
+        if (slowest == NULL || cursor < slowest->cursor) {
+            slowest = context;
+        }
+    }
+
+    if (slowest == NULL || slowest->server == CLUSTER_MYSELF_PTR) {
+        logWarning("file: "__FILE__", line: %d, "
+                "binlog fanout log is full, waiting for "
+                "the binlog write thread", __LINE__);
+        return;
+    }
+
+    if (__sync_bool_compare_and_swap(&slowest->status,
+                BINLOG_CONSUMER_STATUS_ATTACHED,
+                BINLOG_CONSUMER_STATUS_DETACHING))
+    {
+        logWarning("file: "__FILE__", line: %d, "
+                "binlog fanout log is full, detach the consumer of "
+                "server id: %d, it will catch up from the binlog files",
+                __LINE__, slowest->server->server->id);
+    }
+}
+
+//the log index of the data version, -1 for not found
+static int64_t fanout_log_search(const int64_t data_version,
+        const ServerBinlogRecordBuffer *rbuffer)
+{
+    int64_t low;
+    int64_t high;
+    int64_t mid;
+    int64_t current;
+
+    if (rbuffer->data_version == data_version) {
+        return fanout_log.tail;
+    }
+
+    low = fanout_log.reclaimed;
+    high = fanout_log.tail - 1;
+    while (low <= high) {
+        mid = (low + high) / 2;
+        current = fanout_log.entries[mid & (fanout_log.size - 1)]->
+            data_version;
+        if (current == data_version) {
+            return mid;
+        } else if (current < data_version) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+//called before the rbuffer is appended
+static void fanout_log_reattach(const ServerBinlogRecordBuffer *rbuffer)
+{
+    ServerBinlogConsumerContext *context;
+    ServerBinlogConsumerContext *end;
+    int64_t index;
+
+    end = g_binlog_consumer_array.contexts + g_binlog_consumer_array.count;
+    for (context=g_binlog_consumer_array.contexts; context<end; context++) {
+        if (__sync_add_and_fetch(&context->status, 0) !=
+                BINLOG_CONSUMER_STATUS_REATTACHING)
+        {
+            continue;
+        }
+
+        index = fanout_log_search(__sync_add_and_fetch(
+                    &context->data_version, 0) + 1, rbuffer);
+        if (index < 0) {
+            continue;
+        }
+
+        context->cursor = index;
+        if (__sync_bool_compare_and_swap(&context->status,
+                    BINLOG_CONSUMER_STATUS_REATTACHING,
+                    BINLOG_CONSUMER_STATUS_ATTACHED))
+        {
+            logInfo("file: "__FILE__", line: %d, "
+                    "the consumer of server id: %d is reattached "
+                    "to the binlog fanout log", __LINE__,
+                    context->server->server->id);
+        }
+    }
+}
+
+int binlog_consumer_append(ServerBinlogRecordBuffer *rbuffer)
+{
+    int count;
+
+    fanout_log_reclaim();
+    count = 0;
+    while (fanout_log.tail - fanout_log.reclaimed >= fanout_log.size) {
+        if (!fanout_log.running) {
+            server_binlog_free_rbuffer(rbuffer);
+            return ESHUTDOWN;
+        }
+
+        if (++count == 1) {
+            fanout_log_detach_slowest();
+        }
+        usleep(1000);
+        fanout_log_reclaim();
+    }
+
+    fanout_log_reattach(rbuffer);
+    fanout_log.entries[fanout_log.tail & (fanout_log.size - 1)] = rbuffer;
+    __sync_add_and_fetch(&fanout_log.tail, 1);
+    if (__sync_add_and_fetch(&fanout_log.waiting_count, 0) > 0) {
+        pthread_mutex_lock(&fanout_log.lock);
+        pthread_cond_broadcast(&fanout_log.cond);
+        pthread_mutex_unlock(&fanout_log.lock);
     }
     return 0;
 }
+
+int binlog_consumer_fetch(ServerBinlogConsumerContext *context,
+        ServerBinlogRecordBuffer **rbuffers, const int size,
+        const bool blocked)
+{
+    int64_t tail;
+    int64_t index;
+    int count;
+
+    if (__sync_add_and_fetch(&context->status, 0) !=
+            BINLOG_CONSUMER_STATUS_ATTACHED)
+    {
+        //the consumer holds no entries here
+        __sync_bool_compare_and_swap(&context->status,
+                BINLOG_CONSUMER_STATUS_DETACHING,
+                BINLOG_CONSUMER_STATUS_DETACHED);
+        return 0;
+    }
+
+    tail = __sync_add_and_fetch(&fanout_log.tail, 0);
+    if (tail == context->cursor) {
+        if (!blocked) {
+            return 0;
+        }
+
+        pthread_mutex_lock(&fanout_log.lock);
+        __sync_add_and_fetch(&fanout_log.waiting_count, 1);
+        while ((tail=__sync_add_and_fetch(&fanout_log.tail, 0)) ==
+                context->cursor && fanout_log.running)
+        {
+            pthread_cond_wait(&fanout_log.cond, &fanout_log.lock);
+        }
+        __sync_sub_and_fetch(&fanout_log.waiting_count, 1);
+        pthread_mutex_unlock(&fanout_log.lock);
+    }
+
+    count = 0;
+    for (index=context->cursor; index<tail && count<size; index++) {
+        rbuffers[count++] = fanout_log.entries[index & (fanout_log.size - 1)];
+    }
+    return count;
+}
+
+void binlog_consumer_detach(ServerBinlogConsumerContext *context)
+{
+    __sync_bool_compare_and_swap(&context->status,
+            BINLOG_CONSUMER_STATUS_ATTACHED,
+            BINLOG_CONSUMER_STATUS_DETACHED);
+}
+
+int binlog_consumer_reattach(ServerBinlogConsumerContext *context)
+{
+    int i;
+
+    if (!__sync_bool_compare_and_swap(&context->status,
+                BINLOG_CONSUMER_STATUS_DETACHED,
+                BINLOG_CONSUMER_STATUS_REATTACHING))
+    {
+        return EINVAL;
+    }
+
+    //the appender reattaches it when appending the next buffer
+    for (i=0; i<10 && SF_G_CONTINUE_FLAG; i++) {
+        usleep(1000);
+        if (__sync_add_and_fetch(&context->status, 0) ==
+                BINLOG_CONSUMER_STATUS_ATTACHED)
+        {
+            return 0;
+        }
+    }
+
+    if (__sync_bool_compare_and_swap(&context->status,
+                BINLOG_CONSUMER_STATUS_REATTACHING,
+                BINLOG_CONSUMER_STATUS_DETACHED))
+    {
+        return EAGAIN;
+    }
+    return 0;  //reattached just now
+}
@@ -5,6 +5,11 @@
 
 #include "binlog_types.h"
 
+#define BINLOG_CONSUMER_FETCH_BATCH  256
+
+//the last data version sent to each slave, one line per slave
+#define BINLOG_SLAVE_VERSIONS_FILENAME  "slave_versions.dat"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -15,7 +20,42 @@ int binlog_consumer_init();
 void binlog_consumer_destroy();
 void binlog_consumer_terminate();
 
-int binlog_consumer_push_to_queues(ServerBinlogRecordBuffer *rbuffer);
+/* save the data versions of the slaves, called by the schedule thread.
+   min_version: return the min data version of the slaves saved,
+   the binlog files after it MUST be kept */
+int binlog_consumer_save_slave_versions(int64_t *min_version);
+
+//called by the binlog dispatcher only, in data version order
+int binlog_consumer_append(ServerBinlogRecordBuffer *rbuffer);
+
+/* get the record buffers from the consumer's cursor without consuming,
+   wait for the new records when blocked is true until terminated
+   return the record buffer count, 0 when the consumer is detached */
+int binlog_consumer_fetch(ServerBinlogConsumerContext *context,
+        ServerBinlogRecordBuffer **rbuffers, const int size,
+        const bool blocked);
+
+static inline bool binlog_consumer_detached(
+        ServerBinlogConsumerContext *context)
+{
+    return __sync_add_and_fetch(&context->status, 0) ==
+        BINLOG_CONSUMER_STATUS_DETACHED;
+}
+
+//stop reading the log, called by the consumer after advanced
+void binlog_consumer_detach(ServerBinlogConsumerContext *context);
+
+/* called by the detached consumer which has read all the records of
+   the binlog files, return 0 for reattached, EAGAIN for reading the
+   binlog files again */
+int binlog_consumer_reattach(ServerBinlogConsumerContext *context);
+
+//the fetched record buffers MUST NOT be accessed after advanced
+static inline void binlog_consumer_advance(
+        ServerBinlogConsumerContext *context, const int count)
+{
+    __sync_add_and_fetch(&context->cursor, count);
+}
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,367 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "sf/sf_global.h"
+#include "../server_global.h"
+#include "binlog_compress.h"
+#include "binlog_offset_index.h"
+
+#define INDEX_ENTRY_SIZE  ((int)sizeof(BinlogOffsetIndexEntry))
+#define FOOTER_SIZE       ((int)sizeof(BinlogSegmentFooter))
+
+static inline bool is_segment_footer(const BinlogSegmentFooter *footer)
+{
+    return buff2long(footer->flag) == -1 && memcmp(footer->magic,
+            BINLOG_SEGMENT_FOOTER_MAGIC, sizeof(footer->magic)) == 0;
+}
+
+//the size of the plain binlog file, the sealed one may be compressed
+static int get_binlog_file_size(const int binlog_index, int64_t *file_size)
+{
+    char filename[PATH_MAX];
+
+    GET_BINLOG_FILENAME(filename, sizeof(filename), binlog_index);
+    if (access(filename, F_OK) != 0 && errno == ENOENT) {
+        return binlog_compressed_get_raw_size(binlog_index, file_size);
+    }
+    return getFileSize(filename, file_size);
+}
+
+static int load_last_offset(BinlogOffsetIndexWriter *writer,
+        const char *filename)
+{
+    BinlogOffsetIndexEntry entry;
+    int64_t file_size;
+    int result;
+
+    if ((file_size=lseek(writer->fd, 0, SEEK_END)) < 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "lseek file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    if (file_size % INDEX_ENTRY_SIZE != 0) {  //torn entry
+        file_size -= file_size % INDEX_ENTRY_SIZE;
+        if (ftruncate(writer->fd, file_size) != 0) {
+            result = errno != 0 ? errno : EIO;
+            logError("file: "__FILE__", line: %d, "
+                    "truncate file \"%s\" fail, errno: %d, "
+                    "error info: %s", __LINE__, filename,
+                    result, STRERROR(result));
+            return result;
+        }
+    }
+
+    if (file_size >= FOOTER_SIZE) {
+        BinlogSegmentFooter footer;
+
+        if (pread(writer->fd, &footer, FOOTER_SIZE, file_size -
+                    FOOTER_SIZE) == FOOTER_SIZE && is_segment_footer(&footer))
+        {
+            //the binlog file is writable again
+            file_size -= FOOTER_SIZE;
+            if (ftruncate(writer->fd, file_size) != 0) {
+                result = errno != 0 ? errno : EIO;
+                logError("file: "__FILE__", line: %d, "
+                        "truncate file \"%s\" fail, errno: %d, "
+                        "error info: %s", __LINE__, filename,
+                        result, STRERROR(result));
+                return result;
+            }
+        }
+    }
+
+    if (file_size == 0) {
+        writer->last_offset = -1;
+        return 0;
+    }
+
+    if (pread(writer->fd, &entry, INDEX_ENTRY_SIZE, file_size -
+                INDEX_ENTRY_SIZE) != INDEX_ENTRY_SIZE)
+    {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "read file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    writer->last_offset = buff2long(entry.offset);
+    return 0;
+}
+
+int binlog_offset_index_open(BinlogOffsetIndexWriter *writer,
+        const int binlog_index, const bool truncate)
+{
+    char filename[PATH_MAX];
+    int flags;
+    int result;
+
+    GET_BINLOG_OFFSET_INDEX_FILENAME(filename, sizeof(filename),
+            binlog_index);
+    flags = O_RDWR | O_CREAT | O_APPEND;
+    if (truncate) {
+        flags |= O_TRUNC;
+    }
+    writer->fd = open(filename, flags, 0644);
+    if (writer->fd < 0) {
+        result = errno != 0 ? errno : EACCES;
+        logError("file: "__FILE__", line: %d, "
+                "open file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    if (truncate) {
+        writer->last_offset = -1;
+        return 0;
+    }
+
+    if ((result=load_last_offset(writer, filename)) != 0) {
+        binlog_offset_index_close(writer);
+    }
+    return result;
+}
+
+void binlog_offset_index_close(BinlogOffsetIndexWriter *writer)
+{
+    if (writer->fd >= 0) {
+        close(writer->fd);
+        writer->fd = -1;
+    }
+}
+
+int binlog_offset_index_append(BinlogOffsetIndexWriter *writer,
+        const int64_t data_version, const int64_t offset)
+{
+    BinlogOffsetIndexEntry entry;
+    int result;
+
+    if (writer->fd < 0 || BINLOG_INDEX_INTERVAL == 0 ||
+            (writer->last_offset >= 0 && offset -
+             writer->last_offset < BINLOG_INDEX_INTERVAL))
+    {
+        return 0;
+    }
+
+    long2buff(data_version, entry.data_version);
+    long2buff(offset, entry.offset);
+    if (fc_safe_write(writer->fd, (char *)&entry, INDEX_ENTRY_SIZE) !=
+            INDEX_ENTRY_SIZE)
+    {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "write to binlog offset index fail, fd: %d, "
+                "errno: %d, error info: %s", __LINE__,
+                writer->fd, result, STRERROR(result));
+        return result;
+    }
+
+    writer->last_offset = offset;
+    return 0;
+}
+
+int binlog_offset_index_seal(BinlogOffsetIndexWriter *writer,
+        const BinlogSegmentInfo *segment)
+{
+    BinlogSegmentFooter footer;
+    int result;
+
+    if (writer->fd < 0) {
+        return EBADF;
+    }
+
+    memset(&footer, 0, sizeof(footer));
+    long2buff(-1, footer.flag);
+    memcpy(footer.magic, BINLOG_SEGMENT_FOOTER_MAGIC, sizeof(footer.magic));
+    long2buff(segment->record_count, footer.record_count);
+    long2buff(segment->first_version, footer.first_version);
+    long2buff(segment->last_version, footer.last_version);
+    long2buff(segment->last_offset, footer.last_offset);
+    long2buff(segment->file_size, footer.file_size);
+    if (fc_safe_write(writer->fd, (char *)&footer, FOOTER_SIZE) !=
+            FOOTER_SIZE || fdatasync(writer->fd) != 0)
+    {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "write the footer to binlog offset index fail, "
+                "fd: %d, errno: %d, error info: %s", __LINE__,
+                writer->fd, result, STRERROR(result));
+        return result;
+    }
+
+    return 0;
+}
+
+int binlog_offset_index_load_footer(const int binlog_index,
+        BinlogSegmentInfo *segment)
+{
+    char filename[PATH_MAX];
+    BinlogSegmentFooter footer;
+    int64_t file_size;
+    int64_t bytes;
+    int result;
+
+    GET_BINLOG_OFFSET_INDEX_FILENAME(filename, sizeof(filename),
+            binlog_index);
+    if (access(filename, F_OK) != 0) {
+        return ENOENT;
+    }
+    if ((result=getFileSize(filename, &file_size)) != 0) {
+        return result;
+    }
+    if (file_size < FOOTER_SIZE) {
+        return ENOENT;
+    }
+
+    bytes = FOOTER_SIZE;
+    if ((result=getFileContentEx(filename, (char *)&footer,
+                    file_size - FOOTER_SIZE, &bytes)) != 0)
+    {
+        return result;
+    }
+    if (bytes != FOOTER_SIZE || !is_segment_footer(&footer)) {
+        return ENOENT;
+    }
+
+    segment->record_count = buff2long(footer.record_count);
+    segment->first_version = buff2long(footer.first_version);
+    segment->last_version = buff2long(footer.last_version);
+    segment->last_offset = buff2long(footer.last_offset);
+    segment->file_size = buff2long(footer.file_size);
+
+    if ((result=get_binlog_file_size(binlog_index, &file_size)) != 0) {
+        return result;
+    }
+    if (file_size != segment->file_size) {
+        GET_BINLOG_FILENAME(filename, sizeof(filename), binlog_index);
+        logWarning("file: "__FILE__", line: %d, "
+                "binlog file: %s, file size: %"PRId64" != sealed "
+                "size: %"PRId64", ignore the footer", __LINE__,
+                filename, file_size, segment->file_size);
+        return ENOENT;
+    }
+
+    return 0;
+}
+
+int binlog_offset_index_find(const int binlog_index,
+        const int64_t data_version, int64_t *offset)
+{
+    char filename[PATH_MAX];
+    char *content;
+    BinlogOffsetIndexEntry *entries;
+    int64_t binlog_size;
+    int64_t file_size;
+    int64_t entry_offset;
+    int low;
+    int high;
+    int mid;
+    int count;
+    int result;
+
+    if ((result=get_binlog_file_size(binlog_index, &binlog_size)) != 0) {
+        return result;
+    }
+
+    GET_BINLOG_OFFSET_INDEX_FILENAME(filename, sizeof(filename),
+            binlog_index);
+    if (access(filename, F_OK) != 0) {
+        return ENOENT;
+    }
+    if ((result=getFileContent(filename, &content, &file_size)) != 0) {
+        return result;
+    }
+
+    entries = (BinlogOffsetIndexEntry *)content;
+    count = file_size / INDEX_ENTRY_SIZE;
+    if (file_size >= FOOTER_SIZE && is_segment_footer((BinlogSegmentFooter *)
+                (content + file_size - FOOTER_SIZE)))
+    {
+        count -= FOOTER_SIZE / INDEX_ENTRY_SIZE;
+    }
+    low = 0;
+    high = count - 1;
+    result = ENOENT;
+    while (low <= high) {
+        mid = (low + high) / 2;
+        if (buff2long(entries[mid].data_version) <= data_version) {
+            entry_offset = buff2long(entries[mid].offset);
+            if (entry_offset >= binlog_size) {  //lost by crash
+                high = mid - 1;
+                continue;
+            }
+            *offset = entry_offset;
+            result = 0;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    free(content);
+    return result;
+}
+
+int binlog_offset_index_truncate(const int binlog_index,
+        const int64_t binlog_size)
+{
+    char filename[PATH_MAX];
+    char *content;
+    BinlogOffsetIndexEntry *entries;
+    int64_t file_size;
+    int64_t new_size;
+    int count;
+    int result;
+
+    GET_BINLOG_OFFSET_INDEX_FILENAME(filename, sizeof(filename),
+            binlog_index);
+    if (access(filename, F_OK) != 0) {
+        return 0;
+    }
+    if ((result=getFileContent(filename, &content, &file_size)) != 0) {
+        return result;
+    }
+
+    entries = (BinlogOffsetIndexEntry *)content;
+    count = file_size / INDEX_ENTRY_SIZE;
+    if (file_size >= FOOTER_SIZE && is_segment_footer((BinlogSegmentFooter *)
+                (content + file_size - FOOTER_SIZE)))
+    {
+        count -= FOOTER_SIZE / INDEX_ENTRY_SIZE;
+    }
+    while (count > 0 && buff2long(entries[count - 1].offset) >= binlog_size) {
+        count--;
+    }
+    free(content);
+
+    new_size = (int64_t)count * INDEX_ENTRY_SIZE;
+    if (new_size == file_size) {
+        return 0;
+    }
+
+    if (truncate(filename, new_size) != 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "truncate file \"%s\" to %"PRId64" fail, "
+                "errno: %d, error info: %s", __LINE__, filename,
+                new_size, result, STRERROR(result));
+        return result;
+    }
+
+    logWarning("file: "__FILE__", line: %d, "
+            "binlog offset index file: %s, drop %"PRId64" bytes "
+            "beyond the binlog size: %"PRId64, __LINE__, filename,
+            file_size - new_size, binlog_size);
+    return 0;
+}
@@ -0,0 +1,88 @@
+//binlog_offset_index.h
+
+#ifndef _BINLOG_OFFSET_INDEX_H_
+#define _BINLOG_OFFSET_INDEX_H_
+
+#include "binlog_types.h"
+#include "binlog_reader.h"
+
+#define BINLOG_OFFSET_INDEX_EXT  ".idx"
+
+#define BINLOG_SEGMENT_FOOTER_MAGIC  "FDIRSEAL"
+
+/* the sparse index of a binlog file (binlog.NNNNN.idx), one entry per
+   BINLOG_INDEX_INTERVAL bytes at least, the data versions and
+   the offsets are ascending */
+typedef struct {
+    char data_version[8];  //the first data version of the record buffer
+    char offset[8];        //the record start offset in the binlog file
+} BinlogOffsetIndexEntry;
+
+/* appended to the index file when the binlog file is sealed (rotated),
+   the size is a multiple of the entry size */
+typedef struct {
+    char flag[8];   //all 0xFF, never be a data version
+    char magic[8];
+    char record_count[8];
+    char first_version[8];
+    char last_version[8];
+    char last_offset[8];  //the start offset of the last record
+    char file_size[8];    //the binlog file size when sealed
+    char padding[8];
+} BinlogSegmentFooter;
+
+typedef struct {
+    int64_t record_count;
+    int64_t first_version;
+    int64_t last_version;
+    int64_t last_offset;
+    int64_t file_size;
+} BinlogSegmentInfo;
+
+typedef struct {
+    int fd;
+    int64_t last_offset;  //the binlog offset of the last entry, -1 for none
+} BinlogOffsetIndexWriter;
+
+#define GET_BINLOG_OFFSET_INDEX_FILENAME(filename, size, binlog_index) \
+    snprintf(filename, size, "%s/%s"BINLOG_FILE_EXT_FMT               \
+            BINLOG_OFFSET_INDEX_EXT, DATA_PATH_STR,                   \
+            BINLOG_FILE_PREFIX, binlog_index)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//truncate: true for the new binlog file
+int binlog_offset_index_open(BinlogOffsetIndexWriter *writer,
+        const int binlog_index, const bool truncate);
+
+void binlog_offset_index_close(BinlogOffsetIndexWriter *writer);
+
+int binlog_offset_index_seal(BinlogOffsetIndexWriter *writer,
+        const BinlogSegmentInfo *segment);
+
+/* load the footer of the sealed binlog file, return ENOENT when
+   not sealed or the binlog file size changed */
+int binlog_offset_index_load_footer(const int binlog_index,
+        BinlogSegmentInfo *segment);
+
+//skip the offset nearer than BINLOG_INDEX_INTERVAL to the last entry
+int binlog_offset_index_append(BinlogOffsetIndexWriter *writer,
+        const int64_t data_version, const int64_t offset);
+
+/* find the start offset of the last indexed record buffer whose data
+   version <= the given one, return ENOENT when no entry found */
+int binlog_offset_index_find(const int binlog_index,
+        const int64_t data_version, int64_t *offset);
+
+/* drop the entries (and the stale footer) at or beyond the binlog size,
+   called after the torn tail of the binlog file is cut */
+int binlog_offset_index_truncate(const int binlog_index,
+        const int64_t binlog_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
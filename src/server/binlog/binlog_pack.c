@@ -10,10 +10,16 @@
 #include <limits.h>
 #include <fcntl.h>
 #include <pthread.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "fastcommon/logger.h"
 #include "fastcommon/shared_func.h"
 #include "fastcommon/char_converter.h"
 #include "sf/sf_global.h"
+#include "common/fdir_func.h"
 #include "../server_global.h"
 #include "binlog_func.h"
 #include "binlog_producer.h"
@@ -26,6 +32,9 @@
 #define BINLOG_RECORD_END_TAG_STR   "/rec>\n"
 #define BINLOG_RECORD_END_TAG_LEN   (sizeof(BINLOG_RECORD_END_TAG_STR) - 1)
 
+//the initial range of the record start search, doubled until found
+#define BINLOG_DETECT_FORWARD_WINDOW  256
+
 #define BINLOG_RECORD_FIELD_NAME_LENGTH         2
 
 #define BINLOG_RECORD_FIELD_NAME_INODE         "id"
@@ -68,10 +77,21 @@ typedef struct {
     } value;
 } BinlogFieldValue;
 
+#define BINLOG_VARINT_MAX_BYTES     10
+
+typedef struct {
+    unsigned char magic[2];
+    unsigned char version;
+    unsigned char operation;
+    char body_len[2];
+    char crc32[4];
+} BinlogBinaryHeader;
+
 typedef struct {
     const char *p;
     const char *rec_end;
     BinlogFieldValue fv;
+    int format;
     char *error_info;
 } FieldParserContext;
 
@@ -121,6 +141,133 @@ static inline int get_operation_integer(const string_t *operation)
     }
 }
 
+static inline unsigned int binlog_binary_crc32(const char *rec_start,
+        const int body_len)
+{
+    unsigned int crc32;
+
+    crc32 = fdir_crc32c_update(0, rec_start,
+            (long)(&((BinlogBinaryHeader *)NULL)->crc32));
+    return fdir_crc32c_update(crc32, rec_start +
+            BINLOG_BINARY_HEADER_SIZE, body_len);
+}
+
+static inline char *binlog_pack_varint(char *p, uint64_t n)
+{
+    while (n >= 0x80) {
+        *p++ = (char)(n | 0x80);
+        n >>= 7;
+    }
+    *p++ = (char)n;
+    return p;
+}
+
+static inline char *binlog_pack_varstr(char *p, const string_t *s)
+{
+    p = binlog_pack_varint(p, s->len);
+    memcpy(p, s->str, s->len);
+    return p + s->len;
+}
+
+//the upper bound of the packed record size in both formats
+static inline int binlog_record_max_size(const FDIRBinlogRecord *record)
+{
+    return BINLOG_RECORD_FIXED_FIELDS_MAX_SIZE +
+        record->path.fullname.ns.len + record->path.fullname.path.len +
+        record->extra_data.len + record->user_data.len;
+}
+
+static int binlog_pack_binary_record(const FDIRBinlogRecord *record,
+        FastBuffer *buffer)
+{
+    BinlogBinaryHeader *header;
+    char *rec_start;
+    char *p;
+    int fields;
+    int body_len;
+    int result;
+
+    if ((result=fast_buffer_check(buffer,
+                    binlog_record_max_size(record))) != 0)
+    {
+        return result;
+    }
+
+    fields = 0;
+    if (record->options.path_info.flags != 0) {
+        fields |= BINLOG_BINARY_FIELD_PATH;
+    }
+    if (record->options.extra_data) {
+        fields |= BINLOG_BINARY_FIELD_EXTRA_DATA;
+    }
+    if (record->options.user_data) {
+        fields |= BINLOG_BINARY_FIELD_USER_DATA;
+    }
+    if (record->options.mode) {
+        fields |= BINLOG_BINARY_FIELD_MODE;
+    }
+    if (record->options.ctime) {
+        fields |= BINLOG_BINARY_FIELD_CTIME;
+    }
+    if (record->options.mtime) {
+        fields |= BINLOG_BINARY_FIELD_MTIME;
+    }
+    if (record->options.size) {
+        fields |= BINLOG_BINARY_FIELD_FILE_SIZE;
+    }
+
+    rec_start = buffer->data + buffer->length;
+    p = rec_start + BINLOG_BINARY_HEADER_SIZE;
+    p = binlog_pack_varint(p, record->data_version);
+    p = binlog_pack_varint(p, record->inode);
+    p = binlog_pack_varint(p, (uint32_t)record->timestamp);
+    p = binlog_pack_varint(p, fields);
+
+    if ((fields & BINLOG_BINARY_FIELD_PATH)) {
+        p = binlog_pack_varstr(p, &record->path.fullname.ns);
+        p = binlog_pack_varstr(p, &record->path.fullname.path);
+        p = binlog_pack_varint(p, record->path.hash_code);
+    }
+    if ((fields & BINLOG_BINARY_FIELD_EXTRA_DATA)) {
+        p = binlog_pack_varstr(p, &record->extra_data);
+    }
+    if ((fields & BINLOG_BINARY_FIELD_USER_DATA)) {
+        p = binlog_pack_varstr(p, &record->user_data);
+    }
+    if ((fields & BINLOG_BINARY_FIELD_MODE)) {
+        p = binlog_pack_varint(p, (uint32_t)record->stat.mode);
+    }
+    if ((fields & BINLOG_BINARY_FIELD_CTIME)) {
+        p = binlog_pack_varint(p, (uint32_t)record->stat.ctime);
+    }
+    if ((fields & BINLOG_BINARY_FIELD_MTIME)) {
+        p = binlog_pack_varint(p, (uint32_t)record->stat.mtime);
+    }
+    if ((fields & BINLOG_BINARY_FIELD_FILE_SIZE)) {
+        p = binlog_pack_varint(p, record->stat.size);
+    }
+
+    body_len = p - (rec_start + BINLOG_BINARY_HEADER_SIZE);
+    if (BINLOG_BINARY_HEADER_SIZE + body_len > BINLOG_RECORD_MAX_SIZE) {
+        logError("file: "__FILE__", line: %d, "
+                "record length: %d is too large, exceeds %d", __LINE__,
+                BINLOG_BINARY_HEADER_SIZE + body_len,
+                BINLOG_RECORD_MAX_SIZE);
+        return EOVERFLOW;
+    }
+
+    header = (BinlogBinaryHeader *)rec_start;
+    header->magic[0] = BINLOG_BINARY_MAGIC0;
+    header->magic[1] = BINLOG_BINARY_MAGIC1;
+    header->version = BINLOG_BINARY_VERSION;
+    header->operation = record->operation;
+    short2buff(body_len, header->body_len);
+    int2buff(binlog_binary_crc32(rec_start, body_len), header->crc32);
+
+    buffer->length += BINLOG_BINARY_HEADER_SIZE + body_len;
+    return 0;
+}
+
 #define BINLOG_PACK_STRINGL(buffer, name, val, len) \
     do { \
         fast_buffer_append(buffer, " %s=%d,", name, len); \
@@ -130,14 +277,17 @@ static inline int get_operation_integer(const string_t *operation)
 #define BINLOG_PACK_STRING(buffer, name, value) \
     BINLOG_PACK_STRINGL(buffer, name, value.str, value.len)
 
-int binlog_pack_record(const FDIRBinlogRecord *record, FastBuffer *buffer)
+static int binlog_pack_text_record(const FDIRBinlogRecord *record,
+        FastBuffer *buffer)
 {
     string_t op_caption;
     int old_len;
     int record_len;
     int result;
 
-    if ((result=fast_buffer_check(buffer, 1024)) != 0) {
+    if ((result=fast_buffer_check(buffer,
+                    binlog_record_max_size(record))) != 0)
+    {
         return result;
     }
 
@@ -220,6 +370,16 @@ int binlog_pack_record(const FDIRBinlogRecord *record, FastBuffer *buffer)
     return 0;
 }
 
+int binlog_pack_record_ex(const FDIRBinlogRecord *record,
+        const int format, FastBuffer *buffer)
+{
+    if (format == FDIR_BINLOG_FORMAT_BINARY) {
+        return binlog_pack_binary_record(record, buffer);
+    } else {
+        return binlog_pack_text_record(record, buffer);
+    }
+}
+
 static int binlog_get_next_field_value(FieldParserContext *pcontext)
 {
     int remain;
@@ -275,7 +435,7 @@ static int binlog_get_next_field_value(FieldParserContext *pcontext)
                     pcontext->fv.name, n);
             return EINVAL;
         }
-    } else if (*endptr == ' ') {
+    } else if (*endptr == ' ' || *endptr == '/') {  //the last field
         pcontext->fv.type = BINLOG_FIELD_TYPE_INTEGER;
         pcontext->fv.value.n = n;
         pcontext->p = endptr;
@@ -587,6 +747,238 @@ static int binlog_check_record(const char *str, const int len,
     return 0;
 }
 
+static inline int binlog_unpack_varint(FieldParserContext *pcontext,
+        int64_t *n)
+{
+    uint64_t v;
+    int shift;
+    unsigned char ch;
+
+    v = 0;
+    for (shift=0; shift<64; shift+=7) {
+        if (pcontext->p >= pcontext->rec_end) {
+            sprintf(pcontext->error_info, "varint out of bound");
+            return EINVAL;
+        }
+
+        ch = *pcontext->p++;
+        v |= (uint64_t)(ch & 0x7F) << shift;
+        if ((ch & 0x80) == 0) {
+            *n = v;
+            return 0;
+        }
+    }
+
+    sprintf(pcontext->error_info, "varint is too long");
+    return EINVAL;
+}
+
+static inline int binlog_unpack_varstr(FieldParserContext *pcontext,
+        string_t *s)
+{
+    int64_t len;
+    int result;
+
+    if ((result=binlog_unpack_varint(pcontext, &len)) != 0) {
+        return result;
+    }
+
+    if (len < 0 || len > pcontext->rec_end - pcontext->p) {
+        sprintf(pcontext->error_info, "string length: %"PRId64
+                " out of bound", len);
+        return EINVAL;
+    }
+
+    FC_SET_STRING_EX(*s, (char *)pcontext->p, len);
+    pcontext->p += len;
+    return 0;
+}
+
+static bool binlog_is_binary_record_start(const char *str, const int len,
+        FieldParserContext *pcontext)
+{
+    const BinlogBinaryHeader *header;
+    int body_len;
+
+    if (len < BINLOG_BINARY_HEADER_SIZE) {
+        return false;
+    }
+
+    header = (const BinlogBinaryHeader *)str;
+    if (header->magic[0] != BINLOG_BINARY_MAGIC0 || header->magic[1] !=
+            BINLOG_BINARY_MAGIC1 || header->version != BINLOG_BINARY_VERSION)
+    {
+        return false;
+    }
+
+    body_len = (unsigned short)buff2short(header->body_len);
+    if (body_len > len - BINLOG_BINARY_HEADER_SIZE) {
+        return false;
+    }
+    if ((unsigned int)buff2int(header->crc32) !=
+            binlog_binary_crc32(str, body_len))
+    {
+        return false;
+    }
+
+    pcontext->format = FDIR_BINLOG_FORMAT_BINARY;
+    pcontext->p = str + BINLOG_BINARY_HEADER_SIZE;
+    pcontext->rec_end = pcontext->p + body_len;
+    return true;
+}
+
+static int binlog_check_binary_record(const char *str, const int len,
+        FieldParserContext *pcontext)
+{
+    const BinlogBinaryHeader *header;
+    int body_len;
+    unsigned int crc32;
+
+    if (len < BINLOG_BINARY_HEADER_SIZE) {
+        sprintf(pcontext->error_info, "string length: %d is too short", len);
+        return EAGAIN;
+    }
+
+    header = (const BinlogBinaryHeader *)str;
+    if (header->magic[1] != BINLOG_BINARY_MAGIC1) {
+        sprintf(pcontext->error_info, "unexpect magic: 0x%02X%02X, "
+                "expect: 0x%02X%02X", header->magic[0], header->magic[1],
+                BINLOG_BINARY_MAGIC0, BINLOG_BINARY_MAGIC1);
+        return EINVAL;
+    }
+    if (header->version != BINLOG_BINARY_VERSION) {
+        sprintf(pcontext->error_info, "unsupported binary record "
+                "version: %d", header->version);
+        return EINVAL;
+    }
+
+    body_len = (unsigned short)buff2short(header->body_len);
+    if (body_len > BINLOG_RECORD_MAX_SIZE - BINLOG_BINARY_HEADER_SIZE) {
+        sprintf(pcontext->error_info, "body length: %d is too large",
+                body_len);
+        return EINVAL;
+    }
+    if (body_len > len - BINLOG_BINARY_HEADER_SIZE) {
+        sprintf(pcontext->error_info, "record length: %d out of bound",
+                BINLOG_BINARY_HEADER_SIZE + body_len);
+        return EOVERFLOW;
+    }
+
+    crc32 = binlog_binary_crc32(str, body_len);
+    if ((unsigned int)buff2int(header->crc32) != crc32) {
+        sprintf(pcontext->error_info, "record CRC32C: %08X != "
+                "calculated: %08X", (unsigned int)buff2int(header->crc32),
+                crc32);
+        return EINVAL;
+    }
+
+    pcontext->format = FDIR_BINLOG_FORMAT_BINARY;
+    pcontext->p = str + BINLOG_BINARY_HEADER_SIZE;
+    pcontext->rec_end = pcontext->p + body_len;
+    return 0;
+}
+
+static inline int binlog_parse_binary_first_field(
+        FieldParserContext *pcontext, FDIRBinlogRecord *record)
+{
+    return binlog_unpack_varint(pcontext, &record->data_version);
+}
+
+static int binlog_parse_binary_fields(FieldParserContext *pcontext,
+        FDIRBinlogRecord *record)
+{
+    const BinlogBinaryHeader *header;
+    int64_t n;
+    int64_t fields;
+    int result;
+
+    header = (const BinlogBinaryHeader *)(pcontext->p -
+            BINLOG_BINARY_HEADER_SIZE);
+    record->operation = header->operation;
+
+#define BINLOG_UNPACK_INTEGER(var) \
+    do { \
+        if ((result=binlog_unpack_varint(pcontext, &n)) != 0) { \
+            return result; \
+        } \
+        var = n; \
+    } while (0)
+
+#define BINLOG_UNPACK_STRING(var) \
+    do { \
+        if ((result=binlog_unpack_varstr(pcontext, &var)) != 0) { \
+            return result; \
+        } \
+    } while (0)
+
+    BINLOG_UNPACK_INTEGER(record->data_version);
+    BINLOG_UNPACK_INTEGER(record->inode);
+    BINLOG_UNPACK_INTEGER(record->timestamp);
+    BINLOG_UNPACK_INTEGER(fields);
+
+    if ((fields & BINLOG_BINARY_FIELD_PATH)) {
+        BINLOG_UNPACK_STRING(record->path.fullname.ns);
+        BINLOG_UNPACK_STRING(record->path.fullname.path);
+        BINLOG_UNPACK_INTEGER(record->path.hash_code);
+        record->options.path_info.ns = 1;
+        record->options.path_info.pt = 1;
+        record->options.path_info.hc = 1;
+    }
+    if ((fields & BINLOG_BINARY_FIELD_EXTRA_DATA)) {
+        BINLOG_UNPACK_STRING(record->extra_data);
+        record->options.extra_data = 1;
+    }
+    if ((fields & BINLOG_BINARY_FIELD_USER_DATA)) {
+        BINLOG_UNPACK_STRING(record->user_data);
+        record->options.user_data = 1;
+    }
+    if ((fields & BINLOG_BINARY_FIELD_MODE)) {
+        BINLOG_UNPACK_INTEGER(record->stat.mode);
+        record->options.mode = 1;
+    }
+    if ((fields & BINLOG_BINARY_FIELD_CTIME)) {
+        BINLOG_UNPACK_INTEGER(record->stat.ctime);
+        record->options.ctime = 1;
+    }
+    if ((fields & BINLOG_BINARY_FIELD_MTIME)) {
+        BINLOG_UNPACK_INTEGER(record->stat.mtime);
+        record->options.mtime = 1;
+    }
+    if ((fields & BINLOG_BINARY_FIELD_FILE_SIZE)) {
+        BINLOG_UNPACK_INTEGER(record->stat.size);
+        record->options.size = 1;
+    }
+
+    if (pcontext->p != pcontext->rec_end) {
+        sprintf(pcontext->error_info, "%d unkown bytes at the record end",
+                (int)(pcontext->rec_end - pcontext->p));
+        return EINVAL;
+    }
+
+    return binlog_check_required_fields(pcontext, record);
+}
+
+static inline int binlog_check_record_ex(const char *str, const int len,
+        FieldParserContext *pcontext)
+{
+    if (binlog_is_binary_record(str, len)) {
+        return binlog_check_binary_record(str, len, pcontext);
+    } else {
+        pcontext->format = FDIR_BINLOG_FORMAT_TEXT;
+        return binlog_check_record(str, len, pcontext);
+    }
+}
+
+static inline int binlog_parse_first_field_ex(FieldParserContext *pcontext,
+        FDIRBinlogRecord *record)
+{
+    if (pcontext->format == FDIR_BINLOG_FORMAT_BINARY) {
+        return binlog_parse_binary_first_field(pcontext, record);
+    } else {
+        return binlog_parse_first_field(pcontext, record);
+    }
+}
+
 int binlog_unpack_record(const char *str, const int len,
         FDIRBinlogRecord *record, const char **record_end,
         char *error_info)
@@ -596,13 +988,17 @@ int binlog_unpack_record(const char *str, const int len,
 
     memset(record, 0, sizeof(*record));
     pcontext.error_info = error_info;
-    if ((result=binlog_check_record(str, len, &pcontext)) != 0) {
+    if ((result=binlog_check_record_ex(str, len, &pcontext)) != 0) {
         *record_end = NULL;
         return result;
     }
 
     *record_end = pcontext.rec_end;
-    return binlog_parse_fields(&pcontext, record);
+    if (pcontext.format == FDIR_BINLOG_FORMAT_BINARY) {
+        return binlog_parse_binary_fields(&pcontext, record);
+    } else {
+        return binlog_parse_fields(&pcontext, record);
+    }
 }
 
 int binlog_detect_record(const char *str, const int len,
@@ -613,11 +1009,11 @@ int binlog_detect_record(const char *str, const int len,
     int result;
 
     pcontext.error_info = error_info;
-    if ((result=binlog_check_record(str, len, &pcontext)) != 0) {
+    if ((result=binlog_check_record_ex(str, len, &pcontext)) != 0) {
         return result;
     }
 
-    if ((result=binlog_parse_first_field(&pcontext, &record)) != 0) {
+    if ((result=binlog_parse_first_field_ex(&pcontext, &record)) != 0) {
         return result;
     }
 
@@ -626,6 +1022,127 @@ int binlog_detect_record(const char *str, const int len,
     return 0;
 }
 
+/* find the first c0 followed by c1 (the first two bytes of the start
+   tag) in [p, end), the AVX2 / SSE2 version compares 32 / 16 positions
+   at once, return NULL when not found */
+static inline const char *binlog_find_tag(const char *p, const char *end,
+        const char c0, const char c1)
+{
+#if defined(__AVX2__)
+    __m256i v0;
+    __m256i v1;
+    unsigned int mask;
+
+    v0 = _mm256_set1_epi8(c0);
+    v1 = _mm256_set1_epi8(c1);
+    while (end - p > 32) {
+        mask = _mm256_movemask_epi8(_mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                            (const __m256i *)p), v0),
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                            (const __m256i *)(p + 1)), v1)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    __m128i v0;
+    __m128i v1;
+    unsigned int mask;
+
+    v0 = _mm_set1_epi8(c0);
+    v1 = _mm_set1_epi8(c1);
+    while (end - p > 16) {
+        mask = _mm_movemask_epi8(_mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_loadu_si128(
+                            (const __m128i *)p), v0),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(
+                            (const __m128i *)(p + 1)), v1)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    while (end - p >= 2 && (p=(const char *)memchr(p,
+                    c0, (end - 1) - p)) != NULL)
+    {
+        if (p[1] == c1) {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+/* find the last c0 followed by c1 whose position is in [start, limit),
+   the c1 can be at limit when limit < end */
+static inline const char *binlog_rfind_tag(const char *start,
+        const char *limit, const char *end, const char c0, const char c1)
+{
+    const char *p;
+
+    if (limit > end - 1) {
+        limit = end - 1;
+    }
+
+#if defined(__AVX2__)
+    {
+        __m256i v0;
+        __m256i v1;
+        unsigned int mask;
+
+        v0 = _mm256_set1_epi8(c0);
+        v1 = _mm256_set1_epi8(c1);
+        while (limit - start >= 32) {
+            p = limit - 32;
+            mask = _mm256_movemask_epi8(_mm256_and_si256(
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                                (const __m256i *)p), v0),
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                                (const __m256i *)(p + 1)), v1)));
+            if (mask != 0) {
+                return p + (31 - __builtin_clz(mask));
+            }
+            limit = p;
+        }
+    }
+#elif defined(__SSE2__)
+    {
+        __m128i v0;
+        __m128i v1;
+        unsigned int mask;
+
+        v0 = _mm_set1_epi8(c0);
+        v1 = _mm_set1_epi8(c1);
+        while (limit - start >= 16) {
+            p = limit - 16;
+            mask = _mm_movemask_epi8(_mm_and_si128(
+                        _mm_cmpeq_epi8(_mm_loadu_si128(
+                                (const __m128i *)p), v0),
+                        _mm_cmpeq_epi8(_mm_loadu_si128(
+                                (const __m128i *)(p + 1)), v1)));
+            if (mask != 0) {
+                return p + (31 - __builtin_clz(mask));
+            }
+            limit = p;
+        }
+    }
+#endif
+
+    while (limit > start && (p=(const char *)fc_memrchr(start,
+                    c0, limit - start)) != NULL)
+    {
+        if (p[1] == c1) {
+            return p;
+        }
+        limit = p;
+    }
+    return NULL;
+}
+
 static bool binlog_is_record_start(const char *str, const int len,
         FieldParserContext *pcontext)
 {
@@ -656,49 +1173,124 @@ static bool binlog_is_record_start(const char *str, const int len,
                 BINLOG_RECORD_END_TAG_STR,
                 BINLOG_RECORD_END_TAG_LEN) == 0)
     {
+        pcontext->format = FDIR_BINLOG_FORMAT_TEXT;
         pcontext->p = rec_start + BINLOG_RECORD_START_TAG_LEN;
         return true;
     }
     return false;
 }
 
-int binlog_detect_record_forward(const char *str, const int len,
-        int64_t *data_version, int *rstart_offset, int *rend_offset,
-        char *error_info)
+//the candidate starts before max_offset
+static int binlog_search_text_forward(const char *str, const int len,
+        const int max_offset, FieldParserContext *pcontext)
 {
-    FDIRBinlogRecord record;
-    FieldParserContext pcontext;
     const char *rec_start;
+    const char *start;
     const char *p;
     const char *end;
-    int result;
+    const char *search_end;
 
-    pcontext.error_info = error_info;
-    *rstart_offset = -1;
     p = str;
     end = str + len;
+    search_end = (max_offset + BINLOG_RECORD_SIZE_STRLEN < len) ?
+        str + max_offset + BINLOG_RECORD_SIZE_STRLEN + 1 : end;
     while ((end - p > 32 + BINLOG_RECORD_START_TAG_LEN) && (rec_start=
-                (const char *)memchr(p, BINLOG_RECORD_START_TAG_CHAR,
-                    end - p)) != NULL)
+                binlog_find_tag(p, search_end, BINLOG_RECORD_START_TAG_STR[0],
+                    BINLOG_RECORD_START_TAG_STR[1])) != NULL)
     {
-        const char *start;
         start = rec_start - BINLOG_RECORD_SIZE_STRLEN;
         if ((start >= str) && binlog_is_record_start(
-                    start, end - start, &pcontext))
+                    start, end - start, pcontext))
         {
-            *rstart_offset = start - str;
-            break;
+            return start - str;
         }
 
         p = rec_start + 1;
     }
 
+    return -1;
+}
+
+/* the candidate starts before max_offset and is checked against
+   the whole string, so the text record inside a binary record is
+   covered by the binary record */
+static int binlog_search_binary_forward(const char *str, const int len,
+        const int max_offset, FieldParserContext *pcontext)
+{
+    const char *rec_start;
+    const char *p;
+    const char *end;
+    const char *search_end;
+
+    p = str;
+    end = str + len;
+
+    //the tag starts before max_offset, don't scan the rest of the string
+    search_end = (max_offset < len) ? str + max_offset + 1 : end;
+    while ((end - p >= BINLOG_BINARY_HEADER_SIZE) && (rec_start=
+                binlog_find_tag(p, search_end, (char)BINLOG_BINARY_MAGIC0,
+                    (char)BINLOG_BINARY_MAGIC1)) != NULL)
+    {
+        if (binlog_is_binary_record_start(rec_start,
+                    end - rec_start, pcontext))
+        {
+            return rec_start - str;
+        }
+
+        p = rec_start + 1;
+    }
+
+    return -1;
+}
+
+int binlog_detect_record_forward(const char *str, const int len,
+        int64_t *data_version, int *rstart_offset, int *rend_offset,
+        char *error_info)
+{
+    FDIRBinlogRecord record;
+    FieldParserContext pcontext;
+    FieldParserContext binary_context;
+    int max_offset;
+    int binary_offset;
+    int result;
+
+    /* search the record starts before max_offset, so the string of
+       one format is not scanned to the end for the tag of the other */
+    pcontext.error_info = error_info;
+    max_offset = len < BINLOG_DETECT_FORWARD_WINDOW ?
+        len : BINLOG_DETECT_FORWARD_WINDOW;
+    while (1) {
+        *rstart_offset = binlog_search_text_forward(str, len,
+                max_offset, &pcontext);
+
+        /* the binary record before the text record is the first one,
+           the candidates after the text record start are ignored since
+           they are inside the text record or after it */
+        binary_offset = binlog_search_binary_forward(str, len,
+                *rstart_offset >= 0 ? *rstart_offset : max_offset,
+                &binary_context);
+        if (*rstart_offset >= 0 || binary_offset >= 0 ||
+                max_offset == len)
+        {
+            break;
+        }
+        max_offset = (len - max_offset > max_offset) ?
+            2 * max_offset : len;
+    }
+
+    if (binary_offset >= 0) {
+        *rstart_offset = binary_offset;
+        pcontext.p = binary_context.p;
+        pcontext.rec_end = binary_context.rec_end;
+        pcontext.format = binary_context.format;
+    }
+
     if (*rstart_offset < 0) {
         sprintf(error_info, "can't found record start");
         return ENOENT;
     }
 
-    if ((result=binlog_parse_first_field(&pcontext, &record)) != 0) {
+    if ((result=binlog_parse_first_field_ex(&pcontext, &record)) != 0) {
         return result;
     }
 
@@ -707,46 +1299,97 @@ int binlog_detect_record_forward(const char *str, const int len,
     return 0;
 }
 
-int binlog_detect_record_reverse(const char *str, const int len,
-        int64_t *data_version, int *offset, char *error_info)
+static int binlog_search_text_reverse(const char *str, const int len,
+        FieldParserContext *pcontext)
 {
-    FDIRBinlogRecord record;
-    FieldParserContext pcontext;
     const char *start;
     const char *rec_start;
     int l;
-    int result;
 
-    pcontext.error_info = error_info;
-    if ((result=binlog_check_rec_length(len, &pcontext)) != 0) {
-        return result;
-    }
-
-    *offset = -1;
     l = len;
-    while (l > 0 && (rec_start=fc_memrchr(str,
-                    BINLOG_RECORD_START_TAG_CHAR, l)) != NULL)
+    while (l > 0 && (rec_start=binlog_rfind_tag(str, str + l, str + len,
+                    BINLOG_RECORD_START_TAG_STR[0],
+                    BINLOG_RECORD_START_TAG_STR[1])) != NULL)
     {
         start = rec_start - BINLOG_RECORD_SIZE_STRLEN;
         if ((start >= str) && binlog_is_record_start(
-                    start, len - (start - str), &pcontext))
+                    start, len - (start - str), pcontext))
         {
-            *offset = start - str;
-            break;
+            return start - str;
         }
 
         l = (rec_start - 1) - str;
     }
 
-    if (*offset < 0) {
+    return -1;
+}
+
+static int binlog_search_binary_reverse(const char *str, const int len,
+        const int min_offset, FieldParserContext *pcontext)
+{
+    const char *rec_start;
+    int l;
+
+    l = len;
+    while (l > min_offset && (rec_start=binlog_rfind_tag(str + min_offset,
+                    str + l, str + len, (char)BINLOG_BINARY_MAGIC0,
+                    (char)BINLOG_BINARY_MAGIC1)) != NULL)
+    {
+        if (binlog_is_binary_record_start(rec_start,
+                    len - (rec_start - str), pcontext))
+        {
+            return rec_start - str;
+        }
+
+        l = rec_start - str;
+    }
+
+    return -1;
+}
+
+int binlog_detect_record_reverse_ex(const char *str, const int len,
+        int64_t *data_version, int *rstart_offset, int *rend_offset,
+        char *error_info)
+{
+    FDIRBinlogRecord record;
+    FieldParserContext pcontext;
+    FieldParserContext binary_context;
+    int binary_offset;
+    int result;
+
+    pcontext.error_info = error_info;
+    if (len < BINLOG_BINARY_HEADER_SIZE) {
+        sprintf(error_info, "string length: %d is too short", len);
+        return EAGAIN;
+    }
+
+    *rstart_offset = binlog_search_text_reverse(str, len, &pcontext);
+
+    /* the binary record after the text record is the last one, the
+       search starts at the text record end to ignore the binary record
+       like bytes inside the strings of the text record */
+    binary_offset = binlog_search_binary_reverse(str, len,
+            *rstart_offset >= 0 ? pcontext.rec_end - str : 0,
+            &binary_context);
+    if (binary_offset >= 0) {
+        *rstart_offset = binary_offset;
+        pcontext.p = binary_context.p;
+        pcontext.rec_end = binary_context.rec_end;
+        pcontext.format = binary_context.format;
+    }
+
+    if (*rstart_offset < 0) {
         sprintf(error_info, "can't found record start");
         return ENOENT;
     }
 
-    if ((result=binlog_parse_first_field(&pcontext, &record)) != 0) {
+    if ((result=binlog_parse_first_field_ex(&pcontext, &record)) != 0) {
         return result;
     }
 
     *data_version = record.data_version;
+    if (rend_offset != NULL) {
+        *rend_offset = pcontext.rec_end - str;
+    }
     return 0;
 }
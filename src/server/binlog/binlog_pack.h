@@ -3,19 +3,58 @@
 #ifndef _BINLOG_PACK_H_
 #define _BINLOG_PACK_H_
 
+#include "../server_global.h"
 #include "binlog_types.h"
 
 #define BINLOG_RECORD_MAX_SIZE          9999
 #define BINLOG_RECORD_SIZE_STRLEN          4
 #define BINLOG_RECORD_SIZE_PRINTF_FMT  "%04d"
 
+/* the max packed size of the record besides the namespace, the path,
+   the user data and the extra data in both formats,
+   the packing doesn't grow the buffer when so much space is reserved */
+#define BINLOG_RECORD_FIXED_FIELDS_MAX_SIZE  256
+
+/* the binary record: the header and the body
+   the header (10 bytes): magic (2 bytes), format version (1 byte),
+     operation (1 byte), body length (2 bytes) and CRC32C (4 bytes)
+     of the former header fields and the body, in network byte order
+   the body: varint data version, inode, timestamp and field flags,
+     then the fields in the order of the flag bits, the integer field
+     is a varint, the string field is a varint length and the content.
+   the strings of the text record may contain the magic or even a whole
+   binary record, so the detectors ignore the binary record candidates
+   inside a validated text record */
+#define BINLOG_BINARY_MAGIC0            0xFD
+#define BINLOG_BINARY_MAGIC1            0xB1
+#define BINLOG_BINARY_VERSION              1
+#define BINLOG_BINARY_HEADER_SIZE         10
+
+#define BINLOG_BINARY_FIELD_PATH        (1 << 0)
+#define BINLOG_BINARY_FIELD_EXTRA_DATA  (1 << 1)
+#define BINLOG_BINARY_FIELD_USER_DATA   (1 << 2)
+#define BINLOG_BINARY_FIELD_MODE        (1 << 3)
+#define BINLOG_BINARY_FIELD_CTIME       (1 << 4)
+#define BINLOG_BINARY_FIELD_MTIME       (1 << 5)
+#define BINLOG_BINARY_FIELD_FILE_SIZE   (1 << 6)
+
+#define binlog_is_binary_record(str, len) \
+    ((len) > 0 && (unsigned char)*(str) == BINLOG_BINARY_MAGIC0)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 int binlog_pack_init();
 
-int binlog_pack_record(const FDIRBinlogRecord *record, FastBuffer *buffer);
+//format: FDIR_BINLOG_FORMAT_TEXT or FDIR_BINLOG_FORMAT_BINARY
+int binlog_pack_record_ex(const FDIRBinlogRecord *record,
+        const int format, FastBuffer *buffer);
+
+#define binlog_pack_record(record, buffer) \
+    binlog_pack_record_ex(record, BINLOG_FORMAT, buffer)
+
+//the record of both formats can be unpacked
 
 int binlog_unpack_record(const char *str, const int len,
         FDIRBinlogRecord *record, const char **record_end,
@@ -28,8 +67,15 @@ int binlog_detect_record_forward(const char *str, const int len,
         int64_t *data_version, int *rstart_offset, int *rend_offset,
         char *error_info);
 
-int binlog_detect_record_reverse(const char *str, const int len,
-        int64_t *data_version, int *offset, char *error_info);
+//the rend_offset can be NULL
+int binlog_detect_record_reverse_ex(const char *str, const int len,
+        int64_t *data_version, int *rstart_offset, int *rend_offset,
+        char *error_info);
+
+#define binlog_detect_record_reverse(str, len, \
+        data_version, offset, error_info)      \
+    binlog_detect_record_reverse_ex(str, len,  \
+            data_version, offset, NULL, error_info)
 
 #ifdef __cplusplus
 }
@@ -20,13 +20,22 @@
 #include "binlog_consumer.h"
 #include "binlog_producer.h"
 
-#define SLEEP_NANO_SECONDS   (50 * 1000)
-#define MAX_SLEEP_COUNT      (20 * 1000)
+/* the record buffers are published to the ring slot indexed by the data
+   version, and pushed to the consumer queues in data version order by
+   one drainer at a time, so the producer never waits for the others */
+#define DISPATCH_RING_SIZE   (64 * 1024)  //must be power of 2
+#define DISPATCH_RING_MASK   (DISPATCH_RING_SIZE - 1)
 
 static struct fast_mblock_man record_buffer_allocator;
 
-static volatile int64_t next_data_version;
-static struct timespec sleep_ts;
+static struct {
+    ServerBinlogRecordBuffer * volatile *slots;
+    volatile int64_t next_data_version;  //only changed by the drainer
+    volatile int draining;
+    volatile int waiting_count;  //the producers waiting for the full ring
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} dispatch_ring;
 
 int record_buffer_alloc_init_func(void *element, void *args)
 {
@@ -48,6 +57,7 @@ int record_buffer_alloc_init_func(void *element, void *args)
 int binlog_producer_init()
 {
     int result;
+    int bytes;
     int64_t offset;
 
     if ((result=fast_mblock_init_ex(&record_buffer_allocator,
@@ -65,18 +75,43 @@ int binlog_producer_init()
 
     logInfo("DATA_CURRENT_VERSION == %"PRId64, DATA_CURRENT_VERSION);
 
-    next_data_version = DATA_CURRENT_VERSION + 1;
-    sleep_ts.tv_sec = 0;
-    sleep_ts.tv_nsec = SLEEP_NANO_SECONDS;
+    if ((result=init_pthread_lock(&dispatch_ring.lock)) != 0) {
+        return result;
+    }
+    if ((result=pthread_cond_init(&dispatch_ring.cond, NULL)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_cond_init fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+
+    bytes = sizeof(ServerBinlogRecordBuffer *) * DISPATCH_RING_SIZE;
+    dispatch_ring.slots = (ServerBinlogRecordBuffer * volatile *)
+        calloc(1, bytes);
+    if (dispatch_ring.slots == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "calloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+    dispatch_ring.next_data_version = DATA_CURRENT_VERSION + 1;
+    dispatch_ring.draining = 0;
+    dispatch_ring.waiting_count = 0;
 	return 0;
 }
 
 void binlog_producer_destroy()
 {
+    if (dispatch_ring.slots != NULL) {
+        free((void *)dispatch_ring.slots);
+        dispatch_ring.slots = NULL;
+        pthread_cond_destroy(&dispatch_ring.cond);
+        pthread_mutex_destroy(&dispatch_ring.lock);
+    }
     fast_mblock_destroy(&record_buffer_allocator);
 }
 
-ServerBinlogRecordBuffer *server_binlog_alloc_rbuffer()
+ServerBinlogRecordBuffer *server_binlog_alloc_rbuffer_ex(
+        const int record_count)
 {
     ServerBinlogRecordBuffer *rbuffer;
 
@@ -86,54 +121,117 @@ ServerBinlogRecordBuffer *server_binlog_alloc_rbuffer()
         return NULL;
     }
 
-    rbuffer->data_version = __sync_add_and_fetch(&DATA_CURRENT_VERSION, 1);
+    rbuffer->record_count = record_count;
+    rbuffer->data_version = __sync_add_and_fetch(&DATA_CURRENT_VERSION,
+            record_count) - record_count + 1;
     return rbuffer;
 }
 
-void server_binlog_release_rbuffer(ServerBinlogRecordBuffer *rbuffer)
+void server_binlog_free_rbuffer(ServerBinlogRecordBuffer *rbuffer)
+{
+    fast_mblock_free_object(&record_buffer_allocator, rbuffer);
+}
+
+static inline ServerBinlogRecordBuffer *dispatch_ring_next_ready()
 {
-    if (__sync_sub_and_fetch(&rbuffer->reffer_count, 1) == 0) {
-        logInfo("file: "__FILE__", line: %d, "
-                "free record buffer: %p", __LINE__, rbuffer);
-        fast_mblock_free_object(&record_buffer_allocator, rbuffer);
+    ServerBinlogRecordBuffer *rbuffer;
+
+    rbuffer = dispatch_ring.slots[dispatch_ring.next_data_version &
+        DISPATCH_RING_MASK];
+    __sync_synchronize();
+    if (rbuffer != NULL && rbuffer->data_version ==
+            dispatch_ring.next_data_version)
+    {
+        return rbuffer;
     }
+    return NULL;
+}
+
+//wake up the producers waiting for the full ring
+static inline void dispatch_ring_notify()
+{
+    __sync_synchronize();
+    if (dispatch_ring.waiting_count > 0) {
+        pthread_mutex_lock(&dispatch_ring.lock);
+        pthread_cond_broadcast(&dispatch_ring.cond);
+        pthread_mutex_unlock(&dispatch_ring.lock);
+    }
+}
+
+static void dispatch_ring_drain()
+{
+    ServerBinlogRecordBuffer *rbuffer;
+    int count;
+
+    while (__sync_bool_compare_and_swap(&dispatch_ring.draining, 0, 1)) {
+        count = 0;
+        while ((rbuffer=dispatch_ring_next_ready()) != NULL) {
+            ++count;
+            dispatch_ring.slots[rbuffer->data_version &
+                DISPATCH_RING_MASK] = NULL;
+            dispatch_ring.next_data_version += rbuffer->record_count;
+
+            if (rbuffer->buffer.length == 0) {  //for the version hole
+                fast_mblock_free_object(&record_buffer_allocator, rbuffer);
+            } else {
+                binlog_consumer_append(rbuffer);
+            }
+        }
+        __sync_synchronize();
+        dispatch_ring.draining = 0;
+        if (count > 0) {
+            dispatch_ring_notify();
+        }
+
+        /* the buffer published while draining may be missed by the
+           producer who failed to get the drainer flag */
+        __sync_synchronize();
+        if (dispatch_ring_next_ready() == NULL) {
+            break;
+        }
+    }
+}
+
+static inline bool dispatch_ring_full(ServerBinlogRecordBuffer *rbuffer,
+        ServerBinlogRecordBuffer * volatile *slot)
+{
+    return rbuffer->data_version - dispatch_ring.next_data_version >=
+        DISPATCH_RING_SIZE || *slot != NULL;
 }
 
 int server_binlog_dispatch(ServerBinlogRecordBuffer *rbuffer)
 {
+    ServerBinlogRecordBuffer * volatile *slot;
     int count;
-    int result;
 
+    /* wait when the ring is full, the buffer MUST NOT be published
+       before the previous buffer of the same slot is drained */
+    slot = dispatch_ring.slots + (rbuffer->data_version & DISPATCH_RING_MASK);
     count = 0;
-    while ((rbuffer->data_version != __sync_fetch_and_add(
-                &next_data_version, 0)) && (++count < MAX_SLEEP_COUNT))
+    while ((rbuffer->data_version - dispatch_ring.next_data_version >=
+                DISPATCH_RING_SIZE) || !__sync_bool_compare_and_swap(
+                    slot, NULL, rbuffer))
     {
-        nanosleep(&sleep_ts, NULL);
-    }
-
-    if (count >= 1) {
-        if (count == MAX_SLEEP_COUNT) {
-            logError("file: "__FILE__", line: %d, "
-                    "waiting for next data version: %"PRId64" timeout, "
-                    "maybe some mistakes happened", __LINE__,
-                    rbuffer->data_version);
-        } else {
+        if (++count == 1) {
             logWarning("file: "__FILE__", line: %d, "
-                    "waiting for next data version: %"PRId64" count: %d",
-                    __LINE__, rbuffer->data_version, count);
+                    "dispatch ring is full, data version: %"PRId64", "
+                    "next data version: %"PRId64, __LINE__,
+                    rbuffer->data_version,
+                    dispatch_ring.next_data_version);
         }
-    }
-
-    result = binlog_consumer_push_to_queues(rbuffer);
-    if (count < MAX_SLEEP_COUNT) {  //normal
-        __sync_add_and_fetch(&next_data_version, 1);
-    } else {  //on exception
-        int64_t old_data_version;
-        old_data_version = __sync_fetch_and_add(&next_data_version, 0);
-        if (old_data_version <= rbuffer->data_version) {
-            __sync_bool_compare_and_swap(&next_data_version, old_data_version,
-                    rbuffer->data_version + 1);
+        dispatch_ring_drain();
+
+        /* the waiting count is increased before the check, the drainer
+           checks it after advancing, so the wakeup can't be missed */
+        pthread_mutex_lock(&dispatch_ring.lock);
+        __sync_add_and_fetch(&dispatch_ring.waiting_count, 1);
+        if (dispatch_ring_full(rbuffer, slot)) {
+            pthread_cond_wait(&dispatch_ring.cond, &dispatch_ring.lock);
         }
+        __sync_sub_and_fetch(&dispatch_ring.waiting_count, 1);
+        pthread_mutex_unlock(&dispatch_ring.lock);
     }
-    return result;
+
+    dispatch_ring_drain();
+    return 0;
 }
@@ -12,9 +12,18 @@ extern "C" {
 int binlog_producer_init();
 void binlog_producer_destroy();
 
-ServerBinlogRecordBuffer *server_binlog_alloc_rbuffer();
-void server_binlog_release_rbuffer(ServerBinlogRecordBuffer *rbuffer);
+ServerBinlogRecordBuffer *server_binlog_alloc_rbuffer_ex(
+        const int record_count);
 
+#define server_binlog_alloc_rbuffer() server_binlog_alloc_rbuffer_ex(1)
+
+//called by the binlog consumer after all consumers have read the buffer
+void server_binlog_free_rbuffer(ServerBinlogRecordBuffer *rbuffer);
+
+/* publish the record buffer and return without waiting for the previous
+   data versions, the buffers are pushed to the consumers in version
+   order. the allocated buffer MUST be dispatched, dispatch it with empty
+   content on error to fill the data version hole */
 int server_binlog_dispatch(ServerBinlogRecordBuffer *rbuffer);
 
 #ifdef __cplusplus
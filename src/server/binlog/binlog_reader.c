@@ -1,5 +1,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -20,21 +21,82 @@
 #include "binlog_producer.h"
 #include "binlog_write_thread.h"
 #include "binlog_pack.h"
+#include "binlog_offset_index.h"
 #include "binlog_reader.h"
 
-static int open_readable_binlog(ServerBinlogReader *reader)
+static inline int read_binlog_file(ServerBinlogReader *reader,
+        char *buff, const int size)
+{
+    if (reader->compressed.fd >= 0) {
+        return binlog_compressed_read(&reader->compressed, buff, size);
+    }
+    return read(reader->fd, buff, size);
+}
+
+//the sealed binlog file may be replaced by the compressed one
+static int open_compressed_binlog(ServerBinlogReader *reader)
 {
     int result;
 
-    if (reader->fd >= 0) {
+    if ((result=binlog_compressed_open(&reader->compressed,
+                    reader->position.index)) != 0)
+    {
+        if (result == ENOENT) {
+            logError("file: "__FILE__", line: %d, "
+                    "open file \"%s\" fail, errno: %d, error info: %s",
+                    __LINE__, reader->filename, result, STRERROR(result));
+        }
+        return result;
+    }
+
+    if (reader->position.offset > reader->compressed.raw_size) {
+        logWarning("file: "__FILE__", line: %d, "
+                "offset %"PRId64" > file size: %"PRId64,
+                __LINE__, reader->position.offset,
+                reader->compressed.raw_size);
+        reader->position.offset = reader->compressed.raw_size;
+    }
+
+    reader->fd = reader->compressed.fd;
+    reader->binlog_buffer.current = reader->binlog_buffer.buff;
+    reader->binlog_buffer.length = 0;
+    return binlog_compressed_seek(&reader->compressed,
+            reader->position.offset);
+}
+
+static void unmap_binlog(ServerBinlogReader *reader)
+{
+    if (reader->mapped.base != NULL) {
+        munmap(reader->mapped.base, reader->mapped.size);
+        reader->mapped.base = NULL;
+        reader->mapped.size = 0;
+    }
+}
+
+static void close_readable_binlog(ServerBinlogReader *reader)
+{
+    unmap_binlog(reader);
+    if (reader->compressed.fd >= 0) {
+        binlog_compressed_close(&reader->compressed);
+    } else if (reader->fd >= 0) {
         close(reader->fd);
     }
+    reader->fd = -1;
+}
+
+static int open_readable_binlog(ServerBinlogReader *reader)
+{
+    int result;
 
+    close_readable_binlog(reader);
     GET_BINLOG_FILENAME(reader->filename, sizeof(reader->filename),
             reader->position.index);
     reader->fd = open(reader->filename, O_RDONLY);
     if (reader->fd < 0) {
         result = errno != 0 ? errno : EACCES;
+        if (result == ENOENT) {
+            return open_compressed_binlog(reader);
+        }
         logError("file: "__FILE__", line: %d, "
                 "open file \"%s\" fail, "
                 "errno: %d, error info: %s",
@@ -45,7 +107,10 @@ static int open_readable_binlog(ServerBinlogReader *reader)
 
     if (reader->position.offset > 0) {
         int64_t file_size;
-        if ((file_size=lseek(reader->fd, 0L, SEEK_END)) < 0) {
+        if (binlog_write_thread_get_file_size(reader->position.index,
+                    &file_size) != 0 && (file_size=lseek(reader->fd,
+                        0L, SEEK_END)) < 0)
+        {
             result = errno != 0 ? errno : EACCES;
             logError("file: "__FILE__", line: %d, "
                     "lseek file \"%s\" fail, "
@@ -79,6 +144,7 @@ static int open_readable_binlog(ServerBinlogReader *reader)
 
 static int do_binlog_read(ServerBinlogReader *reader)
 {
+    int64_t file_size;
     int remain;
     int result;
     int read_bytes;
@@ -100,7 +166,19 @@ static int do_binlog_read(ServerBinlogReader *reader)
         return ENOSPC;
     }
 
-    read_bytes = read(reader->fd, reader->binlog_buffer.buff +
+    //the current binlog file is zero filled beyond the flushed records
+    if (reader->compressed.fd < 0 && binlog_write_thread_get_file_size(
+                reader->position.index, &file_size) == 0)
+    {
+        if (reader->position.offset >= file_size) {
+            return ENOENT;
+        }
+        if (read_bytes > file_size - reader->position.offset) {
+            read_bytes = file_size - reader->position.offset;
+        }
+    }
+
+    read_bytes = read_binlog_file(reader, reader->binlog_buffer.buff +
             reader->binlog_buffer.length, read_bytes);
     if (read_bytes == 0) {
         return ENOENT;
@@ -118,8 +196,8 @@ static int do_binlog_read(ServerBinlogReader *reader)
     return 0;
 }
 
-static int find_data_version(ServerBinlogReader *reader,
-        const int64_t last_data_version)
+static int do_find_data_version(ServerBinlogReader *reader,
+        const int64_t last_data_version, const int64_t start_offset)
 {
     int result;
     int64_t data_version;
@@ -128,7 +206,7 @@ static int find_data_version(ServerBinlogReader *reader,
     char *buff_end;
     char error_info[FDIR_ERROR_INFO_SIZE];
 
-    reader->position.offset = 0;
+    reader->position.offset = start_offset;
     if ((result=open_readable_binlog(reader)) != 0) {
         return result;
     }
@@ -177,6 +255,27 @@ static int find_data_version(ServerBinlogReader *reader,
     return open_readable_binlog(reader);
 }
 
+static int find_data_version(ServerBinlogReader *reader,
+        const int64_t last_data_version)
+{
+    int64_t offset;
+
+    if (binlog_offset_index_find(reader->position.index,
+                last_data_version, &offset) == 0 && offset > 0)
+    {
+        if (do_find_data_version(reader, last_data_version, offset) == 0) {
+            return 0;
+        }
+
+        logWarning("file: "__FILE__", line: %d, "
+                "seek data version %"PRId64" by the offset index fail, "
+                "binlog file: %s, scan from the file start", __LINE__,
+                last_data_version, reader->filename);
+    }
+
+    return do_find_data_version(reader, last_data_version, 0);
+}
+
 static int binlog_reader_search_data_version(ServerBinlogReader *reader,
         const int64_t last_data_version)
 {
@@ -210,7 +309,7 @@ static int binlog_reader_search_data_version(ServerBinlogReader *reader,
                 return EBUSY;
             }
 
-            if (reader->position.index > 0) {
+            if (reader->position.index > binlog_get_first_write_index()) {
                 reader->position.index--;
             } else {
                 return EFAULT;
@@ -261,7 +360,7 @@ static int binlog_reader_detect_open(ServerBinlogReader *reader,
         }
     }
 
-    if ((bytes=read(reader->fd, buff, sizeof(buff))) < 0) {
+    if ((bytes=read_binlog_file(reader, buff, sizeof(buff))) < 0) {
         result = errno != 0 ? errno : EIO;
         logError("file: "__FILE__", line: %d, "
                 "get_first_record_version fail, "
@@ -282,18 +381,29 @@ static int binlog_reader_detect_open(ServerBinlogReader *reader,
     return binlog_reader_search_data_version(reader, last_data_version);
 }
 
-int binlog_reader_init(ServerBinlogReader *reader,
+int binlog_reader_init_ex(ServerBinlogReader *reader,
         const ServerBinlogFilePosition *hint_pos,
-        const int64_t last_data_version)
+        const int64_t last_data_version, const bool zero_copy)
 {
     int result;
 
+    //binlog_reader_destroy is safe after the init fail
+    reader->fd = -1;
+    reader->zero_copy = zero_copy;
+    reader->compressed.fd = -1;
+    reader->mapped.base = NULL;
+    reader->mapped.size = 0;
     if ((result=binlog_buffer_init(&reader->binlog_buffer)) != 0) {
         return result;
     }
-
-    reader->fd = -1;
     if (last_data_version == 0) {
+        if (binlog_get_first_write_index() > 0) {
+            logError("file: "__FILE__", line: %d, "
+                    "the binlog files before index %d are compacted, "
+                    "can't read from the beginning", __LINE__,
+                    binlog_get_first_write_index());
+            return EFAULT;
+        }
         reader->position.index = 0;
         reader->position.offset = 0;
         return open_readable_binlog(reader);
@@ -303,6 +413,203 @@ int binlog_reader_init(ServerBinlogReader *reader,
     return binlog_reader_detect_open(reader, last_data_version);
 }
 
+void binlog_reader_destroy(ServerBinlogReader *reader)
+{
+    close_readable_binlog(reader);
+    if (reader->binlog_buffer.buff != NULL) {
+        free(reader->binlog_buffer.buff);
+        reader->binlog_buffer.buff = NULL;
+    }
+}
+
+/* the file before the current write index is sealed and never changed,
+   return EAGAIN when it can't be mapped */
+static int map_sealed_binlog(ServerBinlogReader *reader,
+        const int write_index)
+{
+    struct stat st;
+    char *base;
+    int result;
+
+    if (reader->mapped.base != NULL) {
+        return 0;
+    }
+    if (reader->position.index >= write_index ||
+            reader->compressed.fd >= 0 || reader->fd < 0)
+    {
+        return EAGAIN;
+    }
+    if (reader->binlog_buffer.current != reader->binlog_buffer.buff +
+            reader->binlog_buffer.length)
+    {
+        return EAGAIN;  //consume the buffered records first
+    }
+
+    if (fstat(reader->fd, &st) != 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "stat file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, reader->filename, result, STRERROR(result));
+        return result;
+    }
+    if (st.st_size == 0) {
+        return EAGAIN;
+    }
+
+    base = (char *)mmap(NULL, st.st_size, PROT_READ,
+            MAP_SHARED, reader->fd, 0);
+    if (base == MAP_FAILED) {
+        result = errno != 0 ? errno : ENOMEM;
+        logWarning("file: "__FILE__", line: %d, "
+                "mmap file \"%s\" fail, read it by buffer instead, "
+                "errno: %d, error info: %s", __LINE__,
+                reader->filename, result, STRERROR(result));
+        return EAGAIN;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    reader->mapped.base = base;
+    reader->mapped.size = st.st_size;
+    if (reader->position.offset > reader->mapped.size) {
+        reader->position.offset = reader->mapped.size;
+    }
+    return 0;
+}
+
+//cut the range at the end of the last complete record
+static int binlog_align_range(const char *buff, int *length)
+{
+    int window;
+    int rstart_offset;
+    int rend_offset;
+    int result;
+    int64_t data_version;
+    char error_info[FDIR_ERROR_INFO_SIZE];
+
+    window = *length < BINLOG_RECORD_MAX_SIZE ?
+        *length : BINLOG_RECORD_MAX_SIZE;
+    *error_info = '\0';
+    if ((result=binlog_detect_record_reverse_ex(buff + (*length - window),
+                    window, &data_version, &rstart_offset, &rend_offset,
+                    error_info)) != 0)
+    {
+        return result;
+    }
+
+    *length = (*length - window) + rend_offset;
+    return 0;
+}
+
+static int next_mapped_range(ServerBinlogReader *reader,
+        const int max_bytes, BinlogReadRange *range)
+{
+    int64_t remain;
+    int length;
+    int result;
+
+    remain = reader->mapped.size - reader->position.offset;
+    if (remain > max_bytes) {
+        length = max_bytes;
+        if ((result=binlog_align_range(reader->mapped.base +
+                        reader->position.offset, &length)) != 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "binlog file: %s, no complete record in the %d bytes "
+                    "at offset %"PRId64", errno: %d, error info: %s",
+                    __LINE__, reader->filename, length,
+                    reader->position.offset, result, STRERROR(result));
+            return result;
+        }
+    } else {
+        length = remain;  //the sealed file ends with the complete record
+    }
+
+    range->buff = reader->mapped.base + reader->position.offset;
+    range->length = length;
+    reader->position.offset += length;
+    return 0;
+}
+
+static int next_buffered_range(ServerBinlogReader *reader,
+        const int max_bytes, BinlogReadRange *range)
+{
+    int remain;
+    int length;
+    int result;
+
+    remain = reader->binlog_buffer.buff + reader->binlog_buffer.length -
+        reader->binlog_buffer.current;
+    if (remain < max_bytes) {
+        result = do_binlog_read(reader);
+        if (!(result == 0 || result == ENOENT || result == ENOSPC)) {
+            return result;
+        }
+        remain = reader->binlog_buffer.buff + reader->binlog_buffer.length -
+            reader->binlog_buffer.current;
+    }
+
+    if (remain == 0) {
+        return ENOENT;
+    }
+
+    length = remain < max_bytes ? remain : max_bytes;
+    if (binlog_align_range(reader->binlog_buffer.current, &length) != 0)
+    {
+        return ENOENT;  //the last record is being written
+    }
+
+    range->buff = reader->binlog_buffer.current;
+    range->length = length;
+    reader->binlog_buffer.current += length;
+    return 0;
+}
+
+int binlog_reader_next_range(ServerBinlogReader *reader,
+        const int max_bytes, BinlogReadRange *range)
+{
+    int write_index;
+    int result;
+
+    if (max_bytes < BINLOG_RECORD_MAX_SIZE) {
+        return EINVAL;
+    }
+
+    while (1) {
+        //get the write index before reading to avoid missing the tail
+        write_index = binlog_get_current_write_index();
+        if (reader->zero_copy && map_sealed_binlog(
+                    reader, write_index) == 0)
+        {
+            if (reader->position.offset < reader->mapped.size) {
+                return next_mapped_range(reader, max_bytes, range);
+            }
+        } else if ((result=next_buffered_range(reader,
+                        max_bytes, range)) != ENOENT)
+        {
+            return result;
+        }
+
+        if (reader->position.index >= write_index) {
+            return ENOENT;
+        }
+
+        reader->position.index++;
+        reader->position.offset = 0;
+        if ((result=open_readable_binlog(reader)) != 0) {
+            return result;
+        }
+    }
+}
+
+static inline int get_segment_info(const int file_index,
+        BinlogSegmentInfo *segment)
+{
+    if (binlog_offset_index_load_footer(file_index, segment) == 0) {
+        return 0;
+    }
+    return binlog_write_thread_get_segment_info(file_index, segment);
+}
+
 int binlog_get_first_record_version(const int file_index,
         int64_t *data_version)
 {
@@ -315,7 +622,19 @@ int binlog_get_first_record_version(const int file_index,
     char *rec_end;
     int result;
     int64_t bytes;
+    int64_t file_size;
     int offset;
+    BinlogSegmentInfo segment;
+
+    if (get_segment_info(file_index, &segment) == 0) {
+        *data_version = segment.first_version;
+        return 0;
+    }
+    if (binlog_write_thread_get_file_size(file_index, &file_size) == 0 &&
+            file_size == 0)
+    {
+        return ENOENT;  //the current file is empty or zero filled
+    }
 
     GET_BINLOG_FILENAME(filename, sizeof(filename), file_index);
 
@@ -372,9 +691,18 @@ int binlog_get_last_record_version(const int file_index,
     int buff_off;
     int64_t file_size = 0;
     int64_t bytes;
+    BinlogSegmentInfo segment;
+
+    if (get_segment_info(file_index, &segment) == 0) {
+        *data_version = segment.last_version;
+        *offset = segment.last_offset;
+        return 0;
+    }
 
     GET_BINLOG_FILENAME(filename, sizeof(filename), file_index);
-    if (access(filename, F_OK) == 0) {
+    if (binlog_write_thread_get_file_size(file_index, &file_size) == 0) {
+        result = 0;
+    } else if (access(filename, F_OK) == 0) {
         result = getFileSize(filename, &file_size);
     } else {
         result = errno != 0 ? errno : EPERM;
@@ -4,6 +4,7 @@
 #define _BINLOG_READER_H_
 
 #include "binlog_types.h"
+#include "binlog_compress.h"
 
 #define BINLOG_FILE_PREFIX     "binlog"
 #define BINLOG_FILE_EXT_FMT    ".%05d"
@@ -13,20 +14,46 @@ typedef struct {
     int64_t offset; //current file offset
 } ServerBinlogFilePosition;
 
+typedef struct {
+    char *base;    //NULL for not mapped
+    int64_t size;
+} BinlogMappedFile;
+
+//the complete records to send, in the mapped file or the binlog buffer
+typedef struct {
+    const char *buff;
+    int length;
+} BinlogReadRange;
+
 typedef struct {
     char filename[PATH_MAX];
     int fd;
-    ServerBinlogFilePosition position;
+    bool zero_copy;  //mmap the sealed plain binlog files
+    ServerBinlogFilePosition position;  //the offset in the plain file
     ServerBinlogBuffer binlog_buffer;
+    BinlogCompressedFile compressed;  //the fd is -1 for the plain file
+    BinlogMappedFile mapped;
 } ServerBinlogReader;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-int binlog_reader_init(ServerBinlogReader *reader,
+int binlog_reader_init_ex(ServerBinlogReader *reader,
         const ServerBinlogFilePosition *hint_pos,
-        const int64_t last_data_version);
+        const int64_t last_data_version, const bool zero_copy);
+
+#define binlog_reader_init(reader, hint_pos, last_data_version) \
+    binlog_reader_init_ex(reader, hint_pos, last_data_version, false)
+
+void binlog_reader_destroy(ServerBinlogReader *reader);
+
+/* get the next complete records up to max_bytes which should be
+   at least BINLOG_RECORD_MAX_SIZE, the records of the sealed plain
+   binlog files are not copied in the zero copy mode.
+   return ENOENT when no more records for now */
+int binlog_reader_next_range(ServerBinlogReader *reader,
+        const int max_bytes, BinlogReadRange *range);
 
 int binlog_get_first_record_version(const int file_index,
         int64_t *data_version);
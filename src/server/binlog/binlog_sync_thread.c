@@ -17,7 +17,12 @@
 #include "sf/sf_global.h"
 #include "../server_global.h"
 #include "binlog_func.h"
+#include "binlog_pack.h"
+#include "binlog_reader.h"
+#include "binlog_tail_cache.h"
+#include "binlog_write_thread.h"
 #include "binlog_producer.h"
+#include "binlog_consumer.h"
 #include "binlog_sync_thread.h"
 
 typedef struct {
@@ -25,17 +30,26 @@ typedef struct {
     ServerBinlogBuffer binlog_buffer;
 } BinlogSyncContext;
 
+static int binlog_sync_send(BinlogSyncContext *sync_context,
+        const char *buff, const int length)
+{
+    //TODO
+    //int64_t last_data_version;
+    return 0;
+}
+
 static int binlog_sync_to_server(BinlogSyncContext *sync_context)
 {
+    int result;
+
     if (sync_context->binlog_buffer.length == 0) {
         return 0;
     }
 
-    //TODO
-    //int64_t last_data_version;
+    result = binlog_sync_send(sync_context, sync_context->binlog_buffer.buff,
+            sync_context->binlog_buffer.length);
     sync_context->binlog_buffer.length = 0;  //reset cache buff
-
-    return 0;
+    return result;
 }
 
 static inline int deal_binlog_one_record(BinlogSyncContext *sync_context,
@@ -48,6 +62,12 @@ static inline int deal_binlog_one_record(BinlogSyncContext *sync_context,
         if ((result=binlog_sync_to_server(sync_context)) != 0) {
             return result;
         }
+
+        //send the large record buffer directly instead of copying
+        if (rb->buffer.length > sync_context->binlog_buffer.size) {
+            return binlog_sync_send(sync_context,
+                    rb->buffer.data, rb->buffer.length);
+        }
     }
 
     memcpy(sync_context->binlog_buffer.buff +
@@ -58,29 +78,136 @@ static inline int deal_binlog_one_record(BinlogSyncContext *sync_context,
 }
 
 static int deal_binlog_records(BinlogSyncContext *sync_context,
-        struct common_blocked_node *node)
+        ServerBinlogRecordBuffer **rbuffers, const int count)
 {
-    ServerBinlogRecordBuffer *rb;
+    ServerBinlogRecordBuffer **rb;
+    ServerBinlogRecordBuffer **end;
     int result;
 
-    do {
-        rb = (ServerBinlogRecordBuffer *)node->data;
-        if ((result=deal_binlog_one_record(sync_context, rb)) != 0) {
+    end = rbuffers + count;
+    for (rb=rbuffers; rb<end; rb++) {
+        if ((result=deal_binlog_one_record(sync_context, *rb)) != 0) {
             return result;
         }
-
-        server_binlog_release_rbuffer(rb);
-        node = node->next;
-    } while (node != NULL);
+    }
 
     return binlog_sync_to_server(sync_context);
 }
 
+static int get_last_data_version(const char *buff, const int length,
+        int64_t *data_version)
+{
+    int window;
+    int offset;
+    char error_info[FDIR_ERROR_INFO_SIZE];
+
+    window = length < BINLOG_RECORD_MAX_SIZE ?
+        length : BINLOG_RECORD_MAX_SIZE;
+    *error_info = '\0';
+    return binlog_detect_record_reverse(buff + (length - window),
+            window, data_version, &offset, error_info);
+}
+
+/* send the records from the tail cache until reattached to the log,
+   return ENOENT when the records are not in the cache */
+static int binlog_sync_from_cache(BinlogSyncContext *sync_context,
+        ServerBinlogConsumerContext *consumer_context)
+{
+    int64_t data_version;
+    int length;
+    int result;
+
+    while (SF_G_CONTINUE_FLAG) {
+        if (binlog_tail_cache_fetch(consumer_context->data_version,
+                    sync_context->binlog_buffer.buff,
+                    sync_context->binlog_buffer.size,
+                    &length, &data_version) != 0)
+        {
+            return ENOENT;
+        }
+
+        if (length == 0) {  //no newer records flushed
+            if (binlog_consumer_reattach(consumer_context) == 0) {
+                return 0;
+            }
+            continue;
+        }
+
+        if ((result=binlog_sync_send(sync_context, sync_context->
+                        binlog_buffer.buff, length)) != 0)
+        {
+            return result;
+        }
+        consumer_context->data_version = data_version;
+    }
+
+    return 0;
+}
+
+//send the records from the binlog files until reattached to the log
+static int binlog_sync_catch_up(BinlogSyncContext *sync_context,
+        ServerBinlogConsumerContext *consumer_context)
+{
+    ServerBinlogReader reader;
+    ServerBinlogFilePosition hint_pos;
+    BinlogReadRange range;
+    int64_t data_version;
+    int result;
+
+    if ((result=binlog_sync_from_cache(sync_context,
+                    consumer_context)) != ENOENT)
+    {
+        return result;
+    }
+
+    hint_pos.index = binlog_get_current_write_index();
+    hint_pos.offset = 0;
+    /* the sealed plain files are sent from the mapping without copying,
+       the compressed ones are decompressed to the binlog buffer */
+    if ((result=binlog_reader_init_ex(&reader, &hint_pos,
+                    consumer_context->data_version, BINLOG_COMPRESS.
+                    codec == FDIR_BINLOG_COMPRESS_NONE)) != 0)
+    {
+        binlog_reader_destroy(&reader);
+        return result;
+    }
+
+    while (SF_G_CONTINUE_FLAG) {
+        result = binlog_reader_next_range(&reader,
+                sync_context->binlog_buffer.size, &range);
+        if (result == ENOENT) {
+            if ((result=binlog_consumer_reattach(consumer_context)) == 0) {
+                break;
+            }
+            continue;
+        } else if (result != 0) {
+            break;
+        }
+
+        if ((result=get_last_data_version(range.buff, range.length,
+                        &data_version)) != 0)
+        {
+            break;
+        }
+        if ((result=binlog_sync_send(sync_context, range.buff,
+                        range.length)) != 0)
+        {
+            break;
+        }
+        consumer_context->data_version = data_version;
+    }
+
+    binlog_reader_destroy(&reader);
+    return result;
+}
+
 void *binlog_sync_thread_func(void *arg)
 {
-    struct common_blocked_queue *queue;
-    struct common_blocked_node *node;
+    ServerBinlogConsumerContext *consumer_context;
+    ServerBinlogRecordBuffer *rbuffers[BINLOG_CONSUMER_FETCH_BATCH];
     BinlogSyncContext sync_context;
+    int count;
+    int result;
 
     if (binlog_buffer_init(&sync_context.binlog_buffer) != 0) {
         logCrit("file: "__FILE__", line: %d, "
@@ -90,16 +217,46 @@ void *binlog_sync_thread_func(void *arg)
         return NULL;
     }
 
-    sync_context.peer_server = ((ServerBinlogConsumerContext *)arg)->server;
-    queue = &((ServerBinlogConsumerContext *)arg)->queue;
+    consumer_context = (ServerBinlogConsumerContext *)arg;
+    sync_context.peer_server = consumer_context->server;
     while (SF_G_CONTINUE_FLAG) {
-        node = common_blocked_queue_pop_all_nodes(queue);
-        if (node == NULL) {
+        if (binlog_consumer_detached(consumer_context)) {
+            if ((result=binlog_sync_catch_up(&sync_context,
+                            consumer_context)) != 0)
+            {
+                logError("file: "__FILE__", line: %d, "
+                        "sync the binlog files to server id: %d fail, "
+                        "errno: %d, error info: %s", __LINE__,
+                        sync_context.peer_server->server->id,
+                        result, STRERROR(result));
+                sleep(1);
+            }
+            continue;
+        }
+
+        count = binlog_consumer_fetch(consumer_context, rbuffers,
+                BINLOG_CONSUMER_FETCH_BATCH, true);
+        if (count == 0) {
+            continue;
+        }
+
+        if ((result=deal_binlog_records(&sync_context,
+                        rbuffers, count)) != 0)
+        {
+            //resend these records from the binlog files
+            logError("file: "__FILE__", line: %d, "
+                    "sync binlog to server id: %d fail, "
+                    "errno: %d, error info: %s", __LINE__,
+                    sync_context.peer_server->server->id,
+                    result, STRERROR(result));
+            binlog_consumer_advance(consumer_context, count);
+            binlog_consumer_detach(consumer_context);
             continue;
         }
 
-        deal_binlog_records(&sync_context, node);
-        common_blocked_queue_free_all_nodes(queue, node);
+        consumer_context->data_version = rbuffers[count - 1]->
+            data_version + rbuffers[count - 1]->record_count - 1;
+        binlog_consumer_advance(consumer_context, count);
     }
 
     return NULL;
@@ -0,0 +1,285 @@
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/pthread_func.h"
+#include "sf/sf_global.h"
+#include "../server_global.h"
+#include "binlog_pack.h"
+#include "binlog_tail_cache.h"
+
+//the records of one flushed buffer
+typedef struct {
+    int64_t first_version;
+    int64_t last_version;
+    int64_t position;  //the logical position in the ring
+    int length;
+} BinlogTailCacheEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    char *buff;
+    int size;
+    int64_t start;  //the logical position of the oldest record
+    int64_t end;    //the logical position for the next append
+    struct {
+        BinlogTailCacheEntry *items;
+        int alloc;
+        int head;   //the oldest entry
+        int count;
+    } entries;
+} BinlogTailCache;
+
+#define TAIL_CACHE_MIN_BYTES_PER_ENTRY   256
+
+#define TAIL_CACHE_ENTRY(index) (tail_cache.entries.items + \
+        (tail_cache.entries.head + (index)) % tail_cache.entries.alloc)
+
+static BinlogTailCache tail_cache;
+
+int binlog_tail_cache_init()
+{
+    int result;
+    int bytes;
+
+    //only the slave sync threads fetch from the cache
+    if (BINLOG_TAIL_CACHE_SIZE == 0 || CLUSTER_SERVER_ARRAY.count <= 1) {
+        return 0;
+    }
+
+    if ((result=init_pthread_lock(&tail_cache.lock)) != 0) {
+        return result;
+    }
+
+    tail_cache.size = BINLOG_TAIL_CACHE_SIZE;
+    if (tail_cache.size < BINLOG_BUFFER_SIZE) {
+        tail_cache.size = BINLOG_BUFFER_SIZE;
+    }
+    tail_cache.buff = (char *)malloc(tail_cache.size);
+    if (tail_cache.buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, tail_cache.size);
+        return ENOMEM;
+    }
+
+    tail_cache.entries.alloc = tail_cache.size /
+        TAIL_CACHE_MIN_BYTES_PER_ENTRY + 1;
+    bytes = sizeof(BinlogTailCacheEntry) * tail_cache.entries.alloc;
+    tail_cache.entries.items = (BinlogTailCacheEntry *)malloc(bytes);
+    if (tail_cache.entries.items == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+
+    tail_cache.start = tail_cache.end = 0;
+    tail_cache.entries.head = tail_cache.entries.count = 0;
+    return 0;
+}
+
+void binlog_tail_cache_destroy()
+{
+    if (tail_cache.buff != NULL) {
+        free(tail_cache.buff);
+        tail_cache.buff = NULL;
+    }
+    if (tail_cache.entries.items != NULL) {
+        free(tail_cache.entries.items);
+        tail_cache.entries.items = NULL;
+    }
+}
+
+static void tail_cache_copy_in(const int64_t position,
+        const char *buff, const int length)
+{
+    int offset;
+    int bytes;
+
+    offset = position % tail_cache.size;
+    bytes = tail_cache.size - offset;
+    if (bytes >= length) {
+        memcpy(tail_cache.buff + offset, buff, length);
+    } else {
+        memcpy(tail_cache.buff + offset, buff, bytes);
+        memcpy(tail_cache.buff, buff + bytes, length - bytes);
+    }
+}
+
+static void tail_cache_copy_out(const int64_t position,
+        char *buff, const int length)
+{
+    int offset;
+    int bytes;
+
+    offset = position % tail_cache.size;
+    bytes = tail_cache.size - offset;
+    if (bytes >= length) {
+        memcpy(buff, tail_cache.buff + offset, length);
+    } else {
+        memcpy(buff, tail_cache.buff + offset, bytes);
+        memcpy(buff + bytes, tail_cache.buff, length - bytes);
+    }
+}
+
+static inline void tail_cache_evict_oldest()
+{
+    tail_cache.entries.head = (tail_cache.entries.head + 1) %
+        tail_cache.entries.alloc;
+    if (--tail_cache.entries.count == 0) {
+        tail_cache.start = tail_cache.end;
+    } else {
+        tail_cache.start = TAIL_CACHE_ENTRY(0)->position;
+    }
+}
+
+void binlog_tail_cache_append(const char *buff, const int length,
+        const int64_t first_version, const int64_t last_version)
+{
+    BinlogTailCacheEntry *entry;
+
+    if (tail_cache.buff == NULL || length <= 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&tail_cache.lock);
+    if (length > tail_cache.size || (tail_cache.entries.count > 0 &&
+                TAIL_CACHE_ENTRY(tail_cache.entries.count - 1)->
+                last_version + 1 != first_version))
+    {
+        //keep the data versions in the cache continuous
+        tail_cache.entries.head = tail_cache.entries.count = 0;
+        tail_cache.start = tail_cache.end;
+        if (length > tail_cache.size) {
+            pthread_mutex_unlock(&tail_cache.lock);
+            return;
+        }
+    }
+
+    while (tail_cache.entries.count == tail_cache.entries.alloc ||
+            (tail_cache.end + length) - tail_cache.start > tail_cache.size)
+    {
+        tail_cache_evict_oldest();
+    }
+
+    tail_cache_copy_in(tail_cache.end, buff, length);
+    entry = TAIL_CACHE_ENTRY(tail_cache.entries.count);
+    entry->first_version = first_version;
+    entry->last_version = last_version;
+    entry->position = tail_cache.end;
+    entry->length = length;
+    tail_cache.entries.count++;
+    tail_cache.end += length;
+    pthread_mutex_unlock(&tail_cache.lock);
+}
+
+//the first entry whose last version > data_version
+static int tail_cache_find_entry(const int64_t data_version)
+{
+    int low;
+    int high;
+    int mid;
+
+    low = 0;
+    high = tail_cache.entries.count - 1;
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (TAIL_CACHE_ENTRY(mid)->last_version > data_version) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+//remove the records before last_data_version (include) of the first entry
+static int tail_cache_skip_records(const int64_t last_data_version,
+        char *buff, int *length)
+{
+    const char *p;
+    const char *end;
+    const char *rec_end;
+    int64_t data_version;
+    int result;
+    char error_info[FDIR_ERROR_INFO_SIZE];
+
+    p = buff;
+    end = buff + *length;
+    while (p < end) {
+        *error_info = '\0';
+        if ((result=binlog_detect_record(p, end - p, &data_version,
+                        &rec_end, error_info)) != 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "binlog_detect_record fail, errno: %d, "
+                    "error info: %s", __LINE__, result, error_info);
+            return result;
+        }
+        if (data_version > last_data_version) {
+            break;
+        }
+        p = rec_end;
+    }
+
+    *length = end - p;
+    if (p != buff && *length > 0) {
+        memmove(buff, p, *length);
+    }
+    return 0;
+}
+
+int binlog_tail_cache_fetch(const int64_t last_data_version,
+        char *buff, const int size, int *length, int64_t *data_version)
+{
+    BinlogTailCacheEntry *entry;
+    int64_t first_version;
+    int index;
+
+    *length = 0;
+    *data_version = last_data_version;
+    if (tail_cache.buff == NULL) {
+        return ENOENT;
+    }
+
+    pthread_mutex_lock(&tail_cache.lock);
+    if (tail_cache.entries.count == 0 || last_data_version + 1 <
+            TAIL_CACHE_ENTRY(0)->first_version)
+    {
+        pthread_mutex_unlock(&tail_cache.lock);
+        return ENOENT;
+    }
+
+    if (last_data_version >= TAIL_CACHE_ENTRY(tail_cache.
+                entries.count - 1)->last_version)
+    {
+        pthread_mutex_unlock(&tail_cache.lock);
+        return 0;
+    }
+
+    index = tail_cache_find_entry(last_data_version);
+    first_version = TAIL_CACHE_ENTRY(index)->first_version;
+    for (; index<tail_cache.entries.count; index++) {
+        entry = TAIL_CACHE_ENTRY(index);
+        if (*length + entry->length > size) {
+            break;
+        }
+        tail_cache_copy_out(entry->position, buff + *length, entry->length);
+        *length += entry->length;
+        *data_version = entry->last_version;
+    }
+    pthread_mutex_unlock(&tail_cache.lock);
+
+    if (*length == 0) {
+        *data_version = last_data_version;
+        return ENOSPC;
+    }
+
+    if (first_version <= last_data_version) {
+        return tail_cache_skip_records(last_data_version, buff, length);
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+//binlog_tail_cache.h
+
+#ifndef _BINLOG_TAIL_CACHE_H_
+#define _BINLOG_TAIL_CACHE_H_
+
+#include "binlog_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the ring of the most recent flushed binlog records for the slave
+   to catch up without reading the binlog files, 0 size for disable */
+int binlog_tail_cache_init();
+void binlog_tail_cache_destroy();
+
+//called by the flush thread after the records are persisted
+void binlog_tail_cache_append(const char *buff, const int length,
+        const int64_t first_version, const int64_t last_version);
+
+/* copy the complete records after last_data_version to the buff whose
+   size should be at least BINLOG_BUFFER_SIZE.
+   return ENOENT when the records are not in the cache any more,
+   read the binlog files instead. the length is 0 for no newer records */
+int binlog_tail_cache_fetch(const int64_t last_data_version,
+        char *buff, const int size, int *length, int64_t *data_version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,7 +6,6 @@
 #include <time.h>
 #include <pthread.h>
 #include "fastcommon/fast_buffer.h"
-#include "fastcommon/common_blocked_queue.h"
 #include "../server_types.h"
 
 #define BINLOG_OP_NONE_INT           0
@@ -70,18 +69,49 @@ typedef struct server_binlog_buffer {
     int size;      //the buffer size (capacity)
 } ServerBinlogBuffer;
 
+typedef struct server_binlog_sync_stat {
+    int64_t count;       //the fdatasync count
+    int64_t bytes;       //the bytes written by these syncs
+    int64_t time_used;   //the total fdatasync time in us
+    int max_time_used;   //in us
+} ServerBinlogSyncStat;
+
+#define BINLOG_CONSUMER_STATUS_ATTACHED     0
+#define BINLOG_CONSUMER_STATUS_DETACHING    1  //requested by the appender
+#define BINLOG_CONSUMER_STATUS_DETACHED     2  //reading the binlog files
+#define BINLOG_CONSUMER_STATUS_REATTACHING  3  //done by the appender
+
 typedef struct server_binlog_consumer_context {
-    struct common_blocked_queue queue;
+    volatile int64_t cursor;  //the next log index to read
+    volatile int64_t data_version;  //the last data version consumed
+    volatile int status;
+    int64_t saved_version;  //the data version in the slave versions file
     FDIRClusterServerInfo *server;
 } ServerBinlogConsumerContext;
 
 typedef struct server_binlog_record_buffer {
-    int64_t data_version; //for idempotency (slave only)
+    int64_t data_version; //for idempotency (slave only), the first version
+    int record_count;     //the record count, data versions are continuous
     uint64_t hash_code;   //for thread dispatch (master and slave)
-    volatile int reffer_count;
     FastBuffer buffer;
 } ServerBinlogRecordBuffer;
 
+/* the record buffers shared by all consumers in data version order,
+   each consumer reads by its own cursor, the buffers before the
+   slowest cursor are freed by the appender. the slowest slave sync
+   consumer is detached when the log is full, it reads the binlog
+   files until reattached by the appender */
+typedef struct server_binlog_fanout_log {
+    ServerBinlogRecordBuffer **entries;
+    int size;        //power of 2
+    volatile int64_t tail;       //the next log index to append
+    int64_t reclaimed;           //the log index of the oldest entry
+    volatile int waiting_count;  //the consumers waiting for new entries
+    volatile bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} ServerBinlogFanoutLog;
+
 typedef struct server_binlog_consumer_array {
     ServerBinlogConsumerContext *contexts;
     int count;
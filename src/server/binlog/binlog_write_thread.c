@@ -17,32 +17,91 @@
 #include "fastcommon/sched_thread.h"
 #include "sf/sf_global.h"
 #include "../server_global.h"
+#include "../durable_ack.h"
 #include "binlog_func.h"
 #include "binlog_reader.h"
+#include "binlog_tail_cache.h"
 #include "binlog_producer.h"
+#include "binlog_consumer.h"
+#include "binlog_offset_index.h"
+#include "binlog_pack.h"
+#include "binlog_compress.h"
 #include "binlog_write_thread.h"
 
 #define BINLOG_FILE_MAX_SIZE   (1024 * 1024 * 1024)
 
+#define BINLOG_ZERO_FILL_BLOCK_SIZE  (1024 * 1024)
+
+/* a block of zeros can't be inside of the records,
+   it must be larger than BINLOG_RECORD_MAX_SIZE */
+#define BINLOG_ZERO_PROBE_SIZE       (32 * 1024)
+
 #define BINLOG_INDEX_FILENAME  BINLOG_FILE_PREFIX"_index.dat"
 
 #define BINLOG_INDEX_ITEM_CURRENT_WRITE     "current_write"
 #define BINLOG_INDEX_ITEM_CURRENT_COMPRESS  "current_compress"
+#define BINLOG_INDEX_ITEM_FIRST_WRITE       "first_write"
+
+typedef struct {
+    int offset;            //the offset in the buffer
+    int64_t data_version;  //the first data version of the record buffer
+} BinlogWriteMark;
 
+typedef struct {
+    ServerBinlogBuffer buffer;
+    int64_t first_data_version;
+    int64_t last_data_version;  //for the durable ack
+    int64_t record_count;
+    int last_record_offset;     //the offset in the buffer
+    struct {
+        BinlogWriteMark *items;   //for the offset index
+        int count;
+        int alloc;
+        int next_offset;  //the buffer offset of the next mark
+    } marks;
+} BinlogWriteBuffer;
+
+/* the write thread fills one buffer while the flush thread writes and
+   fdatasyncs the other one */
 typedef struct {
     char filename[PATH_MAX];
     int binlog_index;
     int binlog_compress_index;
+    int binlog_first_index;  //the binlog files before it are compacted
     int file_size;
     int fd;
-    ServerBinlogBuffer binlog_buffer;
+    BinlogOffsetIndexWriter index;
+    BinlogSegmentInfo segment;  //the flushed records of the current file
+    BinlogWriteBuffer buffers[2];
+    BinlogWriteBuffer *current;   //filled by the write thread
+    BinlogWriteBuffer *flushing;  //NULL for the flush thread idle
+    pthread_mutex_t lock;
+    pthread_mutex_t index_lock;  //serialize the index file writes
+    pthread_cond_t cond;
+    pthread_t flush_tid;
+    volatile bool flush_running;
+
+    /* the next segment is created and preallocated in background,
+       so the rotation only swaps the fd */
+    struct {
+        int fd;
+        char filename[PATH_MAX];
+        BinlogOffsetIndexWriter index;
+        pthread_cond_t cond;
+        pthread_t tid;
+        volatile bool running;
+    } next;
+    ServerBinlogSyncStat sync_stat;
 } BinlogWriterContext;
 
 static BinlogWriterContext writer_context = {{'\0'}, -1, 0, 0, -1};
-static struct common_blocked_queue *writer_queue = NULL;
+static ServerBinlogConsumerContext *writer_consumer = NULL;
 static volatile bool write_thread_running = false;
 
-static int write_to_binlog_index_file()
+/* called without the writer lock, the caller holds index_lock
+   when the writer threads are running */
+static int write_to_binlog_index_file_ex(const int write_index,
+        const int compress_index, const int first_index)
 {
     char full_filename[PATH_MAX];
     char buff[256];
@@ -53,11 +112,11 @@ static int write_to_binlog_index_file()
             "%s/%s", DATA_PATH_STR, BINLOG_INDEX_FILENAME);
 
     len = sprintf(buff, "%s=%d\n"
+            "%s=%d\n"
             "%s=%d\n",
-            BINLOG_INDEX_ITEM_CURRENT_WRITE,
-            writer_context.binlog_index,
-            BINLOG_INDEX_ITEM_CURRENT_COMPRESS,
-            writer_context.binlog_compress_index);
+            BINLOG_INDEX_ITEM_CURRENT_WRITE, write_index,
+            BINLOG_INDEX_ITEM_CURRENT_COMPRESS, compress_index,
+            BINLOG_INDEX_ITEM_FIRST_WRITE, first_index);
     if ((result=safeWriteToFile(full_filename, buff, len)) != 0) {
         logError("file: "__FILE__", line: %d, "
             "write to file \"%s\" fail, "
@@ -69,6 +128,13 @@ static int write_to_binlog_index_file()
     return result;
 }
 
+static inline int write_to_binlog_index_file()
+{
+    return write_to_binlog_index_file_ex(writer_context.binlog_index,
+            writer_context.binlog_compress_index,
+            writer_context.binlog_first_index);
+}
+
 static int get_binlog_index_from_file()
 {
     char full_filename[PATH_MAX];
@@ -95,11 +161,274 @@ static int get_binlog_index_from_file()
             BINLOG_INDEX_ITEM_CURRENT_WRITE, &iniContext, 0);
     writer_context.binlog_compress_index = iniGetIntValue(NULL,
             BINLOG_INDEX_ITEM_CURRENT_COMPRESS, &iniContext, 0);
+    writer_context.binlog_first_index = iniGetIntValue(NULL,
+            BINLOG_INDEX_ITEM_FIRST_WRITE, &iniContext, 0);
 
     iniFreeContext(&iniContext);
     return 0;
 }
 
+static inline bool binlog_is_zero_buffer(const char *buff,
+        const int64_t length)
+{
+    const char *p;
+    const char *end;
+
+    end = buff + length;
+    for (p=buff; p<end; p++) {
+        if (*p != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* truncate the torn record left by the crash at the tail of the current
+   binlog file, the valid records are checked by the length with the end
+   tag (text) or the CRC32C (binary), the dropped bytes are saved */
+static int binlog_repair_tail(const char *filename,
+        const int fd, int64_t *file_size)
+{
+    char torn_filename[PATH_MAX + 32];
+    char date_str[32];
+    char error_info[FDIR_ERROR_INFO_SIZE];
+    char *buff;
+    const char *rec_end;
+    int64_t window_offset;
+    int64_t valid_size;
+    int64_t data_version;
+    int64_t bytes;
+    int offset;
+    int result;
+
+    //the torn part is one write buffer at most, then the zeros
+    bytes = 2 * BINLOG_BUFFER_SIZE + BINLOG_RECORD_MAX_SIZE +
+        BINLOG_ZERO_PROBE_SIZE;
+    if (bytes > *file_size) {
+        bytes = *file_size;
+    }
+    window_offset = *file_size - bytes;
+    buff = (char *)malloc(bytes + 1);
+    if (buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %"PRId64" bytes fail", __LINE__, bytes + 1);
+        return ENOMEM;
+    }
+
+    bytes += 1;   //for last \0
+    if ((result=getFileContentEx(filename, buff,
+                    window_offset, &bytes)) != 0)
+    {
+        free(buff);
+        return result;
+    }
+
+    *error_info = '\0';
+    data_version = 0;
+    if ((result=binlog_detect_record_reverse(buff, bytes,
+                    &data_version, &offset, error_info)) == 0)
+    {
+        result = binlog_detect_record(buff + offset, bytes - offset,
+                &data_version, &rec_end, error_info);
+    }
+
+    if (result == 0) {
+        valid_size = window_offset + (rec_end - buff);
+    } else if (window_offset == 0) {
+        valid_size = 0;  //no complete record in the file
+    } else {
+        logError("file: "__FILE__", line: %d, "
+                "binlog file: %s, no valid record in the last %"PRId64
+                " bytes, error info: %s, please check it manually!",
+                __LINE__, filename, bytes, error_info);
+        free(buff);
+        return EINVAL;
+    }
+
+    if (valid_size == *file_size) {
+        free(buff);
+        return 0;
+    }
+
+    //the zeros of the preallocation after the last record
+    if (binlog_is_zero_buffer(buff + (valid_size - window_offset),
+                *file_size - valid_size))
+    {
+        free(buff);
+        if (ftruncate(fd, valid_size) != 0 || fsync(fd) != 0) {
+            result = errno != 0 ? errno : EIO;
+            logError("file: "__FILE__", line: %d, "
+                    "truncate binlog file \"%s\" to %"PRId64" fail, "
+                    "errno: %d, error info: %s", __LINE__, filename,
+                    valid_size, result, STRERROR(result));
+            return result;
+        }
+        *file_size = valid_size;
+        return 0;
+    }
+
+    snprintf(torn_filename, sizeof(torn_filename), "%s.torn.%s", filename,
+            formatDatetime(g_current_time, "%Y%m%d%H%M%S",
+                date_str, sizeof(date_str)));
+    result = safeWriteToFile(torn_filename, buff + (valid_size -
+                window_offset), *file_size - valid_size);
+    free(buff);
+    if (result != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "write to file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, torn_filename, result, STRERROR(result));
+        return result;
+    }
+
+    if (ftruncate(fd, valid_size) != 0 || fsync(fd) != 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "truncate binlog file \"%s\" to %"PRId64" fail, "
+                "errno: %d, error info: %s", __LINE__, filename,
+                valid_size, result, STRERROR(result));
+        return result;
+    }
+
+    logWarning("file: "__FILE__", line: %d, "
+            "binlog file: %s, drop the torn tail of %"PRId64" bytes "
+            "after data version %"PRId64" (offset %"PRId64"), "
+            "saved to %s", __LINE__, filename,
+            *file_size - valid_size, data_version,
+            valid_size, torn_filename);
+    *file_size = valid_size;
+    return 0;
+}
+
+static int binlog_is_zero_block(const char *filename, char *buff,
+        const int64_t offset, bool *zero)
+{
+    int64_t bytes;
+    int result;
+
+    bytes = BINLOG_ZERO_PROBE_SIZE + 1;   //for last \0
+    if ((result=getFileContentEx(filename, buff, offset, &bytes)) != 0) {
+        return result;
+    }
+
+    *zero = binlog_is_zero_buffer(buff, bytes);
+    return 0;
+}
+
+/* the current binlog file is zero filled beyond the last record by the
+   preallocation, find the first zero block by a binary search and cut
+   the file there, the zeros less than a block are cut by the repair of
+   the torn record, as the binary record may end with zero bytes */
+static int binlog_trim_zero_tail(const char *filename,
+        const int fd, int64_t *file_size)
+{
+    char *buff;
+    int64_t low;
+    int64_t high;
+    int64_t mid;
+    int64_t valid_size;
+    int result;
+    bool zero;
+
+    buff = (char *)malloc(BINLOG_ZERO_PROBE_SIZE + 1);
+    if (buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__,
+                BINLOG_ZERO_PROBE_SIZE + 1);
+        return ENOMEM;
+    }
+
+    high = (*file_size - 1) / BINLOG_ZERO_PROBE_SIZE;
+    if ((result=binlog_is_zero_block(filename, buff, high *
+                    BINLOG_ZERO_PROBE_SIZE, &zero)) != 0 ||
+            !zero)
+    {
+        free(buff);
+        return result;
+    }
+
+    //the first zero block
+    low = 0;
+    while (low < high) {
+        mid = (low + high) / 2;
+        if ((result=binlog_is_zero_block(filename, buff, mid *
+                        BINLOG_ZERO_PROBE_SIZE, &zero)) != 0)
+        {
+            free(buff);
+            return result;
+        }
+        if (zero) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    free(buff);
+    valid_size = low * BINLOG_ZERO_PROBE_SIZE;
+
+    if (ftruncate(fd, valid_size) != 0 || fsync(fd) != 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "truncate binlog file \"%s\" to %"PRId64" fail, "
+                "errno: %d, error info: %s", __LINE__, filename,
+                valid_size, result, STRERROR(result));
+        return result;
+    }
+
+    logInfo("file: "__FILE__", line: %d, "
+            "binlog file: %s, cut the zero filled tail of %"PRId64
+            " bytes", __LINE__, filename, *file_size - valid_size);
+    *file_size = valid_size;
+    return 0;
+}
+
+int binlog_write_thread_repair_tail()
+{
+    char filename[PATH_MAX];
+    int64_t file_size;
+    int fd;
+    int result;
+
+    if ((result=get_binlog_index_from_file()) != 0) {
+        return result;
+    }
+
+    GET_BINLOG_FILENAME(filename, sizeof(filename),
+            writer_context.binlog_index);
+    if (access(filename, F_OK) != 0) {
+        return 0;
+    }
+    if ((result=getFileSize(filename, &file_size)) != 0) {
+        return result;
+    }
+    if (file_size == 0) {
+        return binlog_offset_index_truncate(
+                writer_context.binlog_index, 0);
+    }
+
+    if ((fd=open(filename, O_WRONLY)) < 0) {
+        result = errno != 0 ? errno : EACCES;
+        logError("file: "__FILE__", line: %d, "
+                "open file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    if ((result=binlog_trim_zero_tail(filename, fd, &file_size)) == 0 &&
+            file_size > 0)
+    {
+        result = binlog_repair_tail(filename, fd, &file_size);
+    }
+    close(fd);
+    if (result != 0) {
+        return result;
+    }
+
+    //the entries beyond the valid size point into the rewritten records
+    return binlog_offset_index_truncate(
+            writer_context.binlog_index, file_size);
+}
+
 static int open_writable_binlog()
 {
     if (writer_context.fd >= 0) {
@@ -129,89 +458,482 @@ static int open_writable_binlog()
         return errno != 0 ? errno : EIO;
     }
 
+    binlog_offset_index_close(&writer_context.index);
+    return binlog_offset_index_open(&writer_context.index,
+            writer_context.binlog_index, writer_context.file_size == 0);
+}
+
+//the tail of the current file is recovered by a short reverse scan
+static int load_current_segment_info()
+{
+    BinlogSegmentInfo *segment;
+    int result;
+
+    segment = &writer_context.segment;
+    memset(segment, 0, sizeof(BinlogSegmentInfo));
+    if (writer_context.file_size == 0) {
+        return 0;
+    }
+
+    if ((result=binlog_get_first_record_version(writer_context.
+                    binlog_index, &segment->first_version)) != 0)
+    {
+        return result;
+    }
+    if ((result=binlog_get_last_record_version(writer_context.
+                    binlog_index, &segment->last_version,
+                    &segment->last_offset)) != 0)
+    {
+        return result;
+    }
+
+    //the data versions are continuous
+    segment->record_count = segment->last_version -
+        segment->first_version + 1;
     return 0;
 }
 
-static int open_next_binlog()
+/* fill the next binlog file with zeros, the records overwrite the
+   written blocks, so the fdatasync after each append flushes the data
+   only, without the file size and the extent updates */
+static int binlog_preallocate(const char *filename,
+        const int fd, int64_t file_size)
 {
-    GET_BINLOG_FILENAME(writer_context.filename, sizeof(writer_context.
-                filename), writer_context.binlog_index);
-    if (access(writer_context.filename, F_OK) == 0) {
+    char *zeros;
+    int bytes;
+    int result;
+
+    if (file_size >= BINLOG_FILE_MAX_SIZE) {
+        return 0;
+    }
+
+    zeros = (char *)calloc(1, BINLOG_ZERO_FILL_BLOCK_SIZE);
+    if (zeros == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__,
+                BINLOG_ZERO_FILL_BLOCK_SIZE);
+        return ENOMEM;
+    }
+
+    result = 0;
+    while (file_size < BINLOG_FILE_MAX_SIZE) {
+        if (!writer_context.next.running) {
+            result = EINTR;
+            break;
+        }
+
+        bytes = BINLOG_FILE_MAX_SIZE - file_size;
+        if (bytes > BINLOG_ZERO_FILL_BLOCK_SIZE) {
+            bytes = BINLOG_ZERO_FILL_BLOCK_SIZE;
+        }
+        if (pwrite(fd, zeros, bytes, file_size) != bytes) {
+            result = errno != 0 ? errno : EIO;
+            break;
+        }
+        file_size += bytes;
+    }
+    free(zeros);
+
+    if (result == 0 && fdatasync(fd) != 0) {
+        result = errno != 0 ? errno : EIO;
+    }
+    if (result != 0 && result != EINTR) {
+        logWarning("file: "__FILE__", line: %d, "
+                "zero fill binlog file \"%s\" fail, offset: %"PRId64", "
+                "errno: %d, error info: %s", __LINE__, filename,
+                file_size, result, STRERROR(result));
+    }
+    return result;
+}
+
+//the file left by the last preallocation starts with zeros
+static bool binlog_is_preallocated(const char *filename)
+{
+    char buff[256];
+    int64_t bytes;
+
+    bytes = sizeof(buff);
+    if (getFileContentEx(filename, buff, 0, &bytes) != 0) {
+        return false;
+    }
+    return binlog_is_zero_buffer(buff, bytes);
+}
+
+static int open_binlog_for_rotate(const int binlog_index,
+        char *filename, const int size, int *fd,
+        BinlogOffsetIndexWriter *index)
+{
+    struct stat buf;
+    int result;
+
+    GET_BINLOG_FILENAME(filename, size, binlog_index);
+    //the empty or zero filled file is preallocated by the last run
+    if (stat(filename, &buf) != 0) {
+        buf.st_size = 0;
+    } else if (buf.st_size > 0 && !binlog_is_preallocated(filename)) {
         char bak_filename[PATH_MAX];
         char date_str[32];
 
-        sprintf(bak_filename, "%s.%s", writer_context.filename,
+        sprintf(bak_filename, "%s.%s", filename,
                 formatDatetime(g_current_time, "%Y%m%d%H%M%S",
                     date_str, sizeof(date_str)));
-        if (rename(writer_context.filename, bak_filename) == 0) { 
+        if (rename(filename, bak_filename) == 0) { 
             logWarning("file: "__FILE__", line: %d, "
                     "binlog file %s exist, rename to %s",
-                    __LINE__, writer_context.filename, bak_filename);
+                    __LINE__, filename, bak_filename);
         } else {
             logError("file: "__FILE__", line: %d, "
                     "rename binlog %s to backup %s fail, "
                     "errno: %d, error info: %s",
-                    __LINE__, writer_context.filename, bak_filename,
+                    __LINE__, filename, bak_filename,
                     errno, STRERROR(errno));
             return errno != 0 ? errno : EPERM;
         }
+        buf.st_size = 0;
+    }
+
+    //without O_APPEND, the records are written from the file start
+    *fd = open(filename, O_WRONLY | O_CREAT, 0644);
+    if (*fd < 0) {
+        logError("file: "__FILE__", line: %d, "
+                "open file \"%s\" fail, "
+                "errno: %d, error info: %s",
+                __LINE__, filename, errno, STRERROR(errno));
+        return errno != 0 ? errno : EACCES;
+    }
+
+    //the appends beyond the zeros still work when it fails
+    if (binlog_preallocate(filename, *fd, buf.st_size) == EINTR) {
+        close(*fd);
+        return EINTR;
+    }
+    if ((result=binlog_offset_index_open(index, binlog_index, true)) != 0) {
+        close(*fd);
+        return result;
+    }
+    return 0;
+}
+
+static void *binlog_preallocate_thread_func(void *arg)
+{
+    char filename[PATH_MAX];
+    BinlogOffsetIndexWriter index;
+    int binlog_index;
+    int fd;
+
+    while (1) {
+        pthread_mutex_lock(&writer_context.lock);
+        while (writer_context.next.fd >= 0 &&
+                writer_context.next.running)
+        {
+            pthread_cond_wait(&writer_context.next.cond,
+                    &writer_context.lock);
+        }
+        binlog_index = writer_context.binlog_index + 1;
+        pthread_mutex_unlock(&writer_context.lock);
+
+        if (!writer_context.next.running) {
+            break;
+        }
+
+        if (open_binlog_for_rotate(binlog_index, filename,
+                    sizeof(filename), &fd, &index) != 0)
+        {
+            sleep(1);  //retry later, the rotation waits for it
+            continue;
+        }
+
+        pthread_mutex_lock(&writer_context.lock);
+        writer_context.next.fd = fd;
+        writer_context.next.index = index;
+        strcpy(writer_context.next.filename, filename);
+        pthread_cond_broadcast(&writer_context.next.cond);
+        pthread_mutex_unlock(&writer_context.lock);
     }
 
-    return open_writable_binlog();
+    return NULL;
 }
 
-static int binlog_write_to_file()
+/* only the fd swap is under the writer lock, the file I/O of the
+   rotation is out of it for the readers and the write thread */
+static int binlog_rotate()
 {
+    BinlogSegmentInfo segment;
+    BinlogOffsetIndexWriter index;
+    int old_fd;
     int result;
 
-    if (writer_context.binlog_buffer.length == 0) {
-        return 0;
+    //cut the zero filled tail, the sealed file ends with the last record
+    if (ftruncate(writer_context.fd, writer_context.file_size) != 0 ||
+            fdatasync(writer_context.fd) != 0)
+    {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "truncate binlog file \"%s\" to %d fail, "
+                "errno: %d, error info: %s", __LINE__,
+                writer_context.filename, writer_context.file_size,
+                result, STRERROR(result));
+        return result;
+    }
+
+    pthread_mutex_lock(&writer_context.lock);
+    while (writer_context.next.fd < 0 && writer_context.next.running) {
+        pthread_cond_wait(&writer_context.next.cond, &writer_context.lock);
+    }
+    result = (writer_context.next.fd < 0) ? EINTR : 0;
+    pthread_mutex_unlock(&writer_context.lock);
+    if (result != 0) {
+        return result;
+    }
+
+    //the index changes are serialized, so the written one is the latest
+    pthread_mutex_lock(&writer_context.index_lock);
+    if ((result=write_to_binlog_index_file_ex(writer_context.
+                    binlog_index + 1, writer_context.binlog_compress_index,
+                    writer_context.binlog_first_index)) != 0)
+    {
+        pthread_mutex_unlock(&writer_context.index_lock);
+        return result;
     }
 
-    if (fc_safe_write(writer_context.fd, writer_context.binlog_buffer.buff,
-                writer_context.binlog_buffer.length) !=
-            writer_context.binlog_buffer.length)
+    segment = writer_context.segment;
+    segment.file_size = writer_context.file_size;
+    old_fd = writer_context.fd;
+    index = writer_context.index;
+
+    pthread_mutex_lock(&writer_context.lock);
+    writer_context.binlog_index++;
+    memset(&writer_context.segment, 0, sizeof(BinlogSegmentInfo));
+    writer_context.fd = writer_context.next.fd;
+    writer_context.file_size = 0;
+    strcpy(writer_context.filename, writer_context.next.filename);
+    writer_context.index = writer_context.next.index;
+    writer_context.next.fd = -1;
+    pthread_cond_broadcast(&writer_context.next.cond);
+    pthread_mutex_unlock(&writer_context.lock);
+    pthread_mutex_unlock(&writer_context.index_lock);
+
+    /* before the footer is written, the readers get the segment info
+       of the sealed file by the reverse scan */
+    binlog_offset_index_seal(&index, &segment);
+    binlog_offset_index_close(&index);
+    close(old_fd);
+    return 0;
+}
+
+static void binlog_write_offset_index(BinlogWriteBuffer *wbuffer)
+{
+    BinlogWriteMark *mark;
+    BinlogWriteMark *end;
+
+    end = wbuffer->marks.items + wbuffer->marks.count;
+    for (mark=wbuffer->marks.items; mark<end; mark++) {
+        //the index is only a hint, the reader falls back to scan
+        if (binlog_offset_index_append(&writer_context.index,
+                    mark->data_version, writer_context.file_size +
+                    mark->offset) != 0)
+        {
+            break;
+        }
+    }
+}
+
+static int binlog_flush_buffer(BinlogWriteBuffer *wbuffer)
+{
+    int64_t start_time;
+    int time_used;
+
+    if (fc_safe_write(writer_context.fd, wbuffer->buffer.buff,
+                wbuffer->buffer.length) != wbuffer->buffer.length)
     {
         logError("file: "__FILE__", line: %d, "
                 "write to binlog file \"%s\" fail, fd: %d, "
                 "errno: %d, error info: %s",
                 __LINE__, writer_context.filename,
                 writer_context.fd, errno, STRERROR(errno));
-        result = errno != 0 ? errno : EIO;
-    } else if (fsync(writer_context.fd) != 0) {
+        return errno != 0 ? errno : EIO;
+    }
+
+    start_time = get_current_time_us();
+    if (fdatasync(writer_context.fd) != 0) {
         logError("file: "__FILE__", line: %d, "
-                "fsync to binlog file \"%s\" fail, "
+                "fdatasync to binlog file \"%s\" fail, "
                 "errno: %d, error info: %s",
                 __LINE__, writer_context.filename,
                 errno, STRERROR(errno));
-        result = errno != 0 ? errno : EIO;
-    } else {
-        writer_context.file_size += writer_context.binlog_buffer.length;
-        if (writer_context.file_size >= BINLOG_FILE_MAX_SIZE) {
-            writer_context.binlog_index++;  //rotate
-            if ((result=write_to_binlog_index_file()) == 0) {
-                result = open_next_binlog();
-            }
+        return errno != 0 ? errno : EIO;
+    }
 
-            if (result != 0) {
-                logError("file: "__FILE__", line: %d, "
-                        "open binlog file \"%s\" fail",
-                        __LINE__, writer_context.filename);
-            }
+    time_used = get_current_time_us() - start_time;
+    writer_context.sync_stat.count++;
+    writer_context.sync_stat.bytes += wbuffer->buffer.length;
+    writer_context.sync_stat.time_used += time_used;
+    if (time_used > writer_context.sync_stat.max_time_used) {
+        writer_context.sync_stat.max_time_used = time_used;
+    }
+
+    binlog_write_offset_index(wbuffer);
+    binlog_tail_cache_append(wbuffer->buffer.buff, wbuffer->buffer.length,
+            wbuffer->first_data_version, wbuffer->last_data_version);
+
+    pthread_mutex_lock(&writer_context.lock);
+    if (writer_context.segment.record_count == 0) {
+        writer_context.segment.first_version = wbuffer->first_data_version;
+    }
+    writer_context.segment.record_count += wbuffer->record_count;
+    writer_context.segment.last_version = wbuffer->last_data_version;
+    writer_context.segment.last_offset = writer_context.file_size +
+        wbuffer->last_record_offset;
+    writer_context.file_size += wbuffer->buffer.length;
+    pthread_mutex_unlock(&writer_context.lock);
+
+    if (writer_context.file_size >= BINLOG_FILE_MAX_SIZE) {
+        if (binlog_rotate() != 0) {
+            logError("file: "__FILE__", line: %d, "
+                    "rotate binlog file \"%s\" fail",
+                    __LINE__, writer_context.filename);
         } else {
-            result = 0;
+            binlog_compress_notify();
         }
     }
 
-    writer_context.binlog_buffer.length = 0;  //reset cache buff
-    return result;
+    return 0;
+}
+
+static void *binlog_flush_thread_func(void *arg)
+{
+    BinlogWriteBuffer *wbuffer;
+
+    while (1) {
+        pthread_mutex_lock(&writer_context.lock);
+        while (writer_context.flushing == NULL &&
+                writer_context.flush_running)
+        {
+            pthread_cond_wait(&writer_context.cond, &writer_context.lock);
+        }
+        wbuffer = writer_context.flushing;
+        pthread_mutex_unlock(&writer_context.lock);
+
+        if (wbuffer == NULL) {  //terminated
+            break;
+        }
+
+        if (binlog_flush_buffer(wbuffer) != 0) {
+            logCrit("file: "__FILE__", line: %d, "
+                    "binlog_flush_buffer fail, program exit!", __LINE__);
+            SF_G_CONTINUE_FLAG = false;
+        } else {
+            durable_ack_notify(wbuffer->last_data_version);
+        }
+        wbuffer->buffer.length = 0;
+        wbuffer->record_count = 0;
+        wbuffer->marks.count = 0;
+        wbuffer->marks.next_offset = 0;
+
+        pthread_mutex_lock(&writer_context.lock);
+        writer_context.flushing = NULL;
+        pthread_cond_broadcast(&writer_context.cond);
+        pthread_mutex_unlock(&writer_context.lock);
+    }
+
+    return NULL;
+}
+
+static inline void binlog_wait_flush_done()
+{
+    pthread_mutex_lock(&writer_context.lock);
+    while (writer_context.flushing != NULL) {
+        pthread_cond_wait(&writer_context.cond, &writer_context.lock);
+    }
+    pthread_mutex_unlock(&writer_context.lock);
+}
+
+//hand the current buffer to the flush thread and switch to the other one
+static void binlog_submit_buffer()
+{
+    if (writer_context.current->buffer.length == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&writer_context.lock);
+    while (writer_context.flushing != NULL) {
+        pthread_cond_wait(&writer_context.cond, &writer_context.lock);
+    }
+    writer_context.flushing = writer_context.current;
+    pthread_cond_broadcast(&writer_context.cond);
+    pthread_mutex_unlock(&writer_context.lock);
+
+    if (writer_context.current == writer_context.buffers) {
+        writer_context.current = writer_context.buffers + 1;
+    } else {
+        writer_context.current = writer_context.buffers;
+    }
+}
+
+static inline bool binlog_flush_idle()
+{
+    bool idle;
+
+    pthread_mutex_lock(&writer_context.lock);
+    idle = (writer_context.flushing == NULL);
+    pthread_mutex_unlock(&writer_context.lock);
+    return idle;
+}
+
+static int binlog_write_buffer_init(BinlogWriteBuffer *wbuffer)
+{
+    int result;
+    int bytes;
+
+    if ((result=binlog_buffer_init(&wbuffer->buffer)) != 0) {
+        return result;
+    }
+
+    if (BINLOG_INDEX_INTERVAL > 0) {
+        wbuffer->marks.alloc = BINLOG_BUFFER_SIZE /
+            BINLOG_INDEX_INTERVAL + 1;
+        bytes = sizeof(BinlogWriteMark) * wbuffer->marks.alloc;
+        wbuffer->marks.items = (BinlogWriteMark *)malloc(bytes);
+        if (wbuffer->marks.items == NULL) {
+            logError("file: "__FILE__", line: %d, "
+                    "malloc %d bytes fail", __LINE__, bytes);
+            return ENOMEM;
+        }
+    }
+    return 0;
 }
 
 int binlog_write_thread_init()
 {
     int result;
 
-    if ((result=binlog_buffer_init(&writer_context.binlog_buffer)) != 0) {
+    if ((result=binlog_write_buffer_init(writer_context.buffers)) != 0) {
+        return result;
+    }
+    if ((result=binlog_write_buffer_init(writer_context.
+                    buffers + 1)) != 0)
+    {
+        return result;
+    }
+    writer_context.current = writer_context.buffers;
+    writer_context.flushing = NULL;
+
+    if ((result=init_pthread_lock(&writer_context.lock)) != 0) {
+        return result;
+    }
+    if ((result=init_pthread_lock(&writer_context.index_lock)) != 0) {
+        return result;
+    }
+    if ((result=pthread_cond_init(&writer_context.cond, NULL)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_cond_init fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+    if ((result=pthread_cond_init(&writer_context.next.cond, NULL)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_cond_init fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
         return result;
     }
 
@@ -219,7 +941,34 @@ int binlog_write_thread_init()
         return result;
     }
 
-    return open_writable_binlog();
+    writer_context.index.fd = -1;
+    if ((result=open_writable_binlog()) != 0) {
+        return result;
+    }
+    if ((result=load_current_segment_info()) != 0) {
+        return result;
+    }
+
+    writer_context.next.fd = -1;
+    writer_context.next.running = true;
+    if ((result=fc_create_thread(&writer_context.next.tid,
+                    binlog_preallocate_thread_func, NULL,
+                    SF_G_THREAD_STACK_SIZE)) != 0)
+    {
+        writer_context.next.running = false;
+        return result;
+    }
+
+    writer_context.flush_running = true;
+    if ((result=fc_create_thread(&writer_context.flush_tid,
+                    binlog_flush_thread_func, NULL,
+                    SF_G_THREAD_STACK_SIZE)) != 0)
+    {
+        writer_context.flush_running = false;
+        return result;
+    }
+
+    return 0;
 }
 
 int binlog_get_current_write_index()
@@ -231,48 +980,222 @@ int binlog_get_current_write_index()
     return writer_context.binlog_index;
 }
 
-static inline int deal_binlog_one_record(ServerBinlogRecordBuffer *rb)
+int binlog_get_first_write_index()
+{
+    if (writer_context.binlog_index < 0) {
+        get_binlog_index_from_file();
+    }
+
+    return writer_context.binlog_first_index;
+}
+
+int binlog_set_first_write_index(const int first_index)
 {
     int result;
-    if (writer_context.binlog_buffer.size - writer_context.binlog_buffer.length
-            < rb->buffer.length)
+
+    //the indexes only change under index_lock
+    pthread_mutex_lock(&writer_context.index_lock);
+    if (first_index > writer_context.binlog_index) {
+        result = EINVAL;
+    } else if ((result=write_to_binlog_index_file_ex(writer_context.
+                    binlog_index, writer_context.binlog_compress_index,
+                    first_index)) == 0)
     {
-        if ((result=binlog_write_to_file()) != 0) {
-            return result;
+        pthread_mutex_lock(&writer_context.lock);
+        writer_context.binlog_first_index = first_index;
+        pthread_mutex_unlock(&writer_context.lock);
+    }
+    pthread_mutex_unlock(&writer_context.index_lock);
+    return result;
+}
+
+int binlog_get_compress_index()
+{
+    if (writer_context.binlog_index < 0) {
+        get_binlog_index_from_file();
+    }
+
+    return writer_context.binlog_compress_index;
+}
+
+int binlog_set_compress_index(const int compress_index)
+{
+    int result;
+
+    pthread_mutex_lock(&writer_context.index_lock);
+    if (compress_index > writer_context.binlog_index) {
+        result = EINVAL;
+    } else if ((result=write_to_binlog_index_file_ex(writer_context.
+                    binlog_index, compress_index, writer_context.
+                    binlog_first_index)) == 0)
+    {
+        pthread_mutex_lock(&writer_context.lock);
+        writer_context.binlog_compress_index = compress_index;
+        pthread_mutex_unlock(&writer_context.lock);
+    }
+    pthread_mutex_unlock(&writer_context.index_lock);
+    return result;
+}
+
+int binlog_write_thread_get_file_size(const int binlog_index,
+        int64_t *file_size)
+{
+    int result;
+
+    if (writer_context.fd < 0) {  //not inited
+        return ENOENT;
+    }
+
+    pthread_mutex_lock(&writer_context.lock);
+    if (binlog_index == writer_context.binlog_index) {
+        *file_size = writer_context.file_size;
+        result = 0;
+    } else {
+        result = ENOENT;
+    }
+    pthread_mutex_unlock(&writer_context.lock);
+    return result;
+}
+
+int binlog_write_thread_get_segment_info(const int binlog_index,
+        BinlogSegmentInfo *segment)
+{
+    int result;
+
+    if (writer_context.fd < 0) {  //not inited
+        return ENOENT;
+    }
+
+    pthread_mutex_lock(&writer_context.lock);
+    if (binlog_index == writer_context.
+            binlog_index && writer_context.segment.record_count > 0)
+    {
+        *segment = writer_context.segment;
+        segment->file_size = writer_context.file_size;
+        result = 0;
+    } else {
+        result = ENOENT;
+    }
+    pthread_mutex_unlock(&writer_context.lock);
+    return result;
+}
+
+void binlog_write_thread_get_sync_stat(ServerBinlogSyncStat *stat)
+{
+    *stat = writer_context.sync_stat;
+}
+
+static void binlog_add_record_info(BinlogWriteBuffer *wbuffer,
+        ServerBinlogRecordBuffer *rb)
+{
+    BinlogWriteMark *mark;
+
+    if (wbuffer->buffer.length >= wbuffer->marks.next_offset &&
+            wbuffer->marks.count < wbuffer->marks.alloc)
+    {
+        mark = wbuffer->marks.items + wbuffer->marks.count++;
+        mark->offset = wbuffer->buffer.length;
+        mark->data_version = rb->data_version;
+        wbuffer->marks.next_offset = wbuffer->buffer.length +
+            BINLOG_INDEX_INTERVAL;
+    }
+
+    if (wbuffer->record_count == 0) {
+        wbuffer->first_data_version = rb->data_version;
+    }
+    wbuffer->record_count += rb->record_count;
+    wbuffer->last_record_offset = wbuffer->buffer.length;
+    if (rb->record_count > 1) {
+        int64_t data_version;
+        int offset;
+        char error_info[FDIR_ERROR_INFO_SIZE];
+
+        if (binlog_detect_record_reverse(rb->buffer.data, rb->buffer.length,
+                    &data_version, &offset, error_info) == 0)
+        {
+            wbuffer->last_record_offset += offset;
+        }
+    }
+    wbuffer->last_data_version = rb->data_version + rb->record_count - 1;
+}
+
+/* the record buffer larger than the write buffer is handed to
+   the flush thread directly instead of copying */
+static int binlog_write_oversized(ServerBinlogRecordBuffer *rb)
+{
+    BinlogWriteBuffer wbuffer;
+    BinlogWriteMark mark;
+
+    binlog_submit_buffer();
+    memset(&wbuffer, 0, sizeof(wbuffer));
+    if (BINLOG_INDEX_INTERVAL > 0) {
+        wbuffer.marks.items = &mark;
+        wbuffer.marks.alloc = 1;
+    }
+    binlog_add_record_info(&wbuffer, rb);
+    wbuffer.buffer.buff = rb->buffer.data;
+    wbuffer.buffer.length = wbuffer.buffer.size = rb->buffer.length;
+
+    pthread_mutex_lock(&writer_context.lock);
+    while (writer_context.flushing != NULL) {
+        pthread_cond_wait(&writer_context.cond, &writer_context.lock);
+    }
+    writer_context.flushing = &wbuffer;
+    pthread_cond_broadcast(&writer_context.cond);
+    while (writer_context.flushing != NULL) {
+        pthread_cond_wait(&writer_context.cond, &writer_context.lock);
+    }
+    pthread_mutex_unlock(&writer_context.lock);
+    return 0;
+}
+
+static inline int deal_binlog_one_record(ServerBinlogRecordBuffer *rb)
+{
+    ServerBinlogBuffer *buffer;
+
+    buffer = &writer_context.current->buffer;
+    if (buffer->size - buffer->length < rb->buffer.length) {
+        if (rb->buffer.length > buffer->size) {
+            return binlog_write_oversized(rb);
         }
+        binlog_submit_buffer();
+        buffer = &writer_context.current->buffer;
     }
 
-    memcpy(writer_context.binlog_buffer.buff +
-            writer_context.binlog_buffer.length,
+    binlog_add_record_info(writer_context.current, rb);
+    memcpy(buffer->buff + buffer->length,
             rb->buffer.data, rb->buffer.length);
-    writer_context.binlog_buffer.length += rb->buffer.length;
+    buffer->length += rb->buffer.length;
     return 0;
 }
 
-static int deal_binlog_records(struct common_blocked_node *node)
+static int deal_binlog_records(ServerBinlogRecordBuffer **rbuffers,
+        const int count)
 {
-    ServerBinlogRecordBuffer *rb;
+    ServerBinlogRecordBuffer **rb;
+    ServerBinlogRecordBuffer **end;
     int result;
 
-    do {
-        rb = (ServerBinlogRecordBuffer *)node->data;
-        if ((result=deal_binlog_one_record(rb)) != 0) {
+    end = rbuffers + count;
+    for (rb=rbuffers; rb<end; rb++) {
+        if ((result=deal_binlog_one_record(*rb)) != 0) {
             return result;
         }
 
-        server_binlog_release_rbuffer(rb);
-        node = node->next;
-    } while (node != NULL);
+        if (BINLOG_SYNC_POLICY == FDIR_BINLOG_SYNC_POLICY_PER_OP) {
+            binlog_submit_buffer();
+        }
+    }
 
-    return binlog_write_to_file();
+    return 0;
 }
 
 void binlog_write_thread_finish()
 {
-    struct common_blocked_node *node;
+    ServerBinlogRecordBuffer *rbuffers[BINLOG_CONSUMER_FETCH_BATCH];
     int count;
 
-    if (writer_queue != NULL) {
+    if (writer_consumer != NULL) {
         count = 0;
         while (write_thread_running && ++count < 100) {
             usleep(100 * 1000);
@@ -284,15 +1207,51 @@ void binlog_write_thread_finish()
                     "exit anyway!", __LINE__);
         }
 
-        node = common_blocked_queue_try_pop_all_nodes(writer_queue);
-        if (node != NULL) {
-            deal_binlog_records(node);
-            common_blocked_queue_free_all_nodes(writer_queue, node);
+        while ((count=binlog_consumer_fetch(writer_consumer, rbuffers,
+                        BINLOG_CONSUMER_FETCH_BATCH, false)) > 0)
+        {
+            if (deal_binlog_records(rbuffers, count) != 0) {
+                break;
+            }
+            binlog_consumer_advance(writer_consumer, count);
         }
-        writer_queue = NULL;
+        writer_consumer = NULL;
     }
 
+    if (writer_context.flush_running) {
+        binlog_submit_buffer();
+        binlog_wait_flush_done();
+
+        pthread_mutex_lock(&writer_context.lock);
+        writer_context.flush_running = false;
+        pthread_cond_broadcast(&writer_context.cond);
+        pthread_mutex_unlock(&writer_context.lock);
+        pthread_join(writer_context.flush_tid, NULL);
+    }
+
+    if (writer_context.next.running) {
+        pthread_mutex_lock(&writer_context.lock);
+        writer_context.next.running = false;
+        pthread_cond_broadcast(&writer_context.next.cond);
+        pthread_mutex_unlock(&writer_context.lock);
+        pthread_join(writer_context.next.tid, NULL);
+    }
+
+    if (writer_context.next.fd >= 0) {
+        close(writer_context.next.fd);  //reused by the next run
+        writer_context.next.fd = -1;
+        binlog_offset_index_close(&writer_context.next.index);
+    }
+    binlog_offset_index_close(&writer_context.index);
+
     if (writer_context.fd >= 0) {
+        //the offline tools read the file without the zero filled tail
+        if (ftruncate(writer_context.fd, writer_context.file_size) != 0) {
+            logWarning("file: "__FILE__", line: %d, "
+                    "truncate binlog file \"%s\" fail, "
+                    "errno: %d, error info: %s", __LINE__,
+                    writer_context.filename, errno, STRERROR(errno));
+        }
         close(writer_context.fd);
         writer_context.fd = -1;
     }
@@ -300,22 +1259,30 @@ void binlog_write_thread_finish()
 
 void *binlog_write_thread_func(void *arg)
 {
-    struct common_blocked_node *node;
+    ServerBinlogRecordBuffer *rbuffers[BINLOG_CONSUMER_FETCH_BATCH];
+    int count;
 
     write_thread_running = true;
-    writer_queue = &((ServerBinlogConsumerContext *)arg)->queue;
+    writer_consumer = (ServerBinlogConsumerContext *)arg;
     while (SF_G_CONTINUE_FLAG) {
-        node = common_blocked_queue_pop_all_nodes(writer_queue);
-        if (node == NULL) {
-            continue;
+        /* block only when nothing to submit, the records arrived
+           during the flush are appended to the current buffer */
+        count = binlog_consumer_fetch(writer_consumer, rbuffers,
+                BINLOG_CONSUMER_FETCH_BATCH,
+                writer_context.current->buffer.length == 0);
+        if (count > 0) {
+            if (deal_binlog_records(rbuffers, count) != 0) {
+                logCrit("file: "__FILE__", line: %d, "
+                        "deal_binlog_records fail, program exit!",
+                        __LINE__);
+                SF_G_CONTINUE_FLAG = false;
+            }
+            binlog_consumer_advance(writer_consumer, count);
         }
 
-        if (deal_binlog_records(node) != 0) {
-            logCrit("file: "__FILE__", line: %d, "
-                    "deal_binlog_records fail, program exit!", __LINE__);
-            SF_G_CONTINUE_FLAG = false;
+        if (count == 0 || binlog_flush_idle()) {
+            binlog_submit_buffer();
         }
-        common_blocked_queue_free_all_nodes(writer_queue, node);
     }
 
     write_thread_running = false;
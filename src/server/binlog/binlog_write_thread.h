@@ -4,11 +4,16 @@
 #define _BINLOG_WRITE_THREAD_H_
 
 #include "binlog_types.h"
+#include "binlog_offset_index.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* truncate the torn record at the tail of the current binlog file,
+   should be called before reading the binlog on startup */
+int binlog_write_thread_repair_tail();
+
 int binlog_write_thread_init();
 void binlog_write_thread_finish();
 
@@ -16,6 +21,30 @@ void *binlog_write_thread_func(void *arg);
 
 int binlog_get_current_write_index();
 
+//the first binlog file index, the files before it are compacted
+int binlog_get_first_write_index();
+
+//called by the compaction only
+int binlog_set_first_write_index(const int first_index);
+
+//the binlog files before it are compressed or skipped
+int binlog_get_compress_index();
+
+//called by the compress thread only
+int binlog_set_compress_index(const int compress_index);
+
+/* the size of the flushed records of the current binlog file which is
+   zero filled beyond them, return ENOENT for the other files */
+int binlog_write_thread_get_file_size(const int binlog_index,
+        int64_t *file_size);
+
+/* get the flushed records info of the current binlog file,
+   return ENOENT when the file is not the current one or empty */
+int binlog_write_thread_get_segment_info(const int binlog_index,
+        BinlogSegmentInfo *segment);
+
+void binlog_write_thread_get_sync_stat(ServerBinlogSyncStat *stat);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,40 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "fastcommon/logger.h"
+#include "bloom_filter.h"
+
+int bloom_filter_init(FDIRBloomFilter *filter, const int capacity)
+{
+    int64_t bit_count;
+    int bytes;
+
+    bit_count = 64;
+    while (bit_count < (int64_t)capacity *
+            FDIR_BLOOM_FILTER_BITS_PER_ELEMENT)
+    {
+        bit_count *= 2;
+    }
+
+    bytes = bit_count / 8;
+    filter->bits = (uint64_t *)calloc(1, bytes);
+    if (filter->bits == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "calloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+
+    filter->mask = bit_count - 1;
+    filter->capacity = capacity;
+    filter->count = 0;
+    filter->removed = 0;
+    return 0;
+}
+
+void bloom_filter_destroy(FDIRBloomFilter *filter)
+{
+    if (filter->bits != NULL) {
+        free(filter->bits);
+        filter->bits = NULL;
+    }
+}
@@ -0,0 +1,69 @@
+//bloom_filter.h
+
+#ifndef _FDIR_BLOOM_FILTER_H
+#define _FDIR_BLOOM_FILTER_H
+
+#include "fastcommon/common_define.h"
+
+#define FDIR_BLOOM_FILTER_HASH_COUNT        6
+#define FDIR_BLOOM_FILTER_BITS_PER_ELEMENT 10  //about 1% false positive
+
+/* the bloom filter never has false negative, the removed element
+   is NOT cleared, the filter should be rebuilt after many removals */
+typedef struct fdir_bloom_filter {
+    uint64_t *bits;
+    unsigned int mask;  //the bit count - 1, the bit count is power of 2
+    int capacity;       //the max element count for the false positive rate
+    int count;          //the added element count
+    int removed;        //the removed element count since the last build
+} FDIRBloomFilter;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    int bloom_filter_init(FDIRBloomFilter *filter, const int capacity);
+    void bloom_filter_destroy(FDIRBloomFilter *filter);
+
+    //the hash code: 32 bits h1 and 32 bits h2 for the double hashing
+    static inline void bloom_filter_add(FDIRBloomFilter *filter,
+            const uint64_t hash_code)
+    {
+        unsigned int h1;
+        unsigned int h2;
+        unsigned int bit;
+        int i;
+
+        h1 = (unsigned int)(hash_code >> 32);
+        h2 = (unsigned int)hash_code | 1;
+        for (i=0; i<FDIR_BLOOM_FILTER_HASH_COUNT; i++) {
+            bit = (h1 + i * h2) & filter->mask;
+            filter->bits[bit >> 6] |= (1ULL << (bit & 63));
+        }
+        filter->count++;
+    }
+
+    static inline bool bloom_filter_may_contain(const FDIRBloomFilter
+            *filter, const uint64_t hash_code)
+    {
+        unsigned int h1;
+        unsigned int h2;
+        unsigned int bit;
+        int i;
+
+        h1 = (unsigned int)(hash_code >> 32);
+        h2 = (unsigned int)hash_code | 1;
+        for (i=0; i<FDIR_BLOOM_FILTER_HASH_COUNT; i++) {
+            bit = (h1 + i * h2) & filter->mask;
+            if ((filter->bits[bit >> 6] & (1ULL << (bit & 63))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,6 +7,7 @@
 #include "fastcommon/shared_func.h"
 #include "fastcommon/logger.h"
 #include "fastcommon/hash.h"
+#include "common/fdir_func.h"
 #include "fastcommon/pthread_func.h"
 #include "fastcommon/sched_thread.h"
 #include "common/fdir_types.h"
@@ -83,6 +84,14 @@ void dentry_destroy()
 
 static int dentry_compare(const void *p1, const void *p2)
 {
+    uint64_t key1;
+    uint64_t key2;
+
+    key1 = ((FDIRServerDentry *)p1)->name_key;
+    key2 = ((FDIRServerDentry *)p2)->name_key;
+    if (key1 != key2) {
+        return key1 < key2 ? -1 : 1;
+    }
     return fc_string_compare(&((FDIRServerDentry *)p1)->name,
             &((FDIRServerDentry *)p2)->name);
 }
@@ -95,6 +104,11 @@ static void dentry_do_free(void *ptr)
     if (dentry->children != NULL) {
         uniq_skiplist_free(dentry->children);
     }
+    if (dentry->filter != NULL) {
+        bloom_filter_destroy(dentry->filter);
+        free(dentry->filter);
+        dentry->filter = NULL;
+    }
 
     fast_allocator_free(&dentry->context->name_acontext, dentry->name.str);
     fast_mblock_free_object(&dentry->context->dentry_allocator,
@@ -197,6 +211,7 @@ static FDIRNamespaceEntry *create_namespace(FDIRDentryContext *context,
         return NULL;
     }
     entry->dentry_root.stat.mode |= S_IFDIR;
+    entry->dentry_root.filter = NULL;
     entry->dentry_root.children = uniq_skiplist_new(&context->factory,
             INIT_LEVEL_COUNT);
     if (entry->dentry_root.children == NULL) {
@@ -269,6 +284,7 @@ static const FDIRServerDentry *dentry_find_ex(FDIRNamespaceEntry *ns_entry,
         }
 
         target.name = *p;
+        target.name_key = dentry_name_key(p);
         current = (FDIRServerDentry *)uniq_skiplist_find(
                 current->children, &target);
         if (current == NULL) {
@@ -279,11 +295,141 @@ static const FDIRServerDentry *dentry_find_ex(FDIRNamespaceEntry *ns_entry,
     return current;
 }
 
+#define DENTRY_STAT  context->server_context->stat
+
+static inline uint64_t dentry_filter_hash_code(const string_t *name)
+{
+    return ((uint64_t)fdir_crc32c_update(0xFFFFFFFF, name->str,
+                name->len) << 32) | (unsigned int)simple_hash(
+                name->str, name->len);
+}
+
+static void dentry_filter_free(void *ptr)
+{
+    bloom_filter_destroy((FDIRBloomFilter *)ptr);
+    free(ptr);
+}
+
+/* the filter is read by the other threads when finding the dentry,
+   so the old filter is freed delayed after the rebuilding.
+   the filter is built when the children count reaches the threshold,
+   and dropped when the children count is less than half of it */
+static int dentry_filter_build(FDIRDentryContext *context,
+        FDIRServerDentry *parent)
+{
+    FDIRServerDentry *current;
+    FDIRBloomFilter *filter;
+    FDIRBloomFilter *old;
+    UniqSkiplistIterator iterator;
+    int count;
+    int capacity;
+    int result;
+
+    count = uniq_skiplist_count(parent->children);
+    if (count < DENTRY_BLOOM_FILTER_THRESHOLD / 2) {
+        filter = NULL;
+    } else {
+        filter = (FDIRBloomFilter *)malloc(sizeof(FDIRBloomFilter));
+        if (filter == NULL) {
+            logError("file: "__FILE__", line: %d, "
+                    "malloc %d bytes fail", __LINE__,
+                    (int)sizeof(FDIRBloomFilter));
+            return ENOMEM;
+        }
+
+        capacity = 2 * (count > DENTRY_BLOOM_FILTER_THRESHOLD ?
+                count : DENTRY_BLOOM_FILTER_THRESHOLD);
+        if ((result=bloom_filter_init(filter, capacity)) != 0) {
+            free(filter);
+            return result;
+        }
+
+        uniq_skiplist_iterator(parent->children, &iterator);
+        while ((current=(FDIRServerDentry *)uniq_skiplist_next(
+                        &iterator)) != NULL)
+        {
+            bloom_filter_add(filter, dentry_filter_hash_code(
+                        &current->name));
+        }
+        DENTRY_STAT.bloom.rebuilds++;
+    }
+
+    old = parent->filter;
+    parent->filter = filter;
+    if (old != NULL) {
+        server_add_to_delay_free_queue(&context->server_context->
+                delay_free_context, old, dentry_filter_free,
+                delay_free_seconds);
+    }
+    return 0;
+}
+
+//called by the owner thread of the parent
+static inline void dentry_filter_on_insert(FDIRDentryContext *context,
+        FDIRServerDentry *parent, const string_t *name)
+{
+    if (DENTRY_BLOOM_FILTER_THRESHOLD <= 0) {
+        return;
+    }
+
+    if (parent->filter == NULL) {
+        if (uniq_skiplist_count(parent->children) >=
+                DENTRY_BLOOM_FILTER_THRESHOLD)
+        {
+            dentry_filter_build(context, parent);
+        }
+    } else if (parent->filter->count < parent->filter->capacity ||
+            dentry_filter_build(context, parent) != 0)
+    {
+        /* keep the old filter on build fail, the name MUST be added
+           to it for no false negative, rebuild on the next insert */
+        bloom_filter_add(parent->filter, dentry_filter_hash_code(name));
+    }
+}
+
+//rebuild lazily when the removed children are too many
+static inline void dentry_filter_on_remove(FDIRDentryContext *context,
+        FDIRServerDentry *parent)
+{
+    if (parent->filter != NULL && ++parent->filter->removed >
+            parent->filter->count / 2)
+    {
+        dentry_filter_build(context, parent);
+    }
+}
+
+//the filter short-circuits the lookup of the absent child
+static FDIRServerDentry *dentry_find_child(FDIRDentryContext *context,
+        FDIRServerDentry *parent, const string_t *name)
+{
+    FDIRServerDentry target;
+    FDIRServerDentry *child;
+    FDIRBloomFilter *filter;
+
+    if ((filter=parent->filter) != NULL) {
+        DENTRY_STAT.bloom.checks++;
+        if (!bloom_filter_may_contain(filter,
+                    dentry_filter_hash_code(name)))
+        {
+            DENTRY_STAT.bloom.negatives++;
+            return NULL;
+        }
+    }
+
+    target.name = *name;
+    target.name_key = dentry_name_key(name);
+    child = (FDIRServerDentry *)uniq_skiplist_find(
+            parent->children, &target);
+    if (child == NULL && filter != NULL) {
+        DENTRY_STAT.bloom.false_positives++;
+    }
+    return child;
+}
+
 static int dentry_find_parent_and_me(FDIRDentryContext *context,
         const FDIRPathInfo *path_info, string_t *my_name,
         FDIRServerDentry **parent, FDIRServerDentry **me, const bool create_ns)
 {
-    FDIRServerDentry target;
     FDIRNamespaceEntry *ns_entry;
     int result;
 
@@ -325,8 +471,72 @@ static int dentry_find_parent_and_me(FDIRDentryContext *context,
         }
     }
 
-    target.name = *my_name;
-    *me = (FDIRServerDentry *)uniq_skiplist_find((*parent)->children, &target);
+    *me = dentry_find_child(context, *parent, my_name);
+    return 0;
+}
+
+static int dentry_check_children_count(FDIRServerDentry *parent,
+        const string_t *parent_path)
+{
+    if (uniq_skiplist_count(parent->children) >= MAX_ENTRIES_PER_PATH) {
+        logError("file: "__FILE__", line: %d, "
+                "too many entries in path %.*s, exceed %d",
+                __LINE__, parent_path->len, parent_path->str,
+                MAX_ENTRIES_PER_PATH);
+        return ENOSPC;
+    }
+
+    return 0;
+}
+
+static int dentry_do_create(FDIRServerContext *server_context,
+        FDIRServerDentry *parent, const string_t *name,
+        const FDIRDEntryStatus *stat, const int64_t inode,
+        FDIRServerDentry **dentry)
+{
+    FDIRServerDentry *current;
+    int result;
+
+    current = (FDIRServerDentry *)fast_mblock_alloc_object(
+            &server_context->dentry_context.dentry_allocator);
+    if (current == NULL) {
+        return ENOMEM;
+    }
+
+    current->filter = NULL;
+    if ((stat->mode & S_IFDIR) == 0) {
+        current->children = NULL;
+    } else {
+        current->children = uniq_skiplist_new(&server_context->
+                dentry_context.factory, INIT_LEVEL_COUNT);
+        if (current->children == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    if ((result=dentry_strdup(&server_context->dentry_context,
+                    &current->name, name)) != 0)
+    {
+        return result;
+    }
+    current->name_key = dentry_name_key(&current->name);
+
+    if (inode == 0) {
+        current->inode = inode_generator_next();
+    } else {
+        current->inode = inode;
+    }
+    current->stat.mode = stat->mode;
+    current->stat.ctime = stat->ctime;
+    current->stat.mtime = stat->mtime;
+    current->stat.size = stat->size;
+    if ((result=uniq_skiplist_insert(parent->children, current)) != 0) {
+        return result;
+    }
+    dentry_filter_on_insert(&server_context->dentry_context,
+            parent, &current->name);
+
+    *dentry = current;
     return 0;
 }
 
@@ -363,57 +573,146 @@ int dentry_create(FDIRServerContext *server_context,
     }
 
     if (uniq_skiplist_count(parent->children) >= MAX_ENTRIES_PER_PATH) {
+        string_t parent_path;
         char *parent_end;
         parent_end = (char *)fc_memrchr(path_info->fullname.path.str, '/',
                 path_info->fullname.path.len);
-        logError("file: "__FILE__", line: %d, "
-                "too many entries in path %.*s, exceed %d",
-                __LINE__, (int)(parent_end - path_info->fullname.path.str),
-                path_info->fullname.path.str, MAX_ENTRIES_PER_PATH);
-        return ENOSPC;
+        FC_SET_STRING_EX(parent_path, path_info->fullname.path.str,
+                parent_end - path_info->fullname.path.str);
+        return dentry_check_children_count(parent, &parent_path);
     }
-    
-    current = (FDIRServerDentry *)fast_mblock_alloc_object(
-            &server_context->dentry_context.dentry_allocator);
-    if (current == NULL) {
-        return ENOMEM;
+
+    if ((result=dentry_do_create(server_context, parent, &my_name,
+                    &record->stat, record->inode, &current)) != 0)
+    {
+        return result;
     }
 
-    if ((record->stat.mode & S_IFDIR) == 0) {
-        current->children = NULL;
-    } else {
-        current->children = uniq_skiplist_new(&server_context->
-                dentry_context.factory, INIT_LEVEL_COUNT);
-        if (current->children == NULL) {
-            return ENOMEM;
-        }
+    if (record->inode == 0) {
+        record->inode = current->inode;
     }
+    return 0;
+}
 
-    if ((result=dentry_strdup(&server_context->dentry_context,
-                    &current->name, &my_name)) != 0)
+static int dentry_batch_entry_compare(const void *p1, const void *p2)
+{
+    return fc_string_compare(&((FDIRDentryBatchEntry *)p1)->name,
+            &((FDIRDentryBatchEntry *)p2)->name);
+}
+
+int dentry_batch_create(FDIRServerContext *server_context,
+        const FDIRPathInfo *parent_info, FDIRDentryBatchArray *array,
+        const FDIRDEntryStatus *stat)
+{
+    FDIRServerDentry *parent;
+    FDIRServerDentry *grandpa;
+    FDIRServerDentry *current;
+    FDIRDentryBatchEntry *entry;
+    FDIRDentryBatchEntry *end;
+    string_t parent_name;
+    int result;
+
+    if ((stat->mode & S_IFMT) == 0) {
+        logError("file: "__FILE__", line: %d, "
+                "invalid file mode: %d", __LINE__, stat->mode);
+        return EINVAL;
+    }
+
+    if ((result=dentry_find_parent_and_me(&server_context->dentry_context,
+                    parent_info, &parent_name, &grandpa, &parent, true)) != 0)
     {
         return result;
     }
+    if (parent == NULL) {
+        return ENOENT;
+    }
+    if ((parent->stat.mode & S_IFDIR) == 0) {
+        return ENOTDIR;
+    }
+    array->parent = parent;
 
-    if (record->inode == 0) {
-        current->inode = inode_generator_next();
-    } else {
-        current->inode = record->inode;
+    /* insert in name order so that the skiplist is walked forward
+       and the duplicate names in the request are adjacent */
+    qsort(array->entries, array->count, sizeof(FDIRDentryBatchEntry),
+            dentry_batch_entry_compare);
+
+    end = array->entries + array->count;
+    for (entry=array->entries; entry<end; entry++) {
+        if (entry->result != 0) {
+            continue;
+        }
+
+        if (entry > array->entries && fc_string_equal(&entry->name,
+                    &(entry - 1)->name))
+        {
+            entry->result = EEXIST;
+            continue;
+        }
+
+        if (dentry_find_child(&server_context->dentry_context,
+                    parent, &entry->name) != NULL)
+        {
+            entry->result = EEXIST;
+            continue;
+        }
+
+        if ((entry->result=dentry_check_children_count(parent,
+                        &parent_info->fullname.path)) != 0)
+        {
+            continue;
+        }
+
+        if ((entry->result=dentry_do_create(server_context, parent,
+                        &entry->name, stat, 0, &current)) == 0)
+        {
+            entry->inode = current->inode;
+        }
     }
-    current->stat.mode = record->stat.mode;
-    current->stat.ctime = record->stat.ctime;
-    current->stat.mtime = record->stat.mtime;
-    current->stat.size = record->stat.size;
-    if ((result=uniq_skiplist_insert(parent->children, current)) != 0) {
-        return result;
+
+    return 0;
+}
+
+static int dentry_do_remove(FDIRServerContext *server_context,
+        FDIRServerDentry *parent, FDIRServerDentry *current)
+{
+    int result;
+
+    if ((current->stat.mode & S_IFDIR) != 0) {
+        if (uniq_skiplist_count(current->children) > 0) {
+            return ENOTEMPTY;
+        }
     }
 
-    if (record->inode == 0) {
-        record->inode = current->inode;
+    if ((result=uniq_skiplist_delete(parent->children, current)) != 0) {
+        return result;
     }
+    dentry_filter_on_remove(&server_context->dentry_context, parent);
     return 0;
 }
 
+void dentry_batch_rollback(FDIRServerContext *server_context,
+        FDIRDentryBatchArray *array, FDIRDentryBatchEntry *start,
+        const int result)
+{
+    FDIRServerDentry *current;
+    FDIRDentryBatchEntry *entry;
+    FDIRDentryBatchEntry *end;
+
+    end = array->entries + array->count;
+    for (entry=start; entry<end; entry++) {
+        if (entry->result != 0) {
+            continue;
+        }
+
+        current = dentry_find_child(&server_context->dentry_context,
+                array->parent, &entry->name);
+        if (current != NULL && current->inode == entry->inode) {
+            dentry_do_remove(server_context, array->parent, current);
+        }
+        entry->result = result;
+    }
+}
+
 int dentry_remove(FDIRServerContext *server_context,
         const FDIRPathInfo *path_info, FDIRBinlogRecord *record)
 {
@@ -432,14 +731,8 @@ int dentry_remove(FDIRServerContext *server_context,
         return ENOENT;
     }
 
-    if ((current->stat.mode & S_IFDIR) != 0) {
-        if (uniq_skiplist_count(current->children) > 0) {
-            return ENOTEMPTY;
-        }
-    }
-
     record->inode = current->inode;
-    return uniq_skiplist_delete(parent->children, current);
+    return dentry_do_remove(server_context, parent, current);
 }
 
 int dentry_find(FDIRServerContext *server_context,
@@ -2,18 +2,22 @@
 #ifndef _FDIR_DENTRY_H
 #define _FDIR_DENTRY_H
 
+#include <string.h>
 #include "server_types.h"
 #include "binlog/binlog_types.h"
+#include "bloom_filter.h"
 
-#define MAX_ENTRIES_PER_PATH  (16 * 1024)
+#define MAX_ENTRIES_PER_PATH  FDIR_MAX_ENTRIES_PER_PATH
 
 typedef struct fdir_server_dentry {
     int64_t inode;
+    uint64_t name_key;  //the first 8 bytes of the name in big-endian
     string_t name;
     FDIRDEntryStatus stat;
     string_t user_data;      //user defined data
     FDIRDentryContext *context;
     UniqSkiplist *children;
+    FDIRBloomFilter *filter;  //the children filter of the large directory
 } FDIRServerDentry;
 
 #ifdef __cplusplus
@@ -29,6 +33,18 @@ extern "C" {
             const FDIRPathInfo *path_info,
             FDIRBinlogRecord *record, const int flags);
 
+    /* create the children of the parent path, each entry's result
+       is set to the errno, the entries will be sorted by name */
+    int dentry_batch_create(FDIRServerContext *server_context,
+            const FDIRPathInfo *parent_info, FDIRDentryBatchArray *array,
+            const FDIRDEntryStatus *stat);
+
+    /* remove the created entries from the start entry when their binlog
+       records can't be produced, the entry's result is set to result */
+    void dentry_batch_rollback(FDIRServerContext *server_context,
+            FDIRDentryBatchArray *array, FDIRDentryBatchEntry *start,
+            const int result);
+
     int dentry_remove(FDIRServerContext *server_context,
             const FDIRPathInfo *path_info,
             FDIRBinlogRecord *record);
@@ -40,6 +56,24 @@ extern "C" {
     int dentry_list(FDIRServerContext *server_context,
             const FDIRPathInfo *path_info, FDIRServerDentryArray *array);
 
+    /* the order of (name_key, name) is the same as the order of name,
+       so the name compare is only needed when the keys are equal */
+    static inline uint64_t dentry_name_key(const string_t *name)
+    {
+        unsigned char buff[8];
+        int len;
+
+        len = name->len < 8 ? name->len : 8;
+        memcpy(buff, name->str, len);
+        if (len < 8) {
+            memset(buff + len, 0, 8 - len);
+        }
+        return ((uint64_t)buff[0] << 56) | ((uint64_t)buff[1] << 48) |
+            ((uint64_t)buff[2] << 40) | ((uint64_t)buff[3] << 32) |
+            ((uint64_t)buff[4] << 24) | ((uint64_t)buff[5] << 16) |
+            ((uint64_t)buff[6] << 8) | (uint64_t)buff[7];
+    }
+
     static inline void dentry_array_free(FDIRServerDentryArray *array)
     {
         if (array->entries != NULL) {
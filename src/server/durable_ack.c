@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/pthread_func.h"
+#include "fastcommon/fast_mblock.h"
+#include "fastcommon/ioevent_loop.h"
+#include "sf/sf_global.h"
+#include "server_global.h"
+#include "durable_ack.h"
+
+typedef struct durable_ack_waiter {
+    struct fast_task_info *task;
+    int64_t task_version;  //for the task closed while waiting
+    int64_t data_version;
+    struct durable_ack_waiter *next;
+} DurableAckWaiter;
+
+typedef struct {
+    pthread_mutex_t lock;
+    DurableAckWaiter *head;
+    DurableAckWaiter *tail;
+    DurableAckWaiter *ready;  //synced, to be resumed by the work thread
+    struct nio_thread_data *thread_data;  //for waking up the work thread
+} DurableAckQueue;
+
+typedef struct {
+    volatile int64_t synced_data_version;
+    int count;
+    DurableAckQueue *queues;  //indexed by the work thread
+    struct fast_mblock_man allocator;
+} DurableAckContext;
+
+static DurableAckContext durable_ack_ctx;
+
+int durable_ack_init()
+{
+    DurableAckQueue *queue;
+    DurableAckQueue *end;
+    int bytes;
+    int result;
+
+    if (BINLOG_SYNC_POLICY == FDIR_BINLOG_SYNC_POLICY_NONE) {
+        return 0;
+    }
+
+    if ((result=fast_mblock_init_ex(&durable_ack_ctx.allocator,
+                    sizeof(DurableAckWaiter), 4096,
+                    NULL, NULL, true)) != 0)
+    {
+        return result;
+    }
+
+    durable_ack_ctx.count = g_sf_global_vars.work_threads;
+    bytes = sizeof(DurableAckQueue) * durable_ack_ctx.count;
+    durable_ack_ctx.queues = (DurableAckQueue *)malloc(bytes);
+    if (durable_ack_ctx.queues == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+
+    end = durable_ack_ctx.queues + durable_ack_ctx.count;
+    for (queue=durable_ack_ctx.queues; queue<end; queue++) {
+        if ((result=init_pthread_lock(&queue->lock)) != 0) {
+            return result;
+        }
+        queue->head = queue->tail = NULL;
+        queue->ready = NULL;
+        queue->thread_data = NULL;
+    }
+
+    return 0;
+}
+
+void durable_ack_destroy()
+{
+    DurableAckQueue *queue;
+    DurableAckQueue *end;
+
+    if (durable_ack_ctx.queues == NULL) {
+        return;
+    }
+
+    end = durable_ack_ctx.queues + durable_ack_ctx.count;
+    for (queue=durable_ack_ctx.queues; queue<end; queue++) {
+        pthread_mutex_destroy(&queue->lock);
+    }
+    free(durable_ack_ctx.queues);
+    durable_ack_ctx.queues = NULL;
+    fast_mblock_destroy(&durable_ack_ctx.allocator);
+}
+
+int durable_ack_hold(const int thread_index,
+        struct fast_task_info *task, const int64_t data_version)
+{
+    DurableAckQueue *queue;
+    DurableAckWaiter *waiter;
+
+    waiter = (DurableAckWaiter *)fast_mblock_alloc_object(
+            &durable_ack_ctx.allocator);
+    if (waiter == NULL) {
+        return ENOMEM;
+    }
+
+    waiter->task = task;
+    waiter->task_version = __sync_add_and_fetch(
+            &((FDIRServerTaskArg *)task->arg)->task_version, 0);
+    waiter->data_version = data_version;
+    waiter->next = NULL;
+
+    /* the synced version MUST be checked in the lock, the notifier
+       updates it before taking the lock */
+    queue = durable_ack_ctx.queues + thread_index;
+    pthread_mutex_lock(&queue->lock);
+    if (data_version <= __sync_add_and_fetch(&durable_ack_ctx.
+                synced_data_version, 0))
+    {
+        pthread_mutex_unlock(&queue->lock);
+        fast_mblock_free_object(&durable_ack_ctx.allocator, waiter);
+        return EALREADY;
+    }
+
+    if (queue->tail == NULL) {
+        queue->head = waiter;
+    } else {
+        queue->tail->next = waiter;
+    }
+    queue->tail = waiter;
+    queue->thread_data = task->thread_data;
+    pthread_mutex_unlock(&queue->lock);
+
+    return 0;
+}
+
+void durable_ack_notify(const int64_t synced_data_version)
+{
+    DurableAckQueue *queue;
+    DurableAckQueue *end;
+    DurableAckWaiter *waiter;
+    DurableAckWaiter *previous;
+    DurableAckWaiter *next;
+    struct nio_thread_data *thread_data;
+
+    if (durable_ack_ctx.queues == NULL || synced_data_version <=
+            durable_ack_ctx.synced_data_version)
+    {
+        return;
+    }
+
+    //only the binlog write thread updates the synced version
+    durable_ack_ctx.synced_data_version = synced_data_version;
+    __sync_synchronize();
+
+    /* the task is NOT touched here because it may be closed and reused
+       at any time, the work thread owned it validates and resumes it */
+    end = durable_ack_ctx.queues + durable_ack_ctx.count;
+    for (queue=durable_ack_ctx.queues; queue<end; queue++) {
+        thread_data = NULL;
+        pthread_mutex_lock(&queue->lock);
+        previous = NULL;
+        waiter = queue->head;
+        while (waiter != NULL) {
+            next = waiter->next;
+            if (waiter->data_version <= synced_data_version) {
+                if (previous == NULL) {
+                    queue->head = next;
+                } else {
+                    previous->next = next;
+                }
+                if (queue->tail == waiter) {
+                    queue->tail = previous;
+                }
+
+                waiter->next = queue->ready;
+                queue->ready = waiter;
+                thread_data = queue->thread_data;
+            } else {
+                previous = waiter;
+            }
+            waiter = next;
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        /* wake up the idle work thread for the ready tasks, otherwise
+           they wait for the ioevent timeout until its next loop */
+        if (thread_data != NULL) {
+            ioevent_notify_thread(thread_data);
+        }
+    }
+}
+
+void durable_ack_deal_ready(const int thread_index,
+        durable_ack_resume_func resume_func)
+{
+    DurableAckQueue *queue;
+    DurableAckWaiter *head;
+    DurableAckWaiter *waiter;
+    FDIRServerTaskArg *task_arg;
+
+    if (durable_ack_ctx.queues == NULL) {
+        return;
+    }
+
+    queue = durable_ack_ctx.queues + thread_index;
+    if (queue->ready == NULL) {  //check without lock for the most cases
+        return;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    head = queue->ready;
+    queue->ready = NULL;
+    pthread_mutex_unlock(&queue->lock);
+
+    while (head != NULL) {
+        /* the task is closed (and maybe reused) by this thread only,
+           so the task version can NOT change during the check */
+        task_arg = (FDIRServerTaskArg *)head->task->arg;
+        if (head->task_version == task_arg->task_version &&
+                task_arg->durable_ack.waiting)
+        {
+            resume_func(head->task);
+        }
+
+        waiter = head;
+        head = head->next;
+        fast_mblock_free_object(&durable_ack_ctx.allocator, waiter);
+    }
+}
@@ -0,0 +1,37 @@
+//durable_ack.h
+
+#ifndef _FDIR_DURABLE_ACK_H
+#define _FDIR_DURABLE_ACK_H
+
+#include "fastcommon/fast_task_queue.h"
+#include "server_types.h"
+
+typedef int (*durable_ack_resume_func)(struct fast_task_info *task);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    int durable_ack_init();
+    void durable_ack_destroy();
+
+    /* hold the response of the task until the binlog is synced to
+       the data version, the task is resumed by the thread then.
+       return 0 for held, EALREADY when the data version is synced */
+    int durable_ack_hold(const int thread_index,
+            struct fast_task_info *task, const int64_t data_version);
+
+    /* called by the binlog write thread after fsync, the work threads
+       with the synced tasks are notified to resume them */
+    void durable_ack_notify(const int64_t synced_data_version);
+
+    /* called by the work thread in its loop, resume the synced tasks
+       which are still waiting (not closed) */
+    void durable_ack_deal_ready(const int thread_index,
+            durable_ack_resume_func resume_func);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
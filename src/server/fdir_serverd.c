@@ -32,6 +32,9 @@
 #include "inode_generator.h"
 #include "server_binlog.h"
 #include "server_handler.h"
+#include "access_log.h"
+#include "request_trace.h"
+#include "durable_ack.h"
 
 static bool daemon_mode = true;
 static int setup_server_env(const char *config_filename);
@@ -101,6 +104,15 @@ int main(int argc, char *argv[])
     r = server_handler_init();
     gofailif(r, "server handler init error");
 
+    r = access_log_init();
+    gofailif(r, "access log init error");
+
+    r = request_trace_init();
+    gofailif(r, "request trace init error");
+
+    r = durable_ack_init();
+    gofailif(r, "durable ack init error");
+
     fdir_proto_init();
 
     r = cluster_top_init();
@@ -138,6 +150,9 @@ int main(int argc, char *argv[])
     inode_generator_destroy();
     server_binlog_terminate();
     sf_service_destroy();
+    access_log_terminate();
+    request_trace_destroy();
+    durable_ack_destroy();
     delete_pid_file(g_pid_filename);
     logInfo("file: "__FILE__", line: %d, "
             "program exit normally.\n", __LINE__);
@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <string.h>
+#include "fastcommon/logger.h"
+#include "latency_stat.h"
+
+void latency_stat_add(FDIRLatencyStat *stat, const unsigned char cmd,
+        const int status, const int64_t time_used,
+        const bool forwarded, const int64_t forwarded_time_used)
+{
+    FDIRCmdLatencyStat *cmd_stat;
+    int index;
+
+    if ((cmd_stat=stat->cmds[cmd]) == NULL) {
+        cmd_stat = (FDIRCmdLatencyStat *)calloc(1,
+                sizeof(FDIRCmdLatencyStat));
+        if (cmd_stat == NULL) {
+            logError("file: "__FILE__", line: %d, "
+                    "calloc %d bytes fail", __LINE__,
+                    (int)sizeof(FDIRCmdLatencyStat));
+            return;
+        }
+        __sync_synchronize();
+        stat->cmds[cmd] = cmd_stat;
+    }
+
+    latency_histogram_add(&cmd_stat->total, time_used);
+    if (forwarded) {
+        latency_histogram_add(&cmd_stat->forwarded, forwarded_time_used);
+    }
+
+    if (status != 0) {
+        cmd_stat->errors++;
+        index = (status > 0 && status < FDIR_LATENCY_STATUS_COUNT) ?
+            status : FDIR_LATENCY_STATUS_COUNT - 1;
+        stat->status_counts[index]++;
+    }
+}
+
+void latency_histogram_merge(FDIRLatencyHistogram *dest,
+        const FDIRLatencyHistogram *src)
+{
+    int i;
+
+    if (src->count == 0) {
+        return;
+    }
+
+    for (i=0; i<FDIR_LATENCY_BUCKET_COUNT; i++) {
+        dest->buckets[i] += src->buckets[i];
+    }
+    dest->count += src->count;
+    if (src->max > dest->max) {
+        dest->max = src->max;
+    }
+}
+
+int64_t latency_histogram_percentile(const FDIRLatencyHistogram *h,
+        const double percent)
+{
+    int64_t target;
+    int64_t count;
+    int64_t upper;
+    int i;
+
+    if (h->count == 0) {
+        return 0;
+    }
+
+    target = (int64_t)(h->count * percent / 100.00 + 0.5);
+    if (target < 1) {
+        target = 1;
+    }
+
+    count = 0;
+    for (i=0; i<FDIR_LATENCY_BUCKET_COUNT; i++) {
+        count += h->buckets[i];
+        if (count >= target) {
+            upper = latency_stat_bucket_upper(i);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+
+    return h->max;
+}
@@ -0,0 +1,100 @@
+//latency_stat.h
+
+#ifndef _FDIR_LATENCY_STAT_H
+#define _FDIR_LATENCY_STAT_H
+
+#include "fastcommon/common_define.h"
+
+/* log-linear buckets in microseconds: the values less than 8 have their
+   own buckets, the others are split into 8 linear sub buckets per power
+   of 2, so the relative error is less than 12.5% */
+#define FDIR_LATENCY_SUB_BUCKET_BITS   3
+#define FDIR_LATENCY_SUB_BUCKET_COUNT  (1 << FDIR_LATENCY_SUB_BUCKET_BITS)
+#define FDIR_LATENCY_BUCKET_COUNT      256
+#define FDIR_LATENCY_CMD_COUNT         256
+#define FDIR_LATENCY_STATUS_COUNT      256  //the last for the larger status
+
+typedef struct fdir_latency_histogram {
+    int64_t count;
+    int64_t max;
+    int64_t buckets[FDIR_LATENCY_BUCKET_COUNT];
+} FDIRLatencyHistogram;
+
+typedef struct fdir_cmd_latency_stat {
+    int64_t errors;
+    FDIRLatencyHistogram total;
+    FDIRLatencyHistogram forwarded;  //the time waiting in forwarding
+} FDIRCmdLatencyStat;
+
+//per work thread, only written by the owner thread
+typedef struct fdir_latency_stat {
+    FDIRCmdLatencyStat *cmds[FDIR_LATENCY_CMD_COUNT];  //alloc on demand
+    int64_t status_counts[FDIR_LATENCY_STATUS_COUNT];
+} FDIRLatencyStat;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void latency_stat_add(FDIRLatencyStat *stat, const unsigned char cmd,
+            const int status, const int64_t time_used,
+            const bool forwarded, const int64_t forwarded_time_used);
+
+    void latency_histogram_merge(FDIRLatencyHistogram *dest,
+            const FDIRLatencyHistogram *src);
+
+    //percent such as 50.0, 99.0 and 99.9
+    int64_t latency_histogram_percentile(const FDIRLatencyHistogram *h,
+            const double percent);
+
+    static inline int latency_stat_bucket(const int64_t value)
+    {
+        int bits;
+        int bucket;
+
+        if (value < FDIR_LATENCY_SUB_BUCKET_COUNT) {
+            return value > 0 ? value : 0;
+        }
+
+        bits = 63 - __builtin_clzll(value);
+        bucket = (bits - FDIR_LATENCY_SUB_BUCKET_BITS + 1) *
+            FDIR_LATENCY_SUB_BUCKET_COUNT + ((value >> (bits -
+                            FDIR_LATENCY_SUB_BUCKET_BITS)) &
+                    (FDIR_LATENCY_SUB_BUCKET_COUNT - 1));
+        return bucket < FDIR_LATENCY_BUCKET_COUNT ? bucket :
+            FDIR_LATENCY_BUCKET_COUNT - 1;
+    }
+
+    //the max value of the bucket
+    static inline int64_t latency_stat_bucket_upper(const int bucket)
+    {
+        int bits;
+        int64_t base;
+
+        if (bucket < FDIR_LATENCY_SUB_BUCKET_COUNT) {
+            return bucket;
+        }
+
+        bits = bucket / FDIR_LATENCY_SUB_BUCKET_COUNT +
+            FDIR_LATENCY_SUB_BUCKET_BITS - 1;
+        base = (int64_t)(FDIR_LATENCY_SUB_BUCKET_COUNT + bucket %
+                FDIR_LATENCY_SUB_BUCKET_COUNT) << (bits -
+                    FDIR_LATENCY_SUB_BUCKET_BITS);
+        return base + (1LL << (bits - FDIR_LATENCY_SUB_BUCKET_BITS)) - 1;
+    }
+
+    static inline void latency_histogram_add(FDIRLatencyHistogram *h,
+            const int64_t value)
+    {
+        h->buckets[latency_stat_bucket(value)]++;
+        h->count++;
+        if (value > h->max) {
+            h->max = value;
+        }
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
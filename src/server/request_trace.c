@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/pthread_func.h"
+#include "server_global.h"
+#include "request_trace.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    int size;
+    int count;
+    int next;   //the index to write
+    FDIRSlowTraceEntry *entries;
+} FDIRSlowTraceRing;
+
+static FDIRSlowTraceRing slow_trace_ring;
+
+int request_trace_init()
+{
+    int bytes;
+    int result;
+
+    if (!SLOW_TRACE_ENABLED) {
+        return 0;
+    }
+
+    if ((result=init_pthread_lock(&slow_trace_ring.lock)) != 0) {
+        return result;
+    }
+
+    slow_trace_ring.size = SLOW_TRACE_RING_SIZE;
+    bytes = sizeof(FDIRSlowTraceEntry) * slow_trace_ring.size;
+    slow_trace_ring.entries = (FDIRSlowTraceEntry *)malloc(bytes);
+    if (slow_trace_ring.entries == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+
+    return 0;
+}
+
+void request_trace_destroy()
+{
+    if (slow_trace_ring.entries != NULL) {
+        free(slow_trace_ring.entries);
+        slow_trace_ring.entries = NULL;
+        pthread_mutex_destroy(&slow_trace_ring.lock);
+    }
+}
+
+static inline int request_trace_elapsed(const int64_t end,
+        const int64_t start)
+{
+    return end > start ? (int)(end - start) : 0;
+}
+
+void request_trace_add(FDIRSlowTraceEntry *entry,
+        const int64_t req_start_time, const int64_t forwarded_time_used,
+        const FDIRRequestStages *stages)
+{
+    int64_t last;
+    const int64_t *ts;
+
+    ts = stages->timestamps;
+    last = req_start_time;
+    entry->total = entry->parse = entry->execute = 0;
+    entry->binlog = entry->send = 0;
+    if (ts[FDIR_TRACE_STAGE_PARSED] > 0) {
+        entry->parse = request_trace_elapsed(
+                ts[FDIR_TRACE_STAGE_PARSED], last);
+        last = ts[FDIR_TRACE_STAGE_PARSED];
+    }
+
+    entry->forward = forwarded_time_used;
+    last += forwarded_time_used;
+    if (ts[FDIR_TRACE_STAGE_EXECUTED] > 0) {
+        entry->execute = request_trace_elapsed(
+                ts[FDIR_TRACE_STAGE_EXECUTED], last);
+        last = ts[FDIR_TRACE_STAGE_EXECUTED];
+    }
+    if (ts[FDIR_TRACE_STAGE_BINLOG] > 0) {
+        entry->binlog = request_trace_elapsed(
+                ts[FDIR_TRACE_STAGE_BINLOG], last);
+        last = ts[FDIR_TRACE_STAGE_BINLOG];
+    }
+    if (ts[FDIR_TRACE_STAGE_SENT] > 0) {
+        entry->send = request_trace_elapsed(ts[FDIR_TRACE_STAGE_SENT], last);
+        entry->total = request_trace_elapsed(ts[FDIR_TRACE_STAGE_SENT],
+                req_start_time);
+    }
+    entry->time_us = req_start_time;
+    entry->sampled = stages->sampled;
+
+    if (slow_trace_ring.entries == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&slow_trace_ring.lock);
+    slow_trace_ring.entries[slow_trace_ring.next] = *entry;
+    slow_trace_ring.next = (slow_trace_ring.next + 1) % slow_trace_ring.size;
+    if (slow_trace_ring.count < slow_trace_ring.size) {
+        slow_trace_ring.count++;
+    }
+    pthread_mutex_unlock(&slow_trace_ring.lock);
+}
+
+int request_trace_fetch(FDIRSlowTraceEntry *entries, const int size)
+{
+    int count;
+    int index;
+    int i;
+
+    if (slow_trace_ring.entries == NULL || size <= 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&slow_trace_ring.lock);
+    count = slow_trace_ring.count < size ? slow_trace_ring.count : size;
+    index = slow_trace_ring.next;
+    for (i=0; i<count; i++) {
+        index = (index - 1 + slow_trace_ring.size) % slow_trace_ring.size;
+        entries[i] = slow_trace_ring.entries[index];
+    }
+    pthread_mutex_unlock(&slow_trace_ring.lock);
+
+    return count;
+}
@@ -0,0 +1,61 @@
+//request_trace.h
+
+#ifndef _FDIR_REQUEST_TRACE_H
+#define _FDIR_REQUEST_TRACE_H
+
+#include "fastcommon/common_define.h"
+
+#define FDIR_SLOW_TRACE_DEFAULT_THRESHOLD_MS   50
+#define FDIR_SLOW_TRACE_DEFAULT_RING_SIZE    1024
+
+//the stages of a request, the timestamp 0 means not reached
+#define FDIR_TRACE_STAGE_PARSED    0  //the request is parsed
+#define FDIR_TRACE_STAGE_EXECUTED  1  //the dentry operation is done
+#define FDIR_TRACE_STAGE_BINLOG    2  //the binlog is dispatched
+#define FDIR_TRACE_STAGE_SENT      3  //the response is queued to send
+#define FDIR_TRACE_STAGE_COUNT     4
+
+typedef struct fdir_request_stages {
+    bool sampled;
+    int64_t timestamps[FDIR_TRACE_STAGE_COUNT];  //in microseconds
+} FDIRRequestStages;
+
+//the time used of each stage in microseconds
+typedef struct fdir_slow_trace_entry {
+    int64_t time_us;  //the request start time
+    int total;
+    int parse;
+    int forward;      //waiting in forwarding
+    int execute;
+    int binlog;       //pack and wait for the binlog dispatch order
+    int send;
+    int req_body_len;
+    short status;
+    short thread_index;
+    unsigned char cmd;
+    bool sampled;
+    bool forwarded;
+    char client_ip[IP_ADDRESS_SIZE];
+} FDIRSlowTraceEntry;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    int request_trace_init();
+    void request_trace_destroy();
+
+    /* calculate the stage time used and push to the slow trace ring,
+       the oldest entry is overwritten when the ring is full */
+    void request_trace_add(FDIRSlowTraceEntry *entry,
+            const int64_t req_start_time, const int64_t forwarded_time_used,
+            const FDIRRequestStages *stages);
+
+    //fetch the latest entries, newest first, return the entry count
+    int request_trace_fetch(FDIRSlowTraceEntry *entries, const int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
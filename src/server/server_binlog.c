@@ -18,6 +18,9 @@
 #include "binlog/binlog_producer.h"
 #include "binlog/binlog_consumer.h"
 #include "binlog/binlog_write_thread.h"
+#include "binlog/binlog_compact.h"
+#include "binlog/binlog_compress.h"
+#include "binlog/binlog_tail_cache.h"
 #include "server_global.h"
 #include "server_binlog.h"
 
@@ -28,6 +31,12 @@ int server_binlog_init()
     if ((result=binlog_pack_init()) != 0) {
         return result;
     }
+    if ((result=binlog_write_thread_repair_tail()) != 0) {
+        return result;
+    }
+    if ((result=binlog_tail_cache_init()) != 0) {
+        return result;
+    }
     if ((result=binlog_producer_init()) != 0) {
         return result;
     }
@@ -36,17 +45,27 @@ int server_binlog_init()
         return result;
     }
 
+    if ((result=binlog_compact_init()) != 0) {
+        return result;
+    }
+
+    if ((result=binlog_compress_init()) != 0) {
+        return result;
+    }
+
 	return 0;
 }
 
 void server_binlog_destroy()
 {
-    binlog_producer_destroy();
     binlog_consumer_destroy();
+    binlog_producer_destroy();
+    binlog_tail_cache_destroy();
 }
  
 void server_binlog_terminate()
 {
     binlog_consumer_terminate();
     binlog_write_thread_finish();
+    binlog_compress_finish();
 }
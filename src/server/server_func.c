@@ -11,6 +11,9 @@
 #include "sf/sf_service.h"
 #include "server_global.h"
 #include "cluster_topology.h"
+#include "access_log.h"
+#include "request_trace.h"
+#include "binlog/binlog_compress.h"
 #include "server_func.h"
 
 static int server_load_admin_config(IniContext *ini_context)
@@ -404,12 +407,186 @@ FDIRClusterServerInfo *fdir_get_server_by_id(const int server_id)
             FC_SID_SERVERS(CLUSTER_CONFIG_CTX));
 }
 
+static int load_binlog_index_interval(IniContext *ini_context,
+        const char *filename)
+{
+    char *binlog_index_interval;
+    int64_t bytes;
+    int result;
+
+    binlog_index_interval = iniGetStrValue(NULL,
+            "binlog_index_interval", ini_context);
+    if (binlog_index_interval == NULL || *binlog_index_interval == '\0') {
+        bytes = FDIR_DEFAULT_BINLOG_INDEX_INTERVAL;
+    } else if ((result=parse_bytes(binlog_index_interval,
+                    1, &bytes)) != 0)
+    {
+        return result;
+    }
+
+    if (bytes < 0 || bytes > INT32_MAX) {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s , invalid binlog_index_interval: %"
+                PRId64, __LINE__, filename, bytes);
+        return EINVAL;
+    }
+
+    BINLOG_INDEX_INTERVAL = bytes;
+    return 0;
+}
+
+static int load_binlog_tail_cache_size(IniContext *ini_context,
+        const char *filename)
+{
+    char *binlog_tail_cache_size;
+    int64_t bytes;
+    int result;
+
+    binlog_tail_cache_size = iniGetStrValue(NULL,
+            "binlog_tail_cache_size", ini_context);
+    if (binlog_tail_cache_size == NULL || *binlog_tail_cache_size == '\0') {
+        bytes = FDIR_DEFAULT_BINLOG_TAIL_CACHE_SIZE;
+    } else if ((result=parse_bytes(binlog_tail_cache_size,
+                    1, &bytes)) != 0)
+    {
+        return result;
+    }
+
+    if (bytes < 0 || bytes > INT32_MAX) {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s , invalid binlog_tail_cache_size: %"
+                PRId64, __LINE__, filename, bytes);
+        return EINVAL;
+    }
+
+    BINLOG_TAIL_CACHE_SIZE = bytes;
+    return 0;
+}
+
+static int load_access_log_rotate_size(IniContext *ini_context,
+        const char *filename)
+{
+    char *rotate_size;
+    int result;
+
+    rotate_size = iniGetStrValue(NULL, "access_log_rotate_size", ini_context);
+    if (rotate_size == NULL || *rotate_size == '\0') {
+        ACCESS_LOG_ROTATE_SIZE = FDIR_ACCESS_LOG_DEFAULT_ROTATE_SIZE;
+    } else if ((result=parse_bytes(rotate_size, 1,
+                    &ACCESS_LOG_ROTATE_SIZE)) != 0)
+    {
+        return result;
+    }
+
+    if (ACCESS_LOG_ROTATE_SIZE < 0) {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s , invalid access_log_rotate_size: %"
+                PRId64, __LINE__, filename, ACCESS_LOG_ROTATE_SIZE);
+        return EINVAL;
+    }
+    return 0;
+}
+
+static int load_binlog_compress_config(IniContext *ini_context,
+        const char *filename)
+{
+    char *codec;
+    char *block_size;
+    int64_t bytes;
+    int result;
+
+    codec = iniGetStrValue(NULL, "binlog_compress", ini_context);
+    if (codec == NULL || *codec == '\0' || strcasecmp(codec, "none") == 0) {
+        BINLOG_COMPRESS.codec = FDIR_BINLOG_COMPRESS_NONE;
+    } else if (strcasecmp(codec, "zlib") == 0) {
+        BINLOG_COMPRESS.codec = FDIR_BINLOG_COMPRESS_ZLIB;
+    } else if (strcasecmp(codec, "lz4") == 0) {
+        BINLOG_COMPRESS.codec = FDIR_BINLOG_COMPRESS_LZ4;
+    } else {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s , invalid binlog_compress: %s, "
+                "expect none, zlib or lz4", __LINE__, filename, codec);
+        return EINVAL;
+    }
+    if (binlog_compress_check_codec(BINLOG_COMPRESS.codec) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s , binlog_compress: %s is not "
+                "supported by this build", __LINE__, filename, codec);
+        return ENOTSUP;
+    }
+
+    block_size = iniGetStrValue(NULL, "binlog_compress_block_size",
+            ini_context);
+    if (block_size == NULL || *block_size == '\0') {
+        bytes = FDIR_DEFAULT_BINLOG_COMPRESS_BLOCK_SIZE;
+    } else if ((result=parse_bytes(block_size, 1, &bytes)) != 0) {
+        return result;
+    }
+    if (bytes < 4 * 1024 || bytes > 64 * 1024 * 1024) {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s , binlog_compress_block_size: %"PRId64
+                " is out of range [4KB, 64MB]", __LINE__, filename, bytes);
+        return EINVAL;
+    }
+
+    BINLOG_COMPRESS.block_size = bytes;
+    return 0;
+}
+
+static int load_binlog_retention_config(IniContext *ini_context,
+        const char *filename)
+{
+    char *retention_bytes;
+    int result;
+
+    retention_bytes = iniGetStrValue(NULL,
+            "binlog_retention_bytes", ini_context);
+    if (retention_bytes == NULL || *retention_bytes == '\0') {
+        BINLOG_RETENTION.bytes = 0;
+    } else if ((result=parse_bytes(retention_bytes, 1,
+                    &BINLOG_RETENTION.bytes)) != 0)
+    {
+        return result;
+    }
+
+    BINLOG_RETENTION.versions = iniGetInt64Value(NULL,
+            "binlog_retention_versions", ini_context, 0);
+    if (BINLOG_RETENTION.bytes < 0 || BINLOG_RETENTION.versions < 0) {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s , binlog_retention_bytes: %"PRId64
+                " or binlog_retention_versions: %"PRId64" < 0",
+                __LINE__, filename, BINLOG_RETENTION.bytes,
+                BINLOG_RETENTION.versions);
+        return EINVAL;
+    }
+
+    BINLOG_RETENTION.compact_interval = iniGetIntValue(NULL,
+            "binlog_compact_interval", ini_context, 300);
+    BINLOG_RETENTION.archive = iniGetBoolValue(NULL,
+            "binlog_compact_archive", ini_context, true);
+    return 0;
+}
+
+static const char *get_binlog_sync_policy_caption(const int policy)
+{
+    switch (policy) {
+        case FDIR_BINLOG_SYNC_POLICY_GROUP:
+            return "group";
+        case FDIR_BINLOG_SYNC_POLICY_PER_OP:
+            return "per_op";
+        default:
+            return "none";
+    }
+}
+
 int server_load_config(const char *filename)
 {
     IniContext ini_context;
-    char server_config_str[1024];
+    char server_config_str[2048];
     SFCustomConfig cluster_cfg;
     SFCustomConfig service_cfg;
+    char *binlog_format;
+    char *binlog_sync_policy;
     int result;
 
     memset(&ini_context, 0, sizeof(IniContext));
@@ -456,6 +633,54 @@ int server_load_config(const char *filename)
         BINLOG_BUFFER_SIZE = g_sf_global_vars.max_buff_size;
     }
 
+    binlog_format = iniGetStrValue(NULL, "binlog_format", &ini_context);
+    if (binlog_format == NULL || *binlog_format == '\0' ||
+            strcasecmp(binlog_format, "text") == 0)
+    {
+        BINLOG_FORMAT = FDIR_BINLOG_FORMAT_TEXT;
+    } else if (strcasecmp(binlog_format, "binary") == 0) {
+        BINLOG_FORMAT = FDIR_BINLOG_FORMAT_BINARY;
+    } else {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s , invalid binlog_format: %s, "
+                "expect text or binary", __LINE__, filename, binlog_format);
+        return EINVAL;
+    }
+
+    binlog_sync_policy = iniGetStrValue(NULL, "binlog_sync_policy",
+            &ini_context);
+    if (binlog_sync_policy == NULL || *binlog_sync_policy == '\0' ||
+            strcasecmp(binlog_sync_policy, "none") == 0)
+    {
+        BINLOG_SYNC_POLICY = FDIR_BINLOG_SYNC_POLICY_NONE;
+    } else if (strcasecmp(binlog_sync_policy, "group") == 0) {
+        BINLOG_SYNC_POLICY = FDIR_BINLOG_SYNC_POLICY_GROUP;
+    } else if (strcasecmp(binlog_sync_policy, "per_op") == 0) {
+        BINLOG_SYNC_POLICY = FDIR_BINLOG_SYNC_POLICY_PER_OP;
+    } else {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s , invalid binlog_sync_policy: %s, "
+                "expect none, group or per_op", __LINE__, filename,
+                binlog_sync_policy);
+        return EINVAL;
+    }
+
+    if ((result=load_binlog_index_interval(&ini_context, filename)) != 0) {
+        return result;
+    }
+
+    if ((result=load_binlog_tail_cache_size(&ini_context, filename)) != 0) {
+        return result;
+    }
+
+    if ((result=load_binlog_compress_config(&ini_context, filename)) != 0) {
+        return result;
+    }
+
+    if ((result=load_binlog_retention_config(&ini_context, filename)) != 0) {
+        return result;
+    }
+
     g_server_global_vars.reload_interval_ms = iniGetIntValue(NULL,
             "reload_interval_ms", &ini_context,
             FDIR_SERVER_DEFAULT_RELOAD_INTERVAL);
@@ -472,6 +697,47 @@ int server_load_config(const char *filename)
             FDIR_SERVER_DEFAULT_CHECK_ALIVE_INTERVAL;
     }
 
+    ACCESS_LOG_ENABLED = iniGetBoolValue(NULL, "access_log_enabled",
+            &ini_context, false);
+    ACCESS_LOG_RING_SIZE = iniGetIntValue(NULL, "access_log_ring_size",
+            &ini_context, FDIR_ACCESS_LOG_DEFAULT_RING_SIZE);
+    if (ACCESS_LOG_RING_SIZE <= 0) {
+        ACCESS_LOG_RING_SIZE = FDIR_ACCESS_LOG_DEFAULT_RING_SIZE;
+    }
+    ACCESS_LOG_FLUSH_INTERVAL_MS = iniGetIntValue(NULL,
+            "access_log_flush_interval_ms", &ini_context,
+            FDIR_ACCESS_LOG_DEFAULT_FLUSH_INTERVAL_MS);
+    if (ACCESS_LOG_FLUSH_INTERVAL_MS <= 0) {
+        ACCESS_LOG_FLUSH_INTERVAL_MS =
+            FDIR_ACCESS_LOG_DEFAULT_FLUSH_INTERVAL_MS;
+    }
+    if ((result=load_access_log_rotate_size(&ini_context, filename)) != 0) {
+        return result;
+    }
+
+    SLOW_TRACE_THRESHOLD_MS = iniGetIntValue(NULL, "slow_trace_threshold_ms",
+            &ini_context, FDIR_SLOW_TRACE_DEFAULT_THRESHOLD_MS);
+    if (SLOW_TRACE_THRESHOLD_MS < 0) {
+        SLOW_TRACE_THRESHOLD_MS = 0;
+    }
+    SLOW_TRACE_SAMPLE_RATE = iniGetIntValue(NULL, "slow_trace_sample_rate",
+            &ini_context, 0);
+    if (SLOW_TRACE_SAMPLE_RATE < 0) {
+        SLOW_TRACE_SAMPLE_RATE = 0;
+    }
+    SLOW_TRACE_RING_SIZE = iniGetIntValue(NULL, "slow_trace_ring_size",
+            &ini_context, FDIR_SLOW_TRACE_DEFAULT_RING_SIZE);
+    if (SLOW_TRACE_RING_SIZE <= 0) {
+        SLOW_TRACE_RING_SIZE = FDIR_SLOW_TRACE_DEFAULT_RING_SIZE;
+    }
+
+    DENTRY_BLOOM_FILTER_THRESHOLD = iniGetIntValue(NULL,
+            "dentry_bloom_filter_threshold", &ini_context,
+            FDIR_DENTRY_BLOOM_FILTER_THRESHOLD);
+    if (DENTRY_BLOOM_FILTER_THRESHOLD < 0) {
+        DENTRY_BLOOM_FILTER_THRESHOLD = 0;
+    }
+
     g_server_global_vars.namespace_hashtable_capacity = iniGetIntValue(NULL,
             "namespace_hashtable_capacity", &ini_context,
             FDIR_NAMESPACE_HASHTABLE_CAPACITY);
@@ -490,19 +756,45 @@ int server_load_config(const char *filename)
     snprintf(server_config_str, sizeof(server_config_str),
             "cluster_id = %d, my server id = %d, data_path = %s, "
             "dentry_max_data_size = %d, binlog_buffer_size = %d KB, "
+            "binlog_format = %s, binlog_sync_policy = %s, "
+            "binlog_index_interval = %d KB, "
+            "binlog_tail_cache_size = %d MB, "
+            "binlog_compress = %s, binlog_compress_block_size = %d KB, "
+            "binlog retention {bytes: %"PRId64" MB, versions: %"PRId64", "
+            "compact_interval: %d s, archive: %d}, "
+            "dentry_bloom_filter_threshold = %d, "
             "admin config {username: %s, secret_key: %s}, "
             "reload_interval_ms = %d ms, "
             "check_alive_interval = %d s, "
             "namespace_hashtable_capacity = %d, "
+            "access_log {enabled: %d, ring_size: %d, "
+            "flush_interval_ms: %d, rotate_size: %"PRId64" MB}, "
+            "slow_trace {threshold_ms: %d, sample_rate: %d, "
+            "ring_size: %d}, "
             "cluster server count = %d",
             CLUSTER_ID, CLUSTER_MY_SERVER_ID,
             DATA_PATH_STR, DENTRY_MAX_DATA_SIZE,
-            BINLOG_BUFFER_SIZE / 1024,
+            BINLOG_BUFFER_SIZE / 1024, BINLOG_FORMAT ==
+            FDIR_BINLOG_FORMAT_BINARY ? "binary" : "text",
+            get_binlog_sync_policy_caption(BINLOG_SYNC_POLICY),
+            BINLOG_INDEX_INTERVAL / 1024,
+            BINLOG_TAIL_CACHE_SIZE / (1024 * 1024),
+            binlog_compress_get_codec_caption(BINLOG_COMPRESS.codec),
+            BINLOG_COMPRESS.block_size / 1024,
+            BINLOG_RETENTION.bytes / (1024 * 1024),
+            BINLOG_RETENTION.versions, BINLOG_RETENTION.compact_interval,
+            BINLOG_RETENTION.archive,
+            DENTRY_BLOOM_FILTER_THRESHOLD,
             g_server_global_vars.admin.username.str,
             g_server_global_vars.admin.secret_key.str,
             g_server_global_vars.reload_interval_ms,
             g_server_global_vars.check_alive_interval,
             g_server_global_vars.namespace_hashtable_capacity,
+            ACCESS_LOG_ENABLED, ACCESS_LOG_RING_SIZE,
+            ACCESS_LOG_FLUSH_INTERVAL_MS,
+            ACCESS_LOG_ROTATE_SIZE / (1024 * 1024),
+            SLOW_TRACE_THRESHOLD_MS, SLOW_TRACE_SAMPLE_RATE,
+            SLOW_TRACE_RING_SIZE,
             FC_SID_SERVER_COUNT(CLUSTER_CONFIG_CTX));
     sf_log_config_ex(server_config_str);
     log_local_host_ip_addrs();
@@ -16,10 +16,25 @@ typedef struct server_global_vars {
 
     int dentry_max_data_size;
 
+    int dentry_bloom_filter_threshold;  //0 for disable
+
     int reload_interval_ms;
 
     int check_alive_interval;
 
+    struct {
+        bool enabled;
+        int ring_size;  //the record count of the ring per work thread
+        int flush_interval_ms;
+        int64_t rotate_size;  //0 for never rotate
+    } access_log;
+
+    struct {
+        int threshold_ms;  //trace the request slower than it, 0 to disable
+        int sample_rate;   //trace one of every sample_rate requests
+        int ring_size;
+    } slow_trace;
+
     struct {
         short id;  //cluster id for generate inode
         bool is_master;  //if I am master
@@ -44,6 +59,20 @@ typedef struct server_global_vars {
         volatile int64_t current_version; //binlog version
         string_t path;   //data path
         int binlog_buffer_size;
+        int binlog_format;  //for the new records
+        int binlog_sync_policy;
+        int binlog_index_interval;  //0 for no offset index
+        int binlog_tail_cache_size; //0 for no tail cache
+        struct {
+            int codec;       //for the sealed binlog files
+            int block_size;  //the plain bytes of a compressed block
+        } compress;
+        struct {
+            int64_t bytes;     //the min bytes of the binlog files to keep
+            int64_t versions;  //the min data versions to keep
+            int compact_interval;  //in seconds, 0 for disable
+            bool archive;      //archive or delete the compacted files
+        } retention;
     } data;
 
     /*
@@ -67,7 +96,15 @@ typedef struct server_global_vars {
 #define CLUSTER_INACTIVE_SLAVES g_server_global_vars.cluster.top.slaves.inactives
 
 #define DENTRY_MAX_DATA_SIZE    g_server_global_vars.dentry_max_data_size
+#define DENTRY_BLOOM_FILTER_THRESHOLD  \
+    g_server_global_vars.dentry_bloom_filter_threshold
 #define BINLOG_BUFFER_SIZE      g_server_global_vars.data.binlog_buffer_size
+#define BINLOG_FORMAT           g_server_global_vars.data.binlog_format
+#define BINLOG_SYNC_POLICY      g_server_global_vars.data.binlog_sync_policy
+#define BINLOG_INDEX_INTERVAL   g_server_global_vars.data.binlog_index_interval
+#define BINLOG_TAIL_CACHE_SIZE  g_server_global_vars.data.binlog_tail_cache_size
+#define BINLOG_RETENTION        g_server_global_vars.data.retention
+#define BINLOG_COMPRESS         g_server_global_vars.data.compress
 #define CURRENT_INODE_SN        g_server_global_vars.inode_generator.sn
 #define INODE_CLUSTER_PART      g_server_global_vars.inode_generator.cluster
 #define DATA_CURRENT_VERSION    g_server_global_vars.data.current_version
@@ -77,6 +114,18 @@ typedef struct server_global_vars {
 
 #define REPLICA_KEY_BUFF        CLUSTER_MYSELF_PTR->key
 
+#define ACCESS_LOG_ENABLED      g_server_global_vars.access_log.enabled
+#define ACCESS_LOG_RING_SIZE    g_server_global_vars.access_log.ring_size
+#define ACCESS_LOG_FLUSH_INTERVAL_MS  \
+    g_server_global_vars.access_log.flush_interval_ms
+#define ACCESS_LOG_ROTATE_SIZE  g_server_global_vars.access_log.rotate_size
+
+#define SLOW_TRACE_THRESHOLD_MS g_server_global_vars.slow_trace.threshold_ms
+#define SLOW_TRACE_SAMPLE_RATE  g_server_global_vars.slow_trace.sample_rate
+#define SLOW_TRACE_RING_SIZE    g_server_global_vars.slow_trace.ring_size
+#define SLOW_TRACE_ENABLED      (SLOW_TRACE_THRESHOLD_MS > 0 || \
+        SLOW_TRACE_SAMPLE_RATE > 0)
+
 #define CLUSTER_GROUP_INDEX     g_server_global_vars.cluster.config.cluster_group_index
 #define SERVICE_GROUP_INDEX     g_server_global_vars.cluster.config.service_group_index
 
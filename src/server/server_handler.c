@@ -23,10 +23,16 @@
 #include "sf/sf_nio.h"
 #include "sf/sf_global.h"
 #include "common/fdir_proto.h"
+#include "common/fdir_func.h"
 #include "binlog/binlog_producer.h"
 #include "binlog/binlog_pack.h"
+#include "binlog/binlog_write_thread.h"
+#include "binlog/binlog_compact.h"
 #include "server_global.h"
 #include "server_func.h"
+#include "access_log.h"
+#include "request_trace.h"
+#include "durable_ack.h"
 #include "dentry.h"
 #include "cluster_relationship.h"
 #include "cluster_topology.h"
@@ -41,18 +47,43 @@
 #define RESP_STATUS     task_context.response.header.status
 
 static volatile int64_t next_token;   //next token for dentry list
+static FDIRServerContext **server_contexts;  //indexed by thread index
 
 int server_handler_init()
 {
+    int bytes;
+
     next_token = ((int64_t)g_current_time) << 32;
+
+    bytes = sizeof(FDIRServerContext *) * g_sf_global_vars.work_threads;
+    server_contexts = (FDIRServerContext **)malloc(bytes);
+    if (server_contexts == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+    memset(server_contexts, 0, bytes);
     return 0;
 }
 
 int server_handler_destroy()
 {   
+    if (server_contexts != NULL) {
+        free(server_contexts);
+        server_contexts = NULL;
+    }
     return 0;
 }
 
+static inline void server_batch_ops_free(FDIRServerBatchOpArray *array)
+{
+    if (array->ops != NULL) {
+        free(array->ops);
+        array->ops = NULL;
+        array->alloc = array->count = 0;
+    }
+}
+
 void server_task_finish_cleanup(struct fast_task_info *task)
 {
     FDIRServerTaskArg *task_arg;
@@ -65,6 +96,9 @@ void server_task_finish_cleanup(struct fast_task_info *task)
     }
 
     dentry_array_free(&task_arg->dentry_list_cache.array);
+    server_batch_ops_free(&task_arg->batch_ops);
+    memset(&task_arg->durable_ack, 0, sizeof(task_arg->durable_ack));
+    task_arg->access_log.parsed = false;
 
     __sync_add_and_fetch(&((FDIRServerTaskArg *)task->arg)->task_version, 1);
     sf_task_finish_clean_up(task);
@@ -286,6 +320,7 @@ static int server_parse_dentry_info(ServerTaskContext *task_context,
         char *start, FDIRPathInfo *path_info)
 {
     FDIRProtoDEntryInfo *proto_dentry;
+    int result;
 
     proto_dentry = (FDIRProtoDEntryInfo *)start;
     path_info->fullname.ns.len = proto_dentry->ns_len;
@@ -325,72 +360,89 @@ static int server_parse_dentry_info(ServerTaskContext *task_context,
         return EINVAL;
     }
 
-    path_info->count = split_string_ex(&path_info->fullname.path, '/',
-        path_info->paths, FDIR_MAX_PATH_COUNT, true);
+    if ((result=fdir_parse_path(&path_info->fullname.ns,
+                    &path_info->fullname.path, path_info->paths,
+                    FDIR_MAX_PATH_COUNT, &path_info->count,
+                    &path_info->parent_hash_code,
+                    &path_info->my_hash_code)) != 0)
+    {
+        RESPONSE.error.length = snprintf(
+                RESPONSE.error.message,
+                sizeof(RESPONSE.error.message),
+                "invalid path: %.*s, %s", path_info->fullname.path.len,
+                path_info->fullname.path.str, result == EOVERFLOW ?
+                "too many path parts" : "path part too long");
+        return result;
+    }
     return 0;
 }
 
-static inline int server_check_and_parse_dentry(ServerTaskContext *task_context,
-        const int front_part_size, const int fixed_part_size)
+static int server_check_and_parse_dentry_ex(ServerTaskContext *task_context,
+        char *body, const int body_len, const int front_part_size,
+        const int fixed_part_size, FDIRPathInfo *path_info)
 {
     int result;
     int req_body_len;
 
-    if ((result=server_check_body_length(task_context,
-                    fixed_part_size + 1, fixed_part_size +
-                    NAME_MAX + PATH_MAX)) != 0)
-    {
-        return result;
+    if (body_len < fixed_part_size + 1) {
+        RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                "request body length: %d < %d",
+                body_len, fixed_part_size + 1);
+        return EINVAL;
+    }
+    if (body_len > fixed_part_size + NAME_MAX + PATH_MAX) {
+        RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                "request body length: %d > %d", body_len,
+                fixed_part_size + NAME_MAX + PATH_MAX);
+        return EINVAL;
     }
 
     if ((result=server_parse_dentry_info(task_context,
-                    REQUEST.body + front_part_size,
-                    &TASK_ARG->path_info)) != 0)
+                    body + front_part_size, path_info)) != 0)
     {
         return result;
     }
 
-    req_body_len = fixed_part_size + TASK_ARG->path_info.fullname.ns.len +
-        TASK_ARG->path_info.fullname.path.len;
-    if (req_body_len != REQUEST.header.body_len) {
+    req_body_len = fixed_part_size + path_info->fullname.ns.len +
+        path_info->fullname.path.len;
+    if (req_body_len != body_len) {
         RESPONSE.error.length = sprintf(
                 RESPONSE.error.message,
                 "body length: %d != expect: %d",
-                REQUEST.header.body_len, req_body_len);
+                body_len, req_body_len);
         return EINVAL;
     }
 
     return 0;
 }
 
-static void server_get_dentry_hashcode(FDIRPathInfo *path_info,
-        const bool include_last)
-{
-    char logic_path[NAME_MAX + PATH_MAX + 2];
-    int len;
-    string_t *part;
-    string_t *end;
-    char *p;
-
-    p = logic_path;
-    memcpy(p, path_info->fullname.ns.str, path_info->fullname.ns.len);
-    p += path_info->fullname.ns.len;
+#define SERVER_TRACE_STAGE(stage) \
+    do { \
+        if (SLOW_TRACE_ENABLED) { \
+            TASK_ARG->stages.timestamps[stage] = get_current_time_us(); \
+        } \
+    } while (0)
 
-    if (include_last) {
-        end = path_info->paths + path_info->count;
-    } else {
-        end = path_info->paths + path_info->count - 1;
-    }
+static inline int server_check_and_parse_dentry(ServerTaskContext *task_context,
+        const int front_part_size, const int fixed_part_size)
+{
+    int result;
 
-    for (part=path_info->paths; part<end; part++) {
-        *p++ = '/';
-        memcpy(p, part->str, part->len);
-        p += part->len;
+    if ((result=server_check_and_parse_dentry_ex(task_context, REQUEST.body,
+                    REQUEST.header.body_len, front_part_size, fixed_part_size,
+                    &TASK_ARG->path_info)) == 0)
+    {
+        SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_PARSED);
     }
+    return result;
+}
 
-    len = p - logic_path;
-    //logInfo("logic_path for hash code: %.*s", len, logic_path);
-    path_info->hash_code = simple_hash(logic_path, len);
+//the hash codes are calculated when parsing the path
+static inline void server_get_dentry_hashcode(FDIRPathInfo *path_info,
+        const bool include_last)
+{
+    path_info->hash_code = include_last ? path_info->my_hash_code :
+        path_info->parent_hash_code;
 }
 
 #define server_get_parent_hashcode(path_info)  \
@@ -400,8 +452,28 @@ static void server_get_dentry_hashcode(FDIRPathInfo *path_info,
     server_get_dentry_hashcode(path_info, true)
 
 
-static int server_binlog_produce(FDIRBinlogRecord *record,
-        const uint64_t hash_code)
+static inline int server_forward_request(ServerTaskContext *task_context,
+        const int target_thread_index)
+{
+    SERVER_CONTEXT->stat.forwarded++;
+    TASK_ARG->forward_start_time = get_current_time_us();
+    REQUEST.done = false;
+    return sf_nio_forward_request(TASK, target_thread_index);
+}
+
+static inline void server_set_binlog_version(ServerTaskContext *task_context,
+        const ServerBinlogRecordBuffer *rbuffer)
+{
+    int64_t last_version;
+
+    last_version = rbuffer->data_version + rbuffer->record_count - 1;
+    if (last_version > TASK_ARG->durable_ack.data_version) {
+        TASK_ARG->durable_ack.data_version = last_version;
+    }
+}
+
+static int server_binlog_produce(ServerTaskContext *task_context,
+        FDIRBinlogRecord *record, const uint64_t hash_code)
 {
     ServerBinlogRecordBuffer *rbuffer;
     int result;
@@ -411,11 +483,14 @@ static int server_binlog_produce(FDIRBinlogRecord *record,
     }
 
     rbuffer->hash_code = hash_code;
+    server_set_binlog_version(task_context, rbuffer);
     record->data_version = rbuffer->data_version;
     record->timestamp = g_current_time;
 
     fast_buffer_reset(&rbuffer->buffer);
     if ((result=binlog_pack_record(record, &rbuffer->buffer)) != 0) {
+        fast_buffer_reset(&rbuffer->buffer);
+        server_binlog_dispatch(rbuffer);
         return result;
     }
 
@@ -429,13 +504,42 @@ static int server_binlog_produce(FDIRBinlogRecord *record,
         record.options.path_info.flags = BINLOG_OPTIONS_PATH_ENABLED; \
     } while (0)
 
+static int server_do_create_dentry(ServerTaskContext *task_context,
+        const FDIRProtoCreateDEntryFront *proto_front,
+        FDIRBinlogRecord *record)
+{
+    int result;
+    int flags;
+
+    flags = buff2int(proto_front->flags);
+    record->stat.mode = buff2int(proto_front->mode);
+
+    record->inode = 0;
+    record->options.flags = 0;
+    record->operation = BINLOG_OP_CREATE_DENTRY_INT;
+    SERVER_SET_RECORD_PATH_INFO((*record), TASK_ARG->path_info);
+    record->stat.ctime = record->stat.mtime = g_current_time;
+    record->stat.size = 0;
+    record->options.ctime = record->options.mtime = 1;
+    record->options.mode = 1;
+    if ((result=dentry_create(SERVER_CONTEXT, &TASK_ARG->path_info,
+                    record, flags)) != 0)
+    {
+        return result;
+    }
+    SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_EXECUTED);
+
+    result = server_binlog_produce(task_context, record,
+            TASK_ARG->path_info.hash_code);
+    SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_BINLOG);
+    return result;
+}
+
 static int server_deal_create_dentry(ServerTaskContext *task_context)
 {
     int result;
-    FDIRProtoCreateDEntryFront *proto_front;
     FDIRBinlogRecord record;
     unsigned int target_thread_index;
-    int flags;
 
     if (!REQUEST.forwarded) {
         if ((result=server_check_and_parse_dentry(task_context,
@@ -449,40 +553,356 @@ static int server_deal_create_dentry(ServerTaskContext *task_context)
         target_thread_index = TASK_ARG->path_info.hash_code %
             g_sf_global_vars.work_threads;
 
-        logInfo("hash_code: %u, target thread_index: %d, "
-                "my thread_index: %d", TASK_ARG->path_info.hash_code,
-                target_thread_index, SERVER_CONTEXT->thread_index);
-
         if (target_thread_index != SERVER_CONTEXT->thread_index) {
-            REQUEST.done = false;
-            return sf_nio_forward_request(TASK, target_thread_index);
+            return server_forward_request(task_context, target_thread_index);
         }
     }
 
-    proto_front = (FDIRProtoCreateDEntryFront *)REQUEST.body;
-    flags = buff2int(proto_front->flags);
-    record.stat.mode = buff2int(proto_front->mode);
+    return server_do_create_dentry(task_context,
+            (FDIRProtoCreateDEntryFront *)REQUEST.body, &record);
+}
+
+static int server_check_alloc_batch_array(ServerTaskContext *task_context,
+        FDIRDentryBatchArray *array, const int count)
+{
+    FDIRDentryBatchEntry *entries;
+    int new_alloc;
+    int bytes;
+
+    if (array->alloc >= count) {
+        return 0;
+    }
+
+    new_alloc = (array->alloc > 0) ? array->alloc : 256;
+    while (new_alloc < count) {
+        new_alloc *= 2;
+    }
+
+    bytes = sizeof(FDIRDentryBatchEntry) * new_alloc;
+    entries = (FDIRDentryBatchEntry *)malloc(bytes);
+    if (entries == NULL) {
+        RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                "malloc %d bytes fail", bytes);
+        return ENOMEM;
+    }
+
+    if (array->entries != NULL) {
+        free(array->entries);
+    }
+    array->entries = entries;
+    array->alloc = new_alloc;
+    return 0;
+}
+
+static int server_parse_batch_names(ServerTaskContext *task_context,
+        const int count, FDIRDentryBatchArray *array)
+{
+    FDIRProtoDEntryNamePart *part;
+    FDIRDentryBatchEntry *entry;
+    FDIRDentryBatchEntry *end;
+    char *p;
+    char *body_end;
+    int result;
+
+    if ((result=server_check_alloc_batch_array(task_context,
+                    array, count)) != 0)
+    {
+        return result;
+    }
+
+    body_end = REQUEST.body + REQUEST.header.body_len;
+    p = TASK_ARG->path_info.fullname.path.str +
+        TASK_ARG->path_info.fullname.path.len;
+    end = array->entries + count;
+    for (entry=array->entries; entry<end; entry++) {
+        part = (FDIRProtoDEntryNamePart *)p;
+        if (body_end - p < sizeof(FDIRProtoDEntryNamePart) ||
+                body_end - p < sizeof(FDIRProtoDEntryNamePart) +
+                part->name_len)
+        {
+            RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                    "name #%d exceeds the body length: %d",
+                    (int)(entry - array->entries),
+                    REQUEST.header.body_len);
+            return EINVAL;
+        }
+
+        FC_SET_STRING_EX(entry->name, part->name_str, part->name_len);
+        entry->index = entry - array->entries;
+        entry->inode = 0;
+        if (entry->name.len == 0 || memchr(entry->name.str, '/',
+                    entry->name.len) != NULL || TASK_ARG->path_info.
+                fullname.path.len + 1 + entry->name.len > PATH_MAX)
+        {
+            entry->result = EINVAL;
+        } else {
+            entry->result = 0;
+        }
+        p += sizeof(FDIRProtoDEntryNamePart) + part->name_len;
+    }
+
+    if (p != body_end) {
+        RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                "body length: %d != expect: %d",
+                REQUEST.header.body_len, (int)(p - REQUEST.body));
+        return EINVAL;
+    }
+
+    array->count = count;
+    return 0;
+}
+
+//pack the records of the entries [start, end) to one record buffer
+static int server_binlog_produce_chunk(ServerTaskContext *task_context,
+        FDIRBinlogRecord *record, char *full_path, const int parent_len,
+        FDIRDentryBatchEntry *start, FDIRDentryBatchEntry *end,
+        const int count, const int bytes)
+{
+    ServerBinlogRecordBuffer *rbuffer;
+    FDIRDentryBatchEntry *entry;
+    int result;
+
+    if ((rbuffer=server_binlog_alloc_rbuffer_ex(count)) == NULL) {
+        return ENOMEM;
+    }
+    rbuffer->hash_code = TASK_ARG->path_info.hash_code;
+    server_set_binlog_version(task_context, rbuffer);
+    fast_buffer_reset(&rbuffer->buffer);
+
+    //reserve the space first, the packing never grows the buffer
+    if ((result=fast_buffer_check(&rbuffer->buffer, bytes)) != 0) {
+        server_binlog_dispatch(rbuffer);
+        return result;
+    }
+
+    record->data_version = rbuffer->data_version;
+    for (entry=start; entry<end; entry++) {
+        if (entry->result != 0) {
+            continue;
+        }
+
+        memcpy(full_path + parent_len + 1, entry->name.str, entry->name.len);
+        record->path.fullname.path.len = parent_len + 1 + entry->name.len;
+        record->inode = entry->inode;
+        if ((result=binlog_pack_record(record, &rbuffer->buffer)) != 0) {
+            fast_buffer_reset(&rbuffer->buffer);
+            server_binlog_dispatch(rbuffer);
+            return result;
+        }
+        record->data_version++;
+    }
+
+    return server_binlog_dispatch(rbuffer);
+}
+
+/* the records are split to the record buffers up to BINLOG_BUFFER_SIZE,
+   the entries whose records can't be produced are rolled back */
+static int server_binlog_produce_batch(ServerTaskContext *task_context,
+        FDIRDentryBatchArray *array, const FDIRDEntryStatus *stat)
+{
+    FDIRBinlogRecord record;
+    FDIRDentryBatchEntry *start;
+    FDIRDentryBatchEntry *entry;
+    FDIRDentryBatchEntry *end;
+    char full_path[PATH_MAX + NAME_MAX + 2];
+    int parent_len;
+    int fixed_size;
+    int record_size;
+    int count;
+    int bytes;
+    int result;
+
+    parent_len = TASK_ARG->path_info.fullname.path.len;
+    while (parent_len > 0 && TASK_ARG->path_info.fullname.
+            path.str[parent_len - 1] == '/')
+    {
+        parent_len--;
+    }
+    memcpy(full_path, TASK_ARG->path_info.fullname.path.str, parent_len);
+    full_path[parent_len] = '/';
 
-    record.inode = 0;
     record.options.flags = 0;
     record.operation = BINLOG_OP_CREATE_DENTRY_INT;
     SERVER_SET_RECORD_PATH_INFO(record, TASK_ARG->path_info);
-    record.stat.ctime = record.stat.mtime = g_current_time;
+    record.path.fullname.path.str = full_path;
+    record.stat = *stat;
     record.options.ctime = record.options.mtime = 1;
     record.options.mode = 1;
-    if ((result=dentry_create(SERVER_CONTEXT, &TASK_ARG->path_info,
-                    &record, flags)) != 0)
+    record.timestamp = g_current_time;
+
+    fixed_size = BINLOG_RECORD_FIXED_FIELDS_MAX_SIZE +
+        TASK_ARG->path_info.fullname.ns.len + parent_len + 1;
+    start = array->entries;
+    end = array->entries + array->count;
+    while (start < end) {
+        count = bytes = 0;
+        for (entry=start; entry<end; entry++) {
+            if (entry->result != 0) {
+                continue;
+            }
+            record_size = fixed_size + entry->name.len;
+            if (count > 0 && bytes + record_size > BINLOG_BUFFER_SIZE) {
+                break;
+            }
+            count++;
+            bytes += record_size;
+        }
+
+        if (count == 0) {
+            break;
+        }
+        if ((result=server_binlog_produce_chunk(task_context, &record,
+                        full_path, parent_len, start, entry,
+                        count, bytes)) != 0)
+        {
+            dentry_batch_rollback(SERVER_CONTEXT, array, start, result);
+            return result;
+        }
+        start = entry;
+    }
+
+    return 0;
+}
+
+static int server_batch_create_output(ServerTaskContext *task_context,
+        FDIRDentryBatchArray *array, const int success_count)
+{
+    FDIRProtoBatchCreateDEntryRespBodyHeader *body_header;
+    FDIRDentryBatchEntry *entry;
+    FDIRDentryBatchEntry *end;
+    char *status_start;
+
+    body_header = (FDIRProtoBatchCreateDEntryRespBodyHeader *)REQUEST.body;
+    status_start = REQUEST.body +
+        sizeof(FDIRProtoBatchCreateDEntryRespBodyHeader);
+    end = array->entries + array->count;
+    for (entry=array->entries; entry<end; entry++) {
+        short2buff(entry->result, status_start + 2 * entry->index);
+    }
+    int2buff(array->count, body_header->count);
+    int2buff(success_count, body_header->success_count);
+
+    RESPONSE.header.body_len = sizeof(FDIRProtoBatchCreateDEntryRespBodyHeader)
+        + 2 * array->count;
+    RESPONSE.header.cmd = FDIR_SERVICE_PROTO_BATCH_CREATE_DENTRY_RESP;
+    task_context->response_done = true;
+    return 0;
+}
+
+static int server_deal_batch_create_dentry(ServerTaskContext *task_context)
+{
+    int result;
+    FDIRProtoBatchCreateDEntryFront *proto_front;
+    FDIRDentryBatchArray *array;
+    FDIRDEntryStatus stat;
+    FDIRDentryBatchEntry *entry;
+    FDIRDentryBatchEntry *end;
+    unsigned int target_thread_index;
+    int count;
+    int fixed_len;
+    int success_count;
+
+    proto_front = (FDIRProtoBatchCreateDEntryFront *)REQUEST.body;
+    if (!REQUEST.forwarded) {
+        if ((result=server_check_min_body_length(task_context,
+                        sizeof(FDIRProtoBatchCreateDEntryBody) + 1)) != 0)
+        {
+            return result;
+        }
+
+        if ((result=server_parse_dentry_info(task_context, REQUEST.body +
+                        sizeof(FDIRProtoBatchCreateDEntryFront),
+                        &TASK_ARG->path_info)) != 0)
+        {
+            return result;
+        }
+
+        count = buff2int(proto_front->count);
+        if (count <= 0 || count > FDIR_BATCH_DENTRY_MAX_COUNT) {
+            RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                    "invalid name count: %d, which <= 0 or > %d",
+                    count, FDIR_BATCH_DENTRY_MAX_COUNT);
+            return EINVAL;
+        }
+
+        fixed_len = sizeof(FDIRProtoBatchCreateDEntryBody) +
+            TASK_ARG->path_info.fullname.ns.len +
+            TASK_ARG->path_info.fullname.path.len;
+        if (REQUEST.header.body_len < fixed_len + count *
+                (sizeof(FDIRProtoDEntryNamePart) + 1))
+        {
+            RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                    "body length: %d is too short for %d names",
+                    REQUEST.header.body_len, count);
+            return EINVAL;
+        }
+
+        SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_PARSED);
+
+        //the children's parent hash code is the hash code of the parent
+        server_get_my_hashcode(&TASK_ARG->path_info);
+        target_thread_index = TASK_ARG->path_info.hash_code %
+            g_sf_global_vars.work_threads;
+        if (target_thread_index != SERVER_CONTEXT->thread_index) {
+            return server_forward_request(task_context, target_thread_index);
+        }
+    }
+
+    array = &SERVER_CONTEXT->batch_array;
+    count = buff2int(proto_front->count);
+    if ((result=server_parse_batch_names(task_context, count, array)) != 0) {
+        return result;
+    }
+
+    stat.mode = buff2int(proto_front->mode);
+    stat.ctime = stat.mtime = g_current_time;
+    stat.size = 0;
+    if ((result=dentry_batch_create(SERVER_CONTEXT, &TASK_ARG->path_info,
+                    array, &stat)) != 0)
     {
         return result;
     }
+    SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_EXECUTED);
+
+    //the failed entries are reported by their status
+    server_binlog_produce_batch(task_context, array, &stat);
+    SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_BINLOG);
+
+    success_count = 0;
+    end = array->entries + array->count;
+    for (entry=array->entries; entry<end; entry++) {
+        if (entry->result == 0) {
+            success_count++;
+        }
+    }
 
-    return server_binlog_produce(&record, TASK_ARG->path_info.hash_code);
+    return server_batch_create_output(task_context, array, success_count);
 }
 
-static int server_deal_remove_dentry(ServerTaskContext *task_context)
+static int server_do_remove_dentry(ServerTaskContext *task_context)
 {
     int result;
     FDIRBinlogRecord record;
+
+    record.options.flags = 0;
+    record.operation = BINLOG_OP_REMOVE_DENTRY_INT;
+    SERVER_SET_RECORD_PATH_INFO(record, TASK_ARG->path_info);
+    if ((result=dentry_remove(SERVER_CONTEXT, &TASK_ARG->path_info,
+                    &record)) != 0)
+    {
+        return result;
+    }
+    SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_EXECUTED);
+
+    result = server_binlog_produce(task_context, &record,
+            TASK_ARG->path_info.hash_code);
+    SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_BINLOG);
+    return result;
+}
+
+static int server_deal_remove_dentry(ServerTaskContext *task_context)
+{
+    int result;
     unsigned int target_thread_index;
 
     if (!REQUEST.forwarded) {
@@ -496,25 +916,355 @@ static int server_deal_remove_dentry(ServerTaskContext *task_context)
         target_thread_index = TASK_ARG->path_info.hash_code %
             g_sf_global_vars.work_threads;
 
-        logInfo("hash_code: %u, target thread_index: %d, my thread_index: %d",
-                TASK_ARG->path_info.hash_code, target_thread_index,
-                SERVER_CONTEXT->thread_index);
+        if (target_thread_index != SERVER_CONTEXT->thread_index) {
+            return server_forward_request(task_context, target_thread_index);
+        }
+    }
+
+    return server_do_remove_dentry(task_context);
+}
+
+static inline void server_pack_dentry_stat(FDIRProtoDEntryStat *proto_stat,
+        const int64_t inode, const FDIRDEntryStatus *stat)
+{
+    long2buff(inode, proto_stat->inode);
+    int2buff(stat->mode, proto_stat->mode);
+    int2buff(stat->ctime, proto_stat->ctime);
+    int2buff(stat->mtime, proto_stat->mtime);
+    long2buff(stat->size, proto_stat->size);
+}
 
+static int server_deal_stat_dentry(ServerTaskContext *task_context)
+{
+    int result;
+    FDIRServerDentry *dentry;
+    unsigned int target_thread_index;
+
+    if (!REQUEST.forwarded) {
+        if ((result=server_check_and_parse_dentry(task_context,
+                        0, sizeof(FDIRProtoStatDEntryBody))) != 0)
+        {
+            return result;
+        }
+
+        //the parent's children are owned by the parent's thread
+        server_get_parent_hashcode(&TASK_ARG->path_info);
+        target_thread_index = TASK_ARG->path_info.hash_code %
+            g_sf_global_vars.work_threads;
         if (target_thread_index != SERVER_CONTEXT->thread_index) {
-            REQUEST.done = false;
-            return sf_nio_forward_request(TASK, target_thread_index);
+            return server_forward_request(task_context, target_thread_index);
         }
     }
 
-    record.options.flags = 0;
-    record.operation = BINLOG_OP_REMOVE_DENTRY_INT;
-    SERVER_SET_RECORD_PATH_INFO(record, TASK_ARG->path_info);
-    if ((result=dentry_remove(SERVER_CONTEXT, &TASK_ARG->path_info,
-                    &record)) != 0)
+    if ((result=dentry_find(SERVER_CONTEXT, &TASK_ARG->path_info,
+                    &dentry)) != 0)
+    {
+        return result;
+    }
+    SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_EXECUTED);
+
+    server_pack_dentry_stat((FDIRProtoDEntryStat *)REQUEST.body,
+            dentry->inode, &dentry->stat);
+    RESPONSE.header.body_len = sizeof(FDIRProtoDEntryStat);
+    RESPONSE.header.cmd = FDIR_SERVICE_PROTO_STAT_DENTRY_RESP;
+    task_context->response_done = true;
+    return 0;
+}
+
+static int server_check_alloc_batch_ops(ServerTaskContext *task_context,
+        FDIRServerBatchOpArray *array, const int count)
+{
+    FDIRServerBatchOp *ops;
+    int new_alloc;
+    int bytes;
+
+    if (array->alloc >= count) {
+        return 0;
+    }
+
+    new_alloc = (array->alloc > 0) ? array->alloc : 16;
+    while (new_alloc < count) {
+        new_alloc *= 2;
+    }
+
+    bytes = sizeof(FDIRServerBatchOp) * new_alloc;
+    ops = (FDIRServerBatchOp *)malloc(bytes);
+    if (ops == NULL) {
+        RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                "malloc %d bytes fail", bytes);
+        return ENOMEM;
+    }
+
+    if (array->ops != NULL) {
+        free(array->ops);
+    }
+    array->ops = ops;
+    array->alloc = new_alloc;
+    return 0;
+}
+
+static int server_parse_batch_op(ServerTaskContext *task_context,
+        FDIRServerBatchOp *op)
+{
+    int front_part_size;
+    int fixed_part_size;
+
+    switch (op->cmd) {
+        case FDIR_SERVICE_PROTO_CREATE_DENTRY:
+            front_part_size = sizeof(FDIRProtoCreateDEntryFront);
+            fixed_part_size = sizeof(FDIRProtoCreateDEntryBody);
+            break;
+        case FDIR_SERVICE_PROTO_REMOVE_DENTRY:
+            front_part_size = 0;
+            fixed_part_size = sizeof(FDIRProtoRemoveDEntry);
+            break;
+        case FDIR_SERVICE_PROTO_STAT_DENTRY_REQ:
+            front_part_size = 0;
+            fixed_part_size = sizeof(FDIRProtoStatDEntryBody);
+            break;
+        default:
+            RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                    "unsupported sub-op cmd: %d", op->cmd);
+            return EINVAL;
+    }
+
+    return server_check_and_parse_dentry_ex(task_context, op->body,
+            op->body_len, front_part_size, fixed_part_size,
+            &TASK_ARG->path_info);
+}
+
+static int server_parse_batch_ops(ServerTaskContext *task_context)
+{
+    FDIRProtoBatchOpFront *proto_front;
+    FDIRProtoBatchOpHeader *op_header;
+    FDIRServerBatchOpArray *array;
+    FDIRServerBatchOp *op;
+    FDIRServerBatchOp *end;
+    char *p;
+    char *body_end;
+    int count;
+    int resp_size;
+    int result;
+
+    if ((result=server_check_min_body_length(task_context,
+                    sizeof(FDIRProtoBatchOpFront))) != 0)
+    {
+        return result;
+    }
+
+    proto_front = (FDIRProtoBatchOpFront *)REQUEST.body;
+    count = buff2int(proto_front->count);
+    if (count <= 0 || count > FDIR_BATCH_OP_MAX_COUNT) {
+        RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                "invalid op count: %d, which <= 0 or > %d",
+                count, FDIR_BATCH_OP_MAX_COUNT);
+        return EINVAL;
+    }
+
+    resp_size = sizeof(FDIRProtoHeader) + sizeof(
+            FDIRProtoBatchOpRespBodyHeader) + count *
+        sizeof(FDIRProtoBatchOpRespBodyPart);
+    if (resp_size > TASK->size) {
+        RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                "response size: %d for %d ops exceeds the task "
+                "buffer size: %d", resp_size, count, TASK->size);
+        return EOVERFLOW;
+    }
+
+    array = &TASK_ARG->batch_ops;
+    if ((result=server_check_alloc_batch_ops(task_context,
+                    array, count)) != 0)
     {
         return result;
     }
-    return server_binlog_produce(&record, TASK_ARG->path_info.hash_code);
+    array->count = count;
+    array->flags = buff2int(proto_front->flags);
+
+    p = REQUEST.body + sizeof(FDIRProtoBatchOpFront);
+    body_end = REQUEST.body + REQUEST.header.body_len;
+    end = array->ops + array->count;
+    for (op=array->ops; op<end; op++) {
+        if (body_end - p < sizeof(FDIRProtoBatchOpHeader)) {
+            RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                    "op #%d exceeds the body length: %d",
+                    (int)(op - array->ops), REQUEST.header.body_len);
+            return EINVAL;
+        }
+
+        op_header = (FDIRProtoBatchOpHeader *)p;
+        op->cmd = op_header->cmd;
+        op->body = p + sizeof(FDIRProtoBatchOpHeader);
+        op->body_len = buff2int(op_header->body_len);
+        if (op->body_len <= 0 || op->body_len > body_end - op->body) {
+            RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                    "op #%d, invalid body length: %d",
+                    (int)(op - array->ops), op->body_len);
+            return EINVAL;
+        }
+
+        if ((result=server_parse_batch_op(task_context, op)) != 0) {
+            return result;
+        }
+
+        server_get_parent_hashcode(&TASK_ARG->path_info);
+        op->thread_index = TASK_ARG->path_info.hash_code %
+            g_sf_global_vars.work_threads;
+        op->done = false;
+        op->result = 0;
+        op->inode = 0;
+        p = op->body + op->body_len;
+    }
+
+    if (p != body_end) {
+        RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                "body length: %d != expect: %d",
+                REQUEST.header.body_len, (int)(p - REQUEST.body));
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+static void server_do_batch_op(ServerTaskContext *task_context,
+        FDIRServerBatchOp *op)
+{
+    FDIRBinlogRecord record;
+    FDIRServerDentry *dentry;
+    int result;
+
+    //the op is validated when parsing, parse again for the path info
+    if ((result=server_parse_batch_op(task_context, op)) == 0) {
+        server_get_parent_hashcode(&TASK_ARG->path_info);
+        switch (op->cmd) {
+            case FDIR_SERVICE_PROTO_CREATE_DENTRY:
+                if ((result=server_do_create_dentry(task_context,
+                                (FDIRProtoCreateDEntryFront *)op->body,
+                                &record)) == 0)
+                {
+                    op->inode = record.inode;
+                    op->stat = record.stat;
+                }
+                break;
+            case FDIR_SERVICE_PROTO_REMOVE_DENTRY:
+                result = server_do_remove_dentry(task_context);
+                break;
+            default:
+                if ((result=dentry_find(SERVER_CONTEXT,
+                                &TASK_ARG->path_info, &dentry)) == 0)
+                {
+                    op->inode = dentry->inode;
+                    op->stat = dentry->stat;
+                }
+                break;
+        }
+    }
+
+    op->result = result;
+    op->done = true;
+}
+
+static int server_batch_op_output(ServerTaskContext *task_context)
+{
+    FDIRProtoBatchOpRespBodyHeader *body_header;
+    FDIRProtoBatchOpRespBodyPart *body_part;
+    FDIRServerBatchOpArray *array;
+    FDIRServerBatchOp *op;
+    FDIRServerBatchOp *end;
+    int success_count;
+
+    array = &TASK_ARG->batch_ops;
+    body_header = (FDIRProtoBatchOpRespBodyHeader *)REQUEST.body;
+    body_part = (FDIRProtoBatchOpRespBodyPart *)(body_header + 1);
+    success_count = 0;
+    end = array->ops + array->count;
+    for (op=array->ops; op<end; op++, body_part++) {
+        memset(body_part, 0, sizeof(FDIRProtoBatchOpRespBodyPart));
+        short2buff(op->result, body_part->status);
+        if (op->result == 0) {
+            success_count++;
+            if (op->cmd != FDIR_SERVICE_PROTO_REMOVE_DENTRY) {
+                server_pack_dentry_stat(&body_part->stat,
+                        op->inode, &op->stat);
+            }
+        }
+    }
+    int2buff(array->count, body_header->count);
+    int2buff(success_count, body_header->success_count);
+
+    RESPONSE.header.body_len = (char *)body_part - REQUEST.body;
+    RESPONSE.header.cmd = FDIR_SERVICE_PROTO_BATCH_OP_RESP;
+    task_context->response_done = true;
+    return 0;
+}
+
+static void server_cancel_batch_ops(FDIRServerBatchOpArray *array)
+{
+    FDIRServerBatchOp *op;
+    FDIRServerBatchOp *end;
+
+    end = array->ops + array->count;
+    for (op=array->ops; op<end; op++) {
+        if (!op->done) {
+            op->result = ECANCELED;
+            op->done = true;
+        }
+    }
+}
+
+/* run the ops owned by this thread then forward the task to the owner
+   thread of the next op, so the ops of one thread are grouped to one hop
+   when the ops can be reordered */
+static int server_deal_batch_op(ServerTaskContext *task_context)
+{
+    FDIRServerBatchOpArray *array;
+    FDIRServerBatchOp *op;
+    FDIRServerBatchOp *end;
+    FDIRServerBatchOp *next;
+    bool any_order;
+    int result;
+
+    if (!REQUEST.forwarded) {
+        if ((result=server_parse_batch_ops(task_context)) != 0) {
+            return result;
+        }
+        SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_PARSED);
+    }
+
+    array = &TASK_ARG->batch_ops;
+    any_order = (array->flags & FDIR_BATCH_OP_FLAGS_ANY_ORDER) != 0;
+    next = NULL;
+    end = array->ops + array->count;
+    for (op=array->ops; op<end; op++) {
+        if (op->done) {
+            continue;
+        }
+
+        if (op->thread_index != SERVER_CONTEXT->thread_index) {
+            if (!any_order) {
+                next = op;
+                break;
+            }
+            if (next == NULL) {
+                next = op;
+            }
+            continue;
+        }
+
+        server_do_batch_op(task_context, op);
+        if (op->result != 0 && (array->flags &
+                    FDIR_BATCH_OP_FLAGS_ABORT_ON_ERROR))
+        {
+            server_cancel_batch_ops(array);
+            next = NULL;
+            break;
+        }
+    }
+
+    if (next != NULL) {
+        return server_forward_request(task_context, next->thread_index);
+    }
+
+    return server_batch_op_output(task_context);
 }
 
 static int server_list_dentry_output(ServerTaskContext *task_context)
@@ -629,6 +1379,262 @@ static int server_deal_list_dentry_next(ServerTaskContext *task_context)
     return server_list_dentry_output(task_context);
 }
 
+static int server_deal_bind_thread(ServerTaskContext *task_context)
+{
+    FDIRProtoBindThreadReq *req;
+    FDIRProtoBindThreadResp *resp;
+    int thread_index;
+    int result;
+
+    req = (FDIRProtoBindThreadReq *)REQUEST.body;
+    if (!REQUEST.forwarded) {
+        if ((result=server_expect_body_length(task_context,
+                        sizeof(FDIRProtoBindThreadReq))) != 0)
+        {
+            return result;
+        }
+
+        thread_index = buff2int(req->thread_index);
+        if (thread_index < 0 || thread_index >=
+                g_sf_global_vars.work_threads)
+        {
+            RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                    "invalid thread index: %d, which < 0 or >= %d",
+                    thread_index, g_sf_global_vars.work_threads);
+            return EINVAL;
+        }
+
+        /* the forwarded task is served by the target thread, so the
+           later requests of this connection are received by it */
+        if (thread_index != SERVER_CONTEXT->thread_index) {
+            return server_forward_request(task_context, thread_index);
+        }
+    }
+
+    resp = (FDIRProtoBindThreadResp *)REQUEST.body;
+    int2buff(g_sf_global_vars.work_threads, resp->work_threads);
+    int2buff(SERVER_CONTEXT->thread_index, resp->thread_index);
+    RESPONSE.header.body_len = sizeof(FDIRProtoBindThreadResp);
+    RESPONSE.header.cmd = FDIR_SERVICE_PROTO_BIND_THREAD_RESP;
+    task_context->response_done = true;
+    return 0;
+}
+
+static int server_deal_service_stat(ServerTaskContext *task_context)
+{
+    FDIRProtoServiceStatRespBodyHeader *body_header;
+    FDIRProtoServiceStatRespBodyPart *body_part;
+    FDIRServerContext *server_context;
+    ServerBinlogSyncStat sync_stat;
+    int result;
+    int i;
+
+    if ((result=server_expect_body_length(task_context, 0)) != 0) {
+        return result;
+    }
+
+    body_header = (FDIRProtoServiceStatRespBodyHeader *)REQUEST.body;
+    body_part = (FDIRProtoServiceStatRespBodyPart *)(body_header + 1);
+    for (i=0; i<g_sf_global_vars.work_threads; i++, body_part++) {
+        server_context = server_contexts[i];
+        if (server_context == NULL) {
+            memset(body_part, 0, sizeof(FDIRProtoServiceStatRespBodyPart));
+        } else {
+            long2buff(server_context->stat.requests, body_part->requests);
+            long2buff(server_context->stat.forwarded, body_part->forwarded);
+            long2buff(server_context->stat.bloom.checks,
+                    body_part->bloom_checks);
+            long2buff(server_context->stat.bloom.negatives,
+                    body_part->bloom_negatives);
+            long2buff(server_context->stat.bloom.false_positives,
+                    body_part->bloom_false_positives);
+            long2buff(server_context->stat.bloom.rebuilds,
+                    body_part->bloom_rebuilds);
+        }
+    }
+    int2buff(g_sf_global_vars.work_threads, body_header->thread_count);
+
+    binlog_write_thread_get_sync_stat(&sync_stat);
+    int2buff(sync_stat.max_time_used, body_header->binlog_sync_max_time_used);
+    long2buff(sync_stat.count, body_header->binlog_sync_count);
+    long2buff(sync_stat.bytes, body_header->binlog_sync_bytes);
+    long2buff(sync_stat.time_used, body_header->binlog_sync_time_used);
+    long2buff(DATA_CURRENT_VERSION, body_header->data_version);
+    long2buff(binlog_compact_get_min_version(),
+            body_header->binlog_min_version);
+
+    RESPONSE.header.body_len = (char *)body_part - REQUEST.body;
+    RESPONSE.header.cmd = FDIR_SERVICE_PROTO_SERVICE_STAT_RESP;
+    task_context->response_done = true;
+    return 0;
+}
+
+static inline void server_pack_latency_percentiles(
+        const FDIRLatencyHistogram *h, FDIRProtoLatencyPercentiles *dest)
+{
+    long2buff(h->count, dest->count);
+    int2buff(latency_histogram_percentile(h, 50.0), dest->p50);
+    int2buff(latency_histogram_percentile(h, 99.0), dest->p99);
+    int2buff(latency_histogram_percentile(h, 99.9), dest->p999);
+    int2buff(h->max, dest->max);
+}
+
+static int server_deal_latency_stat(ServerTaskContext *task_context)
+{
+    FDIRProtoLatencyStatRespBodyHeader *body_header;
+    FDIRProtoLatencyStatCmdPart *cmd_part;
+    FDIRProtoLatencyStatStatusPart *status_part;
+    FDIRCmdLatencyStat *cmd_stat;
+    FDIRCmdLatencyStat merged;
+    char *buff_end;
+    int64_t status_count;
+    int cmd_count;
+    int count;
+    int result;
+    int cmd;
+    int status;
+    int i;
+
+    if ((result=server_expect_body_length(task_context, 0)) != 0) {
+        return result;
+    }
+
+    /* only the commands and the statuses present are responded,
+       the rest is truncated when the task buffer is full */
+    buff_end = TASK->data + TASK->size;
+
+    //the stats are written by the work threads without lock
+    body_header = (FDIRProtoLatencyStatRespBodyHeader *)REQUEST.body;
+    cmd_part = (FDIRProtoLatencyStatCmdPart *)(body_header + 1);
+    cmd_count = 0;
+    for (cmd=0; cmd<FDIR_LATENCY_CMD_COUNT; cmd++) {
+        memset(&merged, 0, sizeof(merged));
+        for (i=0; i<g_sf_global_vars.work_threads; i++) {
+            if (server_contexts[i] == NULL || (cmd_stat=server_contexts[i]->
+                        latency_stat.cmds[cmd]) == NULL)
+            {
+                continue;
+            }
+            merged.errors += cmd_stat->errors;
+            latency_histogram_merge(&merged.total, &cmd_stat->total);
+            latency_histogram_merge(&merged.forwarded, &cmd_stat->forwarded);
+        }
+        if (merged.total.count == 0) {
+            continue;
+        }
+        if ((char *)(cmd_part + 1) > buff_end) {
+            break;
+        }
+
+        memset(cmd_part, 0, sizeof(*cmd_part));
+        cmd_part->cmd = cmd;
+        long2buff(merged.errors, cmd_part->errors);
+        server_pack_latency_percentiles(&merged.total, &cmd_part->total);
+        server_pack_latency_percentiles(&merged.forwarded,
+                &cmd_part->forwarded);
+        cmd_part++;
+        cmd_count++;
+    }
+
+    status_part = (FDIRProtoLatencyStatStatusPart *)cmd_part;
+    count = 0;
+    for (status=1; status<FDIR_LATENCY_STATUS_COUNT; status++) {
+        status_count = 0;
+        for (i=0; i<g_sf_global_vars.work_threads; i++) {
+            if (server_contexts[i] != NULL) {
+                status_count += server_contexts[i]->
+                    latency_stat.status_counts[status];
+            }
+        }
+        if (status_count == 0) {
+            continue;
+        }
+        if ((char *)(status_part + 1) > buff_end) {
+            break;
+        }
+
+        memset(status_part, 0, sizeof(*status_part));
+        short2buff(status, status_part->status);
+        long2buff(status_count, status_part->count);
+        status_part++;
+        count++;
+    }
+    int2buff(cmd_count, body_header->cmd_count);
+    int2buff(count, body_header->status_count);
+
+    RESPONSE.header.body_len = (char *)status_part - REQUEST.body;
+    RESPONSE.header.cmd = FDIR_SERVICE_PROTO_LATENCY_STAT_RESP;
+    task_context->response_done = true;
+    return 0;
+}
+
+static int server_deal_slow_trace(ServerTaskContext *task_context)
+{
+    FDIRProtoSlowTraceReq *req;
+    FDIRProtoSlowTraceRespBodyHeader *body_header;
+    FDIRProtoSlowTraceEntry *proto_entry;
+    FDIRSlowTraceEntry *entries;
+    FDIRSlowTraceEntry *entry;
+    FDIRSlowTraceEntry *end;
+    int max_count;
+    int count;
+    int result;
+
+    if ((result=server_expect_body_length(task_context,
+                    sizeof(FDIRProtoSlowTraceReq))) != 0)
+    {
+        return result;
+    }
+
+    req = (FDIRProtoSlowTraceReq *)REQUEST.body;
+    count = buff2int(req->count);
+    max_count = (TASK->size - sizeof(FDIRProtoHeader) -
+            sizeof(FDIRProtoSlowTraceRespBodyHeader)) /
+        sizeof(FDIRProtoSlowTraceEntry);
+    if (count <= 0 || count > max_count) {
+        count = max_count;
+    }
+
+    entries = (FDIRSlowTraceEntry *)malloc(
+            sizeof(FDIRSlowTraceEntry) * count);
+    if (entries == NULL) {
+        RESPONSE.error.length = sprintf(RESPONSE.error.message,
+                "malloc %d bytes fail",
+                (int)sizeof(FDIRSlowTraceEntry) * count);
+        return ENOMEM;
+    }
+    count = request_trace_fetch(entries, count);
+
+    body_header = (FDIRProtoSlowTraceRespBodyHeader *)REQUEST.body;
+    proto_entry = (FDIRProtoSlowTraceEntry *)(body_header + 1);
+    end = entries + count;
+    for (entry=entries; entry<end; entry++, proto_entry++) {
+        memset(proto_entry, 0, sizeof(FDIRProtoSlowTraceEntry));
+        long2buff(entry->time_us, proto_entry->time_us);
+        int2buff(entry->total, proto_entry->total);
+        int2buff(entry->parse, proto_entry->parse);
+        int2buff(entry->forward, proto_entry->forward);
+        int2buff(entry->execute, proto_entry->execute);
+        int2buff(entry->binlog, proto_entry->binlog);
+        int2buff(entry->send, proto_entry->send);
+        int2buff(entry->req_body_len, proto_entry->req_body_len);
+        short2buff(entry->status, proto_entry->status);
+        short2buff(entry->thread_index, proto_entry->thread_index);
+        proto_entry->cmd = entry->cmd;
+        proto_entry->sampled = entry->sampled;
+        proto_entry->forwarded = entry->forwarded;
+        snprintf(proto_entry->client_ip, sizeof(proto_entry->client_ip),
+                "%s", entry->client_ip);
+    }
+    free(entries);
+    int2buff(count, body_header->count);
+
+    RESPONSE.header.body_len = (char *)proto_entry - REQUEST.body;
+    RESPONSE.header.cmd = FDIR_SERVICE_PROTO_SLOW_TRACE_RESP;
+    task_context->response_done = true;
+    return 0;
+}
+
 static inline void init_task_context(ServerTaskContext *task_context)
 {
     SERVER_CONTEXT = (FDIRServerContext *)TASK->thread_data->arg;
@@ -636,6 +1642,17 @@ static inline void init_task_context(ServerTaskContext *task_context)
 
     if (TASK->nio_stage != SF_NIO_STAGE_FORWARDED) {
         TASK_ARG->req_start_time = get_current_time_us();
+        TASK_ARG->forwarded_time_used = 0;
+        TASK_ARG->durable_ack.data_version = 0;
+        SERVER_CONTEXT->stat.requests++;
+        if (SLOW_TRACE_ENABLED) {
+            memset(&TASK_ARG->stages, 0, sizeof(TASK_ARG->stages));
+            TASK_ARG->stages.sampled = SLOW_TRACE_SAMPLE_RATE > 0 &&
+                SERVER_CONTEXT->stat.requests % SLOW_TRACE_SAMPLE_RATE == 0;
+        }
+    } else {
+        TASK_ARG->forwarded_time_used += get_current_time_us() -
+            TASK_ARG->forward_start_time;
     }
     RESPONSE.header.cmd = FDIR_PROTO_ACK;
     RESPONSE.header.body_len = 0;
@@ -658,11 +1675,71 @@ static inline void init_task_context(ServerTaskContext *task_context)
     }
 }
 
-static inline int deal_task_done(ServerTaskContext *task_context)
+static int deal_task_send(ServerTaskContext *task_context)
 {
-    FDIRProtoHeader *proto_header;
     int r;
     int time_used;
+    bool slow;
+
+    r = sf_send_add_event(TASK);
+    SERVER_TRACE_STAGE(FDIR_TRACE_STAGE_SENT);
+    time_used = (int)(get_current_time_us() - TASK_ARG->req_start_time);
+    slow = (SLOW_TRACE_THRESHOLD_MS > 0 && time_used >=
+            SLOW_TRACE_THRESHOLD_MS * 1000);
+    if (slow) {
+        lwarning("process a request timed used: %d us, "
+                "cmd: %d, req body len: %d, resp body len: %d",
+                time_used, REQUEST.header.cmd,
+                REQUEST.header.body_len,
+                RESPONSE.header.body_len);
+    }
+
+    latency_stat_add(&SERVER_CONTEXT->latency_stat, REQUEST.header.cmd,
+            RESPONSE_STATUS >= 0 ? RESPONSE_STATUS : -1 * RESPONSE_STATUS,
+            time_used, REQUEST.forwarded, TASK_ARG->forwarded_time_used);
+
+    if (SLOW_TRACE_ENABLED && (TASK_ARG->stages.sampled || slow)) {
+        FDIRSlowTraceEntry entry;
+
+        entry.req_body_len = REQUEST.header.body_len;
+        entry.status = RESPONSE_STATUS >= 0 ? RESPONSE_STATUS :
+            -1 * RESPONSE_STATUS;
+        entry.thread_index = SERVER_CONTEXT->thread_index;
+        entry.cmd = REQUEST.header.cmd;
+        entry.forwarded = REQUEST.forwarded;
+        snprintf(entry.client_ip, sizeof(entry.client_ip),
+                "%s", TASK->client_ip);
+        request_trace_add(&entry, TASK_ARG->req_start_time,
+                TASK_ARG->forwarded_time_used, &TASK_ARG->stages);
+    }
+
+    if (ACCESS_LOG_ENABLED) {
+        FDIRAccessLogEntry entry;
+
+        entry.time_us = TASK_ARG->req_start_time;
+        entry.time_used = time_used;
+        entry.req_body_len = REQUEST.header.body_len;
+        entry.resp_body_len = RESPONSE.header.body_len;
+        entry.status = RESPONSE_STATUS;
+        entry.req_cmd = REQUEST.header.cmd;
+        entry.resp_cmd = RESPONSE.header.cmd;
+        entry.thread_index = SERVER_CONTEXT->thread_index;
+        entry.forwarded = REQUEST.forwarded;
+        if (!TASK_ARG->access_log.parsed) {
+            access_log_parse_peer(TASK->client_ip,
+                    &TASK_ARG->access_log.peer);
+            TASK_ARG->access_log.parsed = true;
+        }
+        entry.peer = &TASK_ARG->access_log.peer;
+        access_log_write(&entry);
+    }
+
+    return r == 0 ? RESPONSE_STATUS : r;
+}
+
+static inline int deal_task_done(ServerTaskContext *task_context)
+{
+    FDIRProtoHeader *proto_header;
 
     if (task_context->log_error && RESPONSE.error.length > 0) {
         logError("file: "__FILE__", line: %d, "
@@ -685,33 +1762,54 @@ static inline int deal_task_done(ServerTaskContext *task_context)
         }
     }
 
+    //the req_id of the request header is kept for the client to match
     short2buff(RESPONSE_STATUS >= 0 ? RESPONSE_STATUS : -1 * RESPONSE_STATUS,
             proto_header->status);
     proto_header->cmd = RESPONSE.header.cmd;
     int2buff(RESPONSE.header.body_len, proto_header->body_len);
     TASK->length = sizeof(FDIRProtoHeader) + RESPONSE.header.body_len;
 
-    r = sf_send_add_event(TASK);
-    time_used = (int)(get_current_time_us() - TASK_ARG->req_start_time);
-    if (time_used > 50 * 1000) {
-        lwarning("process a request timed used: %d us, "
-                "cmd: %d, req body len: %d, resp body len: %d",
-                time_used, REQUEST.header.cmd,
-                REQUEST.header.body_len,
-                RESPONSE.header.body_len);
+    if (TASK_ARG->durable_ack.data_version > 0 && BINLOG_SYNC_POLICY !=
+            FDIR_BINLOG_SYNC_POLICY_NONE)
+    {
+        TASK_ARG->durable_ack.req_cmd = REQUEST.header.cmd;
+        TASK_ARG->durable_ack.req_body_len = REQUEST.header.body_len;
+        TASK_ARG->durable_ack.forwarded = REQUEST.forwarded;
+        TASK_ARG->durable_ack.waiting = true;
+        if (durable_ack_hold(SERVER_CONTEXT->thread_index, TASK,
+                    TASK_ARG->durable_ack.data_version) == 0)
+        {
+            return 0;
+        }
+        TASK_ARG->durable_ack.waiting = false;
     }
 
-    if (REQUEST.header.cmd != FDIR_CLUSTER_PROTO_PING_MASTER_REQ) {
-    logInfo("file: "__FILE__", line: %d, thread: #%d, forwarded: %d, "
-            "client ip: %s, req cmd: %d, req body_len: %d, "
-            "resp cmd: %d, status: %d, resp body_len: %d, "
-            "time used: %d us", __LINE__, SERVER_CONTEXT->thread_index,
-            REQUEST.forwarded, TASK->client_ip, REQUEST.header.cmd,
-            REQUEST.header.body_len, RESPONSE.header.cmd,
-            RESPONSE_STATUS, RESPONSE.header.body_len, time_used);
-    }
+    return deal_task_send(task_context);
+}
 
-    return r == 0 ? RESPONSE_STATUS : r;
+//send the response held until the binlog synced
+static int deal_durable_ack_resume(struct fast_task_info *task)
+{
+    ServerTaskContext task_context_holder;
+    ServerTaskContext *task_context;
+    FDIRProtoHeader *proto_header;
+
+    task_context = &task_context_holder;
+    TASK = task;
+    SERVER_CONTEXT = (FDIRServerContext *)TASK->thread_data->arg;
+    TASK_ARG = (FDIRServerTaskArg *)TASK->arg;
+    TASK_ARG->durable_ack.waiting = false;
+    TASK->nio_stage = SF_NIO_STAGE_SEND;
+
+    REQUEST.header.cmd = TASK_ARG->durable_ack.req_cmd;
+    REQUEST.header.body_len = TASK_ARG->durable_ack.req_body_len;
+    REQUEST.forwarded = TASK_ARG->durable_ack.forwarded;
+
+    proto_header = (FDIRProtoHeader *)TASK->data;
+    RESPONSE.header.cmd = proto_header->cmd;
+    RESPONSE.header.body_len = buff2int(proto_header->body_len);
+    RESPONSE_STATUS = buff2short(proto_header->status);
+    return deal_task_send(task_context);
 }
 
 int server_deal_task(struct fast_task_info *task)
@@ -733,6 +1831,27 @@ int server_deal_task(struct fast_task_info *task)
             case FDIR_SERVICE_PROTO_REMOVE_DENTRY:
                 RESP_STATUS = server_deal_remove_dentry(&task_context);
                 break;
+            case FDIR_SERVICE_PROTO_BATCH_CREATE_DENTRY_REQ:
+                RESP_STATUS = server_deal_batch_create_dentry(&task_context);
+                break;
+            case FDIR_SERVICE_PROTO_STAT_DENTRY_REQ:
+                RESP_STATUS = server_deal_stat_dentry(&task_context);
+                break;
+            case FDIR_SERVICE_PROTO_BATCH_OP_REQ:
+                RESP_STATUS = server_deal_batch_op(&task_context);
+                break;
+            case FDIR_SERVICE_PROTO_BIND_THREAD_REQ:
+                RESP_STATUS = server_deal_bind_thread(&task_context);
+                break;
+            case FDIR_SERVICE_PROTO_SERVICE_STAT_REQ:
+                RESP_STATUS = server_deal_service_stat(&task_context);
+                break;
+            case FDIR_SERVICE_PROTO_LATENCY_STAT_REQ:
+                RESP_STATUS = server_deal_latency_stat(&task_context);
+                break;
+            case FDIR_SERVICE_PROTO_SLOW_TRACE_REQ:
+                RESP_STATUS = server_deal_slow_trace(&task_context);
+                break;
             case FDIR_SERVICE_PROTO_LIST_DENTRY_FIRST_REQ:
                 RESP_STATUS = server_deal_list_dentry_first(&task_context);
                 break;
@@ -791,6 +1910,11 @@ void *server_alloc_thread_extra_data(const int thread_index)
     }
 
     server_context->thread_index = thread_index;
+    if (server_contexts != NULL && thread_index <
+            g_sf_global_vars.work_threads)
+    {
+        server_contexts[thread_index] = server_context;
+    }
     return server_context;
 }
 
@@ -854,6 +1978,9 @@ int server_thread_loop(struct nio_thread_data *thread_data)
     ServerDelayFreeNode *node;
     ServerDelayFreeNode *deleted;
 
+    durable_ack_deal_ready(((FDIRServerContext *)thread_data->arg)->
+            thread_index, deal_durable_ack_resume);
+
     delay_context = &((FDIRServerContext *)thread_data->arg)->
         delay_free_context;
     if (delay_context->last_check_time == g_current_time ||
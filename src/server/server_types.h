@@ -10,6 +10,9 @@
 #include "fastcommon/uniq_skiplist.h"
 #include "fastcommon/server_id_func.h"
 #include "common/fdir_types.h"
+#include "latency_stat.h"
+#include "request_trace.h"
+#include "access_log.h"
 
 #define FDIR_CLUSTER_ID_BITS                 10
 #define FDIR_CLUSTER_ID_MAX                  ((1 << FDIR_CLUSTER_ID_BITS) - 1)
@@ -17,6 +20,18 @@
 #define FDIR_SERVER_DEFAULT_RELOAD_INTERVAL       500
 #define FDIR_SERVER_DEFAULT_CHECK_ALIVE_INTERVAL  300
 #define FDIR_NAMESPACE_HASHTABLE_CAPACITY        1361
+#define FDIR_DENTRY_BLOOM_FILTER_THRESHOLD        1024
+
+#define FDIR_BINLOG_FORMAT_TEXT    0
+#define FDIR_BINLOG_FORMAT_BINARY  1
+
+#define FDIR_BINLOG_SYNC_POLICY_NONE    0  //respond without waiting for fsync
+#define FDIR_BINLOG_SYNC_POLICY_GROUP   1  //respond after the batch fsynced
+#define FDIR_BINLOG_SYNC_POLICY_PER_OP  2  //fsync and respond per request
+
+#define FDIR_BINLOG_COMPRESS_NONE  0
+#define FDIR_BINLOG_COMPRESS_ZLIB  1
+#define FDIR_BINLOG_COMPRESS_LZ4   2
 
 typedef void (*server_free_func)(void *ptr);
 typedef void (*server_free_func_ex)(void *ctx, void *ptr);
@@ -57,9 +72,37 @@ typedef struct server_delay_free_context {
     struct fast_mblock_man allocator;
 } ServerDelayFreeContext;
 
+typedef struct fdir_dentry_batch_entry {
+    string_t name;
+    int64_t inode;
+    int index;   //the index in the request
+    int result;  //the errno, 0 for success
+} FDIRDentryBatchEntry;
+
+typedef struct fdir_dentry_batch_array {
+    int alloc;
+    int count;
+    struct fdir_server_dentry *parent;  //set by dentry_batch_create
+    FDIRDentryBatchEntry *entries;
+} FDIRDentryBatchArray;
+
+typedef struct fdir_server_thread_stat {
+    volatile int64_t requests;   //the requests received by this thread
+    volatile int64_t forwarded;  //the requests forwarded to other threads
+    struct {
+        volatile int64_t checks;     //the lookups checked by the filter
+        volatile int64_t negatives;  //the lookups skipped by the filter
+        volatile int64_t false_positives;
+        volatile int64_t rebuilds;
+    } bloom;  //the bloom filters of the large directories
+} FDIRServerThreadStat;
+
 typedef struct fdir_server_context {
     FDIRDentryContext dentry_context;
     ServerDelayFreeContext delay_free_context;
+    FDIRDentryBatchArray batch_array;  //for batch create
+    FDIRServerThreadStat stat;
+    FDIRLatencyStat latency_stat;
     int thread_index;
 } FDIRServerContext;
 
@@ -68,7 +111,9 @@ typedef struct fdir_path_info {
 
     string_t paths[FDIR_MAX_PATH_COUNT];   //splited path parts
     int count;
-    unsigned int hash_code;
+    unsigned int parent_hash_code;
+    unsigned int my_hash_code;
+    unsigned int hash_code;   //the parent's or mine for routing
 } FDIRPathInfo;
 
 struct fdir_server_dentry;
@@ -89,9 +134,30 @@ typedef struct fdir_cluster_server_array {
     FDIRClusterServerInfo *servers;
 } FDIRClusterServerArray;
 
+typedef struct fdir_server_batch_op {
+    char *body;         //the sub-op body in the request
+    int body_len;
+    int thread_index;   //the owner thread of the parent
+    unsigned char cmd;  //the sub-op command
+    bool done;
+    short result;       //the errno, 0 for success
+    int64_t inode;
+    FDIRDEntryStatus stat;
+} FDIRServerBatchOp;
+
+typedef struct fdir_server_batch_op_array {
+    int alloc;
+    int count;
+    int flags;
+    FDIRServerBatchOp *ops;
+} FDIRServerBatchOpArray;
+
 typedef struct server_task_arg {
     volatile int64_t task_version;
     int64_t req_start_time;
+    int64_t forward_start_time;   //the time of the last forwarding
+    int64_t forwarded_time_used;  //the total time waiting in forwarding
+    FDIRRequestStages stages;     //for slow trace
     FDIRPathInfo path_info;
     struct {
         FDIRServerDentryArray array;
@@ -100,7 +166,22 @@ typedef struct server_task_arg {
         time_t expires;  //expire time
     } dentry_list_cache; //for dentry_list
 
+    FDIRServerBatchOpArray batch_ops;     //for batch op
+
     FDIRClusterServerInfo *cluster_peer;  //the peer server in the cluster
+
+    struct {
+        bool parsed;
+        FDIRAccessLogPeer peer;  //the client address of the connection
+    } access_log;
+
+    struct {
+        int64_t data_version;  //the last binlog data version produced
+        int req_body_len;      //the request info for the held response
+        unsigned char req_cmd;
+        bool forwarded;
+        bool waiting;          //waiting for the binlog synced
+    } durable_ack;
 } FDIRServerTaskArg;
 
 typedef struct {
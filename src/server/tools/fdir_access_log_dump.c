@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "access_log.h"
+
+#define RECORDS_PER_READ  1024
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s <access_log_filename>\n", argv[0]);
+}
+
+static void output_entry(const FDIRAccessLogEntry *entry)
+{
+    time_t t;
+    struct tm tm;
+    char time_buff[32];
+    char client_ip[INET6_ADDRSTRLEN];
+
+    t = entry->time_us / 1000000;
+    localtime_r(&t, &tm);
+    strftime(time_buff, sizeof(time_buff), "%Y-%m-%d %H:%M:%S", &tm);
+    printf("%s.%06d thread: #%d, forwarded: %d, client ip: %s, "
+            "req cmd: %d, req body_len: %d, resp cmd: %d, status: %d, "
+            "resp body_len: %d, time used: %d us\n", time_buff,
+            (int)(entry->time_us % 1000000), entry->thread_index,
+            entry->forwarded, access_log_format_peer(entry->peer,
+                client_ip), entry->req_cmd,
+            entry->req_body_len, entry->resp_cmd, entry->status,
+            entry->resp_body_len, entry->time_used);
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *fp;
+    FDIRAccessLogFileHeader header;
+    FDIRAccessLogRecord records[RECORDS_PER_READ];
+    FDIRAccessLogEntry entry;
+    FDIRAccessLogPeer peer;
+    int count;
+    int i;
+    int result;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    if ((fp=fopen(argv[1], "rb")) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, argv[1], errno, STRERROR(errno));
+        return errno != 0 ? errno : ENOENT;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        return 0;  //empty file
+    }
+    if ((result=access_log_check_file_header(&header)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "access log file %s, %s, expect version: %d",
+                __LINE__, argv[1], result == EINVAL ? "invalid magic" :
+                "unsupported version", FDIR_ACCESS_LOG_VERSION);
+        fclose(fp);
+        return result;
+    }
+
+    while ((count=fread(records, sizeof(FDIRAccessLogRecord),
+                    RECORDS_PER_READ, fp)) > 0)
+    {
+        for (i=0; i<count; i++) {
+            access_log_unpack_record(records + i, &entry, &peer);
+            output_entry(&entry);
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
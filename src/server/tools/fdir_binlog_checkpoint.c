@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "binlog/binlog_compact.h"
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s <data path> [data version]\n"
+            "\tshow the binlog checkpoint, or set it after the data "
+            "before the data version (include) is backed up,\n"
+            "\tthe server compacts the binlog files before the "
+            "checkpoint\n", argv[0]);
+}
+
+static int get_checkpoint(const char *filename, int64_t *data_version)
+{
+    char content[32];
+    char *endptr;
+    int64_t file_size;
+    int result;
+
+    file_size = sizeof(content) - 1;
+    if ((result=getFileContentEx(filename, content, 0, &file_size)) != 0) {
+        return result;
+    }
+    content[file_size] = '\0';
+
+    endptr = NULL;
+    *data_version = strtoll(content, &endptr, 10);
+    if (!(endptr == NULL || *endptr == '\0')) {
+        logError("file: "__FILE__", line: %d, "
+                "checkpoint filename: %s, invalid data version: %s",
+                __LINE__, filename, content);
+        return EINVAL;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char filename[PATH_MAX];
+    char buff[32];
+    char *endptr;
+    int64_t data_version;
+    int len;
+    int result;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    snprintf(filename, sizeof(filename), "%s/%s",
+            argv[1], BINLOG_CHECKPOINT_FILENAME);
+    if (argc == 2) {
+        if (access(filename, F_OK) != 0) {
+            printf("no checkpoint\n");
+            return 0;
+        }
+        if ((result=get_checkpoint(filename, &data_version)) != 0) {
+            return result;
+        }
+        printf("checkpoint data version: %"PRId64"\n", data_version);
+        return 0;
+    }
+
+    endptr = NULL;
+    data_version = strtoll(argv[2], &endptr, 10);
+    if (data_version <= 0 || (endptr != NULL && *endptr != '\0')) {
+        usage(argv);
+        return 1;
+    }
+
+    len = sprintf(buff, "%"PRId64, data_version);
+    if ((result=safeWriteToFile(filename, buff, len)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "write to file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    printf("checkpoint data version: %"PRId64"\n", data_version);
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "binlog/binlog_codec.h"
+
+typedef struct {
+    int codec;
+    int64_t compress_time;
+    int64_t decompress_time;
+    int64_t bytes;  //the compressed bytes
+} CodecStat;
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s <binlog filename> [block size]\n"
+            "\tcompress and decompress the binlog file by blocks with "
+            "each codec compiled in,\n\tas the binlog compress thread "
+            "does, default block size: %d KB\n", argv[0],
+            FDIR_DEFAULT_BINLOG_COMPRESS_BLOCK_SIZE / 1024);
+}
+
+static int bench_codec(const char *content, const int64_t file_size,
+        const int block_size, CodecStat *stat)
+{
+    const char *block;
+    const char *end;
+    char *out;
+    char *raw;
+    int64_t start_time;
+    int out_size;
+    int raw_length;
+    int length;
+    int result;
+
+    out_size = binlog_codec_compress_bound(stat->codec, block_size);
+    out = (char *)malloc(out_size);
+    raw = (char *)malloc(block_size);
+    if (out == NULL || raw == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, out_size + block_size);
+        return ENOMEM;
+    }
+
+    result = 0;
+    end = content + file_size;
+    for (block=content; block<end; block+=block_size) {
+        raw_length = (end - block < block_size) ? end - block : block_size;
+        start_time = get_current_time_us();
+        if ((result=binlog_codec_compress(stat->codec, block, raw_length,
+                        out, out_size, &length)) != 0)
+        {
+            break;
+        }
+        stat->compress_time += get_current_time_us() - start_time;
+        stat->bytes += length;
+
+        start_time = get_current_time_us();
+        if ((result=binlog_codec_decompress(stat->codec, out, length,
+                        raw, block_size, &length)) != 0)
+        {
+            break;
+        }
+        stat->decompress_time += get_current_time_us() - start_time;
+
+        if (length != raw_length || memcmp(raw, block, raw_length) != 0) {
+            logError("file: "__FILE__", line: %d, "
+                    "the decompressed block at offset %"PRId64" is "
+                    "not the same", __LINE__, (int64_t)(block - content));
+            result = EINVAL;
+            break;
+        }
+    }
+
+    free(out);
+    free(raw);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    const int codecs[] = {FDIR_BINLOG_COMPRESS_ZLIB,
+        FDIR_BINLOG_COMPRESS_LZ4};
+    CodecStat stat;
+    char *content;
+    int64_t file_size;
+    int block_size;
+    int result;
+    int i;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    block_size = argc > 2 ? atoi(argv[2]) :
+        FDIR_DEFAULT_BINLOG_COMPRESS_BLOCK_SIZE;
+    if (block_size <= 0) {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    if ((result=getFileContent(argv[1], &content, &file_size)) != 0) {
+        return result;
+    }
+
+    printf("file size: %"PRId64" bytes, block size: %d KB\n",
+            file_size, block_size / 1024);
+    for (i=0; i<sizeof(codecs) / sizeof(codecs[0]); i++) {
+        if (binlog_compress_check_codec(codecs[i]) != 0) {
+            printf("%-6s: not compiled in\n",
+                    binlog_compress_get_codec_caption(codecs[i]));
+            continue;
+        }
+
+        memset(&stat, 0, sizeof(stat));
+        stat.codec = codecs[i];
+        if ((result=bench_codec(content, file_size,
+                        block_size, &stat)) != 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "codec: %s, errno: %d, error info: %s", __LINE__,
+                    binlog_compress_get_codec_caption(codecs[i]),
+                    result, STRERROR(result));
+            free(content);
+            return result;
+        }
+
+        printf("%-6s: ratio %.2f, compress %.1f MB/s, "
+                "decompress %.1f MB/s\n",
+                binlog_compress_get_codec_caption(codecs[i]),
+                (double)file_size / (stat.bytes > 0 ? stat.bytes : 1),
+                (double)file_size / (stat.compress_time > 0 ?
+                    stat.compress_time : 1),
+                (double)file_size / (stat.decompress_time > 0 ?
+                    stat.decompress_time : 1));
+    }
+
+    free(content);
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/fast_buffer.h"
+#include "binlog/binlog_pack.h"
+
+#define READ_BUFFER_SIZE  (256 * 1024)
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s <text | binary> <src binlog filename> "
+            "<dest binlog filename>\n"
+            "\tconvert the records of the source binlog to the "
+            "specified format\n", argv[0]);
+}
+
+static int convert_records(const char *buff, const int length,
+        const int format, FastBuffer *out, int *consumed,
+        int64_t *record_count)
+{
+    FDIRBinlogRecord record;
+    const char *p;
+    const char *end;
+    const char *rec_end;
+    char error_info[256];
+    int result;
+
+    p = buff;
+    end = buff + length;
+    while (p < end) {
+        *error_info = '\0';
+        if ((result=binlog_unpack_record(p, end - p, &record,
+                        &rec_end, error_info)) != 0)
+        {
+            if (result == EAGAIN || result == EOVERFLOW) {
+                break;
+            }
+
+            logError("file: "__FILE__", line: %d, "
+                    "unpack record fail, record no: %"PRId64", "
+                    "errno: %d, error info: %s", __LINE__,
+                    *record_count + 1, result, error_info);
+            return result;
+        }
+
+        if ((result=binlog_pack_record_ex(&record, format, out)) != 0) {
+            return result;
+        }
+        (*record_count)++;
+        p = rec_end;
+    }
+
+    *consumed = p - buff;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in;
+    FILE *out;
+    FastBuffer buffer;
+    char *buff;
+    int format;
+    int length;
+    int bytes;
+    int consumed;
+    int64_t record_count;
+    int64_t in_bytes;
+    int64_t out_bytes;
+    int result;
+
+    if (argc < 4) {
+        usage(argv);
+        return 1;
+    }
+
+    if (strcasecmp(argv[1], "text") == 0) {
+        format = FDIR_BINLOG_FORMAT_TEXT;
+    } else if (strcasecmp(argv[1], "binary") == 0) {
+        format = FDIR_BINLOG_FORMAT_BINARY;
+    } else {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    if ((result=binlog_pack_init()) != 0) {
+        return result;
+    }
+    if ((result=fast_buffer_init_ex(&buffer, READ_BUFFER_SIZE)) != 0) {
+        return result;
+    }
+    if ((buff=(char *)malloc(READ_BUFFER_SIZE)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, READ_BUFFER_SIZE);
+        return ENOMEM;
+    }
+
+    if ((in=fopen(argv[2], "rb")) == NULL) {
+        result = errno != 0 ? errno : ENOENT;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, argv[2], result, STRERROR(result));
+        return result;
+    }
+    if ((out=fopen(argv[3], "wb")) == NULL) {
+        result = errno != 0 ? errno : EACCES;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, argv[3], result, STRERROR(result));
+        return result;
+    }
+
+    record_count = 0;
+    in_bytes = out_bytes = 0;
+    length = 0;
+    result = 0;
+    while ((bytes=fread(buff + length, 1, READ_BUFFER_SIZE - length,
+                    in)) > 0)
+    {
+        length += bytes;
+        fast_buffer_reset(&buffer);
+        if ((result=convert_records(buff, length, format, &buffer,
+                        &consumed, &record_count)) != 0)
+        {
+            break;
+        }
+
+        if (buffer.length > 0 && fwrite(buffer.data, 1,
+                    buffer.length, out) != buffer.length)
+        {
+            result = errno != 0 ? errno : EIO;
+            logError("file: "__FILE__", line: %d, "
+                    "write to file %s fail, errno: %d, error info: %s",
+                    __LINE__, argv[3], result, STRERROR(result));
+            break;
+        }
+
+        in_bytes += consumed;
+        out_bytes += buffer.length;
+        length -= consumed;
+        if (length > 0) {
+            memmove(buff, buff + consumed, length);
+        }
+    }
+
+    if (result == 0 && length > 0) {
+        logWarning("file: "__FILE__", line: %d, "
+                "the last %d bytes of file %s is not a complete "
+                "record, skipped", __LINE__, length, argv[2]);
+    }
+
+    fclose(in);
+    if (fclose(out) != 0 && result == 0) {
+        result = errno != 0 ? errno : EIO;
+    }
+
+    if (result == 0) {
+        printf("record count: %"PRId64", %"PRId64" bytes => "
+                "%"PRId64" bytes\n", record_count, in_bytes, out_bytes);
+    }
+    return result;
+}
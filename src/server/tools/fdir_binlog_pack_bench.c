@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/fast_buffer.h"
+#include "binlog/binlog_pack.h"
+
+#define DEFAULT_RECORD_COUNT  (1024 * 1024)
+#define MAX_PATH_DEPTH        8
+
+typedef struct {
+    FDIRBinlogRecord *records;
+    char *path_buff;
+    int count;
+} RecordArray;
+
+typedef struct {
+    const char *caption;
+    int format;
+    int64_t pack_time;
+    int64_t unpack_time;
+    int64_t bytes;
+} FormatStat;
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [record count]\n"
+            "\ttime the pack and unpack of the create, update and remove "
+            "records\n\tin the text and the binary formats, default "
+            "record count: %d\n", argv[0], DEFAULT_RECORD_COUNT);
+}
+
+//the records of the deep paths, as the ingest jobs produce
+static int generate_records(RecordArray *array, const int count)
+{
+    FDIRBinlogRecord *record;
+    char *p;
+    int64_t bytes;
+    int depth;
+    int i;
+    int k;
+
+    array->count = count;
+    bytes = sizeof(FDIRBinlogRecord) * (int64_t)count;
+    if ((array->records=(FDIRBinlogRecord *)malloc(bytes)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %"PRId64" bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+    bytes = (int64_t)MAX_PATH_DEPTH * 16 * count;
+    if ((array->path_buff=(char *)malloc(bytes)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %"PRId64" bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+    memset(array->records, 0, sizeof(FDIRBinlogRecord) * count);
+
+    p = array->path_buff;
+    for (i=0; i<count; i++) {
+        record = array->records + i;
+        record->data_version = i + 1;
+        record->inode = 1000000000LL + i;
+        record->timestamp = 1600000000 + i / 1000;
+        record->options.path_info.flags = BINLOG_OPTIONS_PATH_ENABLED;
+        FC_SET_STRING(record->path.fullname.ns, "fdir");
+        record->path.fullname.path.str = p;
+        depth = 2 + rand() % (MAX_PATH_DEPTH - 1);
+        for (k=1; k<depth; k++) {
+            p += sprintf(p, "/dir%d", rand() % 100);
+        }
+        p += sprintf(p, "/file%d", i);
+        record->path.fullname.path.len = p -
+            record->path.fullname.path.str;
+        record->path.hash_code = rand();
+
+        switch (i % 4) {
+            case 0:
+            case 1:
+                record->operation = BINLOG_OP_CREATE_DENTRY_INT;
+                record->options.mode = 1;
+                record->options.ctime = 1;
+                record->options.mtime = 1;
+                record->stat.mode = 0100644;
+                record->stat.ctime = record->stat.mtime =
+                    record->timestamp;
+                break;
+            case 2:
+                record->operation = BINLOG_OP_UPDATE_DENTRY_INT;
+                record->options.mtime = 1;
+                record->options.size = 1;
+                record->stat.mtime = record->timestamp;
+                record->stat.size = rand();
+                break;
+            default:
+                record->operation = BINLOG_OP_REMOVE_DENTRY_INT;
+                break;
+        }
+    }
+    return 0;
+}
+
+static int bench_format(const RecordArray *array, FormatStat *stat,
+        FastBuffer *buffer)
+{
+    FDIRBinlogRecord record;
+    const char *p;
+    const char *end;
+    const char *rec_end;
+    char error_info[256];
+    int64_t start_time;
+    int64_t count;
+    int result;
+    int i;
+
+    fast_buffer_reset(buffer);
+    start_time = get_current_time_us();
+    for (i=0; i<array->count; i++) {
+        if ((result=binlog_pack_record_ex(array->records + i,
+                        stat->format, buffer)) != 0)
+        {
+            return result;
+        }
+    }
+    stat->pack_time = get_current_time_us() - start_time;
+    stat->bytes = buffer->length;
+
+    count = 0;
+    p = buffer->data;
+    end = buffer->data + buffer->length;
+    start_time = get_current_time_us();
+    while (p < end) {
+        *error_info = '\0';
+        if ((result=binlog_unpack_record(p, end - p, &record,
+                        &rec_end, error_info)) != 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "unpack record fail, errno: %d, error info: %s",
+                    __LINE__, result, error_info);
+            return result;
+        }
+        p = rec_end;
+        count++;
+    }
+    stat->unpack_time = get_current_time_us() - start_time;
+
+    if (count != array->count) {
+        logError("file: "__FILE__", line: %d, "
+                "unpack record count: %"PRId64" != %d",
+                __LINE__, count, array->count);
+        return EINVAL;
+    }
+    return 0;
+}
+
+static void output_stat(const FormatStat *stat, const int count)
+{
+    printf("%-8s: pack %.1f ns, unpack %.1f ns, %.1f bytes per record, "
+            "total %"PRId64" bytes\n", stat->caption,
+            (double)stat->pack_time * 1000 / count,
+            (double)stat->unpack_time * 1000 / count,
+            (double)stat->bytes / count, stat->bytes);
+}
+
+int main(int argc, char *argv[])
+{
+    RecordArray array;
+    FastBuffer buffer;
+    FormatStat text;
+    FormatStat binary;
+    int record_count;
+    int result;
+
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 ||
+                strcmp(argv[1], "--help") == 0))
+    {
+        usage(argv);
+        return 0;
+    }
+
+    record_count = argc > 1 ? atoi(argv[1]) : DEFAULT_RECORD_COUNT;
+    if (record_count <= 0) {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    srand(20200101);
+    if ((result=binlog_pack_init()) != 0) {
+        return result;
+    }
+    if ((result=fast_buffer_init_ex(&buffer, 64 * 1024 * 1024)) != 0) {
+        return result;
+    }
+    if ((result=generate_records(&array, record_count)) != 0) {
+        return result;
+    }
+
+    memset(&text, 0, sizeof(text));
+    text.caption = "text";
+    text.format = FDIR_BINLOG_FORMAT_TEXT;
+    memset(&binary, 0, sizeof(binary));
+    binary.caption = "binary";
+    binary.format = FDIR_BINLOG_FORMAT_BINARY;
+    if ((result=bench_format(&array, &text, &buffer)) != 0) {
+        return result;
+    }
+    if ((result=bench_format(&array, &binary, &buffer)) != 0) {
+        return result;
+    }
+
+    printf("record count: %d\n", record_count);
+    output_stat(&text, record_count);
+    output_stat(&binary, record_count);
+    printf("binary / text: pack time %.2f, unpack time %.2f, size %.2f\n",
+            (double)binary.pack_time / (text.pack_time > 0 ?
+                text.pack_time : 1), (double)binary.unpack_time /
+            (text.unpack_time > 0 ? text.unpack_time : 1),
+            (double)binary.bytes / (text.bytes > 0 ? text.bytes : 1));
+
+    fast_buffer_destroy(&buffer);
+    free(array.records);
+    free(array.path_buff);
+    return 0;
+}
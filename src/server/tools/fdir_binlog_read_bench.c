@@ -0,0 +1,262 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "binlog/binlog_pack.h"
+
+typedef struct {
+    const char *caption;
+    int64_t time_used;  //the wall time in microseconds
+    int64_t cpu_time;   //the user and system time in microseconds
+    int64_t bytes;
+    int64_t range_count;
+} ReadStat;
+
+typedef struct {
+    const char *filename;
+    int fd;
+    int sink_fd;
+    int max_bytes;  //the max bytes of a range, as the sync buffer size
+} ReadContext;
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s <binlog filename> [range bytes]\n"
+            "\tread the binlog file by the record aligned ranges "
+            "as the slave catch-up does,\n\tby read() to the buffer and "
+            "by mmap, the ranges are written to /dev/null,\n\t"
+            "default range bytes: %d KB\n", argv[0],
+            FDIR_DEFAULT_BINLOG_BUFFER_SIZE / 1024);
+}
+
+static int64_t get_cpu_time()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+        1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+//cut the range at the end of the last complete record
+static int align_range(const char *buff, int *length)
+{
+    int window;
+    int rstart_offset;
+    int rend_offset;
+    int result;
+    int64_t data_version;
+    char error_info[256];
+
+    window = *length < BINLOG_RECORD_MAX_SIZE ?
+        *length : BINLOG_RECORD_MAX_SIZE;
+    *error_info = '\0';
+    if ((result=binlog_detect_record_reverse_ex(buff + (*length - window),
+                    window, &data_version, &rstart_offset, &rend_offset,
+                    error_info)) != 0)
+    {
+        return result;
+    }
+
+    *length = (*length - window) + rend_offset;
+    return 0;
+}
+
+static int send_range(ReadContext *ctx, ReadStat *stat,
+        const char *buff, const int length)
+{
+    if (write(ctx->sink_fd, buff, length) != length) {
+        return errno != 0 ? errno : EIO;
+    }
+    stat->bytes += length;
+    stat->range_count++;
+    return 0;
+}
+
+//as do_binlog_read: move the remain to the head, then fill the buffer
+static int read_by_buffer(ReadContext *ctx, ReadStat *stat)
+{
+    char *buff;
+    char *current;
+    int size;
+    int length;
+    int remain;
+    int bytes;
+    int result;
+
+    size = ctx->max_bytes;
+    if ((buff=(char *)malloc(size)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, size);
+        return ENOMEM;
+    }
+
+    result = 0;
+    current = buff;
+    length = 0;
+    lseek(ctx->fd, 0, SEEK_SET);
+    while (1) {
+        remain = (buff + length) - current;
+        if (current != buff && remain > 0) {
+            memmove(buff, current, remain);
+        }
+        current = buff;
+        length = remain;
+
+        if ((bytes=read(ctx->fd, buff + length, size - length)) < 0) {
+            result = errno != 0 ? errno : EIO;
+            break;
+        }
+        length += bytes;
+        if (length == 0) {
+            break;
+        }
+
+        remain = length;
+        if (align_range(current, &remain) != 0) {
+            break;  //the last record is incomplete
+        }
+        if ((result=send_range(ctx, stat, current, remain)) != 0) {
+            break;
+        }
+        current += remain;
+    }
+
+    free(buff);
+    return result;
+}
+
+//as next_mapped_range: the ranges point to the mapped file
+static int read_by_mmap(ReadContext *ctx, ReadStat *stat)
+{
+    struct stat st;
+    char *base;
+    int64_t offset;
+    int64_t remain;
+    int length;
+    int result;
+
+    if (fstat(ctx->fd, &st) != 0) {
+        return errno != 0 ? errno : EIO;
+    }
+    if (st.st_size == 0) {
+        return 0;
+    }
+
+    base = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, ctx->fd, 0);
+    if (base == MAP_FAILED) {
+        result = errno != 0 ? errno : ENOMEM;
+        logError("file: "__FILE__", line: %d, "
+                "mmap file %s fail, errno: %d, error info: %s",
+                __LINE__, ctx->filename, result, STRERROR(result));
+        return result;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    result = 0;
+    offset = 0;
+    while (offset < st.st_size) {
+        remain = st.st_size - offset;
+        length = remain < ctx->max_bytes ? remain : ctx->max_bytes;
+        if (align_range(base + offset, &length) != 0) {
+            break;
+        }
+        if ((result=send_range(ctx, stat, base + offset, length)) != 0) {
+            break;
+        }
+        offset += length;
+    }
+
+    munmap(base, st.st_size);
+    return result;
+}
+
+static int run_bench(ReadContext *ctx, ReadStat *stat,
+        int (*read_func)(ReadContext *ctx, ReadStat *stat))
+{
+    int64_t start_time;
+    int64_t start_cpu_time;
+    int result;
+
+    start_time = get_current_time_us();
+    start_cpu_time = get_cpu_time();
+    result = read_func(ctx, stat);
+    stat->time_used = get_current_time_us() - start_time;
+    stat->cpu_time = get_cpu_time() - start_cpu_time;
+    return result;
+}
+
+static void output_stat(const ReadStat *stat)
+{
+    printf("%-6s: %"PRId64" bytes, %"PRId64" ranges, %"PRId64" ms, "
+            "cpu %"PRId64" ms, %.1f MB/s, %.1f MB per cpu second\n",
+            stat->caption, stat->bytes, stat->range_count,
+            stat->time_used / 1000, stat->cpu_time / 1000,
+            (double)stat->bytes / (stat->time_used > 0 ?
+                stat->time_used : 1), (double)stat->bytes /
+            (stat->cpu_time > 0 ? stat->cpu_time : 1));
+}
+
+int main(int argc, char *argv[])
+{
+    ReadContext ctx;
+    ReadStat buffered;
+    ReadStat mapped;
+    int result;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    ctx.filename = argv[1];
+    ctx.max_bytes = argc > 2 ? atoi(argv[2]) :
+        FDIR_DEFAULT_BINLOG_BUFFER_SIZE;
+    if (ctx.max_bytes < BINLOG_RECORD_MAX_SIZE) {
+        fprintf(stderr, "range bytes must >= %d\n", BINLOG_RECORD_MAX_SIZE);
+        return 1;
+    }
+
+    log_init();
+    if ((result=binlog_pack_init()) != 0) {
+        return result;
+    }
+    if ((ctx.fd=open(ctx.filename, O_RDONLY)) < 0) {
+        result = errno != 0 ? errno : ENOENT;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, ctx.filename, result, STRERROR(result));
+        return result;
+    }
+    if ((ctx.sink_fd=open("/dev/null", O_WRONLY)) < 0) {
+        return errno != 0 ? errno : ENOENT;
+    }
+
+    memset(&buffered, 0, sizeof(buffered));
+    buffered.caption = "read";
+    memset(&mapped, 0, sizeof(mapped));
+    mapped.caption = "mmap";
+    if ((result=run_bench(&ctx, &buffered, read_by_buffer)) != 0 ||
+            (result=run_bench(&ctx, &mapped, read_by_mmap)) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "read file %s fail, errno: %d, error info: %s",
+                __LINE__, ctx.filename, result, STRERROR(result));
+        return result;
+    }
+
+    output_stat(&buffered);
+    output_stat(&mapped);
+    close(ctx.fd);
+    close(ctx.sink_fd);
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "binlog/binlog_pack.h"
+
+#define READ_BUFFER_SIZE  (4 * 1024 * 1024)
+
+//the tail length for the last record detect, as the binlog reader does
+#define REVERSE_WINDOW_SIZE  BINLOG_RECORD_MAX_SIZE
+
+typedef struct {
+    const char *caption;
+    int64_t time_used;  //in microseconds
+    int64_t record_count;
+    int64_t version_sum;
+} ScanStat;
+
+typedef struct {
+    ScanStat forward;   //detect the records one by one
+    ScanStat resync;    //search the next record start from each start + 1
+    ScanStat reverse;   //detect the last record of each buffer
+    int64_t bytes;
+    int64_t skipped;    //the bytes without a record start
+} ScanContext;
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s <binlog filename> [binlog filename ...]\n"
+            "\tscan the record boundaries of the binlog files in the "
+            "memory, the forward detect,\n\tthe resync from the inside of "
+            "each record and the last record detect of each %d KB\n\t"
+            "are timed separately, the file reading is not timed\n",
+            argv[0], READ_BUFFER_SIZE / 1024);
+}
+
+static int scan_forward(ScanContext *ctx, const char *buff,
+        const int length, int *consumed)
+{
+    const char *p;
+    const char *end;
+    char error_info[256];
+    int64_t start_time;
+    int64_t data_version;
+    int rstart_offset;
+    int rend_offset;
+    int result;
+
+    start_time = get_current_time_us();
+    p = buff;
+    end = buff + length;
+    while (p < end) {
+        *error_info = '\0';
+        if ((result=binlog_detect_record_forward(p, end - p, &data_version,
+                        &rstart_offset, &rend_offset, error_info)) != 0)
+        {
+            break;
+        }
+        ctx->forward.record_count++;
+        ctx->forward.version_sum += data_version;
+        p += rend_offset;
+    }
+    ctx->forward.time_used += get_current_time_us() - start_time;
+
+    *consumed = p - buff;
+    return p == buff ? ENOENT : 0;
+}
+
+static void scan_resync(ScanContext *ctx, const char *buff, const int length)
+{
+    const char *p;
+    const char *end;
+    char error_info[256];
+    int64_t start_time;
+    int64_t data_version;
+    int rstart_offset;
+    int rend_offset;
+
+    start_time = get_current_time_us();
+    p = buff;
+    end = buff + length;
+    while (p < end) {
+        *error_info = '\0';
+        if (binlog_detect_record_forward(p, end - p, &data_version,
+                    &rstart_offset, &rend_offset, error_info) != 0)
+        {
+            break;
+        }
+        ctx->resync.record_count++;
+        ctx->resync.version_sum += data_version;
+
+        //as the recovery from a corrupt record, scan over its body
+        p += rstart_offset + 1;
+    }
+    ctx->resync.time_used += get_current_time_us() - start_time;
+}
+
+static void scan_reverse(ScanContext *ctx, const char *buff, const int length)
+{
+    char error_info[256];
+    int64_t start_time;
+    int64_t data_version;
+    int rstart_offset;
+    int window;
+
+    start_time = get_current_time_us();
+    window = length < REVERSE_WINDOW_SIZE ? length : REVERSE_WINDOW_SIZE;
+    *error_info = '\0';
+    if (binlog_detect_record_reverse(buff + (length - window), window,
+                &data_version, &rstart_offset, error_info) == 0)
+    {
+        ctx->reverse.record_count++;
+        ctx->reverse.version_sum += data_version;
+    }
+    ctx->reverse.time_used += get_current_time_us() - start_time;
+}
+
+static int scan_file(ScanContext *ctx, const char *filename, char *buff)
+{
+    FILE *fp;
+    int length;
+    int bytes;
+    int consumed;
+
+    if ((fp=fopen(filename, "rb")) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, errno, STRERROR(errno));
+        return errno != 0 ? errno : ENOENT;
+    }
+
+    length = 0;
+    while ((bytes=fread(buff + length, 1, READ_BUFFER_SIZE - length,
+                    fp)) > 0)
+    {
+        length += bytes;
+        if (scan_forward(ctx, buff, length, &consumed) != 0) {
+            if (length < READ_BUFFER_SIZE) {
+                continue;  //read more for the record
+            }
+            ctx->skipped += length;
+            consumed = length;
+        } else {
+            scan_resync(ctx, buff, consumed);
+            scan_reverse(ctx, buff, consumed);
+        }
+
+        ctx->bytes += consumed;
+        length -= consumed;
+        if (length > 0) {
+            memmove(buff, buff + consumed, length);
+        }
+    }
+
+    if (length > 0) {
+        ctx->skipped += length;
+        logWarning("file: "__FILE__", line: %d, "
+                "the last %d bytes of file %s is not a complete "
+                "record, skipped", __LINE__, length, filename);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static void output_stat(const ScanStat *stat, const int64_t bytes)
+{
+    int64_t time_used;
+
+    time_used = stat->time_used > 0 ? stat->time_used : 1;
+    printf("%-8s: %"PRId64" ms, %.1f MB/s, record count: %"PRId64", "
+            "version sum: %"PRId64"\n", stat->caption, stat->time_used /
+            1000, (double)bytes / time_used, stat->record_count,
+            stat->version_sum);
+}
+
+static void output_reverse_stat(const ScanStat *stat)
+{
+    printf("%-8s: %"PRId64" us, %.1f us per detect, detect count: %"PRId64
+            ", version sum: %"PRId64"\n", stat->caption, stat->time_used,
+            stat->record_count > 0 ? (double)stat->time_used /
+            stat->record_count : 0.0, stat->record_count,
+            stat->version_sum);
+}
+
+int main(int argc, char *argv[])
+{
+    ScanContext ctx;
+    char *buff;
+    int result;
+    int i;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    if ((result=binlog_pack_init()) != 0) {
+        return result;
+    }
+    if ((buff=(char *)malloc(READ_BUFFER_SIZE)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, READ_BUFFER_SIZE);
+        return ENOMEM;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.forward.caption = "forward";
+    ctx.resync.caption = "resync";
+    ctx.reverse.caption = "reverse";
+    for (i=1; i<argc; i++) {
+        if ((result=scan_file(&ctx, argv[i], buff)) != 0) {
+            free(buff);
+            return result;
+        }
+    }
+
+    printf("scanned bytes: %"PRId64", skipped bytes: %"PRId64"\n",
+            ctx.bytes, ctx.skipped);
+    output_stat(&ctx.forward, ctx.bytes);
+    output_stat(&ctx.resync, ctx.bytes);
+    output_reverse_stat(&ctx.reverse);
+
+    free(buff);
+    return 0;
+}
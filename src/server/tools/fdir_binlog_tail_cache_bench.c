@@ -0,0 +1,346 @@
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "server_global.h"
+#include "binlog/binlog_pack.h"
+#include "binlog/binlog_tail_cache.h"
+
+#define RANDOM_FETCH_COUNT  10000
+
+//the records of one write buffer, as the flush thread appends
+typedef struct {
+    int64_t offset;
+    int64_t first_version;
+    int64_t last_version;
+    int length;
+} FlushChunk;
+
+typedef struct {
+    const char *filename;
+    char *content;
+    int64_t file_size;
+    FlushChunk *chunks;
+    int count;
+    int cached_index;  //the oldest chunk still in the tail cache
+    int64_t cached_bytes;
+} BenchContext;
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s <binlog filename> [tail cache size]\n"
+            "\tappend the binlog file to the tail cache by the write "
+            "buffers of %d KB,\n\tthen catch up the cached records from "
+            "the tail cache and from the file,\n\tdefault tail cache "
+            "size: %d MB\n", argv[0], FDIR_DEFAULT_BINLOG_BUFFER_SIZE /
+            1024, FDIR_DEFAULT_BINLOG_TAIL_CACHE_SIZE / (1024 * 1024));
+}
+
+//split the file by the record boundaries as the write buffers
+static int split_chunks(BenchContext *ctx)
+{
+    FlushChunk *chunk;
+    const char *p;
+    const char *end;
+    char error_info[256];
+    int64_t data_version;
+    int64_t bytes;
+    int rstart_offset;
+    int rend_offset;
+    int result;
+
+    bytes = sizeof(FlushChunk) * (ctx->file_size /
+            BINLOG_RECORD_MAX_SIZE + 2);
+    if ((ctx->chunks=(FlushChunk *)malloc(bytes)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %"PRId64" bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+
+    ctx->count = 0;
+    chunk = NULL;
+    p = ctx->content;
+    end = ctx->content + ctx->file_size;
+    while (p < end) {
+        *error_info = '\0';
+        if ((result=binlog_detect_record_forward(p, end - p, &data_version,
+                        &rstart_offset, &rend_offset, error_info)) != 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "file: %s, offset: %"PRId64", detect record fail, "
+                    "errno: %d, error info: %s", __LINE__, ctx->filename,
+                    (int64_t)(p - ctx->content), result, error_info);
+            return result;
+        }
+        if (rstart_offset != 0) {
+            logError("file: "__FILE__", line: %d, "
+                    "file: %s, offset: %"PRId64", %d bytes before the "
+                    "record", __LINE__, ctx->filename, (int64_t)
+                    (p - ctx->content), rstart_offset);
+            return EINVAL;
+        }
+
+        if (chunk == NULL || chunk->length + rend_offset >
+                BINLOG_BUFFER_SIZE)
+        {
+            chunk = ctx->chunks + ctx->count++;
+            chunk->offset = p - ctx->content;
+            chunk->first_version = data_version;
+            chunk->length = 0;
+        }
+        chunk->last_version = data_version;
+        chunk->length += rend_offset;
+        p += rend_offset;
+    }
+
+    return ctx->count > 0 ? 0 : ENOENT;
+}
+
+static void find_cached_chunks(BenchContext *ctx)
+{
+    int64_t bytes;
+    int i;
+
+    bytes = 0;
+    for (i=ctx->count-1; i>=0; i--) {
+        if (bytes + ctx->chunks[i].length > BINLOG_TAIL_CACHE_SIZE ||
+                (i < ctx->count - 1 && ctx->chunks[i].last_version + 1 !=
+                 ctx->chunks[i + 1].first_version))
+        {
+            break;
+        }
+        bytes += ctx->chunks[i].length;
+    }
+    ctx->cached_index = i + 1;
+    ctx->cached_bytes = bytes;
+}
+
+static int64_t bench_append(BenchContext *ctx)
+{
+    FlushChunk *chunk;
+    FlushChunk *end;
+    int64_t start_time;
+
+    start_time = get_current_time_us();
+    end = ctx->chunks + ctx->count;
+    for (chunk=ctx->chunks; chunk<end; chunk++) {
+        binlog_tail_cache_append(ctx->content + chunk->offset,
+                chunk->length, chunk->first_version, chunk->last_version);
+    }
+    return get_current_time_us() - start_time;
+}
+
+//catch up from the oldest cached record to the end
+static int bench_fetch_cache(BenchContext *ctx, char *buff,
+        int64_t *time_used)
+{
+    int64_t start_time;
+    int64_t last_data_version;
+    int64_t bytes;
+    int length;
+    int result;
+
+    bytes = 0;
+    last_data_version = ctx->chunks[ctx->cached_index].first_version - 1;
+    start_time = get_current_time_us();
+    while (1) {
+        if ((result=binlog_tail_cache_fetch(last_data_version, buff,
+                        BINLOG_BUFFER_SIZE, &length,
+                        &last_data_version)) != 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "fetch after data version: %"PRId64" fail, "
+                    "errno: %d, error info: %s", __LINE__,
+                    last_data_version, result, STRERROR(result));
+            return result;
+        }
+        if (length == 0) {
+            break;
+        }
+        bytes += length;
+    }
+    *time_used = get_current_time_us() - start_time;
+
+    if (bytes != ctx->cached_bytes) {
+        logError("file: "__FILE__", line: %d, "
+                "fetched bytes: %"PRId64" != cached bytes: %"PRId64,
+                __LINE__, bytes, ctx->cached_bytes);
+        return EINVAL;
+    }
+    return 0;
+}
+
+//catch up the same records by read as the binlog reader does
+static int bench_read_file(BenchContext *ctx, char *buff, int64_t *time_used)
+{
+    int64_t start_time;
+    int64_t offset;
+    int64_t end;
+    int64_t data_version;
+    int length;
+    int window;
+    int rstart_offset;
+    int rend_offset;
+    int result;
+    char error_info[256];
+    int fd;
+
+    if ((fd=open(ctx->filename, O_RDONLY)) < 0) {
+        result = errno != 0 ? errno : ENOENT;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, ctx->filename, result, STRERROR(result));
+        return result;
+    }
+
+    result = 0;
+    offset = ctx->chunks[ctx->cached_index].offset;
+    end = ctx->file_size;
+    start_time = get_current_time_us();
+    while (offset < end) {
+        length = (end - offset < BINLOG_BUFFER_SIZE) ?
+            end - offset : BINLOG_BUFFER_SIZE;
+        if ((length=pread(fd, buff, length, offset)) <= 0) {
+            result = errno != 0 ? errno : EIO;
+            break;
+        }
+
+        window = length < BINLOG_RECORD_MAX_SIZE ?
+            length : BINLOG_RECORD_MAX_SIZE;
+        *error_info = '\0';
+        if ((result=binlog_detect_record_reverse_ex(buff + (length -
+                            window), window, &data_version, &rstart_offset,
+                        &rend_offset, error_info)) != 0)
+        {
+            break;
+        }
+        offset += (length - window) + rend_offset;
+    }
+    *time_used = get_current_time_us() - start_time;
+
+    close(fd);
+    return result;
+}
+
+//the lagging slaves fetch from inside of the cached write buffers
+static int bench_random_fetch(BenchContext *ctx, char *buff,
+        int64_t *time_used)
+{
+    FlushChunk *chunk;
+    int64_t start_time;
+    int64_t last_data_version;
+    int64_t data_version;
+    int length;
+    int result;
+    int i;
+
+    *time_used = 0;
+    for (i=0; i<RANDOM_FETCH_COUNT; i++) {
+        chunk = ctx->chunks + ctx->cached_index + rand() %
+            (ctx->count - ctx->cached_index);
+        last_data_version = chunk->first_version - 1 + rand() %
+            (chunk->last_version - chunk->first_version + 1);
+
+        start_time = get_current_time_us();
+        result = binlog_tail_cache_fetch(last_data_version, buff,
+                BINLOG_BUFFER_SIZE, &length, &data_version);
+        *time_used += get_current_time_us() - start_time;
+        if (result != 0) {
+            logError("file: "__FILE__", line: %d, "
+                    "fetch after data version: %"PRId64" fail, "
+                    "errno: %d, error info: %s", __LINE__,
+                    last_data_version, result, STRERROR(result));
+            return result;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchContext ctx;
+    char *buff;
+    int64_t cache_size;
+    int64_t append_time;
+    int64_t fetch_time;
+    int64_t read_time;
+    int64_t random_time;
+    int result;
+
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    cache_size = FDIR_DEFAULT_BINLOG_TAIL_CACHE_SIZE;
+    if (argc > 2 && ((result=parse_bytes(argv[2], 1, &cache_size)) != 0 ||
+                cache_size < FDIR_DEFAULT_BINLOG_BUFFER_SIZE ||
+                cache_size > INT32_MAX))
+    {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    srand(20200101);
+    BINLOG_BUFFER_SIZE = FDIR_DEFAULT_BINLOG_BUFFER_SIZE;
+    BINLOG_TAIL_CACHE_SIZE = cache_size;
+    CLUSTER_SERVER_ARRAY.count = 2;  //the cache is for the slaves only
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.filename = argv[1];
+    if ((result=binlog_pack_init()) != 0 ||
+            (result=binlog_tail_cache_init()) != 0)
+    {
+        return result;
+    }
+    if ((result=getFileContent(ctx.filename, &ctx.content,
+                    &ctx.file_size)) != 0)
+    {
+        return result;
+    }
+    if ((result=split_chunks(&ctx)) != 0) {
+        return result;
+    }
+    find_cached_chunks(&ctx);
+    if ((buff=(char *)malloc(BINLOG_BUFFER_SIZE)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, BINLOG_BUFFER_SIZE);
+        return ENOMEM;
+    }
+
+    append_time = bench_append(&ctx);
+    if ((result=bench_fetch_cache(&ctx, buff, &fetch_time)) != 0 ||
+            (result=bench_read_file(&ctx, buff, &read_time)) != 0 ||
+            (result=bench_random_fetch(&ctx, buff, &random_time)) != 0)
+    {
+        return result;
+    }
+
+    printf("file size: %"PRId64" bytes, write buffer count: %d, "
+            "tail cache size: %d MB, cached bytes: %"PRId64"\n",
+            ctx.file_size, ctx.count, BINLOG_TAIL_CACHE_SIZE /
+            (1024 * 1024), ctx.cached_bytes);
+    printf("append: %.2f us per write buffer, %.1f MB/s\n",
+            (double)append_time / ctx.count, (double)ctx.file_size /
+            (append_time > 0 ? append_time : 1));
+    printf("catch up from cache: %"PRId64" ms, %.1f MB/s\n",
+            fetch_time / 1000, (double)ctx.cached_bytes /
+            (fetch_time > 0 ? fetch_time : 1));
+    printf("catch up from file : %"PRId64" ms, %.1f MB/s\n",
+            read_time / 1000, (double)ctx.cached_bytes /
+            (read_time > 0 ? read_time : 1));
+    printf("random fetch: %.2f us per fetch\n",
+            (double)random_time / RANDOM_FETCH_COUNT);
+
+    binlog_tail_cache_destroy();
+    free(buff);
+    free(ctx.chunks);
+    free(ctx.content);
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/hash.h"
+#include "common/fdir_func.h"
+
+#define DEFAULT_PATH_COUNT  (64 * 1024)
+#define DEFAULT_LOOP_COUNT  32
+#define MIN_PATH_DEPTH      4
+#define MAX_PATH_DEPTH      16
+
+typedef struct {
+    string_t ns;
+    string_t *paths;
+    char *buff;
+    int count;
+} PathArray;
+
+static void usage(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [path count] [loop count]\n"
+            "\tcompare the path split and hash of the old split_string_ex "
+            "+ simple_hash way\n\twith fdir_parse_path on the random "
+            "deep paths, default path count: %d, loop count: %d\n",
+            argv[0], DEFAULT_PATH_COUNT, DEFAULT_LOOP_COUNT);
+}
+
+//the way before fdir_parse_path: split, then rebuild the logic path to hash
+static unsigned int legacy_parse_path(const string_t *ns,
+        const string_t *path, string_t *parts, int *count,
+        unsigned int *parent_hash_code)
+{
+    char logic_path[NAME_MAX + PATH_MAX + 2];
+    char *p;
+    char *last;
+    int i;
+
+    *count = split_string_ex(path, '/', parts,
+            FDIR_MAX_PATH_COUNT, true);
+
+    p = logic_path;
+    memcpy(p, ns->str, ns->len);
+    p += ns->len;
+    last = p;
+    for (i=0; i<*count; i++) {
+        last = p;
+        *p++ = '/';
+        memcpy(p, parts[i].str, parts[i].len);
+        p += parts[i].len;
+    }
+
+    *parent_hash_code = simple_hash(logic_path, last - logic_path);
+    return simple_hash(logic_path, p - logic_path);
+}
+
+static void random_name(char *p, const int len)
+{
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz"
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-.";
+    int i;
+
+    for (i=0; i<len; i++) {
+        p[i] = chars[rand() % (sizeof(chars) - 1)];
+    }
+}
+
+//the realistic paths: 4 ~ 16 levels, 3 ~ 24 chars per level
+static int generate_paths(PathArray *array, const int count)
+{
+    char *p;
+    int bytes;
+    int depth;
+    int len;
+    int i;
+    int k;
+
+    array->ns.str = "bench";
+    array->ns.len = strlen(array->ns.str);
+    array->count = count;
+    bytes = sizeof(string_t) * count;
+    if ((array->paths=(string_t *)malloc(bytes)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+    bytes = MAX_PATH_DEPTH * 25 * count;
+    if ((array->buff=(char *)malloc(bytes)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, bytes);
+        return ENOMEM;
+    }
+
+    p = array->buff;
+    for (i=0; i<count; i++) {
+        array->paths[i].str = p;
+        depth = MIN_PATH_DEPTH + rand() % (MAX_PATH_DEPTH -
+                MIN_PATH_DEPTH + 1);
+        for (k=0; k<depth; k++) {
+            *p++ = '/';
+            len = 3 + rand() % 22;
+            random_name(p, len);
+            p += len;
+        }
+        array->paths[i].len = p - array->paths[i].str;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    PathArray array;
+    string_t parts[FDIR_MAX_PATH_COUNT];
+    int64_t start_time;
+    int64_t legacy_time;
+    int64_t parse_time;
+    int64_t total_bytes;
+    int64_t checksum;
+    unsigned int parent_hash_code;
+    unsigned int hash_code;
+    int path_count;
+    int loop_count;
+    int count;
+    int result;
+    int loop;
+    int i;
+
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 ||
+                strcmp(argv[1], "--help") == 0))
+    {
+        usage(argv);
+        return 0;
+    }
+
+    path_count = argc > 1 ? atoi(argv[1]) : DEFAULT_PATH_COUNT;
+    loop_count = argc > 2 ? atoi(argv[2]) : DEFAULT_LOOP_COUNT;
+    if (path_count <= 0 || loop_count <= 0) {
+        usage(argv);
+        return 1;
+    }
+
+    log_init();
+    srand(20200101);
+    if ((result=generate_paths(&array, path_count)) != 0) {
+        return result;
+    }
+
+    total_bytes = 0;
+    for (i=0; i<array.count; i++) {
+        total_bytes += array.paths[i].len;
+    }
+    total_bytes *= loop_count;
+
+    //the checksums avoid the calls be optimized out
+    checksum = 0;
+    start_time = get_current_time_us();
+    for (loop=0; loop<loop_count; loop++) {
+        for (i=0; i<array.count; i++) {
+            hash_code = legacy_parse_path(&array.ns, array.paths + i,
+                    parts, &count, &parent_hash_code);
+            checksum += hash_code + parent_hash_code + count;
+        }
+    }
+    legacy_time = get_current_time_us() - start_time;
+    printf("split_string_ex + simple_hash: %"PRId64" ms, "
+            "%.1f ns per path, %.1f MB/s, checksum: %"PRId64"\n",
+            legacy_time / 1000, (double)legacy_time * 1000 /
+            ((int64_t)array.count * loop_count), (double)total_bytes /
+            (legacy_time > 0 ? legacy_time : 1), checksum);
+
+    checksum = 0;
+    start_time = get_current_time_us();
+    for (loop=0; loop<loop_count; loop++) {
+        for (i=0; i<array.count; i++) {
+            if ((result=fdir_parse_path(&array.ns, array.paths + i,
+                            parts, FDIR_MAX_PATH_COUNT, &count,
+                            &parent_hash_code, &hash_code)) != 0)
+            {
+                logError("file: "__FILE__", line: %d, "
+                        "fdir_parse_path fail, errno: %d, path: %.*s",
+                        __LINE__, result, array.paths[i].len,
+                        array.paths[i].str);
+                return result;
+            }
+            checksum += hash_code + parent_hash_code + count;
+        }
+    }
+    parse_time = get_current_time_us() - start_time;
+    printf("fdir_parse_path: %"PRId64" ms, %.1f ns per path, "
+            "%.1f MB/s, checksum: %"PRId64"\n", parse_time / 1000,
+            (double)parse_time * 1000 / ((int64_t)array.count *
+                loop_count), (double)total_bytes /
+            (parse_time > 0 ? parse_time : 1), checksum);
+
+    printf("path count: %d, loop count: %d, average path length: %.1f, "
+            "speedup: %.2fx\n", array.count, loop_count, (double)
+            total_bytes / ((int64_t)array.count * loop_count),
+            (double)legacy_time / (parse_time > 0 ? parse_time : 1));
+
+    free(array.paths);
+    free(array.buff);
+    return 0;
+}